@@ -48,6 +48,7 @@ if "%target%" == "main_d3d12" goto main_d3d12
 if "%target%" == "main_reflect_serialize" goto main_reflect_serialize
 if "%target%" == "main_interpreter" goto main_interpreter
 if "%target%" == "main_atof" goto main_atof
+if "%target%" == "main_assets_validate" goto main_assets_validate
 if "%target%" == "data" goto data
 if "%target%" == "reflection" goto reflection
 if "%target%" == "clean" goto clean
@@ -174,6 +175,21 @@ exit /b 0
 
 
 
+REM ######################################################
+REM main_assets_validate
+REM ######################################################
+: main_assets_validate
+
+call vcenv.bat
+set CommonCompilerFlags=%CommonCompilerFlags%
+set CommonLinkerFlags=%CommonLinkerFlags%
+pushd build
+cl %CommonCompilerFlags% ..\code\misc\main_assets_validate.cpp /link %CommonLinkerFlags%
+popd
+exit /b 0
+
+
+
 REM ######################################################
 REM unit_test_ilu
 REM ######################################################
@@ -2,24 +2,43 @@
 ////////////////////////////////////////////////////////////////////////
 // Audio command queue
 
-#define AUDIO_CMD_QUEUE_CAPACITY 64
+#define AUDIO_CMD_QUEUE_CAPACITY 1024
 
 enum AudioCmdType : u32
 {
-	AudioCmd_SourcePlay,
-	AudioCmd_SourcePause,
-	AudioCmd_SourceStop,
+	AudioCmd_VoiceStart,
+	AudioCmd_VoicePlay,
+	AudioCmd_VoicePause,
+	AudioCmd_VoiceStop,
+	AudioCmd_VoiceGainPan,
+	AudioCmd_VoicePitch,
+	AudioCmd_RealVoiceLimit,
 	AudioCmd_MusicPlay,
 	AudioCmd_MusicPause,
 	AudioCmd_MusicStop,
 	AudioCmd_StopAll,
+	AudioCmd_BusGain,
+	AudioCmd_BusReverbSend,
+	AudioCmd_BusFilter,
+	AudioCmd_Reverb,
 };
 
 struct AudioCmd
 {
 	AudioCmdType type;
 	Handle handle; // Clip or Music handle
-	u32 sourceIndex; // For active audio sources
+	AudioVoiceH voice;
+	u8 priority;
+	f32 gain;
+	f32 pan;
+	f32 pitch;
+	u32 realVoiceLimit;
+	AudioBusId bus;
+	AudioFilterType filter;
+	f32 frequency; // Filter cutoff, in Hz
+	f32 q;
+	f32 decaySeconds;
+	f32 damping;
 };
 
 struct AudioCmdQueue
@@ -40,31 +59,209 @@ static void AudioCmdQueue_Push(AudioCmd cmd)
 	queue.writePos = queue.writePos + 1;
 }
 
+// Publishes the stream cursor of a real voice, so the streamer starts loading its chunks
+static void AudioStreamStart(Audio &audio, u32 realVoiceIndex, Handle clip, u32 sampleIndex)
+{
+	AudioStream &stream = audio.streamer.streams[realVoiceIndex];
+
+	u32 &playId = audio.streamer.lastPlayId;
+	if ( ++playId == 0 ) {
+		++playId;
+	}
+
+	// The streamer ignores the cursor while playId is 0
+	stream.playId = 0;
+	FullWriteBarrier();
+	stream.clip = clip.num;
+	stream.chunkIndex = sampleIndex / AUDIO_CHUNK_SAMPLE_COUNT;
+	stream.startSampleIndex = sampleIndex;
+	FullWriteBarrier();
+	stream.playId = playId;
+}
+
+static void AudioStreamStop(Audio &audio, u32 realVoiceIndex)
+{
+	AudioStream &stream = audio.streamer.streams[realVoiceIndex];
+	stream.playId = 0;
+}
+
+// Makes a voice real, mixing it from the stream of a free real voice slot
+static void AudioVoiceMakeReal(Audio &audio, AudioVoice &voice)
+{
+	for (u32 i = 0; i < MAX_AUDIO_REAL_VOICES; ++i)
+	{
+		if ( audio.realVoices[i] == U32_MAX )
+		{
+			audio.realVoices[i] = voice.handle.idx;
+			voice.realVoiceIndex = i;
+			voice.mixing = false;
+			AudioStreamStart(audio, i, voice.clip, voice.lastWriteSampleIndex);
+			break;
+		}
+	}
+}
+
+static void AudioVoiceMakeVirtual(Audio &audio, AudioVoice &voice)
+{
+	if ( voice.realVoiceIndex != INVALID_AUDIO_REAL_VOICE )
+	{
+		AudioStreamStop(audio, voice.realVoiceIndex);
+		audio.realVoices[voice.realVoiceIndex] = U32_MAX;
+		voice.realVoiceIndex = INVALID_AUDIO_REAL_VOICE;
+		voice.mixing = false;
+	}
+}
+
+// Ends the voice at the given position of the active list, so the update thread frees its handle
+static void AudioVoiceEnd(Audio &audio, u32 activeIndex)
+{
+	AudioVoice &voice = audio.voices[audio.activeVoices[activeIndex]];
+	AudioVoiceMakeVirtual(audio, voice);
+	voice.state = AUDIO_STATE_IDLE;
+
+	audio.activeVoices[activeIndex] = audio.activeVoices[--audio.activeVoiceCount];
+
+	FullWriteBarrier();
+	voice.endedHandle = voice.handle.num;
+}
+
+static u32 AudioVoiceActiveIndex(const Audio &audio, const AudioVoice &voice)
+{
+	u32 activeIndex = U32_MAX;
+	for (u32 i = 0; i < audio.activeVoiceCount; ++i) {
+		if ( audio.activeVoices[i] == voice.handle.idx ) {
+			activeIndex = i;
+			break;
+		}
+	}
+	return activeIndex;
+}
+
+// Returns the voice of the handle, or null if it already ended (commands may arrive late)
+static AudioVoice *AudioCmdVoice(Audio &audio, AudioVoiceH handle)
+{
+	AudioVoice &voice = audio.voices[handle.idx];
+	AudioVoice *res = voice.handle == handle && voice.state != AUDIO_STATE_IDLE ? &voice : nullptr;
+	return res;
+}
+
+// Resampling step of a voice, given its pitch and the rate of its clip
+static void AudioVoiceSetPitch(Audio &audio, AudioVoice &voice, f32 pitch)
+{
+	const AudioClip *clip = IsValidHandle(audio.clipHandles, voice.clip) ? &GetAudioClip(audio, voice.clip) : nullptr;
+	const u32 clipRate = clip && clip->samplingRate > 0 ? clip->samplingRate : AUDIO_SAMPLE_RATE;
+
+	voice.pitch = Clamp(pitch, AUDIO_MIN_PITCH, AUDIO_MAX_PITCH);
+	const u64 clipStep = ( (u64)clipRate << 32 ) / AUDIO_SAMPLE_RATE;
+	voice.resampler.step = (u64)( (f64)clipStep * voice.pitch );
+
+	// Once resampled, the voice stays on the resampler even back at the mix rate: its
+	// output lags the clip by the filter delay, so switching paths would skip or repeat
+	// frames and click. Switching to it mid-play starts on the cursor instead, rewound
+	// over the frames of the current chunk already mixed, so they fill the filter.
+	if ( !voice.resampled && voice.resampler.step != AUDIO_RESAMPLER_ONE )
+	{
+		voice.resampled = true;
+		if ( voice.lastWriteSampleIndex > 0 )
+		{
+			// Virtual voices mixed nothing, and streams skip the samples before their start
+			u32 mixedFrameCount = 0;
+			if ( voice.realVoiceIndex != INVALID_AUDIO_REAL_VOICE )
+			{
+				const u32 chunkSampleIndex = voice.lastWriteSampleIndex - voice.lastWriteSampleIndex % AUDIO_CHUNK_SAMPLE_COUNT;
+				const u32 firstSampleIndex = Max(chunkSampleIndex, (u32)audio.streamer.streams[voice.realVoiceIndex].startSampleIndex);
+				mixedFrameCount = firstSampleIndex < voice.lastWriteSampleIndex ? ( voice.lastWriteSampleIndex - firstSampleIndex ) / 2 : 0;
+			}
+			const u32 rewindFrameCount = Min(mixedFrameCount, (u32)( AUDIO_RESAMPLER_HALF_TAPS - 1 ));
+			voice.lastWriteSampleIndex -= rewindFrameCount * 2;
+			voice.resampler.position = (u64)( AUDIO_RESAMPLER_TAPS + rewindFrameCount ) << 32;
+		}
+	}
+}
+
 static void AudioCmdQueue_ProcessCommand(Audio &audio, AudioCmd cmd)
 {
+	AudioVoice *voice = cmd.type < AudioCmd_RealVoiceLimit ? AudioCmdVoice(audio, cmd.voice) : nullptr;
+
 	switch (cmd.type)
 	{
-		case AudioCmd_SourcePlay:
-			audio.sources[cmd.sourceIndex].state = AUDIO_STATE_PLAYING;
+		case AudioCmd_VoiceStart:
+		{
+			AudioVoice &newVoice = audio.voices[cmd.voice.idx];
+			newVoice.handle = cmd.voice;
+			newVoice.clip = cmd.handle;
+			newVoice.lastWriteSampleIndex = 0;
+			newVoice.state = AUDIO_STATE_PLAYING;
+			newVoice.gain = 1.0f;
+			newVoice.pan = 0.0f;
+			InitializeResampler(newVoice.resampler, AudioResamplerQuality_Sinc, &audio.sincFilter, AUDIO_SAMPLE_RATE, AUDIO_SAMPLE_RATE);
+			newVoice.resampled = false;
+			AudioVoiceSetPitch(audio, newVoice, 1.0f);
+			newVoice.priority = cmd.priority;
+			newVoice.mixing = false;
+			newVoice.realVoiceIndex = INVALID_AUDIO_REAL_VOICE;
+			audio.activeVoices[audio.activeVoiceCount++] = cmd.voice.idx;
+			break;
+		}
+		case AudioCmd_VoicePlay:
+			if ( voice ) {
+				voice->state = AUDIO_STATE_PLAYING;
+			}
+			break;
+		case AudioCmd_VoicePause:
+			if ( voice ) {
+				voice->state = AUDIO_STATE_PAUSED;
+			}
+			break;
+		case AudioCmd_VoiceStop:
+			if ( voice ) {
+				AudioVoiceEnd(audio, AudioVoiceActiveIndex(audio, *voice));
+			}
+			break;
+		case AudioCmd_VoiceGainPan:
+			if ( voice ) {
+				voice->gain = cmd.gain;
+				voice->pan = cmd.pan;
+			}
 			break;
-		case AudioCmd_SourcePause:
-			audio.sources[cmd.sourceIndex].state = AUDIO_STATE_PAUSED;
+		case AudioCmd_VoicePitch:
+			if ( voice ) {
+				AudioVoiceSetPitch(audio, *voice, cmd.pitch);
+			}
 			break;
-		case AudioCmd_SourceStop:
-			audio.sources[cmd.sourceIndex] = {};
+		case AudioCmd_RealVoiceLimit:
+			audio.realVoiceLimit = cmd.realVoiceLimit;
 			break;
 		case AudioCmd_MusicPlay:
 			audio.musicState = AUDIO_STATE_PLAYING;
+			audio.musicRestartCount = audio.musicRestartCount + 1;
+			audio.musicPrimed = false;
 			break;
 		case AudioCmd_MusicPause:
 			audio.musicState = AUDIO_STATE_PAUSED;
 			break;
 		case AudioCmd_MusicStop:
+			// The consumer drops what is left in the ring
 			audio.musicState = AUDIO_STATE_IDLE;
-			audio.musicBufferReadSampleIndex = 0;
-			audio.musicBufferWriteSampleIndex = 0;
+			audio.musicRestartCount = audio.musicRestartCount + 1;
+			audio.musicRing.readIndex = audio.musicRing.writeIndex;
 			break;
 		case AudioCmd_StopAll:
+			while ( audio.activeVoiceCount > 0 ) {
+				AudioVoiceEnd(audio, audio.activeVoiceCount - 1);
+			}
+			break;
+		case AudioCmd_BusGain:
+			audio.buses[cmd.bus].gain = cmd.gain;
+			break;
+		case AudioCmd_BusReverbSend:
+			audio.buses[cmd.bus].reverbSend = cmd.gain;
+			break;
+		case AudioCmd_BusFilter:
+			InitializeBiquad(audio.buses[cmd.bus].filters[cmd.filter], cmd.filter, cmd.frequency, cmd.q, AUDIO_SAMPLE_RATE);
+			break;
+		case AudioCmd_Reverb:
+			SetReverbDecay(audio.reverb, cmd.decaySeconds, cmd.damping);
 			break;
 	};
 }
@@ -86,60 +283,83 @@ static void AudioCmdQueue_Process(Audio &audio)
 
 // At 48000 Hz, 2 channels, 2 bytes per mono sample, 1MB is about 6 seconds of audio
 
-#define AUDIO_CHUNK_MEMORY MB(4)
 #define AUDIO_MUSIC_MEMORY MB(4)
+CT_ASSERT( ( AUDIO_MUSIC_MEMORY & ( AUDIO_MUSIC_MEMORY - 1 ) ) == 0 ); // Power of two ring
 #define AUDIO_MODULE_MEMORY MB(2)
 
+static AudioStreamReadFunc AudioStreamRead;
+
 bool InitializeAudio(Audio &audio, Arena &globalArena)
 {
-	// Allocate audio chunks
+	// Allocate audio streams (every sound is split in sequences of chunks,
+	// so we play one while the streamer loads the next ones)
 
-	const u32 totalChunkCount = AUDIO_CHUNK_MEMORY / sizeof(AudioChunk);
-
-	// Make sure we at least have as many audio chunks as twice the number of
-	// simultaneos audio sources. This is needed because every sound is split
-	// in sequences of chunks, so we play one and prefetch the next one.
-	if (totalChunkCount < MAX_AUDIO_SOURCES * 2)
+	AudioStreamer &streamer = audio.streamer;
+	streamer.streams = PushZeroArray(globalArena, AudioStream, MAX_AUDIO_REAL_VOICES);
+	if ( streamer.streams == nullptr )
 	{
-		LOG(Error, "- totalChunkCount (%u) must be >= MAX_AUDIO_SOURCES * 2 (%u)\n", totalChunkCount, MAX_AUDIO_SOURCES * 2);
+		LOG(Error, "- Could not allocate memory for %u audio streams\n", MAX_AUDIO_REAL_VOICES);
 		return false;
 	}
 
-	AudioChunk *chunks = PushArray(globalArena, AudioChunk, totalChunkCount);
-	if ( chunks == nullptr )
+	streamer.adpcmBlocks = PushArray(globalArena, byte, AdpcmEncodedSize(AUDIO_CHUNK_SAMPLE_COUNT / 2));
+	if ( streamer.adpcmBlocks == nullptr )
 	{
-		LOG(Error, "- Could not allocate memory for %u audio chunks\n", totalChunkCount);
+		LOG(Error, "- Could not allocate memory for the audio decoder\n");
 		return false;
 	}
 
-	// Initialize doubly linked list of chunks
+	streamer.read = AudioStreamRead;
+	streamer.jobState = AudioStreamJobState_Idle;
+
+	audio.limiter.gain = 1.0f;
+
+	// Buses (all of them at unity gain, without effects)
+
+	for (u32 i = 0; i < AudioBus_COUNT; ++i)
+	{
+		audio.buses[i].gain = 1.0f;
+		audio.buses[i].currentGain = 1.0f;
+	}
 
-	for (u32 i = 0; i < totalChunkCount; ++i)
+	if ( !InitializeReverb(audio.reverb, globalArena) )
 	{
-		chunks[i].next = &chunks[i+1];
-		chunks[i].prev = &chunks[i-1];
+		LOG(Error, "- Could not allocate memory for the audio reverb\n");
+		return false;
 	}
 
-	AudioChunk *first = &chunks[0];
-	AudioChunk *last = &chunks[totalChunkCount-1];
-	first->prev = &audio.audioChunkSentinel;
-	last->next = &audio.audioChunkSentinel;
-	audio.audioChunkSentinel.next = first;
-	audio.audioChunkSentinel.prev = last;
+	// Resamplers (the device rate is known on the first render)
+
+	InitializeSincFilter(audio.sincFilter, AUDIO_RESAMPLER_CUTOFF);
+	InitializeResampler(audio.outputResampler, AudioResamplerQuality_Sinc, &audio.outputFilter, AUDIO_SAMPLE_RATE, AUDIO_SAMPLE_RATE);
+	audio.outputRate = AUDIO_SAMPLE_RATE;
+
+	// Voices
+
+	audio.voices = PushZeroArray(globalArena, AudioVoice, MAX_AUDIO_VOICES);
+	audio.voiceInfos = PushZeroArray(globalArena, AudioVoiceInfo, MAX_AUDIO_VOICES);
+	audio.activeVoices = PushArray(globalArena, u16, MAX_AUDIO_VOICES);
+	audio.activeVoiceCount = 0;
+
+	for (u32 i = 0; i < MAX_AUDIO_REAL_VOICES; ++i) {
+		audio.realVoices[i] = U32_MAX;
+	}
+	audio.realVoiceLimit = AUDIO_DEFAULT_REAL_VOICES;
 
 	// Handles
 
-	Initialize(audio.clipHandles, globalArena, MAX_AUDIO_SOURCES);
+	Initialize(audio.clipHandles, globalArena, U16_MAX);
+	Initialize(audio.voiceHandles, globalArena, MAX_AUDIO_VOICES);
 	Initialize(audio.musicHandles, globalArena, MAX_MUSIC_FILES);
 
 	// Allocate music buffer
 
-	const u32 musicMonoSampleCount = AUDIO_MUSIC_MEMORY / sizeof(i16);
-	audio.musicBuffer = PushArray(globalArena, i16, musicMonoSampleCount);
-	audio.musicBufferSampleCount = musicMonoSampleCount;
-
-	audio.musicBufferReadSampleIndex = 0;
-	audio.musicBufferWriteSampleIndex = 0;
+	AudioMusicRing &musicRing = audio.musicRing;
+	musicRing.sampleCount = AUDIO_MUSIC_MEMORY / sizeof(i16);
+	musicRing.mask = musicRing.sampleCount - 1;
+	musicRing.samples = PushArray(globalArena, i16, musicRing.sampleCount);
+	musicRing.readIndex = 0;
+	musicRing.writeIndex = 0;
 
 	// Mod track
 
@@ -236,13 +456,13 @@ bool LoadAudioClipFromWAVFile(const char *filename, Arena &arena, AudioClip &aud
 				case RIFF_fmt:
 					fread(&Fmt, Chunk.Size, 1, file);
 					ASSERT(Fmt.AudioFormat == 1); // 1 means PCM
-					ASSERT(Fmt.SampleRate == 48000);
-					ASSERT(Fmt.NumChannels == 2);
+					ASSERT(Fmt.NumChannels == 1 || Fmt.NumChannels == 2); // Any rate, BuildAssets resamples
 					ASSERT(Fmt.BitsPerSample == 16);
 					break;
 				case RIFF_data:
 					ASSERT(data == nullptr);
 					dataSize = Chunk.Size;
+					audioClip.dataOffset = (u32)ftell(file);
 					if (outSamples != nullptr)
 					{
 						data = PushSize(arena, dataSize);
@@ -263,6 +483,7 @@ bool LoadAudioClipFromWAVFile(const char *filename, Arena &arena, AudioClip &aud
 		}
 
 		audioClip.filename = filename;
+		audioClip.format = AudioClipFormat_PCM16;
 		audioClip.sampleSize = Fmt.BitsPerSample / 8;
 		audioClip.samplingRate = Fmt.SampleRate;
 		audioClip.channelCount = Fmt.NumChannels;
@@ -284,64 +505,6 @@ bool LoadAudioClipFromWAVFile(const char *filename, AudioClip &audioClip)
 	return LoadAudioClipFromWAVFile(filename, dummyArena, audioClip, nullptr);
 }
 
-bool LoadSamplesFromWAVFile(const char *filename, void *samples, u32 firstSampleIndex, u32 sampleCount)
-{
-	FilePath path = MakePath(AssetDir, filename);
-
-	FILE *file = fopen(path.str, "rb");
-	if (file != nullptr)
-	{
-		WAVE_header Header;
-		WAVE_chunk Chunk;
-		WAVE_fmt Fmt;
-		const u32 dataOffset = firstSampleIndex * sizeof(i16);
-		const u32 dataSize = sampleCount * sizeof(i16);;
-
-		fread(&Header, sizeof(Header), 1, file);
-		ASSERT(Header.ChunkID == RIFF_RIFF); // "RIFF"
-		ASSERT(Header.Format == RIFF_WAVE); // "WAVE"
-
-		bool keepReading = true;
-
-		while (keepReading)
-		{
-			fread(&Chunk, sizeof(Chunk), 1, file);
-			if (feof(file)) {
-				break;
-			}
-
-			switch (Chunk.ID)
-			{
-				case RIFF_fmt:
-					fread(&Fmt, Chunk.Size, 1, file);
-					ASSERT(Fmt.AudioFormat == 1); // 1 means PCM
-					ASSERT(Fmt.SampleRate == 48000);
-					ASSERT(Fmt.NumChannels == 2);
-					ASSERT(Fmt.BitsPerSample == 16);
-					break;
-				case RIFF_data:
-					ASSERT( dataOffset + dataSize <= Chunk.Size );
-					fseek(file, dataOffset, SEEK_CUR);
-					fread(samples, dataSize, 1, file);
-					keepReading = false;
-					break;
-				default:
-					ASSERT(Chunk.Size > 0);
-					fseek(file, Chunk.Size, SEEK_CUR);
-					break;
-			}
-		}
-
-		fclose(file);
-		return true;
-	}
-	else
-	{
-		LOG(Warning, "Could not load sound file %s\n", filename);
-		return false;
-	}
-}
-
 static i32 mixedSamples[48000/3];
 
 void LoadSamplesFromModFile(struct replay *replay, void *samples, u32 firstSampleIndex, u32 sampleCount)
@@ -378,40 +541,80 @@ void LoadSamplesFromModFile(struct replay *replay, void *samples, u32 firstSampl
 	}
 }
 
-// returns the number of mono samples loaded
-u32 LoadSamplesFromModFile(struct replay *replay, void *samples, u32 sampleCount)
+// Renders the next tick of the module into the ring, returns the number of mono samples loaded
+u32 LoadSamplesFromModFile(struct replay *replay, AudioMusicRing &ring)
 {
-	i16 *dstSamples = (i16*)samples;
 	i32 *srcSamples = mixedSamples;
 	i32 renderedStereoSampleCount = replay_get_audio(replay, srcSamples, 0);
-	ASSERT(renderedStereoSampleCount * 2 <= sampleCount);
-	ASSERT(renderedStereoSampleCount * 2 <= ARRAY_COUNT(mixedSamples));
+	const u32 sampleCount = renderedStereoSampleCount * 2;
+	ASSERT(sampleCount <= ARRAY_COUNT(mixedSamples));
+	ASSERT(sampleCount <= ring.sampleCount - ( ring.writeIndex - ring.readIndex ));
 
-	for (u32 i = 0; i < renderedStereoSampleCount; ++i)
-	{
-		*dstSamples++ = ClipI32ToI16( *srcSamples++ );
-		*dstSamples++ = ClipI32ToI16( *srcSamples++ );
+	// Up to the end of the ring, and the rest from its beginning
+	const u32 writeIndex = ring.writeIndex;
+	const u32 firstIndex = writeIndex & ring.mask;
+	const u32 firstCount = Min(sampleCount, ring.sampleCount - firstIndex);
+
+	for (u32 i = 0; i < firstCount; ++i) {
+		ring.samples[firstIndex + i] = ClipI32ToI16( srcSamples[i] );
+	}
+	for (u32 i = firstCount; i < sampleCount; ++i) {
+		ring.samples[i - firstCount] = ClipI32ToI16( srcSamples[i] );
 	}
 
-	return renderedStereoSampleCount * 2;
+	// Publish the samples before the index
+	FullWriteBarrier();
+	ring.writeIndex = writeIndex + sampleCount;
+
+	return sampleCount;
 }
 
 
 
 ////////////////////////////////////////////////////////////////////////
-// AudioClip and AudioSource management
+// AudioClip and AudioVoice management
+
+// Clips live in pages, allocated the first time one of their handles is used
+static AudioClip &AudioClipAt(Audio &audio, u32 index)
+{
+	AudioClipPage &page = *audio.clipPages[index / AUDIO_CLIP_PAGE_SIZE];
+	AudioClip &audioClip = page.clips[index % AUDIO_CLIP_PAGE_SIZE];
+	return audioClip;
+}
+
+static Handle NewAudioClipHandle(Audio &audio)
+{
+	Handle handle = NewHandle(audio.clipHandles);
+
+	if ( IsValidHandle(audio.clipHandles, handle) )
+	{
+		AudioClipPage *&page = audio.clipPages[handle.idx / AUDIO_CLIP_PAGE_SIZE];
+		if ( page == nullptr )
+		{
+			page = PushZeroStruct(GlobalArena, AudioClipPage);
+			if ( page == nullptr )
+			{
+				FreeHandle(audio.clipHandles, handle);
+				handle = InvalidHandle;
+			}
+		}
+	}
+
+	return handle;
+}
 
 AudioClip &GetAudioClip(Audio &audio, Handle handle)
 {
 	ASSERT( IsValidHandle(audio.clipHandles, handle) );
-	AudioClip &audioClip = audio.clips[handle.idx];
+	AudioClip &audioClip = AudioClipAt(audio, handle.idx);
 	return audioClip;
 }
 
 AudioClipDesc &GetAudioClipDesc(Audio &audio, Handle handle)
 {
 	ASSERT( IsValidHandle(audio.clipHandles, handle) );
-	AudioClipDesc &audioClipDesc = audio.clipDescs[handle.idx];
+	AudioClipPage &page = *audio.clipPages[handle.idx / AUDIO_CLIP_PAGE_SIZE];
+	AudioClipDesc &audioClipDesc = page.descs[handle.idx % AUDIO_CLIP_PAGE_SIZE];
 	return audioClipDesc;
 }
 
@@ -419,7 +622,7 @@ Handle CreateAudioClip(Engine &engine, const BinAudioClip &binAudioClip)
 {
 	Audio &audio = engine.audio;
 
-	Handle handle = NewHandle(audio.clipHandles);
+	Handle handle = NewAudioClipHandle(audio);
 
 	if ( IsValidHandle(audio.clipHandles, handle) )
 	{
@@ -430,6 +633,7 @@ Handle CreateAudioClip(Engine &engine, const BinAudioClip &binAudioClip)
 		audioClip.samplingRate = desc.samplingRate;
 		audioClip.channelCount = desc.channelCount;
 		audioClip.sampleCount = desc.sampleCount;
+		audioClip.format = desc.format;
 		audioClip.loadSource = AUDIO_CLIP_LOAD_SOURCE_ASSETS;
 		audioClip.location = desc.location;
 	}
@@ -446,22 +650,29 @@ Handle CreateAudioClip(Engine &engine, const AudioClipDesc &audioClipDesc)
 	Audio &audio = engine.audio;
 	Arena &arena = DataArena;
 
-	Handle handle = NewHandle(audio.clipHandles);
+	Handle handle = NewAudioClipHandle(audio);
 
 	if ( IsValidHandle(audio.clipHandles, handle) )
 	{
-		audio.clipDescs[handle.idx] = audioClipDesc;
+		GetAudioClipDesc(audio, handle) = audioClipDesc;
 
 		AudioClip &audioClip = GetAudioClip(audio, handle);
 		//ASSERT(!audioClip.samples);
 
-		if ( LoadAudioClipFromWAVFile(audioClipDesc.filename, audioClip) )
+		const bool loaded = LoadAudioClipFromWAVFile(audioClipDesc.filename, audioClip);
+
+		// WAV clips are streamed as they are, only the built assets are converted to stereo
+		if ( loaded && audioClip.channelCount == 2 )
 		{
 			audioClip.loadSource = AUDIO_CLIP_LOAD_SOURCE_WAV;
 		}
 		else
 		{
-			LOG(Warning, "Could not load audio clip %s (not enough memory for audio clips)\n", audioClipDesc.filename);
+			if ( loaded ) {
+				LOG(Warning, "Could not load audio clip %s (only stereo WAV files can be streamed)\n", audioClipDesc.filename);
+			} else {
+				LOG(Warning, "Could not load audio clip %s (not enough memory for audio clips)\n", audioClipDesc.filename);
+			}
 			FreeHandle(audio.clipHandles, handle);
 			handle = InvalidHandle;
 		}
@@ -498,338 +709,1603 @@ Handle GetOrCreateAudioClip(Engine &engine, const AudioClipDesc &desc)
 
 void RemoveAudioClip(Engine &engine, AudioClipH handle)
 {
+	WaitAudioStreaming(engine.audio);
+
 	AudioClip &clip = GetAudioClip(engine.audio, handle);
 	clip = {};
 
 	FreeHandle(engine.audio.clipHandles, handle);
 }
 
-#define INVALID_AUDIO_CLIP U32_MAX
-#define INVALID_AUDIO_SOURCE U32_MAX
-
-//u32 FindAudioClipIndex(Engine &engine, const char *name)
-//{
-//	u32 audioClipIndex = INVALID_AUDIO_CLIP;
-//	for (u32 i = 0; i < audio.clipCount; ++i)
-//	{
-//		const AudioClip &audioClip = audio.clips[i];
-//		if (StrEq(audioClip.name, name))
-//		{
-//			audioClipIndex = INVALID_AUDIO_CLIP;
-//			break;
-//		}
-//	}
-//	return audioClipIndex;
-//}
-
-u32 FindFreeAudioSource(Engine &engine)
+// Update thread: frees the handles of the voices the audio thread ended
+static void AudioReclaimVoices(Audio &audio)
 {
-	Audio &audio = engine.audio;
+	for (u32 i = audio.voiceHandles.handleCount; i-- > 0; )
+	{
+		const AudioVoiceH handle = GetHandleAt(audio.voiceHandles, i);
+		if ( audio.voices[handle.idx].endedHandle == handle.num ) {
+			FreeHandle(audio.voiceHandles, handle);
+		}
+	}
+}
 
-	for (u32 i = 0; i < ARRAY_COUNT(audio.sources); ++i)
+// Update thread: stops the oldest voice of lowest priority, if not above the given one
+static bool AudioStealVoice(Audio &audio, u8 priority)
+{
+	AudioVoiceH victim = InvalidHandle;
+	for (u32 i = 0; i < audio.voiceHandles.handleCount; ++i)
 	{
-		if (audio.sources[i].state == AUDIO_STATE_IDLE)
+		const AudioVoiceH handle = GetHandleAt(audio.voiceHandles, i);
+		const AudioVoiceInfo &info = audio.voiceInfos[handle.idx];
+		if ( info.priority <= priority )
 		{
-			return i;
+			const AudioVoiceInfo *victimInfo = victim != InvalidHandle ? &audio.voiceInfos[victim.idx] : nullptr;
+			if ( !victimInfo || info.priority < victimInfo->priority ||
+				( info.priority == victimInfo->priority && info.startIndex < victimInfo->startIndex ) )
+			{
+				victim = handle;
+			}
 		}
 	}
 
-	return INVALID_AUDIO_SOURCE;
+	if ( victim != InvalidHandle )
+	{
+		// The stop command goes before the start of the voice reusing the handle index
+		AudioCmd cmd = { .type = AudioCmd_VoiceStop, .voice = victim };
+		AudioCmdQueue_Push(cmd);
+		FreeHandle(audio.voiceHandles, victim);
+		audio.stolenVoiceCount++;
+	}
+
+	return victim != InvalidHandle;
 }
 
-u32 PlayAudioClip(Engine &engine, AudioClipH handle)
+AudioVoiceH PlayAudioClip(Engine &engine, AudioClipH handle, u8 priority)
 {
 	Audio &audio = engine.audio;
 
-	const u32 audioSourceIndex = FindFreeAudioSource(engine);
+	if ( audio.voiceHandles.handleCount == MAX_AUDIO_VOICES ) {
+		AudioReclaimVoices(audio);
+	}
 
-	if (audioSourceIndex == INVALID_AUDIO_SOURCE)
+	if ( audio.voiceHandles.handleCount == MAX_AUDIO_VOICES && !AudioStealVoice(audio, priority) )
 	{
-		LOG(Warning, "No available source to play audio clip\n");
+		LOG(Warning, "No available voice to play audio clip\n");
+		return InvalidHandle;
 	}
-	else
-	{
-		AudioSource &audioSource = audio.sources[audioSourceIndex];
-		audioSource.clip = handle;
-		audioSource.lastWriteSampleIndex = 0;
 
+	const AudioVoiceH voice = NewHandle(audio.voiceHandles);
+	audio.voiceInfos[voice.idx] = { .priority = priority, .startIndex = audio.voiceStartCount++ };
 
-		AudioCmd cmd = { .type = AudioCmd_SourcePlay, .sourceIndex = audioSourceIndex };
-		AudioCmdQueue_Push(cmd);
-	}
+	AudioCmd cmd = { .type = AudioCmd_VoiceStart, .handle = handle, .voice = voice, .priority = priority };
+	AudioCmdQueue_Push(cmd);
 
-	return audioSourceIndex;
+	return voice;
 }
 
-bool IsActiveAudioSource(Engine &engine, u32 audioSourceIndex)
+bool IsActiveAudioVoice(Engine &engine, AudioVoiceH handle)
 {
 	Audio &audio = engine.audio;
-	bool active = false;
-	if (audioSourceIndex < ARRAY_COUNT(audio.sources)) {
-		AudioSource &audioSource = audio.sources[audioSourceIndex];
-		active = audioSource.state != AUDIO_STATE_IDLE;
-	}
+	const bool active = IsValidHandle(audio.voiceHandles, handle) && audio.voices[handle.idx].endedHandle != handle.num;
 	return active;
 }
 
-bool IsPausedAudioSource(Engine &engine, u32 audioSourceIndex)
+bool IsPausedAudioVoice(Engine &engine, AudioVoiceH handle)
 {
 	Audio &audio = engine.audio;
-	bool paused = false;
-	if (audioSourceIndex < ARRAY_COUNT(audio.sources)) {
-		AudioSource &audioSource = audio.sources[audioSourceIndex];
-		paused = audioSource.state == AUDIO_STATE_PAUSED;
-	}
+	const AudioVoice &voice = audio.voices[handle.idx];
+	const bool paused = IsActiveAudioVoice(engine, handle) && voice.handle == handle && voice.state == AUDIO_STATE_PAUSED;
 	return paused;
 }
 
-void PauseAudioSource(Engine &engine, u32 audioSourceIndex)
+void PauseAudioVoice(Engine &engine, AudioVoiceH handle)
 {
-	Audio &audio = engine.audio;
-	AudioCmd cmd = { .type = AudioCmd_SourcePause, .sourceIndex = audioSourceIndex };
-	AudioCmdQueue_Push(cmd);
+	if ( IsValidHandle(engine.audio.voiceHandles, handle) )
+	{
+		AudioCmd cmd = { .type = AudioCmd_VoicePause, .voice = handle };
+		AudioCmdQueue_Push(cmd);
+	}
 }
 
-void ResumeAudioSource(Engine &engine, u32 audioSourceIndex)
+void ResumeAudioVoice(Engine &engine, AudioVoiceH handle)
 {
-	Audio &audio = engine.audio;
-	AudioCmd cmd = { .type = AudioCmd_SourcePlay, .sourceIndex = audioSourceIndex };
-	AudioCmdQueue_Push(cmd);
+	if ( IsValidHandle(engine.audio.voiceHandles, handle) )
+	{
+		AudioCmd cmd = { .type = AudioCmd_VoicePlay, .voice = handle };
+		AudioCmdQueue_Push(cmd);
+	}
 }
 
-void StopAudioSource(Engine &engine, u32 audioSourceIndex)
+void StopAudioVoice(Engine &engine, AudioVoiceH handle)
 {
-	if ( audioSourceIndex < MAX_AUDIO_SOURCES )
+	if ( IsValidHandle(engine.audio.voiceHandles, handle) )
 	{
-		Audio &audio = engine.audio;
-		AudioCmd cmd = { .type = AudioCmd_SourceStop, .sourceIndex = audioSourceIndex };
+		AudioCmd cmd = { .type = AudioCmd_VoiceStop, .voice = handle };
 		AudioCmdQueue_Push(cmd);
 	}
 }
 
+void SetAudioVoiceGainPan(Engine &engine, AudioVoiceH handle, f32 gain, f32 pan)
+{
+	if ( IsValidHandle(engine.audio.voiceHandles, handle) )
+	{
+		AudioCmd cmd = { .type = AudioCmd_VoiceGainPan, .voice = handle, .gain = gain, .pan = pan };
+		AudioCmdQueue_Push(cmd);
+	}
+}
 
+void SetAudioVoicePitch(Engine &engine, AudioVoiceH handle, f32 pitch)
+{
+	if ( IsValidHandle(engine.audio.voiceHandles, handle) )
+	{
+		AudioCmd cmd = { .type = AudioCmd_VoicePitch, .voice = handle, .pitch = pitch };
+		AudioCmdQueue_Push(cmd);
+	}
+}
 
-////////////////////////////////////////////////////////////////////////
-// Music pre-render
+void SetAudioRealVoiceLimit(Engine &engine, u32 realVoiceLimit)
+{
+	AudioCmd cmd = { .type = AudioCmd_RealVoiceLimit, .realVoiceLimit = Min(realVoiceLimit, (u32)MAX_AUDIO_REAL_VOICES) };
+	AudioCmdQueue_Push(cmd);
+}
 
-void PreRenderAudio(Engine &engine)
+void SetAudioBusGain(Engine &engine, AudioBusId bus, f32 gain)
 {
-	Audio &audio = engine.audio;
+	ASSERT( bus < AudioBus_COUNT );
+	AudioCmd cmd = { .type = AudioCmd_BusGain, .gain = Max(gain, 0.0f), .bus = bus };
+	AudioCmdQueue_Push(cmd);
+}
 
-	Clock beginClock = GetClock();
+// Only the music and sfx buses send to the reverb
+void SetAudioBusReverbSend(Engine &engine, AudioBusId bus, f32 send)
+{
+	ASSERT( bus == AudioBus_Music || bus == AudioBus_Sfx );
+	AudioCmd cmd = { .type = AudioCmd_BusReverbSend, .gain = Max(send, 0.0f), .bus = bus };
+	AudioCmdQueue_Push(cmd);
+}
 
-	if ( audio.musicState == AUDIO_STATE_PLAYING )
-	{
-		struct replay *replay = audio.moduleReplay;
+// A zero frequency disables the filter
+void SetAudioBusFilter(Engine &engine, AudioBusId bus, AudioFilterType filter, f32 frequency, f32 q)
+{
+	ASSERT( bus < AudioBus_COUNT && filter < AudioFilter_COUNT );
+	AudioCmd cmd = { .type = AudioCmd_BusFilter, .bus = bus, .filter = filter, .frequency = frequency, .q = q };
+	AudioCmdQueue_Push(cmd);
+}
 
-		const float budgetSeconds = 0.007f;
-		const float elapsedSeconds = GetSecondsElapsed(beginClock, GetClock());
+void SetAudioReverb(Engine &engine, f32 decaySeconds, f32 damping)
+{
+	AudioCmd cmd = { .type = AudioCmd_Reverb, .decaySeconds = decaySeconds, .damping = damping };
+	AudioCmdQueue_Push(cmd);
+}
 
-		while (elapsedSeconds < budgetSeconds)
-		{
-			u32 writtenSampleCount = audio.musicBufferWriteSampleIndex - audio.musicBufferReadSampleIndex;
-			ASSERT(writtenSampleCount <= audio.musicBufferSampleCount);
 
-			// If music is not being read, don't load any more samples
-			if ( writtenSampleCount > audio.musicBufferSampleCount * 0.7 )
-			{
-				//LOG(Info, "Break\n");
-				break;
-			}
 
-			// If we are writting far in the music buffer... place samples back at the beginning
-			if (audio.musicBufferWriteSampleIndex > audio.musicBufferSampleCount * 0.7 )
-			{
-				//LOG(Info, "Copy\n");
-				const u32 prevReadSampleIndex = audio.musicBufferReadSampleIndex;
-				for (u32 i = 0; i < writtenSampleCount; ++i)
-				{
-					audio.musicBuffer[i] = audio.musicBuffer[prevReadSampleIndex + i];
-				}
-				audio.musicBufferReadSampleIndex = 0;
-				audio.musicBufferWriteSampleIndex = writtenSampleCount;
-			}
+////////////////////////////////////////////////////////////////////////
+// IMA-ADPCM
+//
+// Built clips are encoded with 4 bits per sample and decoded by the streamer,
+// a chunk at a time. Each code scales the current step of its channel, and
+// moves the step up or down the table for the next sample.
+
+static const i16 sAdpcmSteps[89] = {
+	7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+	50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+	253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+	1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+	3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+	11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+	32767,
+};
 
-			void *samples = audio.musicBuffer + audio.musicBufferWriteSampleIndex;
-			u32 sampleCount = audio.musicBufferSampleCount - audio.musicBufferWriteSampleIndex;
+static const i8 sAdpcmStepIndexDeltas[8] = { -1, -1, -1, -1, 2, 4, 6, 8 };
 
-			static u32 counter = 0;
-			//LOG(Info, "%u - LoadSamplesFromModFile %d\n", counter++, sampleCount);
+CT_ASSERT( sizeof(AudioAdpcmHeader) == 4 );
+CT_ASSERT( ( AUDIO_CHUNK_SAMPLE_COUNT / 2 ) % AUDIO_ADPCM_BLOCK_FRAMES == 0 ); // Chunks start on a block
 
-			u32 loadedSampleCount = LoadSamplesFromModFile(replay, samples, sampleCount);
-			audio.musicBufferWriteSampleIndex += loadedSampleCount;
+struct AudioAdpcmState
+{
+	i32 predictor;
+	i32 stepIndex;
+};
 
-			if ( loadedSampleCount == 0 )
-			{
-				audio.musicState = AUDIO_STATE_IDLE;
-				break;
-			}
-		}
-	}
+// The magnitude of a code scales the step by (2 * magnitude + 1) / 8, and its
+// fourth bit is the sign
+static i32 AudioAdpcmDecode(AudioAdpcmState &state, u32 code)
+{
+	const i32 step = sAdpcmSteps[state.stepIndex];
+	const i32 magnitude = code & 7;
+	const i32 diff = ( ( 2 * magnitude + 1 ) * step ) >> 3;
+	const i32 predictor = state.predictor + ( code & 8 ? -diff : diff );
+	state.predictor = Clamp(predictor, -32768, 32767);
+	state.stepIndex = Clamp(state.stepIndex + sAdpcmStepIndexDeltas[magnitude], 0, 88);
+	return state.predictor;
+}
 
-	if (audio.musicState == AUDIO_STATE_IDLE)
-	{
-		audio.musicBufferWriteSampleIndex = 0;
-		audio.musicBufferReadSampleIndex = 0;
-	}
+// Returns the code whose decoded sample is the closest one, and decodes it to
+// keep the state of the encoder in sync with the decoder
+static u32 AudioAdpcmEncode(AudioAdpcmState &state, i32 sample)
+{
+	const i32 step = sAdpcmSteps[state.stepIndex];
+	const i32 delta = sample - state.predictor;
+	const i32 magnitude = Min( 4 * Max(delta, -delta) / step, 7 );
+	const u32 code = ( delta < 0 ? 8 : 0 ) | magnitude;
+	AudioAdpcmDecode(state, code);
+	return code;
 }
 
-////////////////////////////////////////////////////////////////////////
-// Audio mixer
+// Bytes of the blocks of frameCount stereo frames, the last block may be shorter
+u32 AdpcmEncodedSize(u32 frameCount)
+{
+	const u32 blockCount = ( frameCount + AUDIO_ADPCM_BLOCK_FRAMES - 1 ) / AUDIO_ADPCM_BLOCK_FRAMES;
+	const u32 size = blockCount * 2 * sizeof(AudioAdpcmHeader) + frameCount;
+	return size;
+}
 
-void RenderAudio(Engine &engine, SoundBuffer &soundBuffer)
+// Encodes interleaved stereo frames into AdpcmEncodedSize(frameCount) bytes
+void EncodeAdpcm(const i16 *samples, u32 frameCount, byte *blocks)
 {
-	Audio &audio = engine.audio;
+	AudioAdpcmState states[2] = {};
 
-	if (!audio.initialized) {
-		return;
-	}
+	for (u32 firstFrame = 0; firstFrame < frameCount; firstFrame += AUDIO_ADPCM_BLOCK_FRAMES)
+	{
+		const u32 blockFrameCount = Min(AUDIO_ADPCM_BLOCK_FRAMES, frameCount - firstFrame);
 
-	if ( soundBuffer.sampleCount == 0 ) {
-		return;
-	}
+		// Blocks start from the exact sample before them, so errors do not carry over
+		AudioAdpcmHeader *headers = (AudioAdpcmHeader*)blocks;
+		for (u32 c = 0; c < 2; ++c)
+		{
+			states[c].predictor = samples[ firstFrame > 0 ? firstFrame * 2 - 2 + c : c ];
+			headers[c].predictor = (i16)states[c].predictor;
+			headers[c].stepIndex = (u8)states[c].stepIndex;
+			headers[c].unused = 0;
+		}
 
-#if 1
-	AudioCmdQueue_Process(audio);
+		byte *codes = blocks + 2 * sizeof(AudioAdpcmHeader);
+		const i16 *blockSamples = samples + firstFrame * 2;
+		for (u32 i = 0; i < blockFrameCount; ++i)
+		{
+			const u32 codeL = AudioAdpcmEncode(states[0], blockSamples[i * 2 + 0]);
+			const u32 codeR = AudioAdpcmEncode(states[1], blockSamples[i * 2 + 1]);
+			codes[i] = (byte)( codeL | codeR << 4 );
+		}
 
-	Scratch scratch;
+		blocks = codes + blockFrameCount;
+	}
+}
 
-	f32 *realSamples = PushArray(scratch.arena, f32, soundBuffer.sampleCount * 2.0f );
+// Decodes frameCount stereo frames, from the beginning of a block
+void DecodeAdpcm(const byte *blocks, u32 frameCount, i16 *samples)
+{
+	for (u32 firstFrame = 0; firstFrame < frameCount; firstFrame += AUDIO_ADPCM_BLOCK_FRAMES)
+	{
+		const u32 blockFrameCount = Min(AUDIO_ADPCM_BLOCK_FRAMES, frameCount - firstFrame);
 
-	// Clear sound buffer
-	f32 *samplePtr = realSamples;
-	for (u32 i = 0; i < soundBuffer.sampleCount; ++i)
+		// Step indices are clamped, so corrupted blocks decode as noise instead of crashing
+		const AudioAdpcmHeader *headers = (const AudioAdpcmHeader*)blocks;
+		AudioAdpcmState left = { headers[0].predictor, Min((i32)headers[0].stepIndex, 88) };
+		AudioAdpcmState right = { headers[1].predictor, Min((i32)headers[1].stepIndex, 88) };
+
+		const byte *codes = blocks + 2 * sizeof(AudioAdpcmHeader);
+		for (u32 i = 0; i < blockFrameCount; ++i)
+		{
+			samples[0] = (i16)AudioAdpcmDecode(left, codes[i] & 15);
+			samples[1] = (i16)AudioAdpcmDecode(right, codes[i] >> 4);
+			samples += 2;
+		}
+
+		blocks = codes + blockFrameCount;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////
+// Audio streaming
+//
+// A job on a worker thread loads the chunks ahead of the play cursor of each
+// real voice, so the audio thread never touches the disk. Chunks
+// closer to the cursors are loaded first. The job is kicked by the update
+// thread every frame and returns when there is nothing left to load.
+// ADPCM clips are decoded here too, so the mixer only sees i16 samples.
+
+static bool AudioStreamRead(File &file, u64 offset, void *samples, u32 size)
+{
+	const bool ok = FileSeek(file, offset) && ReadFromFile(file, samples, size);
+	return ok;
+}
+
+static File AudioStreamOpenClipFile(Audio &audio, const AudioClip &clip)
+{
+	File file = {};
+	if ( clip.loadSource == AUDIO_CLIP_LOAD_SOURCE_ASSETS )
 	{
-		*samplePtr++ = 0.0f;
-		*samplePtr++ = 0.0f;
+		file = OpenFile(audio.streamer.assetsFilepath.str, FileModeRead);
 	}
+	else // if ( clip.loadSource == AUDIO_CLIP_LOAD_SOURCE_WAV )
+	{
+		const FilePath path = MakePath(AssetDir, clip.filename);
+		file = OpenFile(path.str, FileModeRead);
+		if ( !file.isOpen ) { // try if filename is a filepath per se
+			file = OpenFile(clip.filename, FileModeRead);
+		}
+	}
+	return file;
+}
 
-	// Render music
-	if ( audio.musicState == AUDIO_STATE_PLAYING )
+static void AudioStreamLoadChunks(Audio &audio)
+{
+	AudioStreamer &streamer = audio.streamer;
+
+	File file = {};
+	u32 fileClip = InvalidHandle.num;
+
+	for (u32 distance = 0; distance < AUDIO_STREAM_CHUNK_COUNT; ++distance)
 	{
-		u32 availableMusicSampleCount = audio.musicBufferWriteSampleIndex - audio.musicBufferReadSampleIndex;
-		u32 musicSampleCount = Min((u32)soundBuffer.sampleCount * 2, availableMusicSampleCount);
-		//LOG(Info, "%u / %u (%u)\n", audio.musicBufferReadSampleIndex, audio.musicBufferWriteSampleIndex, availableMusicSampleCount);
-		i16 *srcSample = audio.musicBuffer + audio.musicBufferReadSampleIndex;
-		f32 *dstSample = realSamples;
-		for (u32 i = 0; i < musicSampleCount; ++i)
+		for (u32 i = 0; i < MAX_AUDIO_REAL_VOICES; ++i)
 		{
-			*dstSample++ = (f32)*srcSample++;
+			AudioStream &stream = streamer.streams[i];
+
+			// Read a consistent cursor, skipping sources restarted in the meantime
+			const u32 playId = stream.playId;
+			FullReadBarrier();
+			const Handle clipH = { .num = stream.clip };
+			const u32 cursorChunkIndex = stream.chunkIndex;
+			const u32 startSampleIndex = stream.startSampleIndex;
+			FullReadBarrier();
+			if ( playId == 0 || playId != stream.playId ) {
+				continue;
+			}
+
+			// Clips are not removed while this job is running, but voices can outlive theirs,
+			// and the slot may already hold another clip
+			if ( !IsValidHandle(audio.clipHandles, clipH) ) {
+				continue;
+			}
+			const AudioClip &clip = AudioClipAt(audio, clipH.idx);
+			if ( clip.sampleCount == 0 ) {
+				continue;
+			}
+
+			const u32 chunkCount = (clip.sampleCount - 1) / AUDIO_CHUNK_SAMPLE_COUNT + 1;
+			const u32 chunkIndex = cursorChunkIndex + distance;
+			if ( chunkIndex >= chunkCount ) {
+				continue;
+			}
+
+			// Ready chunks are either loaded already or about to be released by the audio thread
+			AudioChunk &chunk = stream.chunks[chunkIndex % AUDIO_STREAM_CHUNK_COUNT];
+			if ( chunk.state != AudioChunkState_Empty ) {
+				continue;
+			}
+
+			if ( fileClip != clipH.num )
+			{
+				CloseFile(file);
+				file = AudioStreamOpenClipFile(audio, clip);
+				fileClip = clipH.num;
+			}
+
+			const u32 firstSampleIndex = chunkIndex * AUDIO_CHUNK_SAMPLE_COUNT;
+			const u32 sampleCount = Min(AUDIO_CHUNK_SAMPLE_COUNT, clip.sampleCount - firstSampleIndex);
+			const u64 dataOffset = clip.loadSource == AUDIO_CLIP_LOAD_SOURCE_ASSETS ? clip.location.offset : clip.dataOffset;
+
+			// Voices starting within a chunk skip the samples before them, which are
+			// never mixed. ADPCM clips can only skip whole blocks.
+			u32 skipSampleCount = 0;
+			if ( chunkIndex == startSampleIndex / AUDIO_CHUNK_SAMPLE_COUNT )
+			{
+				skipSampleCount = startSampleIndex - firstSampleIndex;
+				if ( clip.format == AudioClipFormat_ADPCM ) {
+					skipSampleCount -= skipSampleCount % ( AUDIO_ADPCM_BLOCK_FRAMES * 2 );
+				}
+			}
+			const u32 loadSampleIndex = firstSampleIndex + skipSampleCount;
+			const u32 loadSampleCount = sampleCount - skipSampleCount;
+			i16 *samples = chunk.samples + skipSampleCount;
+
+			bool loaded = file.isOpen;
+			if ( clip.format == AudioClipFormat_ADPCM )
+			{
+				const u32 firstBlock = loadSampleIndex / ( AUDIO_ADPCM_BLOCK_FRAMES * 2 );
+				const u64 offset = dataOffset + firstBlock * AUDIO_ADPCM_BLOCK_SIZE;
+				const u32 size = AdpcmEncodedSize(loadSampleCount / 2);
+				loaded = loaded && streamer.read(file, offset, streamer.adpcmBlocks, size);
+				if ( loaded ) {
+					DecodeAdpcm(streamer.adpcmBlocks, loadSampleCount / 2, samples);
+				}
+			}
+			else
+			{
+				const u64 offset = dataOffset + loadSampleIndex * sizeof(i16);
+				loaded = loaded && streamer.read(file, offset, samples, loadSampleCount * sizeof(i16));
+			}
+
+			if ( !loaded )
+			{
+				LOG(Warning, "Could not stream chunk %u of audio clip\n", chunkIndex);
+				MemSet(samples, loadSampleCount * sizeof(i16), 0);
+			}
+
+			chunk.playId = playId;
+			chunk.index = chunkIndex;
+			chunk.sampleCount = sampleCount;
+
+			FullWriteBarrier();
+			chunk.state = AudioChunkState_Ready;
+			streamer.loadedChunkCount = streamer.loadedChunkCount + 1;
 		}
-		audio.musicBufferReadSampleIndex += musicSampleCount;
 	}
 
+	CloseFile(file);
+}
+
+static WORK_QUEUE_CALLBACK(AudioStreamJobCallback)
+{
+	Audio &audio = *(Audio*)data;
+	AudioStreamer &streamer = audio.streamer;
+
+	// Jobs cancelled before being picked up, or already run from a stale queue entry
+	if ( !AtomicSwap(&streamer.jobState, AudioStreamJobState_Pending, AudioStreamJobState_Running) ) {
+		return;
+	}
+
+	ProfileRegisterThread("Worker");
 
-	// Render audio clips
-	for (u32 i = 0; i < ARRAY_COUNT(audio.sources); ++i)
 	{
-		AudioSource &audioSource = audio.sources[i];
+		PROFILE_BLOCK(AudioStreamJob);
+		AudioStreamLoadChunks(audio);
+	}
 
-		bool audioSourceIsValid = IsValidHandle(audio.clipHandles, audioSource.clip);
+	// Each job is a profiler frame on the worker thread
+	ProfileFlush();
 
-		if ( audioSourceIsValid && audioSource.state == AUDIO_STATE_PLAYING )
-		{
-			AudioClip &audioClip = GetAudioClip(audio, audioSource.clip);
+	FullWriteBarrier();
+	streamer.jobState = AudioStreamJobState_Idle;
+}
+
+// Called from the update thread every frame
+void UpdateAudio(Engine &engine)
+{
+	Audio &audio = engine.audio;
+	if ( !audio.initialized ) {
+		return;
+	}
 
-			const u32 chunkCount = (audioClip.sampleCount - 1) / AUDIO_CHUNK_SAMPLE_COUNT + 1;
-			const u32 currChunkIndex = audioSource.lastWriteSampleIndex / AUDIO_CHUNK_SAMPLE_COUNT;
-			const u32 nextChunkIndex = Min(currChunkIndex + 1, chunkCount - 1);
+	AudioReclaimVoices(audio);
 
-			const u32 chunkIndices[] = { currChunkIndex, nextChunkIndex };
-			const u32 prefetchChunkCount = nextChunkIndex - currChunkIndex + 1;
-			ASSERT(prefetchChunkCount <= 2);
+	AudioStreamer &streamer = audio.streamer;
+	if ( AtomicSwap(&streamer.jobState, AudioStreamJobState_Idle, AudioStreamJobState_Pending) ) {
+		PushWork(AudioStreamJobCallback, &audio);
+	}
+}
 
-			// soundBuffer.sampleCount is for stereo samples (each stereo sample is 2 mono samples)
-			u32 requestedSampleCount = soundBuffer.sampleCount * 2;
+// Waits until the streamer is not accessing the audio clips
+void WaitAudioStreaming(Audio &audio)
+{
+	AudioStreamer &streamer = audio.streamer;
 
-			f32 *dstSample = realSamples;
+	// Jobs still in the queue are retired here, a running one finishes its pass
+	if ( !AtomicSwap(&streamer.jobState, AudioStreamJobState_Pending, AudioStreamJobState_Idle) )
+	{
+		while ( streamer.jobState != AudioStreamJobState_Idle ) {
+			Yield();
+		}
+	}
+}
 
-			for (u32 i = 0; i < prefetchChunkCount; ++i)
+// Update thread: sets the file the clips created from the assets are streamed from.
+// Called when a scene starts loading, so the streamer never reads it while it changes.
+void SetAudioAssetsFilepath(Audio &audio, const char *filepath)
+{
+	WaitAudioStreaming(audio);
+	StrCopy(audio.streamer.assetsFilepath.str, filepath);
+}
+
+// Audio thread: releases the chunks that are behind the cursor or belong to a previous play
+static void AudioStreamReleaseChunks(AudioStream &stream, u32 playId, u32 chunkIndex)
+{
+	for (u32 i = 0; i < AUDIO_STREAM_CHUNK_COUNT; ++i)
+	{
+		AudioChunk &chunk = stream.chunks[i];
+		if ( chunk.state == AudioChunkState_Ready )
+		{
+			FullReadBarrier();
+			if ( chunk.playId != playId || chunk.index < chunkIndex )
 			{
-				const u32 chunkIndex = chunkIndices[i];
-				const u32 firstSampleIndex = chunkIndex * AUDIO_CHUNK_SAMPLE_COUNT;
+				FullWriteBarrier();
+				chunk.state = AudioChunkState_Empty;
+			}
+		}
+	}
+}
 
-				// Search chunk
-				AudioChunk *chunk = audio.audioChunkSentinel.next;
-				AudioChunk *end = &audio.audioChunkSentinel;
-				while (chunk != end)
-				{
-					if ( audioSource.clip == chunk->clipH && chunkIndex == chunk->index ) {
-						break;
-					}
-					chunk = chunk->next;
-				}
 
-				// No chunk found, get LRU and populate it
-				if ( chunk == end )
-				{
-					chunk = audio.audioChunkSentinel.prev;
-					chunk->clipH = audioSource.clip;
-					chunk->index = chunkIndex;
 
-					const u32 chunkSampleCount = (chunkIndex == chunkCount - 1) ? audioClip.sampleCount % AUDIO_CHUNK_SAMPLE_COUNT : AUDIO_CHUNK_SAMPLE_COUNT;
-					if ( audioClip.loadSource == AUDIO_CLIP_LOAD_SOURCE_ASSETS )
-					{
-						FileSeek(engine.assets.file, audioClip.location.offset + firstSampleIndex * sizeof(i16));
-						ReadFromFile(engine.assets.file, chunk->samples, chunkSampleCount * sizeof(i16));
-					}
-					else // id ( audioClip.loadSource == AUDIO_CLIP_LOAD_SOURCE_WAV )
-					{
-						LoadSamplesFromWAVFile(audioClip.filename, chunk->samples, firstSampleIndex, chunkSampleCount);
-					}
-				}
+////////////////////////////////////////////////////////////////////////
+// Music pre-render
+
+// Refills the music ring once it goes under half its size, a whole module tick at a
+// time, until it is full or the time budget runs out
+void PreRenderAudio(Engine &engine)
+{
+	Audio &audio = engine.audio;
+	AudioMusicRing &ring = audio.musicRing;
 
-				// Remove chunk from the list
-				chunk->next->prev = chunk->prev;
-				chunk->prev->next = chunk->next;
-				// Put it back first in the list
-				chunk->next = audio.audioChunkSentinel.next;
-				chunk->prev = &audio.audioChunkSentinel;
-				chunk->next->prev = chunk;
-				chunk->prev->next = chunk;
+	Clock beginClock = GetClock();
 
-				// Copy requested samples from chunk to real samples
-				const i16 *srcSample = chunk->samples + audioSource.lastWriteSampleIndex - firstSampleIndex;
+	// The consumer restarted the music, which has samples again
+	const u32 restartCount = audio.musicRestartCount;
+	if ( audio.musicRestartAck != restartCount )
+	{
+		audio.musicEnded = false;
+		FullWriteBarrier();
+		audio.musicRestartAck = restartCount;
+	}
 
-				const u32 remainingClipSampleCount = audioClip.sampleCount - audioSource.lastWriteSampleIndex;
-				const u32 remainingChunkSampleCount = firstSampleIndex + AUDIO_CHUNK_SAMPLE_COUNT - audioSource.lastWriteSampleIndex;
-				const u32 remainingSampleCount = Min(remainingClipSampleCount, remainingChunkSampleCount);
-				const u32 sampleCount = Min(remainingSampleCount, requestedSampleCount);
+	if ( audio.musicState == AUDIO_STATE_PLAYING && !audio.musicEnded )
+	{
+		const u32 watermark = ring.sampleCount / 2;
+		if ( ring.writeIndex - ring.readIndex < watermark ) {
+			audio.musicRefilling = true;
+		}
 
-				for (u32 sampleIndex = 0; sampleIndex < sampleCount; ++sampleIndex)
+		if ( audio.musicRefilling )
+		{
+			PROFILE_BLOCK(MusicRefill);
+
+			struct replay *replay = audio.moduleReplay;
+			const float budgetSeconds = 0.007f;
+
+			while ( GetSecondsElapsed(beginClock, GetClock()) < budgetSeconds )
+			{
+				// Stop when the longest tick may not fit anymore
+				const u32 freeSampleCount = ring.sampleCount - ( ring.writeIndex - ring.readIndex );
+				if ( freeSampleCount < ARRAY_COUNT(mixedSamples) )
 				{
-					*dstSample += (f32)*srcSample;
-					dstSample++;
-					srcSample++;
+					audio.musicRefilling = false;
+					break;
 				}
 
-				audioSource.lastWriteSampleIndex += sampleCount;
-				if (audioSource.lastWriteSampleIndex >= audioClip.sampleCount)
+				const u32 loadedSampleCount = LoadSamplesFromModFile(replay, ring);
+				if ( loadedSampleCount == 0 )
 				{
-					audioSourceIsValid = false;
+					// RenderAudio plays what is left in the ring before going idle
+					audio.musicEnded = true;
+					audio.musicRefilling = false;
+					break;
 				}
+			}
+		}
+	}
+
+	audio.musicProducerMillis = 1000.0f * GetSecondsElapsed(beginClock, GetClock());
+	audio.maxMusicProducerMillis = Max(audio.maxMusicProducerMillis, audio.musicProducerMillis);
+}
+
+////////////////////////////////////////////////////////////////////////
+// Audio mixer
+//
+// Sources are accumulated as interleaved f32 stereo frames, and the soft limiter
+// turns the mix back into i16 samples. The scalar versions are the reference
+// for the SIMD ones.
+
+#define AUDIO_LIMITER_THRESHOLD 32000.0f // Output peak level
+#define AUDIO_LIMITER_RELEASE 0.02f // Fraction of the way back to the target gain per block
+
+// Constant-power pan, scaled so that a centered source keeps its gain
+static void AudioPanGains(f32 gain, f32 pan, f32 &gainL, f32 &gainR)
+{
+	const f32 angle = ( Clamp(pan, -1.0f, 1.0f) + 1.0f ) * 0.25f * Pi;
+	gainL = gain * Sqrt(2.0f) * Cos(angle);
+	gainR = gain * Sqrt(2.0f) * Sin(angle);
+}
+
+void MixSamplesScalar(f32 *dst, const i16 *src, u32 frameCount, f32 gainL, f32 gainR)
+{
+	for (u32 i = 0; i < frameCount; ++i)
+	{
+		dst[2 * i + 0] += (f32)src[2 * i + 0] * gainL;
+		dst[2 * i + 1] += (f32)src[2 * i + 1] * gainR;
+	}
+}
+
+void MixSamples(f32 *dst, const i16 *src, u32 frameCount, f32 gainL, f32 gainR)
+{
+	u32 i = 0;
+
+#if USE_AUDIO_AVX2
+	const __m256 gains8 = _mm256_setr_ps(gainL, gainR, gainL, gainR, gainL, gainR, gainL, gainR);
+	for (; i + 8 <= frameCount; i += 8)
+	{
+		const __m128i s0 = _mm_loadu_si128((const __m128i*)(src + 2 * i));
+		const __m128i s1 = _mm_loadu_si128((const __m128i*)(src + 2 * i + 8));
+		const __m256 f0 = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(s0));
+		const __m256 f1 = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(s1));
+		const __m256 d0 = _mm256_add_ps(_mm256_loadu_ps(dst + 2 * i), _mm256_mul_ps(f0, gains8));
+		const __m256 d1 = _mm256_add_ps(_mm256_loadu_ps(dst + 2 * i + 8), _mm256_mul_ps(f1, gains8));
+		_mm256_storeu_ps(dst + 2 * i, d0);
+		_mm256_storeu_ps(dst + 2 * i + 8, d1);
+	}
+#endif
+
+#if USE_AUDIO_SSE2
+	const __m128 gains4 = _mm_setr_ps(gainL, gainR, gainL, gainR);
+	for (; i + 4 <= frameCount; i += 4)
+	{
+		// Sign-extend i16 to i32 by unpacking each sample into the high half and shifting back
+		const __m128i s = _mm_loadu_si128((const __m128i*)(src + 2 * i));
+		const __m128 f0 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16));
+		const __m128 f1 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16));
+		const __m128 d0 = _mm_add_ps(_mm_loadu_ps(dst + 2 * i), _mm_mul_ps(f0, gains4));
+		const __m128 d1 = _mm_add_ps(_mm_loadu_ps(dst + 2 * i + 4), _mm_mul_ps(f1, gains4));
+		_mm_storeu_ps(dst + 2 * i, d0);
+		_mm_storeu_ps(dst + 2 * i + 4, d1);
+	}
+#endif
+
+	MixSamplesScalar(dst + 2 * i, src + 2 * i, frameCount - i, gainL, gainR);
+}
+
+// Returns a zeroed mix buffer for frameCount stereo frames, preceded by the frames
+// the limiter has not output yet. LimitSamples expects this layout.
+static f32 *PushMixBuffer(Arena &arena, const AudioLimiter &limiter, u32 frameCount)
+{
+	f32 *samples = PushArray(arena, f32, (AUDIO_LIMITER_LOOKAHEAD + frameCount) * 2);
+	MemCopy(samples, limiter.delay, sizeof(limiter.delay));
+	MemSet(samples + AUDIO_LIMITER_LOOKAHEAD * 2, frameCount * 2 * sizeof(f32), 0);
+	return samples;
+}
+
+// Gain at the end of a block, given the peak of the block and its lookahead
+static f32 AudioLimiterBlockGain(const AudioLimiter &limiter, f32 peak)
+{
+	f32 gain = peak > AUDIO_LIMITER_THRESHOLD ? AUDIO_LIMITER_THRESHOLD / peak : 1.0f;
+	if ( gain > limiter.gain ) {
+		gain = limiter.gain + ( gain - limiter.gain ) * AUDIO_LIMITER_RELEASE;
+	}
+	return gain;
+}
+
+static i16 AudioSaturate(f32 sample)
+{
+	const i16 res = (i16)lrintf( Clamp(sample, -32768.0f, 32767.0f) );
+	return res;
+}
+
+void LimitSamplesScalar(AudioLimiter &limiter, const f32 *samples, u32 frameCount, i16 *output)
+{
+	for (u32 first = 0; first < frameCount; first += AUDIO_LIMITER_LOOKAHEAD)
+	{
+		const u32 blockFrameCount = Min((u32)AUDIO_LIMITER_LOOKAHEAD, frameCount - first);
+		const u32 windowEnd = first + blockFrameCount + AUDIO_LIMITER_LOOKAHEAD;
+
+		f32 peak = 0.0f;
+		for (u32 i = first * 2; i < windowEnd * 2; ++i) {
+			peak = Max(peak, Max(samples[i], -samples[i]));
+		}
+
+		const f32 gain0 = limiter.gain;
+		const f32 gain1 = AudioLimiterBlockGain(limiter, peak);
+		const f32 step = ( gain1 - gain0 ) / blockFrameCount;
+
+		for (u32 i = 0; i < blockFrameCount; ++i)
+		{
+			const f32 gain = gain0 + step * (f32)(i + 1);
+			const u32 index = ( first + i ) * 2;
+			output[index + 0] = AudioSaturate(samples[index + 0] * gain);
+			output[index + 1] = AudioSaturate(samples[index + 1] * gain);
+		}
+
+		limiter.gain = gain1;
+	}
+
+	MemCopy(limiter.delay, samples + frameCount * 2, sizeof(limiter.delay));
+}
+
+void LimitSamples(AudioLimiter &limiter, const f32 *samples, u32 frameCount, i16 *output)
+{
+#if USE_AUDIO_SSE2
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	const __m128 minSample = _mm_set1_ps(-32768.0f);
+	const __m128 maxSample = _mm_set1_ps(32767.0f);
+
+	for (u32 first = 0; first < frameCount; first += AUDIO_LIMITER_LOOKAHEAD)
+	{
+		const u32 blockFrameCount = Min((u32)AUDIO_LIMITER_LOOKAHEAD, frameCount - first);
+		const u32 windowEnd = first + blockFrameCount + AUDIO_LIMITER_LOOKAHEAD;
+
+		// Peak of the block and its lookahead (both frame counts are even)
+		u32 i = first * 2;
+		__m128 peak4 = _mm_setzero_ps();
+		for (; i + 4 <= windowEnd * 2; i += 4) {
+			peak4 = _mm_max_ps(peak4, _mm_andnot_ps(signMask, _mm_loadu_ps(samples + i)));
+		}
+		peak4 = _mm_max_ps(peak4, _mm_shuffle_ps(peak4, peak4, _MM_SHUFFLE(1, 0, 3, 2)));
+		peak4 = _mm_max_ps(peak4, _mm_shuffle_ps(peak4, peak4, _MM_SHUFFLE(2, 3, 0, 1)));
+		f32 peak = _mm_cvtss_f32(peak4);
+		for (; i < windowEnd * 2; ++i) {
+			peak = Max(peak, Max(samples[i], -samples[i]));
+		}
+
+		const f32 gain0 = limiter.gain;
+		const f32 gain1 = AudioLimiterBlockGain(limiter, peak);
+		const f32 step = ( gain1 - gain0 ) / blockFrameCount;
+
+		// Four frames per iteration, the gain of frame i being gain0 + step * (i + 1)
+		const __m128 gainBase = _mm_set1_ps(gain0);
+		const __m128 gainStep = _mm_set1_ps(step);
+		__m128 frameNumber0 = _mm_setr_ps(1.0f, 1.0f, 2.0f, 2.0f);
+		__m128 frameNumber1 = _mm_setr_ps(3.0f, 3.0f, 4.0f, 4.0f);
+		const __m128 frameIncrement = _mm_set1_ps(4.0f);
+
+		u32 f = 0;
+		for (; f + 4 <= blockFrameCount; f += 4)
+		{
+			const u32 index = ( first + f ) * 2;
+			const __m128 gain0_ = _mm_add_ps(gainBase, _mm_mul_ps(gainStep, frameNumber0));
+			const __m128 gain1_ = _mm_add_ps(gainBase, _mm_mul_ps(gainStep, frameNumber1));
+			__m128 s0 = _mm_mul_ps(_mm_loadu_ps(samples + index), gain0_);
+			__m128 s1 = _mm_mul_ps(_mm_loadu_ps(samples + index + 4), gain1_);
+			s0 = _mm_min_ps(_mm_max_ps(s0, minSample), maxSample);
+			s1 = _mm_min_ps(_mm_max_ps(s1, minSample), maxSample);
+			const __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(s0), _mm_cvtps_epi32(s1));
+			_mm_storeu_si128((__m128i*)(output + index), packed);
+			frameNumber0 = _mm_add_ps(frameNumber0, frameIncrement);
+			frameNumber1 = _mm_add_ps(frameNumber1, frameIncrement);
+		}
+		for (; f < blockFrameCount; ++f)
+		{
+			const f32 gain = gain0 + step * (f32)(f + 1);
+			const u32 index = ( first + f ) * 2;
+			output[index + 0] = AudioSaturate(samples[index + 0] * gain);
+			output[index + 1] = AudioSaturate(samples[index + 1] * gain);
+		}
+
+		limiter.gain = gain1;
+	}
+
+	MemCopy(limiter.delay, samples + frameCount * 2, sizeof(limiter.delay));
+#else
+	LimitSamplesScalar(limiter, samples, frameCount, output);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////
+// Resampler
+//
+// Output frame k is the input at position p = p0 + k * step. The sinc quality
+// filters the AUDIO_RESAMPLER_TAPS input frames from floor(p) - TAPS/2 + 1 to
+// floor(p) + TAPS/2, interpolating the coefficients of the two closest phases.
+// The linear quality only interpolates frames floor(p) and floor(p) + 1.
+
+#define AUDIO_RESAMPLER_PHASE_BITS 6 // log2(AUDIO_RESAMPLER_PHASES)
+
+CT_ASSERT( ( 1 << AUDIO_RESAMPLER_PHASE_BITS ) == AUDIO_RESAMPLER_PHASES );
+CT_ASSERT( AUDIO_RESAMPLER_TAPS % 4 == 0 ); // Taps are filtered in groups of four
+
+void InitializeSincFilter(AudioSincFilter &filter, f32 cutoff)
+{
+	for (u32 phase = 0; phase <= AUDIO_RESAMPLER_PHASES; ++phase)
+	{
+		f32 *coefs = filter.coefs + phase * AUDIO_RESAMPLER_TAPS * 2;
+		const f32 fraction = (f32)phase / AUDIO_RESAMPLER_PHASES;
+
+		f32 sum = 0.0f;
+		for (u32 tap = 0; tap < AUDIO_RESAMPLER_TAPS; ++tap)
+		{
+			// Distance from the input frame of the tap to the resampled position
+			const f32 x = fraction + (f32)( AUDIO_RESAMPLER_HALF_TAPS - 1 ) - (f32)tap;
+			const f32 t = Pi * cutoff * x;
+			const f32 sinc = Max(t, -t) < 1e-6f ? 1.0f : Sin(t) / t;
+
+			// Blackman window, reaching zero at a distance of TAPS/2 frames
+			const f32 w = Pi * x / AUDIO_RESAMPLER_HALF_TAPS;
+			const f32 window = 0.42f + 0.5f * Cos(w) + 0.08f * Cos(2.0f * w);
+
+			coefs[tap * 2 + 0] = sinc * window;
+			sum += sinc * window;
+		}
+
+		// Unity gain for constant signals
+		for (u32 tap = 0; tap < AUDIO_RESAMPLER_TAPS; ++tap)
+		{
+			coefs[tap * 2 + 0] /= sum;
+			coefs[tap * 2 + 1] = coefs[tap * 2 + 0];
+		}
+	}
+}
+
+void InitializeResampler(AudioResampler &resampler, AudioResamplerQuality quality, const AudioSincFilter *filter, u32 inputRate, u32 outputRate)
+{
+	ASSERT( quality == AudioResamplerQuality_Linear || filter != nullptr );
+	ASSERT( inputRate > 0 && outputRate > 0 );
+
+	resampler = {};
+	resampler.quality = quality;
+	resampler.filter = filter;
+	resampler.step = ( (u64)inputRate << 32 ) / outputRate;
 
-				requestedSampleCount -= sampleCount;
+	// The first output needs its TAPS/2 - 1 previous frames, which are in the history
+	resampler.position = (u64)( AUDIO_RESAMPLER_HALF_TAPS - 1 ) << 32;
+}
+
+// New input frames needed to produce the given output frames
+u32 ResamplerInputFrames(const AudioResampler &resampler, u32 outputFrameCount)
+{
+	if ( outputFrameCount == 0 ) {
+		return 0;
+	}
+
+	const u64 lastPosition = resampler.position + (u64)( outputFrameCount - 1 ) * resampler.step;
+	const u64 lastFrame = ( lastPosition >> 32 ) + AUDIO_RESAMPLER_HALF_TAPS;
+	const u32 inputFrameCount = lastFrame >= AUDIO_RESAMPLER_TAPS ? (u32)( lastFrame - AUDIO_RESAMPLER_TAPS + 1 ) : 0;
+	return inputFrameCount;
+}
+
+// Returns a zeroed input buffer for inputFrameCount stereo frames, preceded by the
+// history frames of the resampler. New frames go after the first AUDIO_RESAMPLER_TAPS.
+f32 *PushResampleBuffer(Arena &arena, const AudioResampler &resampler, u32 inputFrameCount)
+{
+	f32 *samples = PushArray(arena, f32, ( AUDIO_RESAMPLER_TAPS + inputFrameCount ) * 2);
+	MemCopy(samples, resampler.history, sizeof(resampler.history));
+	MemSet(samples + AUDIO_RESAMPLER_TAPS * 2, inputFrameCount * 2 * sizeof(f32), 0);
+	return samples;
+}
+
+// Consumes the input frames, keeping the last ones as history for the next call
+static void AudioResamplerConsume(AudioResampler &resampler, const f32 *samples, u32 inputFrameCount)
+{
+	ASSERT( resampler.position >= (u64)( inputFrameCount + AUDIO_RESAMPLER_HALF_TAPS - 1 ) << 32 );
+	MemCopy(resampler.history, samples + inputFrameCount * 2, sizeof(resampler.history));
+	resampler.position -= (u64)inputFrameCount << 32;
+}
+
+// Moves the resampler forward without output, returns the input frames skipped
+static u32 AudioResamplerSkip(AudioResampler &resampler, u32 outputFrameCount)
+{
+	const u32 inputFrameCount = ResamplerInputFrames(resampler, outputFrameCount);
+	resampler.position += (u64)outputFrameCount * resampler.step - ( (u64)inputFrameCount << 32 );
+	MemSet(resampler.history, sizeof(resampler.history), 0);
+	return inputFrameCount;
+}
+
+// Accumulates up to outputFrameCount resampled frames into the output, consuming
+// all the input frames (ResamplerInputFrames at most). Returns the frames written.
+u32 ResampleFramesScalar(AudioResampler &resampler, const f32 *samples, u32 inputFrameCount, f32 *output, u32 outputFrameCount, f32 gainL, f32 gainR)
+{
+	const u32 endFrame = AUDIO_RESAMPLER_HALF_TAPS + inputFrameCount;
+
+	u32 k = 0;
+	for (; k < outputFrameCount; ++k)
+	{
+		const u32 frame = (u32)( resampler.position >> 32 );
+		if ( frame >= endFrame ) {
+			break;
+		}
+
+		const u32 fraction = (u32)resampler.position;
+		const f32 *x = samples + frame * 2;
+		f32 left = 0.0f;
+		f32 right = 0.0f;
+
+		if ( resampler.quality == AudioResamplerQuality_Linear )
+		{
+			const f32 t = (f32)fraction * ( 1.0f / 4294967296.0f );
+			left = x[0] + ( x[2] - x[0] ) * t;
+			right = x[1] + ( x[3] - x[1] ) * t;
+		}
+		else
+		{
+			const u32 phase = fraction >> ( 32 - AUDIO_RESAMPLER_PHASE_BITS );
+			const f32 t = (f32)( fraction << AUDIO_RESAMPLER_PHASE_BITS ) * ( 1.0f / 4294967296.0f );
+			const f32 *coefs0 = resampler.filter->coefs + phase * AUDIO_RESAMPLER_TAPS * 2;
+			const f32 *coefs1 = coefs0 + AUDIO_RESAMPLER_TAPS * 2;
+			const f32 *first = x - ( AUDIO_RESAMPLER_HALF_TAPS - 1 ) * 2;
+
+			for (u32 tap = 0; tap < AUDIO_RESAMPLER_TAPS; ++tap)
+			{
+				const f32 coef = coefs0[tap * 2] + ( coefs1[tap * 2] - coefs0[tap * 2] ) * t;
+				left += coef * first[tap * 2 + 0];
+				right += coef * first[tap * 2 + 1];
 			}
+		}
 
-			FullWriteBarrier();
+		output[k * 2 + 0] += left * gainL;
+		output[k * 2 + 1] += right * gainR;
+		resampler.position += resampler.step;
+	}
+
+	AudioResamplerConsume(resampler, samples, inputFrameCount);
+	return k;
+}
+
+u32 ResampleFrames(AudioResampler &resampler, const f32 *samples, u32 inputFrameCount, f32 *output, u32 outputFrameCount, f32 gainL, f32 gainR)
+{
+#if USE_AUDIO_SSE2
+	const u32 endFrame = AUDIO_RESAMPLER_HALF_TAPS + inputFrameCount;
+	const __m128 gains = _mm_setr_ps(gainL, gainR, 0.0f, 0.0f);
+	const __m128 toFloat = _mm_set1_ps(1.0f / 4294967296.0f);
+
+	u32 k = 0;
+	for (; k < outputFrameCount; ++k)
+	{
+		const u32 frame = (u32)( resampler.position >> 32 );
+		if ( frame >= endFrame ) {
+			break;
 		}
 
-		if ( !audioSourceIsValid )
+		const u32 fraction = (u32)resampler.position;
+		const f32 *x = samples + frame * 2;
+		__m128 resampled;
+
+		if ( resampler.quality == AudioResamplerQuality_Linear )
 		{
-			// This implies AUDIO_STATE_IDLE
-			audioSource = {};
+			// Both frames in one load: L0 R0 L1 R1
+			const __m128 t = _mm_mul_ps(_mm_set1_ps((f32)fraction), toFloat);
+			const __m128 frames = _mm_loadu_ps(x);
+			const __m128 next = _mm_movehl_ps(frames, frames);
+			resampled = _mm_add_ps(frames, _mm_mul_ps(_mm_sub_ps(next, frames), t));
+		}
+		else
+		{
+			// Two stereo taps per vector, and two accumulators to overlap the latencies
+			const u32 phase = fraction >> ( 32 - AUDIO_RESAMPLER_PHASE_BITS );
+			const __m128 t = _mm_mul_ps(_mm_set1_ps((f32)( fraction << AUDIO_RESAMPLER_PHASE_BITS )), toFloat);
+			const f32 *coefs0 = resampler.filter->coefs + phase * AUDIO_RESAMPLER_TAPS * 2;
+			const f32 *coefs1 = coefs0 + AUDIO_RESAMPLER_TAPS * 2;
+			const f32 *first = x - ( AUDIO_RESAMPLER_HALF_TAPS - 1 ) * 2;
+
+			__m128 sum0 = _mm_setzero_ps();
+			__m128 sum1 = _mm_setzero_ps();
+			for (u32 i = 0; i < AUDIO_RESAMPLER_TAPS * 2; i += 8)
+			{
+				const __m128 c00 = _mm_loadu_ps(coefs0 + i);
+				const __m128 c01 = _mm_loadu_ps(coefs0 + i + 4);
+				const __m128 c0 = _mm_add_ps(c00, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(coefs1 + i), c00), t));
+				const __m128 c1 = _mm_add_ps(c01, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(coefs1 + i + 4), c01), t));
+				sum0 = _mm_add_ps(sum0, _mm_mul_ps(c0, _mm_loadu_ps(first + i)));
+				sum1 = _mm_add_ps(sum1, _mm_mul_ps(c1, _mm_loadu_ps(first + i + 4)));
+			}
+			const __m128 sum = _mm_add_ps(sum0, sum1);
+			resampled = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
 		}
+
+		__m128 out = _mm_loadl_pi(_mm_setzero_ps(), (const __m64*)(output + k * 2));
+		out = _mm_add_ps(out, _mm_mul_ps(resampled, gains));
+		_mm_storel_pi((__m64*)(output + k * 2), out);
+		resampler.position += resampler.step;
 	}
 
-	// Convert f32 samples back to i16 samples
-	f32 *srcSample = realSamples;
-	i16 *dstSample = soundBuffer.samples;
-	for (u32 i = 0; i < soundBuffer.sampleCount; ++i)
+	AudioResamplerConsume(resampler, samples, inputFrameCount);
+	return k;
+#else
+	return ResampleFramesScalar(resampler, samples, inputFrameCount, output, outputFrameCount, gainL, gainR);
+#endif
+}
+
+// Converts a clip into stereo frames at the output rate, without delay. Returns the
+// number of frames of the new clip, whose samples are pushed into the arena.
+u32 ResampleClip(Arena &arena, const i16 *samples, u32 frameCount, u32 channelCount, u32 inputRate, u32 outputRate, i16 **outSamples)
+{
+	ASSERT( channelCount == 1 || channelCount == 2 );
+
+	// Lower the cutoff when reducing the rate, so removed frequencies do not alias
+	AudioSincFilter *filter = PushStruct(arena, AudioSincFilter);
+	InitializeSincFilter(*filter, Min(1.0f, (f32)outputRate / (f32)inputRate) * AUDIO_RESAMPLER_CUTOFF);
+
+	AudioResampler resampler;
+	InitializeResampler(resampler, AudioResamplerQuality_Sinc, filter, inputRate, outputRate);
+
+	// Start on the first input frame, the history being the silence before the clip
+	resampler.position = (u64)AUDIO_RESAMPLER_TAPS << 32;
+
+	// The input frames needed past the end of the clip are silence too
+	const u32 outputFrameCount = (u32)( ( (u64)frameCount * outputRate + inputRate / 2 ) / inputRate );
+	const u32 inputFrameCount = ResamplerInputFrames(resampler, outputFrameCount);
+	f32 *input = PushResampleBuffer(arena, resampler, inputFrameCount);
+	f32 *inputFrame = input + AUDIO_RESAMPLER_TAPS * 2;
+
+	for (u32 i = 0; i < Min(frameCount, inputFrameCount); ++i)
+	{
+		const i16 *frame = samples + i * channelCount;
+		inputFrame[i * 2 + 0] = frame[0];
+		inputFrame[i * 2 + 1] = frame[channelCount - 1];
+	}
+
+	f32 *output = PushZeroArray(arena, f32, outputFrameCount * 2);
+	const u32 resampledFrameCount = ResampleFrames(resampler, input, inputFrameCount, output, outputFrameCount, 1.0f, 1.0f);
+	ASSERT( resampledFrameCount == outputFrameCount );
+
+	i16 *resampled = PushArray(arena, i16, outputFrameCount * 2);
+	for (u32 i = 0; i < outputFrameCount * 2; ++i) {
+		resampled[i] = AudioSaturate(output[i]);
+	}
+
+	*outSamples = resampled;
+	return outputFrameCount;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Audio buses
+//
+// Sources are mixed into the music and sfx buses, whose outputs (filtered, and
+// scaled by their gain) are accumulated into the master bus and sent to the reverb
+// bus. Gain changes ramp over a callback, so they do not click.
+
+#define AUDIO_REVERB_DEFAULT_DECAY 1.5f // Seconds
+#define AUDIO_REVERB_DEFAULT_DAMPING 0.3f
+
+// Coprime delay lengths, between 26 and 45 ms at 48 kHz
+static const u32 sAudioReverbLengths[AUDIO_REVERB_LINE_COUNT] = { 1277, 1559, 1823, 2129 };
+
+void AccumulateSamplesScalar(f32 *dst, const f32 *src, u32 frameCount, f32 gain0, f32 gain1)
+{
+	const f32 step = ( gain1 - gain0 ) / frameCount;
+	for (u32 i = 0; i < frameCount; ++i)
+	{
+		const f32 gain = gain0 + step * (f32)(i + 1);
+		dst[2 * i + 0] += src[2 * i + 0] * gain;
+		dst[2 * i + 1] += src[2 * i + 1] * gain;
+	}
+}
+
+void AccumulateSamples(f32 *dst, const f32 *src, u32 frameCount, f32 gain0, f32 gain1)
+{
+#if USE_AUDIO_SSE2
+	// Two frames per vector, the gain of frame i being gain0 + step * (i + 1)
+	const f32 step = ( gain1 - gain0 ) / frameCount;
+	const __m128 gainBase = _mm_set1_ps(gain0);
+	const __m128 gainStep = _mm_set1_ps(step);
+	__m128 frameNumber0 = _mm_setr_ps(1.0f, 1.0f, 2.0f, 2.0f);
+	__m128 frameNumber1 = _mm_setr_ps(3.0f, 3.0f, 4.0f, 4.0f);
+	const __m128 frameIncrement = _mm_set1_ps(4.0f);
+
+	u32 i = 0;
+	for (; i + 4 <= frameCount; i += 4)
+	{
+		const __m128 g0 = _mm_add_ps(gainBase, _mm_mul_ps(gainStep, frameNumber0));
+		const __m128 g1 = _mm_add_ps(gainBase, _mm_mul_ps(gainStep, frameNumber1));
+		const __m128 d0 = _mm_add_ps(_mm_loadu_ps(dst + 2 * i), _mm_mul_ps(_mm_loadu_ps(src + 2 * i), g0));
+		const __m128 d1 = _mm_add_ps(_mm_loadu_ps(dst + 2 * i + 4), _mm_mul_ps(_mm_loadu_ps(src + 2 * i + 4), g1));
+		_mm_storeu_ps(dst + 2 * i, d0);
+		_mm_storeu_ps(dst + 2 * i + 4, d1);
+		frameNumber0 = _mm_add_ps(frameNumber0, frameIncrement);
+		frameNumber1 = _mm_add_ps(frameNumber1, frameIncrement);
+	}
+	for (; i < frameCount; ++i)
+	{
+		const f32 gain = gain0 + step * (f32)(i + 1);
+		dst[2 * i + 0] += src[2 * i + 0] * gain;
+		dst[2 * i + 1] += src[2 * i + 1] * gain;
+	}
+#else
+	AccumulateSamplesScalar(dst, src, frameCount, gain0, gain1);
+#endif
+}
+
+// Sets the coefficients of a low-pass or high-pass filter (Audio EQ Cookbook), keeping
+// its state so the filter can be changed while playing. A zero frequency disables it.
+void InitializeBiquad(AudioBiquad &biquad, AudioFilterType type, f32 frequency, f32 q, u32 sampleRate)
+{
+	biquad.enabled = frequency > 0.0f;
+	if ( !biquad.enabled )
+	{
+		biquad.z1[0] = biquad.z1[1] = 0.0f;
+		biquad.z2[0] = biquad.z2[1] = 0.0f;
+		return;
+	}
+
+	const f32 w0 = TwoPi * Clamp(frequency, 10.0f, 0.45f * sampleRate) / sampleRate;
+	const f32 alpha = Sin(w0) / ( 2.0f * Max(q, 0.1f) );
+	const f32 cosw0 = Cos(w0);
+	const f32 a0 = 1.0f + alpha;
+
+	if ( type == AudioFilter_LowPass ) {
+		biquad.b0 = ( 1.0f - cosw0 ) * 0.5f / a0;
+		biquad.b1 = ( 1.0f - cosw0 ) / a0;
+	} else {
+		biquad.b0 = ( 1.0f + cosw0 ) * 0.5f / a0;
+		biquad.b1 = -( 1.0f + cosw0 ) / a0;
+	}
+	biquad.b2 = biquad.b0;
+	biquad.a1 = -2.0f * cosw0 / a0;
+	biquad.a2 = ( 1.0f - alpha ) / a0;
+}
+
+void ProcessBiquadScalar(AudioBiquad &biquad, f32 *samples, u32 frameCount)
+{
+	for (u32 c = 0; c < 2; ++c)
+	{
+		f32 z1 = biquad.z1[c];
+		f32 z2 = biquad.z2[c];
+		for (u32 i = 0; i < frameCount; ++i)
+		{
+			const f32 x = samples[2 * i + c];
+			const f32 y = biquad.b0 * x + z1;
+			z1 = biquad.b1 * x - biquad.a1 * y + z2;
+			z2 = biquad.b2 * x - biquad.a2 * y;
+			samples[2 * i + c] = y;
+		}
+		biquad.z1[c] = z1;
+		biquad.z2[c] = z2;
+	}
+}
+
+void ProcessBiquad(AudioBiquad &biquad, f32 *samples, u32 frameCount)
+{
+#if USE_AUDIO_SSE2
+	// The recursion goes frame by frame, both channels in the lower lanes
+	const __m128 b0 = _mm_set1_ps(biquad.b0);
+	const __m128 b1 = _mm_set1_ps(biquad.b1);
+	const __m128 b2 = _mm_set1_ps(biquad.b2);
+	const __m128 a1 = _mm_set1_ps(biquad.a1);
+	const __m128 a2 = _mm_set1_ps(biquad.a2);
+	__m128 z1 = _mm_setr_ps(biquad.z1[0], biquad.z1[1], 0.0f, 0.0f);
+	__m128 z2 = _mm_setr_ps(biquad.z2[0], biquad.z2[1], 0.0f, 0.0f);
+
+	for (u32 i = 0; i < frameCount; ++i)
+	{
+		const __m128 x = _mm_loadl_pi(_mm_setzero_ps(), (const __m64*)(samples + 2 * i));
+		const __m128 y = _mm_add_ps(_mm_mul_ps(b0, x), z1);
+		z1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1, x), _mm_mul_ps(a1, y)), z2);
+		z2 = _mm_sub_ps(_mm_mul_ps(b2, x), _mm_mul_ps(a2, y));
+		_mm_storel_pi((__m64*)(samples + 2 * i), y);
+	}
+
+	_mm_storel_pi((__m64*)biquad.z1, z1);
+	_mm_storel_pi((__m64*)biquad.z2, z2);
+#else
+	ProcessBiquadScalar(biquad, samples, frameCount);
+#endif
+}
+
+bool InitializeReverb(AudioReverb &reverb, Arena &arena)
+{
+	reverb = {};
+	for (u32 l = 0; l < AUDIO_REVERB_LINE_COUNT; ++l)
+	{
+		reverb.lengths[l] = sAudioReverbLengths[l];
+		reverb.lines[l] = PushZeroArray(arena, f32, reverb.lengths[l]);
+		if ( reverb.lines[l] == nullptr ) {
+			return false;
+		}
+	}
+	SetReverbDecay(reverb, AUDIO_REVERB_DEFAULT_DECAY, AUDIO_REVERB_DEFAULT_DAMPING);
+	return true;
+}
+
+void SetReverbDecay(AudioReverb &reverb, f32 decaySeconds, f32 damping)
+{
+	reverb.decaySeconds = Clamp(decaySeconds, 0.1f, 20.0f);
+	reverb.damping = Clamp(damping, 0.0f, 0.95f);
+
+	// Each trip through a line of n frames loses 60 dB * n / (decay * rate)
+	for (u32 l = 0; l < AUDIO_REVERB_LINE_COUNT; ++l) {
+		const f32 decayFrames = reverb.decaySeconds * AUDIO_SAMPLE_RATE;
+		reverb.feedbacks[l] = powf(10.0f, -3.0f * reverb.lengths[l] / decayFrames);
+	}
+}
+
+// Accumulates the reverberation of the input into the output
+void ProcessReverbScalar(AudioReverb &reverb, const f32 *input, f32 *output, u32 frameCount)
+{
+	for (u32 i = 0; i < frameCount; ++i)
 	{
-		*dstSample++ = (i16)*srcSample++;
-		*dstSample++ = (i16)*srcSample++;
+		const f32 in = ( input[2 * i + 0] + input[2 * i + 1] ) * 0.5f;
+
+		f32 x[AUDIO_REVERB_LINE_COUNT];
+		for (u32 l = 0; l < AUDIO_REVERB_LINE_COUNT; ++l) {
+			x[l] = reverb.lines[l][reverb.positions[l]];
+			reverb.lowPass[l] = x[l] + reverb.damping * ( reverb.lowPass[l] - x[l] );
+		}
+
+		// Orthogonal mix of the damped lines
+		const f32 *d = reverb.lowPass;
+		const f32 h[AUDIO_REVERB_LINE_COUNT] = {
+			( ( d[0] + d[1] ) + ( d[2] + d[3] ) ) * 0.5f,
+			( ( d[0] - d[1] ) + ( d[2] - d[3] ) ) * 0.5f,
+			( ( d[0] + d[1] ) - ( d[2] + d[3] ) ) * 0.5f,
+			( ( d[0] - d[1] ) - ( d[2] - d[3] ) ) * 0.5f,
+		};
+
+		for (u32 l = 0; l < AUDIO_REVERB_LINE_COUNT; ++l)
+		{
+			reverb.lines[l][reverb.positions[l]] = h[l] * reverb.feedbacks[l] + in;
+			reverb.positions[l] = reverb.positions[l] + 1 < reverb.lengths[l] ? reverb.positions[l] + 1 : 0;
+		}
+
+		output[2 * i + 0] += ( x[0] + x[2] ) * 0.5f;
+		output[2 * i + 1] += ( x[1] + x[3] ) * 0.5f;
 	}
+}
+
+void ProcessReverb(AudioReverb &reverb, const f32 *input, f32 *output, u32 frameCount)
+{
+#if USE_AUDIO_SSE2
+	// One delay line per lane: the damping, the Hadamard mix and the feedback are vectorized
+	CT_ASSERT( AUDIO_REVERB_LINE_COUNT == 4 );
+	const __m128 damping = _mm_set1_ps(reverb.damping);
+	const __m128 feedbacks = _mm_mul_ps(_mm_loadu_ps(reverb.feedbacks), _mm_set1_ps(0.5f));
+	const __m128 signs1 = _mm_setr_ps(1.0f, -1.0f, 1.0f, -1.0f);
+	const __m128 signs2 = _mm_setr_ps(1.0f, 1.0f, -1.0f, -1.0f);
+	__m128 lowPass = _mm_loadu_ps(reverb.lowPass);
+
+	f32 *line0 = reverb.lines[0], *line1 = reverb.lines[1], *line2 = reverb.lines[2], *line3 = reverb.lines[3];
+	u32 p0 = reverb.positions[0], p1 = reverb.positions[1], p2 = reverb.positions[2], p3 = reverb.positions[3];
+	f32 y[AUDIO_REVERB_LINE_COUNT];
+
+	for (u32 i = 0; i < frameCount; ++i)
+	{
+		const f32 in = ( input[2 * i + 0] + input[2 * i + 1] ) * 0.5f;
+		const f32 x0 = line0[p0], x1 = line1[p1], x2 = line2[p2], x3 = line3[p3];
+
+		const __m128 x = _mm_setr_ps(x0, x1, x2, x3);
+		lowPass = _mm_add_ps(x, _mm_mul_ps(damping, _mm_sub_ps(lowPass, x)));
+
+		// Hadamard butterflies: (a+b, a-b, c+d, c-d), and then across the pairs
+		const __m128 h1 = _mm_add_ps(_mm_mul_ps(lowPass, signs1), _mm_shuffle_ps(lowPass, lowPass, _MM_SHUFFLE(2, 3, 0, 1)));
+		const __m128 h2 = _mm_add_ps(_mm_mul_ps(h1, signs2), _mm_shuffle_ps(h1, h1, _MM_SHUFFLE(1, 0, 3, 2)));
+		_mm_storeu_ps(y, _mm_add_ps(_mm_mul_ps(h2, feedbacks), _mm_set1_ps(in)));
+
+		line0[p0] = y[0];
+		line1[p1] = y[1];
+		line2[p2] = y[2];
+		line3[p3] = y[3];
+		p0 = p0 + 1 < reverb.lengths[0] ? p0 + 1 : 0;
+		p1 = p1 + 1 < reverb.lengths[1] ? p1 + 1 : 0;
+		p2 = p2 + 1 < reverb.lengths[2] ? p2 + 1 : 0;
+		p3 = p3 + 1 < reverb.lengths[3] ? p3 + 1 : 0;
+
+		output[2 * i + 0] += ( x0 + x2 ) * 0.5f;
+		output[2 * i + 1] += ( x1 + x3 ) * 0.5f;
+	}
+
+	_mm_storeu_ps(reverb.lowPass, lowPass);
+	reverb.positions[0] = p0;
+	reverb.positions[1] = p1;
+	reverb.positions[2] = p2;
+	reverb.positions[3] = p3;
+#else
+	ProcessReverbScalar(reverb, input, output, frameCount);
+#endif
+}
+
+// Filters, scales and routes the buses, from the music and sfx ones to the output
+static void AudioProcessBuses(Audio &audio, Arena scratchArena, f32 *busSamples[AudioBus_COUNT], f32 *output, u32 frameCount)
+{
+	AudioReverb &reverb = audio.reverb;
+	f32 *reverbInput = PushZeroArray(scratchArena, f32, frameCount * 2);
+	bool reverbFed = false;
+
+	for (u32 b = 0; b < AudioBus_COUNT; ++b)
+	{
+		AudioBus &bus = audio.buses[b];
+		f32 *samples = busSamples[b];
+		const Clock begin = GetClock();
+
+		// The reverb keeps running until its tail fades out
+		if ( b == AudioBus_Reverb )
+		{
+			if ( reverbFed ) {
+				reverb.tailFrameCount = (u32)( reverb.decaySeconds * AUDIO_SAMPLE_RATE );
+			} else {
+				reverb.tailFrameCount -= Min(reverb.tailFrameCount, frameCount);
+			}
+			if ( reverb.tailFrameCount > 0 ) {
+				ProcessReverb(reverb, reverbInput, samples, frameCount);
+			}
+		}
+
+		for (u32 f = 0; f < AudioFilter_COUNT; ++f) {
+			if ( bus.filters[f].enabled ) {
+				ProcessBiquad(bus.filters[f], samples, frameCount);
+			}
+		}
+
+		f32 *parent = b == AudioBus_Master ? output : busSamples[AudioBus_Master];
+		AccumulateSamples(parent, samples, frameCount, bus.currentGain, bus.gain);
+
+		// Post-gain send
+		if ( bus.currentReverbSend > 0.0f || bus.reverbSend > 0.0f )
+		{
+			const f32 send0 = bus.currentGain * bus.currentReverbSend;
+			const f32 send1 = bus.gain * bus.reverbSend;
+			AccumulateSamples(reverbInput, samples, frameCount, send0, send1);
+			reverbFed = true;
+		}
+
+		bus.currentGain = bus.gain;
+		bus.currentReverbSend = bus.reverbSend;
+		bus.millis = 1000.0f * GetSecondsElapsed(begin, GetClock());
+	}
+}
+
+// Makes real the audible voices of highest priority, and then the loudest ones,
+// up to the real voice limit. The other voices become virtual.
+static void AudioSelectRealVoices(Audio &audio)
+{
+	u32 selected[MAX_AUDIO_REAL_VOICES]; // Active voice indices, by descending score
+	u64 selectedScores[MAX_AUDIO_REAL_VOICES];
+	u32 selectedCount = 0;
+	const u32 limit = Min(audio.realVoiceLimit, (u32)MAX_AUDIO_REAL_VOICES);
+
+	for (u32 i = 0; i < audio.activeVoiceCount; ++i)
+	{
+		AudioVoice &voice = audio.voices[audio.activeVoices[i]];
+		voice.selected = false;
+
+		if ( voice.state != AUDIO_STATE_PLAYING || voice.gain < AUDIO_AUDIBLE_GAIN ) {
+			continue;
+		}
+
+		// Priority first, then gain (positive floats compare like their bits),
+		// and real voices win ties so they are not swapped back and forth
+		u32 gainBits;
+		MemCopy(&gainBits, &voice.gain, sizeof(gainBits));
+		const u64 isReal = voice.realVoiceIndex != INVALID_AUDIO_REAL_VOICE ? 1 : 0;
+		const u64 score = (u64)voice.priority << 33 | (u64)gainBits << 1 | isReal;
+
+		if ( selectedCount == limit && ( limit == 0 || score <= selectedScores[limit - 1] ) ) {
+			continue;
+		}
+
+		u32 j = selectedCount < limit ? selectedCount++ : limit - 1;
+		while ( j > 0 && selectedScores[j - 1] < score )
+		{
+			selectedScores[j] = selectedScores[j - 1];
+			selected[j] = selected[j - 1];
+			--j;
+		}
+		selectedScores[j] = score;
+		selected[j] = i;
+	}
+
+	for (u32 i = 0; i < selectedCount; ++i) {
+		audio.voices[audio.activeVoices[selected[i]]].selected = true;
+	}
+
+	// Free the streams of the voices left out before giving them to the new ones
+	for (u32 i = 0; i < audio.activeVoiceCount; ++i)
+	{
+		AudioVoice &voice = audio.voices[audio.activeVoices[i]];
+		if ( !voice.selected ) {
+			AudioVoiceMakeVirtual(audio, voice);
+		}
+	}
+
+	for (u32 i = 0; i < selectedCount; ++i)
+	{
+		AudioVoice &voice = audio.voices[audio.activeVoices[selected[i]]];
+		if ( voice.realVoiceIndex == INVALID_AUDIO_REAL_VOICE ) {
+			AudioVoiceMakeReal(audio, voice);
+		}
+	}
+
+	audio.realVoiceCount = selectedCount;
+	audio.virtualVoiceCount = audio.activeVoiceCount - selectedCount;
+}
+
+// Moves a voice forward without mixing it, returns false when the voice ends
+static bool AudioAdvanceVoice(Audio &audio, AudioVoice &voice, u32 sampleCount)
+{
+	const AudioClip &audioClip = GetAudioClip(audio, voice.clip);
+
+	voice.lastWriteSampleIndex += sampleCount;
+
+	// Real voices waiting for their chunks keep the streamer loading ahead of them
+	if ( voice.realVoiceIndex != INVALID_AUDIO_REAL_VOICE )
+	{
+		AudioStream &stream = audio.streamer.streams[voice.realVoiceIndex];
+		stream.chunkIndex = voice.lastWriteSampleIndex / AUDIO_CHUNK_SAMPLE_COUNT;
+	}
+
+	const bool playing = voice.lastWriteSampleIndex < audioClip.sampleCount;
+	return playing;
+}
+
+// Mixes the next samples of a real voice from its stream, returns false when the voice ends
+static bool AudioMixVoice(Audio &audio, AudioVoice &voice, f32 *dstSample, u32 requestedSampleCount, f32 gainL, f32 gainR)
+{
+	const AudioClip &audioClip = GetAudioClip(audio, voice.clip);
+	AudioStream &stream = audio.streamer.streams[voice.realVoiceIndex];
+
+	bool playing = true;
+
+	while ( requestedSampleCount > 0 && playing )
+	{
+		const u32 chunkIndex = voice.lastWriteSampleIndex / AUDIO_CHUNK_SAMPLE_COUNT;
+		const u32 firstSampleIndex = chunkIndex * AUDIO_CHUNK_SAMPLE_COUNT;
+
+		// Chunks loaded for a previous play may still arrive after a restart
+		AudioStreamReleaseChunks(stream, stream.playId, chunkIndex);
+
+		// New voices wait for their first chunk, and voices that were virtual keep
+		// moving until it arrives. Late chunks afterwards are underruns.
+		const AudioChunk &chunk = stream.chunks[chunkIndex % AUDIO_STREAM_CHUNK_COUNT];
+		if ( chunk.state != AudioChunkState_Ready ) {
+			if ( voice.mixing ) {
+				audio.streamer.underrunCount = audio.streamer.underrunCount + 1;
+			} else if ( voice.lastWriteSampleIndex > 0 ) {
+				playing = AudioAdvanceVoice(audio, voice, requestedSampleCount);
+			}
+			break;
+		}
+
+		FullReadBarrier();
+		ASSERT( chunk.playId == stream.playId && chunk.index == chunkIndex );
+		voice.mixing = true;
+
+		// Mix requested samples from chunk to real samples
+		const u32 chunkSampleOffset = voice.lastWriteSampleIndex - firstSampleIndex;
+		const i16 *srcSample = chunk.samples + chunkSampleOffset;
+		const u32 remainingSampleCount = chunk.sampleCount - chunkSampleOffset;
+		const u32 sampleCount = Min(remainingSampleCount, requestedSampleCount);
+
+		MixSamples(dstSample, srcSample, sampleCount / 2, gainL, gainR);
+		dstSample += sampleCount;
+
+		voice.lastWriteSampleIndex += sampleCount;
+		playing = voice.lastWriteSampleIndex < audioClip.sampleCount;
+
+		requestedSampleCount -= sampleCount;
+
+		// Move the cursor, so the streamer loads the chunks after it
+		stream.chunkIndex = voice.lastWriteSampleIndex / AUDIO_CHUNK_SAMPLE_COUNT;
+	}
+
+	FullWriteBarrier();
+	return playing;
+}
+
+// Voices whose clip rate or pitch differ (or differed) from the mix rate go through their resampler
+static bool AudioVoiceIsResampled(const AudioVoice &voice)
+{
+	return voice.resampled;
+}
+
+// Mixes the clip samples of a real voice into a scratch buffer, and resamples them
+// into the mix, returns false when the voice ends
+static bool AudioMixResampledVoice(Audio &audio, AudioVoice &voice, Arena scratchArena, f32 *dstSample, u32 frameCount, f32 gainL, f32 gainR)
+{
+	const u32 inputFrameCount = ResamplerInputFrames(voice.resampler, frameCount);
+	f32 *input = PushResampleBuffer(scratchArena, voice.resampler, inputFrameCount);
+	const bool playing = AudioMixVoice(audio, voice, input + AUDIO_RESAMPLER_TAPS * 2, inputFrameCount * 2, 1.0f, 1.0f);
+	ResampleFrames(voice.resampler, input, inputFrameCount, dstSample, frameCount, gainL, gainR);
+	return playing;
+}
+
+void RenderAudio(Engine &engine, SoundBuffer &soundBuffer)
+{
+	Audio &audio = engine.audio;
+
+	if (!audio.initialized) {
+		return;
+	}
+
+	if ( soundBuffer.sampleCount == 0 ) {
+		return;
+	}
+
+#if 1
+#if USE_AUDIO_SSE2
+	// Decaying filter and reverb states would otherwise turn into slow denormals
+	_mm_setcsr(_mm_getcsr() | 0x8040); // Flush to zero, denormals are zero
+#endif
+
+	AudioCmdQueue_Process(audio);
+
+	Scratch scratch;
+
+	// Sources are mixed at AUDIO_SAMPLE_RATE, and resampled if the device runs at another rate
+	if ( soundBuffer.samplesPerSecond != audio.outputRate )
+	{
+		audio.outputRate = soundBuffer.samplesPerSecond;
+		const f32 cutoff = Min(1.0f, (f32)audio.outputRate / AUDIO_SAMPLE_RATE) * AUDIO_RESAMPLER_CUTOFF;
+		InitializeSincFilter(audio.outputFilter, cutoff);
+		InitializeResampler(audio.outputResampler, AudioResamplerQuality_Sinc, &audio.outputFilter, AUDIO_SAMPLE_RATE, audio.outputRate);
+	}
+	const bool resampleOutput = audio.outputRate != AUDIO_SAMPLE_RATE;
+	const u32 frameCount = resampleOutput ?
+		ResamplerInputFrames(audio.outputResampler, soundBuffer.sampleCount) :
+		soundBuffer.sampleCount;
+
+	// Mixed samples follow the ones still held back by the limiter (or by the resampler)
+	f32 *mixSamples = PushMixBuffer(scratch.arena, audio.limiter, soundBuffer.sampleCount);
+	f32 *resampleSamples = resampleOutput ? PushResampleBuffer(scratch.arena, audio.outputResampler, frameCount) : nullptr;
+	f32 *realSamples = resampleOutput ?
+		resampleSamples + AUDIO_RESAMPLER_TAPS * 2 :
+		mixSamples + AUDIO_LIMITER_LOOKAHEAD * 2;
+
+	// Sources are mixed into their bus
+	f32 *busSamples[AudioBus_COUNT];
+	for (u32 i = 0; i < AudioBus_COUNT; ++i) {
+		busSamples[i] = PushZeroArray(scratch.arena, f32, frameCount * 2);
+	}
+	f32 *musicSamples = busSamples[AudioBus_Music];
+	f32 *sfxSamples = busSamples[AudioBus_Sfx];
+
+	// Render music
+	if ( audio.musicState == AUDIO_STATE_PLAYING )
+	{
+		AudioMusicRing &ring = audio.musicRing;
+		const u32 readIndex = ring.readIndex;
+		const u32 availableMusicSampleCount = ring.writeIndex - readIndex;
+		FullReadBarrier();
+
+		// Wrap around the end of the ring
+		const u32 musicSampleCount = Min(frameCount * 2, availableMusicSampleCount);
+		const u32 firstIndex = readIndex & ring.mask;
+		const u32 firstSampleCount = Min(musicSampleCount, ring.sampleCount - firstIndex);
+		MixSamples(musicSamples, ring.samples + firstIndex, firstSampleCount / 2, 1.0f, 1.0f);
+		MixSamples(musicSamples + firstSampleCount, ring.samples, ( musicSampleCount - firstSampleCount ) / 2, 1.0f, 1.0f);
+
+		// Release the samples once read
+		FullWriteBarrier();
+		ring.readIndex = readIndex + musicSampleCount;
+
+		// Until the producer runs once after a play, the ring is expected to be empty
+		if ( musicSampleCount < frameCount * 2 )
+		{
+			// The producer may not have seen the last restart yet, ending the previous play
+			const bool restartSeen = audio.musicRestartAck == audio.musicRestartCount;
+			FullReadBarrier();
+			if ( restartSeen && audio.musicEnded ) {
+				audio.musicState = AUDIO_STATE_IDLE;
+			} else if ( audio.musicPrimed ) {
+				audio.musicUnderrunCount++;
+			}
+		}
+		audio.musicPrimed = audio.musicPrimed || musicSampleCount > 0;
+	}
+
+
+	// Pick the voices to mix within the real voice limit
+	AudioSelectRealVoices(audio);
+
+	// Render audio clips: real voices are mixed, virtual ones only move forward
+	// frameCount is for stereo samples (each stereo sample is 2 mono samples)
+	for (u32 i = audio.activeVoiceCount; i-- > 0; )
+	{
+		AudioVoice &voice = audio.voices[audio.activeVoices[i]];
+
+		bool voiceIsValid = IsValidHandle(audio.clipHandles, voice.clip);
+
+		if ( voiceIsValid && voice.state == AUDIO_STATE_PLAYING )
+		{
+			const bool resampled = AudioVoiceIsResampled(voice);
+
+			if ( voice.realVoiceIndex != INVALID_AUDIO_REAL_VOICE ) {
+				f32 gainL, gainR;
+				AudioPanGains(voice.gain, voice.pan, gainL, gainR);
+				voiceIsValid = resampled ?
+					AudioMixResampledVoice(audio, voice, scratch.arena, sfxSamples, frameCount, gainL, gainR) :
+					AudioMixVoice(audio, voice, sfxSamples, frameCount * 2, gainL, gainR);
+			} else {
+				const u32 clipFrameCount = resampled ? AudioResamplerSkip(voice.resampler, frameCount) : frameCount;
+				voiceIsValid = AudioAdvanceVoice(audio, voice, clipFrameCount * 2);
+			}
+		}
+
+		if ( !voiceIsValid )
+		{
+			AudioVoiceEnd(audio, i);
+		}
+	}
+
+	// Chunks of stopped voices, or loaded for a previous play, go back to the streamer
+	for (u32 i = 0; i < MAX_AUDIO_REAL_VOICES; ++i)
+	{
+		AudioStream &stream = audio.streamer.streams[i];
+		AudioStreamReleaseChunks(stream, stream.playId, stream.chunkIndex);
+	}
+
+	// Effects, and buses into the mix
+	AudioProcessBuses(audio, scratch.arena, busSamples, realSamples, frameCount);
+
+	if ( resampleOutput ) {
+		ResampleFrames(audio.outputResampler, resampleSamples, frameCount, mixSamples + AUDIO_LIMITER_LOOKAHEAD * 2, soundBuffer.sampleCount, 1.0f, 1.0f);
+	}
+
+	// Convert f32 samples back to i16 samples
+	LimitSamples(audio.limiter, mixSamples, soundBuffer.sampleCount, soundBuffer.samples);
 #else
 	// Wave parameters
 	const u32 ToneHz = 256;
@@ -985,7 +2461,10 @@ void MusicPlay(Engine &engine, Handle handle)
 			FileSeek(engine.assets.file, musicFile.location.offset);
 			chunk.size = musicFile.location.size;
 			chunk.bytes = PushArray(audio.moduleArena, byte, chunk.size);
-			ReadFromFile(engine.assets.file, chunk.bytes, chunk.size);
+			if ( !ReadFromFile(engine.assets.file, chunk.bytes, chunk.size) ||
+			     !CheckAssetPayload(musicFile.location, chunk.bytes) ) {
+				chunk.bytes = nullptr;
+			}
 		}
 
 		if ( chunk.bytes != nullptr )
@@ -1056,9 +2535,7 @@ void AudioStopAll(Engine &engine)
 {
 	MusicStop(engine);
 
-	for (u32 i = 0; i < MAX_AUDIO_SOURCES; ++i)
-	{
-		StopAudioSource(engine, i);
-	}
+	AudioCmd cmd = { .type = AudioCmd_StopAll };
+	AudioCmdQueue_Push(cmd);
 }
 
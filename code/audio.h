@@ -4,12 +4,43 @@
 //#include "tools_mod.h"
 #include "libs/ibxm/ibxm.h"
 
-
-#define MAX_AUDIO_CLIPS 16
-#define MAX_AUDIO_SOURCES 16
+// The mixer uses AVX2 when the compiler targets it, SSE2 on any other x86-64 build,
+// and the scalar reference elsewhere (ARM)
+#if defined(__AVX2__)
+#	define USE_AUDIO_AVX2 1
+#	define USE_AUDIO_SSE2 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#	define USE_AUDIO_SSE2 1
+#endif
+
+#if USE_AUDIO_SSE2
+#include <immintrin.h>
+#endif
+
+
+#define AUDIO_CLIP_PAGE_SIZE 64 // Clips are allocated in pages, as they are created
+#define MAX_AUDIO_CLIP_PAGES ( ( U16_MAX + AUDIO_CLIP_PAGE_SIZE - 1 ) / AUDIO_CLIP_PAGE_SIZE ) // Enough for any 16-bit handle index
+#define MAX_AUDIO_VOICES 512 // Voices that can play at the same time, most of them virtual
+#define MAX_AUDIO_REAL_VOICES 64 // Voices that can be streamed and mixed at the same time
+#define AUDIO_DEFAULT_REAL_VOICES 32
+#define AUDIO_PRIORITY_DEFAULT 128
+#define AUDIO_AUDIBLE_GAIN 0.001f // Quieter voices (-60 dB) are never mixed
 #define AUDIO_CHUNK_SAMPLE_COUNT (48000u/4u)
+#define AUDIO_STREAM_CHUNK_COUNT 4 // Chunks streamed ahead per audio source, including the one being played
+#define AUDIO_LIMITER_LOOKAHEAD 32 // Frames the limiter looks ahead (and delays the output)
+#define AUDIO_SAMPLE_RATE 48000 // Rate of the streamed clips and the mix
+#define AUDIO_RESAMPLER_TAPS 16 // Input frames per output frame, and frames of history
+#define AUDIO_RESAMPLER_HALF_TAPS ( AUDIO_RESAMPLER_TAPS / 2 )
+#define AUDIO_RESAMPLER_ONE ( (u64)1 << 32 ) // Step of the resampler at the same rate (32.32 fixed point)
+#define AUDIO_RESAMPLER_PHASES 64 // Filters between two input frames (interpolated)
+#define AUDIO_RESAMPLER_CUTOFF 0.95f // Fraction of the Nyquist frequency kept by the sinc filters
+#define AUDIO_MIN_PITCH 0.125f
+#define AUDIO_MAX_PITCH 8.0f
+#define AUDIO_REVERB_LINE_COUNT 4 // Delay lines of the reverb, one per SIMD lane
+#define AUDIO_BUTTERWORTH_Q 0.7071f
 
 #define MAX_MUSIC_FILES 16
+#define AUDIO_CACHE_LINE_SIZE 64
 
 ////////////////////////////////////////////////////////////////////////
 // Types
@@ -23,16 +54,18 @@ enum AudioClipLoadSource
 
 struct AudioClip
 {
-	u32 sampleCount;
+	u32 sampleCount; // Decoded samples
 	u32 samplingRate;
 	u16 sampleSize;
 	u16 channelCount;
+	AudioClipFormat format;
 	AudioClipLoadSource loadSource;
 	union
 	{
 		BinLocation location;
 		const char *filename;
 	};
+	u32 dataOffset; // WAV only: offset of the samples within the file
 };
 
 enum AudioState
@@ -43,21 +76,195 @@ enum AudioState
 };
 
 typedef Handle AudioClipH;
+typedef Handle AudioVoiceH;
+
+// Windowed-sinc lowpass filter, sampled at AUDIO_RESAMPLER_PHASES + 1 fractional
+// positions. Each coefficient is stored twice, to filter interleaved stereo frames.
+struct AudioSincFilter
+{
+	f32 coefs[(AUDIO_RESAMPLER_PHASES + 1) * AUDIO_RESAMPLER_TAPS * 2];
+};
+
+enum AudioResamplerQuality
+{
+	AudioResamplerQuality_Linear,
+	AudioResamplerQuality_Sinc,
+};
+
+// Streaming sample rate converter for stereo frames. The input buffers start with
+// the last AUDIO_RESAMPLER_TAPS frames of the previous input (see PushResampleBuffer),
+// and the output is delayed by AUDIO_RESAMPLER_TAPS / 2 + 1 input frames.
+struct AudioResampler
+{
+	AudioResamplerQuality quality;
+	const AudioSincFilter *filter;
+	u64 step; // Input frames per output frame, 32.32 fixed point
+	u64 position; // Position in the input buffer, 32.32 fixed point
+	f32 history[AUDIO_RESAMPLER_TAPS * 2];
+};
+
+// Single producer (PreRenderAudio) single consumer (RenderAudio) ring of music
+// samples. The indices only grow and wrap with the mask, each one on its own cache line.
+struct AudioMusicRing
+{
+	i16 *samples;
+	u32 sampleCount; // Mono samples count, a power of two
+	u32 mask;
+	u8 padding0[AUDIO_CACHE_LINE_SIZE];
+	volatile_u32 writeIndex; // Only written by the producer
+	u8 padding1[AUDIO_CACHE_LINE_SIZE - sizeof(u32)];
+	volatile_u32 readIndex; // Only written by the consumer
+	u8 padding2[AUDIO_CACHE_LINE_SIZE - sizeof(u32)];
+};
+
+// Buses, in processing order: each one is mixed into the master bus, and the music
+// and sfx buses can also send to the reverb bus
+enum AudioBusId
+{
+	AudioBus_Music,
+	AudioBus_Sfx, // Audio clip voices
+	AudioBus_Reverb, // Send effect
+	AudioBus_Master,
+	AudioBus_COUNT,
+};
+
+enum AudioFilterType
+{
+	AudioFilter_LowPass,
+	AudioFilter_HighPass,
+	AudioFilter_COUNT,
+};
+
+// Stereo biquad filter, in transposed direct form II
+struct AudioBiquad
+{
+	bool enabled;
+	f32 b0, b1, b2;
+	f32 a1, a2;
+	f32 z1[2];
+	f32 z2[2];
+};
+
+// Feedback delay network: damped delay lines of coprime lengths, mixed by a Hadamard
+// matrix and fed back with the gain that makes them decay 60 dB in decaySeconds
+struct AudioReverb
+{
+	f32 *lines[AUDIO_REVERB_LINE_COUNT];
+	u32 lengths[AUDIO_REVERB_LINE_COUNT]; // Frames
+	u32 positions[AUDIO_REVERB_LINE_COUNT];
+	f32 feedbacks[AUDIO_REVERB_LINE_COUNT];
+	f32 lowPass[AUDIO_REVERB_LINE_COUNT]; // Damping filter states
+	f32 damping; // 0 (bright) to 1 (dark)
+	f32 decaySeconds;
+	u32 tailFrameCount; // Frames still ringing after the last input
+};
+
+struct AudioBus
+{
+	f32 gain;
+	f32 reverbSend; // Amount of the bus output sent to the reverb bus
+	f32 currentGain; // Gains ramp to their target over a callback
+	f32 currentReverbSend;
+	AudioBiquad filters[AudioFilter_COUNT];
+	f32 millis; // CPU time of the last callback, written by the audio thread
+};
+
+struct AudioClipPage
+{
+	AudioClip clips[AUDIO_CLIP_PAGE_SIZE];
+	AudioClipDesc descs[AUDIO_CLIP_PAGE_SIZE];
+};
+
+#define INVALID_AUDIO_REAL_VOICE U32_MAX
 
-struct AudioSource
+// A playing voice, owned by the audio thread. Real voices are streamed and mixed,
+// virtual ones only move their play position until they become real again.
+struct AudioVoice
 {
+	AudioVoiceH handle;
 	AudioClipH clip;
-	u32 lastWriteSampleIndex = 0;
+	u32 lastWriteSampleIndex;
 	AudioState state;
+	f32 gain;
+	f32 pan; // -1 (left) to 1 (right)
+	f32 pitch;
+	AudioResampler resampler; // Only used when the pitch or the clip rate need it
+	bool resampled; // Mixed through the resampler, until the voice is started again
+	u8 priority; // Higher priority voices are mixed and kept first
+	bool mixing; // Real voice whose chunks already arrived
+	bool selected; // Scratch flag for the real voice selection
+	u32 realVoiceIndex; // Stream of the voice, or INVALID_AUDIO_REAL_VOICE if virtual
+	volatile_u32 endedHandle; // Handle of the last voice that ended, for the update thread to free it
+};
+
+// Update thread bookkeeping of a voice, to pick the one to steal when the pool is full
+struct AudioVoiceInfo
+{
+	u8 priority;
+	u32 startIndex;
+};
+
+// Soft limiter applied to the final mix. The gain moves linearly over blocks of
+// AUDIO_LIMITER_LOOKAHEAD frames, and each block sees the peak of the next one in
+// advance, so the gain is already down when a peak arrives.
+struct AudioLimiter
+{
+	f32 delay[AUDIO_LIMITER_LOOKAHEAD * 2]; // Last stereo frames of the previous mix, not output yet
+	f32 gain;
+};
+
+// Audio chunks are handed from the streamer to the audio thread without locks:
+// the streamer only writes Empty chunks and the audio thread only reads Ready ones.
+enum AudioChunkState : u32
+{
+	AudioChunkState_Empty, // Owned by the streamer
+	AudioChunkState_Ready, // Owned by the audio thread
 };
 
 struct AudioChunk
 {
-	AudioClipH clipH;
+	volatile_u32 state; // AudioChunkState
+	u32 playId;
 	u32 index;
+	u32 sampleCount;
 	i16 samples[AUDIO_CHUNK_SAMPLE_COUNT];
-	AudioChunk *prev;
-	AudioChunk *next;
+};
+
+// Streaming state of an audio source. The cursor is published by the audio thread
+// and read by the streamer to predict the next chunks. Chunk i goes into slot
+// i % AUDIO_STREAM_CHUNK_COUNT.
+struct AudioStream
+{
+	volatile_u32 playId; // 0 if not streaming
+	volatile_u32 clip;   // AudioClipH of the clip being played
+	volatile_u32 chunkIndex;
+	volatile_u32 startSampleIndex; // Samples of the first chunk before it are not loaded
+	AudioChunk chunks[AUDIO_STREAM_CHUNK_COUNT];
+};
+
+enum AudioStreamJobState : u32
+{
+	AudioStreamJobState_Idle,
+	AudioStreamJobState_Pending,
+	AudioStreamJobState_Running,
+};
+
+typedef bool AudioStreamReadFunc(File &file, u64 offset, void *samples, u32 size);
+
+struct AudioStreamer
+{
+	AudioStream *streams; // One per real voice
+
+	volatile_u32 jobState; // AudioStreamJobState
+	AudioStreamReadFunc *read;
+	FilePath assetsFilepath; // Set by the update thread while no job runs
+	byte *adpcmBlocks; // Blocks of the chunk being decoded, streamer only
+
+	u32 lastPlayId; // Audio thread only
+
+	// Stats
+	volatile_u32 underrunCount; // Written by the audio thread
+	volatile_u32 loadedChunkCount; // Written by the streamer
 };
 
 enum LoadSource
@@ -78,23 +285,54 @@ struct MusicFile
 
 struct Audio
 {
-	AudioClip clips[MAX_AUDIO_CLIPS] = {};
-	AudioClipDesc clipDescs[MAX_AUDIO_CLIPS] = {};
+	AudioClipPage *clipPages[MAX_AUDIO_CLIP_PAGES] = {};
 	HandleManager clipHandles;
 
-	AudioSource sources[MAX_AUDIO_SOURCES] = {};
+	// Voices are allocated by the update thread and played by the audio thread
+	AudioVoice *voices; // Indexed by handle
+	AudioVoiceInfo *voiceInfos; // Indexed by handle
+	HandleManager voiceHandles;
+	u32 voiceStartCount; // Update thread only
+
+	// Audio thread only
+	u16 *activeVoices; // Playing or paused voices
+	u32 activeVoiceCount;
+	u32 realVoices[MAX_AUDIO_REAL_VOICES]; // Voice index of each stream, or U32_MAX if free
+	u32 realVoiceLimit;
+
+	// Stats
+	volatile_u32 realVoiceCount; // Written by the audio thread
+	volatile_u32 virtualVoiceCount; // Written by the audio thread
+	u32 stolenVoiceCount;
+
+	// Chunks of the audio sources, loaded ahead of time on a worker thread
+	AudioStreamer streamer;
 
-	// Circular list of audio chunks
-	AudioChunk audioChunkSentinel;
+	AudioLimiter limiter;
+
+	// DSP graph, audio thread only (configured through commands)
+	AudioBus buses[AudioBus_COUNT];
+	AudioReverb reverb;
+
+	// Sample rate conversion
+	AudioSincFilter sincFilter; // Voices
+	AudioSincFilter outputFilter; // Lower cutoff for device rates under AUDIO_SAMPLE_RATE
+	AudioResampler outputResampler; // From AUDIO_SAMPLE_RATE to the device rate
+	u32 outputRate;
 
 	// Music ring buffer
-	i16 *musicBuffer;
-	u32 musicBufferSampleCount; // Mono samples count
+	AudioMusicRing musicRing;
+	bool musicRefilling; // Producer: filling the ring since it went under the watermark
+	volatile_u32 musicEnded; // Producer: the module has no more samples, since musicRestartAck
+	volatile_u32 musicRestartAck; // Producer: musicRestartCount when musicEnded was last cleared
+	volatile_u32 musicRestartCount; // Consumer: music plays and stops, each one clears musicEnded
+	bool musicPrimed; // Consumer: the first samples arrived since the music started
+	u32 musicUnderrunCount; // Consumer: callbacks short of music samples
+	f32 musicProducerMillis; // Last PreRenderAudio call
+	f32 maxMusicProducerMillis;
 
 	// Music play state
 	AudioState musicState;
-	u32 musicBufferReadSampleIndex;
-	u32 musicBufferWriteSampleIndex;
 
 	MusicFile musicFiles[MAX_MUSIC_FILES] = {};
 	MusicFileDesc musicFileDescs[MAX_MUSIC_FILES] = {};
@@ -120,7 +358,6 @@ struct Engine;
 bool InitializeAudio(Audio &audio, Arena &globalArena);
 
 bool LoadAudioClipFromWAVFile(const char *filename, Arena &arena, AudioClip &audioClip, void **outSamples);
-bool LoadSamplesFromWAVFile(const char *filename, void *samples, u32 firstSampleIndex, u32 sampleCount);
 
 AudioClip &GetAudioClip(Audio &audio, Handle handle);
 AudioClipDesc &GetAudioClipDesc(Audio &audio, Handle handle);
@@ -128,13 +365,52 @@ Handle CreateAudioClip(Engine &engine, const BinAudioClip &binAudioClip);
 Handle CreateAudioClip(Engine &engine, const AudioClipDesc &audioClipDesc);
 Handle GetOrCreateAudioClip(Engine &engine, const AudioClipDesc &audioClipDesc);
 void RemoveAudioClip(Engine &engine, AudioClipH handle);
-u32 PlayAudioClip(Engine &engine, AudioClipH handle);
-bool IsActiveAudioSource(Engine &engine, u32 audioSourceIndex);
-bool IsPausedAudioSource(Engine &engine, u32 audioSourceIndex);
-void PauseAudioSource(Engine &engine, u32 audioSourceIndex);
-void ResumeAudioSource(Engine &engine, u32 audioSourceIndex);
-void StopAudioSource(Engine &engine, u32 audioSourceIndex);
-
+AudioVoiceH PlayAudioClip(Engine &engine, AudioClipH handle, u8 priority = AUDIO_PRIORITY_DEFAULT);
+bool IsActiveAudioVoice(Engine &engine, AudioVoiceH handle);
+bool IsPausedAudioVoice(Engine &engine, AudioVoiceH handle);
+void PauseAudioVoice(Engine &engine, AudioVoiceH handle);
+void ResumeAudioVoice(Engine &engine, AudioVoiceH handle);
+void StopAudioVoice(Engine &engine, AudioVoiceH handle);
+
+void SetAudioVoiceGainPan(Engine &engine, AudioVoiceH handle, f32 gain, f32 pan);
+void SetAudioVoicePitch(Engine &engine, AudioVoiceH handle, f32 pitch);
+void SetAudioRealVoiceLimit(Engine &engine, u32 realVoiceLimit);
+
+void SetAudioBusGain(Engine &engine, AudioBusId bus, f32 gain);
+void SetAudioBusReverbSend(Engine &engine, AudioBusId bus, f32 send);
+void SetAudioBusFilter(Engine &engine, AudioBusId bus, AudioFilterType filter, f32 frequency, f32 q = AUDIO_BUTTERWORTH_Q);
+void SetAudioReverb(Engine &engine, f32 decaySeconds, f32 damping);
+
+void MixSamples(f32 *dst, const i16 *src, u32 frameCount, f32 gainL, f32 gainR);
+void MixSamplesScalar(f32 *dst, const i16 *src, u32 frameCount, f32 gainL, f32 gainR);
+void LimitSamples(AudioLimiter &limiter, const f32 *samples, u32 frameCount, i16 *output);
+void LimitSamplesScalar(AudioLimiter &limiter, const f32 *samples, u32 frameCount, i16 *output);
+
+void InitializeSincFilter(AudioSincFilter &filter, f32 cutoff);
+void InitializeResampler(AudioResampler &resampler, AudioResamplerQuality quality, const AudioSincFilter *filter, u32 inputRate, u32 outputRate);
+u32 ResamplerInputFrames(const AudioResampler &resampler, u32 outputFrameCount);
+f32 *PushResampleBuffer(Arena &arena, const AudioResampler &resampler, u32 inputFrameCount);
+u32 ResampleFrames(AudioResampler &resampler, const f32 *samples, u32 inputFrameCount, f32 *output, u32 outputFrameCount, f32 gainL, f32 gainR);
+u32 ResampleFramesScalar(AudioResampler &resampler, const f32 *samples, u32 inputFrameCount, f32 *output, u32 outputFrameCount, f32 gainL, f32 gainR);
+u32 ResampleClip(Arena &arena, const i16 *samples, u32 frameCount, u32 channelCount, u32 inputRate, u32 outputRate, i16 **outSamples);
+
+u32 AdpcmEncodedSize(u32 frameCount);
+void EncodeAdpcm(const i16 *samples, u32 frameCount, byte *blocks);
+void DecodeAdpcm(const byte *blocks, u32 frameCount, i16 *samples);
+
+void AccumulateSamples(f32 *dst, const f32 *src, u32 frameCount, f32 gain0, f32 gain1);
+void AccumulateSamplesScalar(f32 *dst, const f32 *src, u32 frameCount, f32 gain0, f32 gain1);
+void InitializeBiquad(AudioBiquad &biquad, AudioFilterType type, f32 frequency, f32 q, u32 sampleRate);
+void ProcessBiquad(AudioBiquad &biquad, f32 *samples, u32 frameCount);
+void ProcessBiquadScalar(AudioBiquad &biquad, f32 *samples, u32 frameCount);
+bool InitializeReverb(AudioReverb &reverb, Arena &arena);
+void SetReverbDecay(AudioReverb &reverb, f32 decaySeconds, f32 damping);
+void ProcessReverb(AudioReverb &reverb, const f32 *input, f32 *output, u32 frameCount);
+void ProcessReverbScalar(AudioReverb &reverb, const f32 *input, f32 *output, u32 frameCount);
+
+void UpdateAudio(Engine &engine);
+void WaitAudioStreaming(Audio &audio);
+void SetAudioAssetsFilepath(Audio &audio, const char *filepath);
 void PreRenderAudio(Engine &engine);
 void RenderAudio(Engine &engine, SoundBuffer &soundBuffer);
 
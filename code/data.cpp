@@ -119,18 +119,25 @@ bool CompileModifiedShaders()
 ////////////////////////////////////////////////////////////////////////
 // Text output
 
+// All the text is formatted in place into a single buffer, reserved up front,
+// and written to the file at once.
+
 struct WriteContext
 {
 	Arena arena;
-	char line[MAX_PATH_LENGTH];
 	u32 indent;
 };
 
+static char *WriteReserve(WriteContext &ctx, u32 size)
+{
+	char *chars = (char*)PeekSize(ctx.arena, size);
+	return chars;
+}
+
 static void WriteIndentation(WriteContext &ctx)
 {
-	for (u32 i = 0; i < ctx.indent; ++i) {
-		PushChar(ctx.arena, ' ');
-	}
+	char *chars = (char*)PushSize(ctx.arena, ctx.indent);
+	MemSet(chars, ctx.indent, ' ');
 }
 
 static void NewLine(WriteContext &ctx)
@@ -176,16 +183,106 @@ static void WriteLine(WriteContext &ctx, const char *format, ...)
 	WriteIndentation(ctx);
 
 	// Push text
-	const i32 len = VSPrintf(ctx.line, format, vaList);
-	char *chars = (char*)PushSize(ctx.arena, len);
-	MemCopy(chars, ctx.line, len);
-	
+	char *chars = WriteReserve(ctx, MAX_PATH_LENGTH);
+	const i32 len = VSPrintf(chars, format, vaList);
+	ASSERT(len >= 0 && len < MAX_PATH_LENGTH);
+	ctx.arena.used += len;
+
 	// Push new line
 	NewLine(ctx);
 
 	va_end(vaList);
 }
 
+static char *WriteU16(char *chars, u16 value)
+{
+	char digits[5];
+	u32 digitCount = 0;
+	do {
+		digits[digitCount++] = '0' + value % 10;
+		value /= 10;
+	} while (value > 0);
+
+	while (digitCount > 0) {
+		*chars++ = digits[--digitCount];
+	}
+	return chars;
+}
+
+// Tiles are formatted by hand, as they make up most of the text in large room sets
+static void WriteTiles(WriteContext &ctx, const TileDesc *tiles, u32 tileCount)
+{
+	constexpr u32 tilesPerLine = 8;
+	constexpr u32 maxTileLength = sizeof("{65535, 65535, 65535}, ") - 1;
+
+	for (u32 t = 0; t < tileCount; t += tilesPerLine)
+	{
+		const u32 lineTileCount = Min(tilesPerLine, tileCount - t);
+
+		WriteIndentation(ctx);
+
+		char *begin = WriteReserve(ctx, lineTileCount * maxTileLength);
+		char *chars = begin;
+
+		for (u32 i = 0; i < lineTileCount; ++i)
+		{
+			const TileDesc &tile = tiles[t + i];
+			*chars++ = '{';
+			chars = WriteU16(chars, tile.x);
+			*chars++ = ',';
+			*chars++ = ' ';
+			chars = WriteU16(chars, tile.y);
+			*chars++ = ',';
+			*chars++ = ' ';
+			chars = WriteU16(chars, tile.spriteIndex);
+			*chars++ = '}';
+			*chars++ = ',';
+			*chars++ = ' ';
+		}
+
+		ctx.arena.used += chars - begin;
+
+		NewLine(ctx);
+	}
+}
+
+// Upper bound of the text size, so the whole file fits in one buffer
+static u32 DescriptorsTextSize(const AssetDescriptors &assets)
+{
+	constexpr u32 maxIndentation = 16;
+	constexpr u32 maxLineLength = MAX_PATH_LENGTH + maxIndentation;
+	constexpr u32 maxLinesPerDesc = 12;
+	constexpr u32 maxLinesPerLayer = 10;
+	constexpr u32 maxTileLength = sizeof("{65535, 65535, 65535}, ") - 1;
+	constexpr u32 tilesPerLine = 8;
+	constexpr u32 sectionCount = 9;
+
+	u32 lineCount = sectionCount * 3;
+	lineCount += maxLinesPerDesc * assets.textureDescCount;
+	lineCount += maxLinesPerDesc * assets.meshDescCount;
+	lineCount += maxLinesPerDesc * assets.spriteDescCount;
+	lineCount += maxLinesPerDesc * assets.materialDescCount;
+	lineCount += maxLinesPerDesc * assets.entityDescCount;
+	lineCount += maxLinesPerDesc * assets.roomDescCount;
+	lineCount += maxLinesPerDesc * assets.audioClipDescCount;
+	lineCount += maxLinesPerDesc * assets.musicFileDescCount;
+
+	u32 tileBytes = 0;
+	for (u32 i = 0; i < assets.roomDescCount; ++i)
+	{
+		const RoomDesc &desc = assets.roomDescs[i];
+		for (u32 l = 0; l < desc.layerCount; ++l)
+		{
+			const u32 tileCount = desc.layers[l].tileCount;
+			lineCount += maxLinesPerLayer;
+			tileBytes += tileCount * maxTileLength + (tileCount / tilesPerLine + 1) * (maxIndentation + 1);
+		}
+	}
+
+	const u32 size = lineCount * maxLineLength + tileBytes;
+	return size;
+}
+
 static void PushIndent(WriteContext &ctx)
 {
 	ctx.indent++;
@@ -227,15 +324,13 @@ static GeometryType StrToGeometryType(String str)
 
 void SaveAssetDescriptors(const char *path, const AssetDescriptors &assets)
 {
-	Scratch scratch(MB(16)); // room tile lists can make the text large
+	Scratch scratch(DescriptorsTextSize(assets));
 	WriteContext ctx = {
 		.arena = scratch.arena,
 	};
 
 	LOG(Info, "Saving data to text file: %s\n", path);
 
-	char line[MAX_PATH_LENGTH];
-
 	WriteSectionLine(ctx, "Textures");
 
 	for (u32 i = 0; i < assets.textureDescCount; ++i)
@@ -247,6 +342,24 @@ void SaveAssetDescriptors(const char *path, const AssetDescriptors &assets)
 		PushIndent(ctx);
 		WriteLine(ctx, ".filename = \"%s\",", desc.filename);
 		WriteLine(ctx, ".mipmap = %d,", desc.mipmap);
+		if (desc.atlas)
+			WriteLine(ctx, ".atlas = %d,", desc.atlas);
+		PopIndent(ctx);
+
+		WriteLine(ctx, "};");
+		NewLine(ctx);
+	}
+
+	WriteSectionLine(ctx, "Meshes");
+
+	for (u32 i = 0; i < assets.meshDescCount; ++i)
+	{
+		const MeshDesc &desc = assets.meshDescs[i];
+
+		WriteLine(ctx, "Mesh %s = {", desc.name);
+
+		PushIndent(ctx);
+		WriteLine(ctx, ".filename = \"%s\",", desc.filename);
 		PopIndent(ctx);
 
 		WriteLine(ctx, "};");
@@ -310,7 +423,11 @@ void SaveAssetDescriptors(const char *path, const AssetDescriptors &assets)
 			WriteLine(ctx, ".spriteName = \"%s\",", desc.spriteName);
 		} else if (desc.materialName) {
 			WriteLine(ctx, ".materialName = \"%s\",", desc.materialName);
-			WriteLine(ctx, ".geometryType = %s,", GeometryTypeToString(desc.geometryType));
+			if (desc.meshName) {
+				WriteLine(ctx, ".meshName = \"%s\",", desc.meshName);
+			} else {
+				WriteLine(ctx, ".geometryType = %s,", GeometryTypeToString(desc.geometryType));
+			}
 		}
 		WriteLine(ctx, ".pos = {%f, %f, %f},", desc.pos.x, desc.pos.y, desc.pos.z);
 		WriteLine(ctx, ".scale = %f,", desc.scale);
@@ -351,22 +468,7 @@ void SaveAssetDescriptors(const char *path, const AssetDescriptors &assets)
 			{
 				WriteLine(ctx, ".tiles = {");
 				PushIndent(ctx);
-
-				char tileLine[MAX_PATH_LENGTH];
-				i32 tileLineLen = 0;
-				u32 tilesInLine = 0;
-				for (u32 t = 0; t < layer.tileCount; ++t)
-				{
-					const TileDesc &tile = layer.tiles[t];
-					tileLineLen += SPrintf(tileLine + tileLineLen, "{%u, %u, %u}, ", tile.x, tile.y, tile.spriteIndex);
-					if (++tilesInLine == 8 || t + 1 == layer.tileCount)
-					{
-						WriteLine(ctx, "%s", tileLine);
-						tileLineLen = 0;
-						tilesInLine = 0;
-					}
-				}
-
+				WriteTiles(ctx, layer.tiles, layer.tileCount);
 				PopIndent(ctx);
 				WriteLine(ctx, "},");
 			}
@@ -416,6 +518,9 @@ void SaveAssetDescriptors(const char *path, const AssetDescriptors &assets)
 
 ////////////////////////////////////////////////////////////////////////
 // Text scanner / parser
+//
+// Single pass: the parser pulls tokens from the scanner as it needs them, with
+// one token of lookahead, and token lexemes point into the source text.
 
 enum DTokenId
 {
@@ -462,6 +567,7 @@ struct DToken
 {
 	DTokenId id;
 	u32 line;
+	i32 column; // Scanner currentInLine before the first character of the lexeme
 	String lexeme;
 };
 
@@ -471,14 +577,6 @@ static DToken gNullToken = {
 	.lexeme = { "", 0 },
 };
 
-struct DTokenList
-{
-	Arena *arena;
-	DToken *tokens;
-	i32 count;
-	bool valid;
-};
-
 struct DScanner
 {
 	i32 start;
@@ -556,15 +654,14 @@ static String DScanner_ScannedString(const DScanner &scanner)
 	return scannedString;
 }
 
-static void DScanner_AddToken(const DScanner &scanner, DTokenList &tokenList, DTokenId tokenId)
+static DToken DScanner_MakeToken(const DScanner &scanner, DTokenId tokenId)
 {
 	DToken newToken = {};
 	newToken.id = tokenId;
 	newToken.lexeme = DScanner_ScannedString(scanner);
 	newToken.line = scanner.line;
-
-	PushStruct(*tokenList.arena, DToken);
-	tokenList.tokens[tokenList.count++] = newToken;
+	newToken.column = scanner.currentInLine - ( scanner.current - scanner.start );
+	return newToken;
 }
 
 static void DScanner_SetError(DScanner &scanner, const char *format, ...)
@@ -578,33 +675,72 @@ static void DScanner_SetError(DScanner &scanner, const char *format, ...)
 	scanner.hasErrors = true;
 }
 
-static void DScanner_ScanToken(DScanner &scanner, DTokenList &tokenList)
+static DToken DScanner_ScanToken(DScanner &scanner)
 {
-	scanner.start = scanner.current;
+	while ( !DScanner_IsAtEnd(scanner) )
+	{
+		scanner.start = scanner.current;
 
-	char c = DScanner_Advance(scanner);
+		char c = DScanner_Advance(scanner);
 
-	switch (c)
-	{
-		case '{': DScanner_AddToken(scanner, tokenList, TOKEN_LEFT_BRACE); break;
-		case '}': DScanner_AddToken(scanner, tokenList, TOKEN_RIGHT_BRACE); break;
-		case ',': DScanner_AddToken(scanner, tokenList, TOKEN_COMMA); break;
-		case '.': DScanner_AddToken(scanner, tokenList, TOKEN_DOT); break;
-		case '-': DScanner_AddToken(scanner, tokenList, TOKEN_MINUS); break;
-		case ';': DScanner_AddToken(scanner, tokenList, TOKEN_SEMICOLON); break;
-		case '=': DScanner_AddToken(scanner, tokenList, TOKEN_EQUAL ); break;
-		case '/':
-			if ( DScanner_Consume(scanner, '/') )
-			{
-				// Discard all chars until the end of line is reached
-				while ( !Char_IsEOL( DScanner_Peek(scanner) ) && !DScanner_IsAtEnd(scanner) )
+		switch (c)
+		{
+			case '{': return DScanner_MakeToken(scanner, TOKEN_LEFT_BRACE);
+			case '}': return DScanner_MakeToken(scanner, TOKEN_RIGHT_BRACE);
+			case ',': return DScanner_MakeToken(scanner, TOKEN_COMMA);
+			case '.': return DScanner_MakeToken(scanner, TOKEN_DOT);
+			case '-': return DScanner_MakeToken(scanner, TOKEN_MINUS);
+			case ';': return DScanner_MakeToken(scanner, TOKEN_SEMICOLON);
+			case '=': return DScanner_MakeToken(scanner, TOKEN_EQUAL );
+			case '/':
+				if ( DScanner_Consume(scanner, '/') )
+				{
+					// Discard all chars until the end of line is reached
+					while ( !Char_IsEOL( DScanner_Peek(scanner) ) && !DScanner_IsAtEnd(scanner) )
+					{
+						DScanner_Advance(scanner);
+					}
+				}
+				else if ( DScanner_Consume(scanner, '*') )
 				{
+					while ( !DScanner_IsAtEnd(scanner) && !( DScanner_Peek(scanner) == '*' && DScanner_PeekNext(scanner) == '/' ) )
+					{
+						if ( Char_IsEOL( DScanner_Peek(scanner) ) ) {
+							scanner.line++;
+							scanner.currentInLine = 0;
+						}
+						DScanner_Advance(scanner);
+					}
+
+					if ( DScanner_IsAtEnd(scanner) )
+					{
+						DScanner_SetError( scanner, "Unterminated comment." );
+						break;
+					}
+
+					DScanner_Advance(scanner);
 					DScanner_Advance(scanner);
 				}
-			}
-			else if ( DScanner_Consume(scanner, '*') )
-			{
-				while( !(DScanner_Consume(scanner, '*') && DScanner_Consume(scanner, '/')) || DScanner_IsAtEnd(scanner) )
+				else
+				{
+					DScanner_SetError( scanner, "Unterminated comment." );
+				}
+				break;
+
+			// Skip whitespaces
+			case ' ':
+			case '\r':
+			case '\t':
+				break;
+
+			// End of line counter
+			case '\n':
+				scanner.line++;
+				scanner.currentInLine = 0;
+				break;
+
+			case '\"':
+				while ( DScanner_Peek(scanner) != '\"' && !DScanner_IsAtEnd(scanner) )
 				{
 					if ( Char_IsEOL( DScanner_Peek(scanner) ) ) {
 						scanner.line++;
@@ -612,151 +748,205 @@ static void DScanner_ScanToken(DScanner &scanner, DTokenList &tokenList)
 					}
 					DScanner_Advance(scanner);
 				}
-			}
-			else
-			{
-				DScanner_SetError( scanner, "Unterminated comment." );
-				return;
-			}
-			break;
-
-		// Skip whitespaces
-		case ' ':
-		case '\r':
-		case '\t':
-			break;
 
-		// End of line counter
-		case '\n':
-			scanner.line++;
-			scanner.currentInLine = 0;
-			break;
-
-		case '\"':
-			while ( DScanner_Peek(scanner) != '\"' && !DScanner_IsAtEnd(scanner) )
-			{
-				if ( Char_IsEOL( DScanner_Peek(scanner) ) ) {
-					scanner.line++;
-					scanner.currentInLine = 0;
+				if ( DScanner_IsAtEnd(scanner) )
+				{
+					DScanner_SetError( scanner, "Unterminated string." );
+					break;
 				}
+
 				DScanner_Advance(scanner);
-			}
 
-			if ( DScanner_IsAtEnd(scanner) )
-			{
-				DScanner_SetError( scanner, "Unterminated string." );
-				return;
-			}
+				return DScanner_MakeToken(scanner, TOKEN_STRING);
+
+			case '\'':
+				{
+					if ( DScanner_IsAtEnd(scanner) )
+					{
+						DScanner_SetError( scanner, "Unterminated character" );
+						break;
+					}
+					char character = DScanner_Advance(scanner);
+					if ( DScanner_IsAtEnd(scanner) || DScanner_Advance(scanner) != '\'' )
+					{
+						DScanner_SetError( scanner, "Invalid char literal '%c'", character);
+						break;
+					}
+					return DScanner_MakeToken(scanner, TOKEN_CHARACTER);
+				}
 
-			DScanner_Advance(scanner);
+			default:
+				if ( Char_IsDigit(c) )
+				{
+					while ( Char_IsDigit( DScanner_Peek(scanner) ) ) DScanner_Advance(scanner);
 
-			DScanner_AddToken(scanner, tokenList, TOKEN_STRING);
-			break;
+					if ( DScanner_Peek(scanner) == '.' && Char_IsDigit( DScanner_PeekNext(scanner) ) )
+					{
+						DScanner_Advance(scanner);
+						while ( Char_IsDigit(DScanner_Peek(scanner)) ) DScanner_Advance(scanner);
+						DScanner_Consume(scanner, 'f');
+					}
 
-		case '\'':
-			{
-				if ( DScanner_IsAtEnd(scanner) )
+					return DScanner_MakeToken(scanner, TOKEN_NUMBER);
+				}
+				else if ( Char_IsAlpha(c) )
 				{
-					DScanner_SetError( scanner, "Unterminated character" );
-					return;
+					while ( Char_IsAlphaNumeric( DScanner_Peek(scanner) ) ) DScanner_Advance(scanner);
+
+					return DScanner_MakeToken(scanner, TOKEN_IDENTIFIER);
 				}
-				char character = DScanner_Advance(scanner);
-				if ( DScanner_Advance(scanner) != '\'' )
+				else
 				{
-					DScanner_SetError( scanner, "Invalid char literal '%c'", character);
-					return;
+					DScanner_SetError( scanner, "Unexpected character '%c'.", c );
 				}
-				DScanner_AddToken(scanner, tokenList, TOKEN_CHARACTER);
-			}
-			break;
+		}
+	}
 
-		default:
-			if ( Char_IsDigit(c) )
-			{
-				while ( Char_IsDigit( DScanner_Peek(scanner) ) ) DScanner_Advance(scanner);
+	scanner.start = scanner.current;
+	return DScanner_MakeToken(scanner, TOKEN_EOF);
+}
 
-				if ( DScanner_Peek(scanner) == '.' && Char_IsDigit( DScanner_PeekNext(scanner) ) )
-				{
-					DScanner_Advance(scanner);
-					while ( Char_IsDigit(DScanner_Peek(scanner)) ) DScanner_Advance(scanner);
-					DScanner_Consume(scanner, 'f');
-				}
+static void DScanner_SkipBlanks(DScanner &scanner)
+{
+	while ( !DScanner_IsAtEnd(scanner) )
+	{
+		const char c = scanner.text[scanner.current];
+		if ( c != ' ' && c != '\t' && c != '\r' && c != '\n' ) {
+			break;
+		}
 
-				DScanner_AddToken(scanner, tokenList, TOKEN_NUMBER);
-			}
-			else if ( Char_IsAlpha(c) )
-			{
-				while ( Char_IsAlphaNumeric( DScanner_Peek(scanner) ) ) DScanner_Advance(scanner);
+		DScanner_Advance(scanner);
 
-				DScanner_AddToken(scanner, tokenList, TOKEN_IDENTIFIER);
-			}
-			else
-			{
-				DScanner_SetError( scanner, "Unexpected character '%c'.", c );
-			}
+		if ( Char_IsEOL(c) ) {
+			scanner.line++;
+			scanner.currentInLine = 0;
+		}
 	}
 }
 
-static DTokenList DScan(Arena &arena, const char *text, u32 textSize)
+static bool DScanner_ScanChar(DScanner &scanner, char expected)
 {
-	DTokenList tokenList = {};
-	tokenList.arena = &arena;
-	tokenList.tokens = (DToken*)(arena.base + arena.used);
+	DScanner_SkipBlanks(scanner);
+	return DScanner_Consume(scanner, expected);
+}
 
-	DScanner scanner = {};
-	scanner.line = 1;
-	scanner.hasErrors = false;
-	scanner.text = text;
-	scanner.textSize = textSize;
+static bool DScanner_ScanUnsigned(DScanner &scanner, u32 &value)
+{
+	DScanner_SkipBlanks(scanner);
 
-	while ( ! DScanner_IsAtEnd(scanner) )
-	{
-		DScanner_ScanToken(scanner, tokenList);
+	const i32 start = scanner.current;
+	u32 res = 0;
+	while ( Char_IsDigit( DScanner_Peek(scanner) ) && res <= U16_MAX ) {
+		res = res * 10 + ( DScanner_Advance(scanner) - '0' );
 	}
 
-	DScanner_AddToken(scanner, tokenList, TOKEN_EOF);
-	tokenList.valid = !scanner.hasErrors;
+	value = res;
+	return scanner.current > start && res <= U16_MAX;
+}
+
+// Bulk path for tile lists, reading "{x, y, spriteIndex}," triplets straight from the text.
+// It stops before the first tile it cannot read this way (signs, comments, end of list...),
+// and the caller carries on from there token by token.
+static u32 DScanner_ScanTiles(DScanner &scanner, Arena &arena)
+{
+	u32 tileCount = 0;
+
+	for (;;)
+	{
+		const DScanner tileStart = scanner;
+
+		u32 x, y, spriteIndex;
+		const bool ok =
+			DScanner_ScanChar(scanner, '{') &&
+			DScanner_ScanUnsigned(scanner, x) && DScanner_ScanChar(scanner, ',') &&
+			DScanner_ScanUnsigned(scanner, y) && DScanner_ScanChar(scanner, ',') &&
+			DScanner_ScanUnsigned(scanner, spriteIndex) && DScanner_ScanChar(scanner, '}');
+
+		if ( !ok ) {
+			scanner = tileStart;
+			break;
+		}
+
+		DScanner_ScanChar(scanner, ',');
+
+		TileDesc &tile = *PushStruct(arena, TileDesc);
+		tile.x = (u16)x;
+		tile.y = (u16)y;
+		tile.spriteIndex = (u16)spriteIndex;
+		tileCount++;
+	}
 
-	return tokenList;
+	return tileCount;
 }
 
+enum DDescType
+{
+	DDescType_Texture,
+	DDescType_Mesh,
+	DDescType_Sprite,
+	DDescType_Material,
+	DDescType_Entity,
+	DDescType_Room,
+	DDescType_AudioClip,
+	DDescType_MusicFile,
+	DDescType_COUNT,
+};
+
+// Descriptors are stored in file order while parsing, as their counts are unknown
+// until the end of the file, and packed into per-type arrays afterwards.
+struct DDescRecord
+{
+	DDescType type;
+	union
+	{
+		TextureDesc texture;
+		MeshDesc mesh;
+		SpriteDesc sprite;
+		MaterialDesc material;
+		EntityDesc entity;
+		RoomDesc room;
+		AudioClipDesc audioClip;
+		MusicFileDesc musicFile;
+	};
+};
+
 struct DParser
 {
-	const DTokenList *tokenList;
+	DScanner scanner;
+	DToken previousToken;
+	DToken nextToken;
 	Arena *arena;
-	u32 nextToken;
-	u32 lastToken;
+	Arena *recordArena;
+	DDescRecord *records;
+	u32 recordCount;
 	bool hasErrors;
-	bool hasFinished;
-	AssetDescriptors *descriptors;
 };
 
 
-static DParser DParser_Init(const DTokenList &tokenList, Arena &arena, AssetDescriptors &descriptors)
+static DParser DParser_Init(const char *text, u32 textSize, Arena &arena, Arena &recordArena)
 {
-	const DParser parser = {
-		.tokenList = &tokenList,
+	DParser parser = {
+		.scanner = {
+			.line = 1,
+			.text = text,
+			.textSize = textSize,
+		},
 		.arena = &arena,
-		.descriptors = &descriptors,
+		.recordArena = &recordArena,
+		.records = (DDescRecord*)(recordArena.base + recordArena.used),
 	};
+	parser.nextToken = DScanner_ScanToken(parser.scanner);
 	return parser;
 }
 
-static u32 DParser_RemainingTokens(const DParser &parser)
-{
-	return parser.tokenList->count - parser.nextToken;
-}
-
 static const DToken &DParser_GetPreviousToken( const DParser &parser )
 {
-	ASSERT(parser.nextToken > 0);
-	return parser.tokenList->tokens[parser.nextToken-1];
+	return parser.previousToken;
 }
 
 static const DToken &DParser_GetNextToken( const DParser &parser )
 {
-	ASSERT(parser.nextToken < parser.tokenList->count);
-	return parser.tokenList->tokens[parser.nextToken];
+	return parser.nextToken;
 }
 
 static bool DParser_HasFinished(const DParser &parser)
@@ -771,16 +961,10 @@ static bool DParser_IsNextToken( const DParser &parser, DTokenId tokenId )
 	if ( DParser_HasFinished( parser ) ) {
 		return tokenId == TOKEN_EOF;
 	} else {
-		ASSERT(parser.nextToken < parser.tokenList->count);
-		return tokenId == parser.tokenList->tokens[parser.nextToken].id;
+		return tokenId == parser.nextToken.id;
 	}
 }
 
-static const DToken &DParser_GetLastToken( const DParser &parser )
-{
-	return parser.tokenList->tokens[parser.lastToken];
-}
-
 static void DParser_SetError(DParser &parser, const char *message)
 {
 	DToken token = DParser_GetNextToken(parser);
@@ -791,8 +975,8 @@ static void DParser_SetError(DParser &parser, const char *message)
 static const DToken &DParser_Consume( DParser &parser )
 {
 	if ( !DParser_HasFinished( parser ) ) {
-		parser.nextToken++;
-		parser.lastToken = parser.nextToken > parser.lastToken ? parser.nextToken : parser.lastToken;
+		parser.previousToken = parser.nextToken;
+		parser.nextToken = DScanner_ScanToken(parser.scanner);
 		return DParser_GetPreviousToken(parser);
 	} else {
 		DParser_SetError(parser, "Reached end of file");
@@ -800,6 +984,24 @@ static const DToken &DParser_Consume( DParser &parser )
 	}
 }
 
+// Hands the lookahead token back to the scanner, to read the text from there directly
+static void DParser_Unscan( DParser &parser )
+{
+	DScanner &scanner = parser.scanner;
+	scanner.current = parser.nextToken.lexeme.str - scanner.text;
+	scanner.start = scanner.current;
+	scanner.line = parser.nextToken.line;
+	scanner.currentInLine = parser.nextToken.column;
+}
+
+static DDescRecord &DParser_PushDesc( DParser &parser, DDescType type )
+{
+	DDescRecord &record = *PushZeroStruct(*parser.recordArena, DDescRecord);
+	record.type = type;
+	parser.recordCount++;
+	return record;
+}
+
 static bool DParser_TryConsume( DParser &parser, DTokenId tokenId )
 {
 	if ( DParser_IsNextToken( parser, tokenId ) ) {
@@ -920,6 +1122,14 @@ static void DParser_ConsumeTiles( DParser &parser, LayerDesc &layer )
 	layer.tiles = (TileDesc*)(arena.base + arena.used);
 	layer.tileCount = 0;
 
+	// Fast path for the bulk of the list, then any remaining tiles are parsed token by token
+	if ( DParser_IsNextToken(parser, TOKEN_LEFT_BRACE) )
+	{
+		DParser_Unscan(parser);
+		layer.tileCount = DScanner_ScanTiles(parser.scanner, arena);
+		parser.nextToken = DScanner_ScanToken(parser.scanner);
+	}
+
 	while ( DParser_TryConsume(parser, TOKEN_LEFT_BRACE) && !DParser_HasFinished(parser) )
 	{
 		TileDesc &tile = *PushStruct(arena, TileDesc);
@@ -997,16 +1207,15 @@ static void DParser_ConsumeUntil( DParser &parser, DTokenId tokenId )
 
 static const String sMaterialStr = MakeString("Material");
 static const String sTextureStr = MakeString("Texture");
+static const String sMeshStr = MakeString("Mesh");
 static const String sSpriteStr = MakeString("Sprite");
 static const String sEntityStr = MakeString("Entity");
 static const String sRoomStr = MakeString("Room");
 static const String sAudioClipStr = MakeString("AudioClip");
 static const String sMusicFileStr = MakeString("MusicFile");
 
-static void DParseDescriptors(DParser &parser, bool countOnly)
+static void DParseDescriptors(DParser &parser)
 {
-	AssetDescriptors &descriptors = *parser.descriptors;
-
 	while ( !DParser_HasFinished( parser ) )
 	{
 		if ( DParser_TryConsume(parser, TOKEN_IDENTIFIER) )
@@ -1016,10 +1225,7 @@ static void DParseDescriptors(DParser &parser, bool countOnly)
 			// Texture
 			if ( StrEq(type, sTextureStr) ) {
 
-				const uint index = descriptors.textureDescCount++;
-				if ( countOnly ) goto parse_descriptors_continue;
-
-				TextureDesc &desc = descriptors.textureDescs[index];
+				TextureDesc &desc = DParser_PushDesc(parser, DDescType_Texture).texture;
 				const String name = DParser_ConsumeLexeme( parser );
 				desc.name = PushString(*parser.arena, name);
 				DParser_TryConsume( parser, TOKEN_EQUAL );
@@ -1034,10 +1240,37 @@ static void DParseDescriptors(DParser &parser, bool countOnly)
 
 					static const String sFilename = MakeString("filename");
 					static const String sMipmap = MakeString("mipmap");
+					static const String sAtlas = MakeString("atlas");
 					if ( StrEq( field, sFilename ) ) {
 						desc.filename = PushString(*parser.arena, DParser_ConsumeString(parser));
 					} else if ( StrEq( field, sMipmap ) ) {
 						desc.mipmap = DParser_ConsumeU8(parser);
+					} else if ( StrEq( field, sAtlas ) ) {
+						desc.atlas = DParser_ConsumeU8(parser);
+					}
+
+					DParser_TryConsume( parser, TOKEN_COMMA );
+				}
+
+			// Mesh
+			} else if ( StrEq(type, sMeshStr) ) {
+
+				MeshDesc &desc = DParser_PushDesc(parser, DDescType_Mesh).mesh;
+				const String name = DParser_ConsumeLexeme( parser );
+				desc.name = PushString(*parser.arena, name);
+				DParser_TryConsume( parser, TOKEN_EQUAL );
+				DParser_TryConsume( parser, TOKEN_LEFT_BRACE );
+				while ( !DParser_IsNextToken( parser, TOKEN_RIGHT_BRACE ) )
+				{
+					DParser_TryConsume( parser, TOKEN_DOT );
+
+					const String field = DParser_ConsumeLexeme( parser );
+
+					DParser_TryConsume( parser, TOKEN_EQUAL );
+
+					static const String sFilename = MakeString("filename");
+					if ( StrEq( field, sFilename ) ) {
+						desc.filename = PushString(*parser.arena, DParser_ConsumeString(parser));
 					}
 
 					DParser_TryConsume( parser, TOKEN_COMMA );
@@ -1046,10 +1279,7 @@ static void DParseDescriptors(DParser &parser, bool countOnly)
 			// Material
 			} else if ( StrEq(type, sMaterialStr) ) {
 
-				const uint index = descriptors.materialDescCount++;
-				if ( countOnly ) goto parse_descriptors_continue;
-
-				MaterialDesc &desc = descriptors.materialDescs[index];
+				MaterialDesc &desc = DParser_PushDesc(parser, DDescType_Material).material;
 				const String name = DParser_ConsumeLexeme( parser );
 				desc.name = PushString(*parser.arena, name);
 				DParser_TryConsume( parser, TOKEN_EQUAL );
@@ -1080,10 +1310,7 @@ static void DParseDescriptors(DParser &parser, bool countOnly)
 			// Sprite
 			} else if ( StrEq(type, sSpriteStr) ) {
 
-				const uint index = descriptors.spriteDescCount++;
-				if ( countOnly ) goto parse_descriptors_continue;
-
-				SpriteDesc &desc = descriptors.spriteDescs[index];
+				SpriteDesc &desc = DParser_PushDesc(parser, DDescType_Sprite).sprite;
 				const String name = DParser_ConsumeLexeme( parser );
 				desc.name = PushString(*parser.arena, name);
 				DParser_TryConsume( parser, TOKEN_EQUAL );
@@ -1123,10 +1350,7 @@ static void DParseDescriptors(DParser &parser, bool countOnly)
 			// Entity
 			} else if ( StrEq(type, sEntityStr) ) {
 
-				const uint index = descriptors.entityDescCount++;
-				if ( countOnly ) goto parse_descriptors_continue;
-
-				EntityDesc &desc = descriptors.entityDescs[index];
+				EntityDesc &desc = DParser_PushDesc(parser, DDescType_Entity).entity;
 				const String name = DParser_ConsumeLexeme( parser );
 				desc.name = PushString(*parser.arena, name);
 				DParser_TryConsume( parser, TOKEN_EQUAL );
@@ -1141,6 +1365,7 @@ static void DParseDescriptors(DParser &parser, bool countOnly)
 
 					static const String sMaterialName = MakeString("materialName");
 					static const String sSpriteName = MakeString("spriteName");
+					static const String sMeshName = MakeString("meshName");
 					static const String sPos = MakeString("pos");
 					static const String sScale = MakeString("scale");
 					static const String sLayer = MakeString("layer");
@@ -1150,6 +1375,8 @@ static void DParseDescriptors(DParser &parser, bool countOnly)
 						desc.materialName = PushString(*parser.arena, DParser_ConsumeString(parser));
 					} else if ( StrEq( field, sSpriteName ) ) {
 						desc.spriteName = PushString(*parser.arena, DParser_ConsumeString(parser));
+					} else if ( StrEq( field, sMeshName ) ) {
+						desc.meshName = PushString(*parser.arena, DParser_ConsumeString(parser));
 					} else if ( StrEq( field, sPos ) ) {
 						desc.pos = DParser_ConsumeFloat3(parser);
 					} else if ( StrEq( field, sScale ) ) {
@@ -1166,10 +1393,7 @@ static void DParseDescriptors(DParser &parser, bool countOnly)
 			// Room
 			} else if ( StrEq(type, sRoomStr) ) {
 
-				const uint index = descriptors.roomDescCount++;
-				if ( countOnly ) goto parse_descriptors_continue;
-
-				RoomDesc &desc = descriptors.roomDescs[index];
+				RoomDesc &desc = DParser_PushDesc(parser, DDescType_Room).room;
 				const String name = DParser_ConsumeLexeme( parser );
 				desc.name = PushString(*parser.arena, name);
 				DParser_TryConsume( parser, TOKEN_EQUAL );
@@ -1197,10 +1421,7 @@ static void DParseDescriptors(DParser &parser, bool countOnly)
 			// AudioClip
 			} else if ( StrEq(type, sAudioClipStr) ) {
 
-				const uint index = descriptors.audioClipDescCount++;
-				if ( countOnly ) goto parse_descriptors_continue;
-
-				AudioClipDesc &desc = descriptors.audioClipDescs[index];
+				AudioClipDesc &desc = DParser_PushDesc(parser, DDescType_AudioClip).audioClip;
 				const String name = DParser_ConsumeLexeme( parser );
 				desc.name = PushString(*parser.arena, name);
 				DParser_TryConsume( parser, TOKEN_EQUAL );
@@ -1224,10 +1445,7 @@ static void DParseDescriptors(DParser &parser, bool countOnly)
 			// MusicFile
 			} else if ( StrEq(type, sMusicFileStr) ) {
 
-				const uint index = descriptors.musicFileDescCount++;
-				if ( countOnly ) goto parse_descriptors_continue;
-
-				MusicFileDesc &desc = descriptors.musicFileDescs[index];
+				MusicFileDesc &desc = DParser_PushDesc(parser, DDescType_MusicFile).musicFile;
 				const String name = DParser_ConsumeLexeme( parser );
 				desc.name = PushString(*parser.arena, name);
 				DParser_TryConsume( parser, TOKEN_EQUAL );
@@ -1253,8 +1471,6 @@ static void DParseDescriptors(DParser &parser, bool countOnly)
 				LOG(Warning, "Unexpected descriptor\n");
 			}
 
-			parse_descriptors_continue:
-
 			DParser_ConsumeUntil(parser, TOKEN_SEMICOLON);
 		}
 		else
@@ -1264,6 +1480,43 @@ static void DParseDescriptors(DParser &parser, bool countOnly)
 	}
 }
 
+static AssetDescriptors DPackDescriptors(const DDescRecord *records, u32 recordCount, Arena &arena)
+{
+	u32 counts[DDescType_COUNT] = {};
+	for (u32 i = 0; i < recordCount; ++i) {
+		counts[records[i].type]++;
+	}
+
+	AssetDescriptors descriptors = {};
+	descriptors.textureDescs = PushArray(arena, TextureDesc, counts[DDescType_Texture]);
+	descriptors.meshDescs = PushArray(arena, MeshDesc, counts[DDescType_Mesh]);
+	descriptors.spriteDescs = PushArray(arena, SpriteDesc, counts[DDescType_Sprite] + 1);
+	descriptors.materialDescs = PushArray(arena, MaterialDesc, counts[DDescType_Material]);
+	descriptors.entityDescs = PushArray(arena, EntityDesc, counts[DDescType_Entity]);
+	descriptors.roomDescs = PushArray(arena, RoomDesc, counts[DDescType_Room]);
+	descriptors.audioClipDescs = PushArray(arena, AudioClipDesc, counts[DDescType_AudioClip]);
+	descriptors.musicFileDescs = PushArray(arena, MusicFileDesc, counts[DDescType_MusicFile]);
+
+	for (u32 i = 0; i < recordCount; ++i)
+	{
+		const DDescRecord &record = records[i];
+		switch (record.type)
+		{
+			case DDescType_Texture: descriptors.textureDescs[descriptors.textureDescCount++] = record.texture; break;
+			case DDescType_Mesh: descriptors.meshDescs[descriptors.meshDescCount++] = record.mesh; break;
+			case DDescType_Sprite: descriptors.spriteDescs[descriptors.spriteDescCount++] = record.sprite; break;
+			case DDescType_Material: descriptors.materialDescs[descriptors.materialDescCount++] = record.material; break;
+			case DDescType_Entity: descriptors.entityDescs[descriptors.entityDescCount++] = record.entity; break;
+			case DDescType_Room: descriptors.roomDescs[descriptors.roomDescCount++] = record.room; break;
+			case DDescType_AudioClip: descriptors.audioClipDescs[descriptors.audioClipDescCount++] = record.audioClip; break;
+			case DDescType_MusicFile: descriptors.musicFileDescs[descriptors.musicFileDescCount++] = record.musicFile; break;
+			default: INVALID_CODE_PATH();
+		}
+	}
+
+	return descriptors;
+}
+
 AssetDescriptors ParseDescriptors(const char *filepath, Arena &arena)
 {
 	AssetDescriptors descriptors = {};
@@ -1271,46 +1524,23 @@ AssetDescriptors ParseDescriptors(const char *filepath, Arena &arena)
 
 	if ( chunk )
 	{
-		DTokenList tokenList = DScan(arena, (const char *)chunk->bytes, chunk->size);
-		if ( tokenList.valid )
-		{
-			DParser parser = DParser_Init(tokenList, arena, descriptors);
-			DParseDescriptors(parser, true);
+		Scratch scratch(MB(4)); // descriptor records until they are packed
 
-			if (!parser.hasErrors)
-			{
-				// Reserve memory and reset counts
-				descriptors.textureDescs = PushArray(arena, TextureDesc, descriptors.textureDescCount);
-				descriptors.textureDescCount = 0;
-				descriptors.spriteDescs = PushArray(arena, SpriteDesc, descriptors.spriteDescCount + 1);
-				descriptors.spriteDescCount = 0;
-				descriptors.materialDescs = PushArray(arena, MaterialDesc, descriptors.materialDescCount);
-				descriptors.materialDescCount = 0;
-				descriptors.entityDescs = PushArray(arena, EntityDesc, descriptors.entityDescCount);
-				descriptors.entityDescCount = 0;
-				descriptors.roomDescs = PushZeroArray(arena, RoomDesc, descriptors.roomDescCount);
-				descriptors.roomDescCount = 0;
-				descriptors.audioClipDescs = PushArray(arena, AudioClipDesc, descriptors.audioClipDescCount);
-				descriptors.audioClipDescCount = 0;
-				descriptors.musicFileDescs = PushArray(arena, MusicFileDesc, descriptors.musicFileDescCount);
-				descriptors.musicFileDescCount = 0;
-
-				parser = DParser_Init(tokenList, arena, descriptors);
-				DParseDescriptors(parser, false);
-
-				if ( parser.hasErrors )
-				{
-					LOG(Error, "Could not parser tokens: %s\n", filepath);
-				}
-			}
-			else
-			{
-				LOG(Error, "Could not parse tokens for counts: %s\n", filepath);
-			}
+		DParser parser = DParser_Init(chunk->chars, chunk->size, arena, scratch.arena);
+		DParseDescriptors(parser);
+
+		if ( parser.scanner.hasErrors )
+		{
+			LOG(Error, "Could not scan tokens: %s\n", filepath);
 		}
 		else
 		{
-			LOG(Error, "Could not scan tokens: %s\n", filepath);
+			if ( parser.hasErrors )
+			{
+				LOG(Error, "Could not parser tokens: %s\n", filepath);
+			}
+
+			descriptors = DPackDescriptors(parser.records, parser.recordCount, arena);
 		}
 	}
 	else
@@ -1331,103 +1561,1133 @@ AssetDescriptors ParseDescriptors(const char *filepath, Arena &arena)
 
 
 ////////////////////////////////////////////////////////////////////////
-// Binary output
+// Mesh import
 
-u32 PostIncrement(u32 *value, u32 incr)
-{
-	ASSERT( *value );
-	u32 ret = *value;
-	*value += incr;
-	return ret;
-}
+#define MESH_OPTIMIZER_CACHE_SIZE 32 // LRU cache modelled when reordering triangles
+#define MESH_ACMR_CACHE_SIZE 16      // FIFO cache used to measure the average cache miss ratio
 
-struct DataStringPool
+struct ObjCorner
 {
-	char *str;
-	u32 size;
+	u32 pos;      // 1-based indices, 0 when missing
+	u32 texCoord;
+	u32 normal;
 };
 
-static const char *DataInternString( DataStringPool &stringPool, const char *str )
+static const char *ObjSkipBlanks(const char *str, const char *end)
 {
-	if (!str) { return nullptr; }
+	while ( str < end && ( *str == ' ' || *str == '\t' || *str == '\r' ) ) str++;
+	return str;
+}
 
-	u32 offset = stringPool.size;
-	char *dst = stringPool.str + offset;
-	while (*str) { *dst++ = *str++; stringPool.size++; }
-	*dst = '\0';
-	stringPool.size++;
-	const char *offsetPtr = (const char*)(uintptr_t)offset;
-	return offsetPtr;
+static const char *ObjNextLine(const char *str, const char *end)
+{
+	while ( str < end && *str != '\n' ) str++;
+	return str < end ? str + 1 : end;
 }
 
-static const char *DataGetString( const char *stringPool, const char *offsetPtr )
+static bool ObjIsKeyword(const char *str, const char *end, const char *keyword)
 {
-	const char *str = offsetPtr ? stringPool + (uintptr_t)offsetPtr : nullptr;
-	return str;
+	while ( *keyword && str < end && *str == *keyword ) { str++; keyword++; }
+	return *keyword == '\0' && str < end && ( *str == ' ' || *str == '\t' );
 }
 
-void BuildAssets(const AssetDescriptors &descriptors, const char *filepath, Arena tempArena)
+static const char *ObjParseF32(const char *str, const char *end, f32 &value)
 {
-	LOG(Info, "Build assets: %s\n", filepath);
+	str = ObjSkipBlanks(str, end);
+
+	f64 sign = 1.0;
+	if ( str < end && ( *str == '-' || *str == '+' ) ) {
+		sign = *str++ == '-' ? -1.0 : 1.0;
+	}
+
+	f64 number = 0.0;
+	while ( str < end && Char_IsDigit(*str) ) {
+		number = number * 10.0 + ( *str++ - '0' );
+	}
+
+	if ( str < end && *str == '.' )
+	{
+		str++;
+		f64 scale = 0.1;
+		while ( str < end && Char_IsDigit(*str) ) {
+			number += scale * ( *str++ - '0' );
+			scale *= 0.1;
+		}
+	}
+
+	if ( str < end && ( *str == 'e' || *str == 'E' ) )
+	{
+		str++;
+		i32 exponentSign = 1;
+		if ( str < end && ( *str == '-' || *str == '+' ) ) {
+			exponentSign = *str++ == '-' ? -1 : 1;
+		}
+		i32 exponent = 0;
+		while ( str < end && Char_IsDigit(*str) ) {
+			exponent = exponent * 10 + ( *str++ - '0' );
+		}
+		for (i32 i = 0; i < exponent; ++i) {
+			number = exponentSign > 0 ? number * 10.0 : number * 0.1;
+		}
+	}
+
+	value = (f32)(sign * number);
+	return str;
+}
+
+// Parses one OBJ index, resolving negative (relative) indices. Returns 0 if there is none.
+static const char *ObjParseIndex(const char *str, const char *end, u32 elementCount, u32 &index)
+{
+	bool negative = false;
+	if ( str < end && *str == '-' ) {
+		negative = true;
+		str++;
+	}
+
+	i64 number = 0;
+	while ( str < end && Char_IsDigit(*str) ) {
+		number = number * 10 + ( *str++ - '0' );
+	}
+
+	if ( negative ) {
+		number = (i64)elementCount + 1 - number;
+	}
+
+	index = number > 0 && number <= elementCount ? (u32)number : 0;
+	return str;
+}
+
+static u32 ObjCornerHash(const ObjCorner &corner)
+{
+	u32 hash = corner.pos * 0x9E3779B1u;
+	hash ^= corner.texCoord * 0x85EBCA77u + ( hash >> 15 );
+	hash ^= corner.normal * 0xC2B2AE3Du + ( hash >> 13 );
+	return hash;
+}
+
+// Average cache miss ratio: vertex shader invocations per triangle with a FIFO cache
+static f32 MeshACMR(const u32 *indices, u32 indexCount, u32 vertexCount, Arena scratch)
+{
+	u32 *timestamps = PushZeroArray(scratch, u32, vertexCount);
+	u32 time = MESH_ACMR_CACHE_SIZE + 1;
+	u32 missCount = 0;
+
+	for (u32 i = 0; i < indexCount; ++i)
+	{
+		const u32 vertex = indices[i];
+		if ( time - timestamps[vertex] > MESH_ACMR_CACHE_SIZE ) {
+			timestamps[vertex] = time++;
+			missCount++;
+		}
+	}
+
+	const u32 triangleCount = indexCount / 3;
+	const f32 acmr = triangleCount > 0 ? (f32)missCount / triangleCount : 0.0f;
+	return acmr;
+}
+
+static f32 ForsythVertexScore(i32 cachePosition, u32 activeTriangleCount)
+{
+	if ( activeTriangleCount == 0 ) {
+		return -1.0f; // No triangles left to use this vertex
+	}
+
+	f32 score = 0.0f;
+	if ( cachePosition >= 0 && cachePosition < 3 )
+	{
+		// Vertices of the last triangle get a fixed score so that it is not reused right away
+		score = 0.75f;
+	}
+	else if ( cachePosition >= 3 && cachePosition < MESH_OPTIMIZER_CACHE_SIZE )
+	{
+		const f32 x = 1.0f - (f32)( cachePosition - 3 ) / ( MESH_OPTIMIZER_CACHE_SIZE - 3 );
+		score = x * Sqrt(x); // x^1.5
+	}
+
+	// Boost vertices with few triangles left, to finish them off and avoid lone triangles
+	score += 2.0f / Sqrt((f32)activeTriangleCount);
+	return score;
+}
+
+// Reorders triangles for post-transform cache locality.
+// Tom Forsyth, "Linear-Speed Vertex Cache Optimisation" (2006).
+static void OptimizeVertexCache(u32 *indices, u32 indexCount, u32 vertexCount, Arena scratch)
+{
+	const u32 triangleCount = indexCount / 3;
+	if ( triangleCount == 0 ) {
+		return;
+	}
+
+	// Triangles adjacent to each vertex. The first activeCount[v] entries of each list are the
+	// triangles not emitted yet.
+	u32 *activeCount = PushZeroArray(scratch, u32, vertexCount);
+	u32 *adjacencyOffset = PushArray(scratch, u32, vertexCount + 1);
+	u32 *adjacency = PushArray(scratch, u32, indexCount);
+
+	for (u32 i = 0; i < indexCount; ++i) {
+		activeCount[indices[i]]++;
+	}
+
+	adjacencyOffset[0] = 0;
+	for (u32 v = 0; v < vertexCount; ++v) {
+		adjacencyOffset[v + 1] = adjacencyOffset[v] + activeCount[v];
+		activeCount[v] = 0;
+	}
+
+	for (u32 i = 0; i < indexCount; ++i) {
+		const u32 v = indices[i];
+		adjacency[adjacencyOffset[v] + activeCount[v]++] = i / 3;
+	}
+
+	i32 *cachePosition = PushArray(scratch, i32, vertexCount);
+	f32 *vertexScore = PushArray(scratch, f32, vertexCount);
+	for (u32 v = 0; v < vertexCount; ++v) {
+		cachePosition[v] = -1;
+		vertexScore[v] = ForsythVertexScore(-1, activeCount[v]);
+	}
+
+	f32 *triangleScore = PushArray(scratch, f32, triangleCount);
+	u8 *triangleEmitted = PushZeroArray(scratch, u8, triangleCount);
+	i64 bestTriangle = 0;
+	for (u32 t = 0; t < triangleCount; ++t)
+	{
+		const u32 *tri = indices + 3 * t;
+		triangleScore[t] = vertexScore[tri[0]] + vertexScore[tri[1]] + vertexScore[tri[2]];
+		if ( triangleScore[t] > triangleScore[bestTriangle] ) {
+			bestTriangle = t;
+		}
+	}
+
+	u32 *output = PushArray(scratch, u32, indexCount);
+	u32 cache[MESH_OPTIMIZER_CACHE_SIZE + 3];
+	u32 cacheCount = 0;
+	u32 nextUnemitted = 0;
+
+	for (u32 emitted = 0; emitted < triangleCount; ++emitted)
+	{
+		if ( bestTriangle < 0 )
+		{
+			// Nothing left around the cache, continue with the next triangle in the input
+			while ( triangleEmitted[nextUnemitted] ) nextUnemitted++;
+			bestTriangle = nextUnemitted;
+		}
+
+		const u32 t = (u32)bestTriangle;
+		const u32 *tri = indices + 3 * t;
+		triangleEmitted[t] = 1;
+		output[3 * emitted + 0] = tri[0];
+		output[3 * emitted + 1] = tri[1];
+		output[3 * emitted + 2] = tri[2];
+
+		// Remove the triangle from the active lists of its vertices
+		for (u32 k = 0; k < 3; ++k)
+		{
+			const u32 v = tri[k];
+			u32 *list = adjacency + adjacencyOffset[v];
+			for (u32 a = 0; a < activeCount[v]; ++a)
+			{
+				if ( list[a] == t ) {
+					list[a] = list[--activeCount[v]];
+					list[activeCount[v]] = t;
+					break;
+				}
+			}
+		}
+
+		// Move the triangle vertices to the front of the LRU cache
+		u32 newCache[MESH_OPTIMIZER_CACHE_SIZE + 3];
+		u32 newCacheCount = 0;
+		newCache[newCacheCount++] = tri[0];
+		newCache[newCacheCount++] = tri[1];
+		newCache[newCacheCount++] = tri[2];
+		for (u32 c = 0; c < cacheCount; ++c)
+		{
+			const u32 v = cache[c];
+			if ( v != tri[0] && v != tri[1] && v != tri[2] ) {
+				newCache[newCacheCount++] = v;
+			}
+		}
+
+		// Rescore the vertices whose cache position changed, including evicted ones
+		for (u32 c = 0; c < newCacheCount; ++c)
+		{
+			const u32 v = newCache[c];
+			cachePosition[v] = c < MESH_OPTIMIZER_CACHE_SIZE ? (i32)c : -1;
+			vertexScore[v] = ForsythVertexScore(cachePosition[v], activeCount[v]);
+		}
+
+		// Rescore the triangles around the cache and pick the best one
+		bestTriangle = -1;
+		f32 bestScore = -1.0f;
+		for (u32 c = 0; c < newCacheCount; ++c)
+		{
+			const u32 v = newCache[c];
+			const u32 *list = adjacency + adjacencyOffset[v];
+			for (u32 a = 0; a < activeCount[v]; ++a)
+			{
+				const u32 tt = list[a];
+				const u32 *ttri = indices + 3 * tt;
+				triangleScore[tt] = vertexScore[ttri[0]] + vertexScore[ttri[1]] + vertexScore[ttri[2]];
+				if ( triangleScore[tt] > bestScore ) {
+					bestScore = triangleScore[tt];
+					bestTriangle = tt;
+				}
+			}
+		}
+
+		cacheCount = Min(newCacheCount, (u32)MESH_OPTIMIZER_CACHE_SIZE);
+		MemCopy(cache, newCache, cacheCount * sizeof(u32));
+	}
+
+	MemCopy(indices, output, indexCount * sizeof(u32));
+}
+
+struct MeshCluster
+{
+	u32 firstTriangle;
+	u32 triangleCount;
+	f32 sortKey;
+};
+
+#define MESH_OVERDRAW_THRESHOLD 1.05f // Allowed ACMR degradation when splitting clusters
+
+static u32 MeshCacheMissCount(const u32 *triangle, u32 *timestamps, u32 &time)
+{
+	u32 missCount = 0;
+	for (u32 k = 0; k < 3; ++k)
+	{
+		const u32 v = triangle[k];
+		if ( time - timestamps[v] > MESH_ACMR_CACHE_SIZE ) {
+			timestamps[v] = time++;
+			missCount++;
+		}
+	}
+	return missCount;
+}
+
+// Reorders clusters of triangles so that the ones facing away from the mesh center, which
+// are more likely to occlude the rest, are drawn first. Hard cluster boundaries are placed
+// where the cache misses all the vertices of a triangle, and clusters are further split
+// wherever their ACMR, starting with a cold cache, is within a threshold of the original one.
+// Sander et al., "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw" (2007).
+static void OptimizeOverdraw(u32 *indices, u32 indexCount, const float3 *positions, u32 vertexCount, Arena scratch)
+{
+	const u32 triangleCount = indexCount / 3;
+	if ( triangleCount == 0 ) {
+		return;
+	}
+
+	u32 *timestamps = PushZeroArray(scratch, u32, vertexCount);
+	u32 time = MESH_ACMR_CACHE_SIZE + 1;
+
+	// Hard boundaries
+	u32 *hardBoundaries = PushArray(scratch, u32, triangleCount + 1);
+	u32 hardClusterCount = 0;
+	for (u32 t = 0; t < triangleCount; ++t)
+	{
+		const u32 missCount = MeshCacheMissCount(indices + 3 * t, timestamps, time);
+		if ( t == 0 || missCount == 3 ) {
+			hardBoundaries[hardClusterCount++] = t;
+		}
+	}
+	hardBoundaries[hardClusterCount] = triangleCount;
+
+	// Soft boundaries
+	MeshCluster *clusters = PushArray(scratch, MeshCluster, triangleCount);
+	u32 clusterCount = 0;
+	for (u32 h = 0; h < hardClusterCount; ++h)
+	{
+		const u32 begin = hardBoundaries[h];
+		const u32 end = hardBoundaries[h + 1];
+
+		time += MESH_ACMR_CACHE_SIZE + 1; // Cold cache
+		u32 clusterMissCount = 0;
+		for (u32 t = begin; t < end; ++t) {
+			clusterMissCount += MeshCacheMissCount(indices + 3 * t, timestamps, time);
+		}
+		const f32 threshold = MESH_OVERDRAW_THRESHOLD * clusterMissCount / ( end - begin );
+
+		time += MESH_ACMR_CACHE_SIZE + 1;
+		clusters[clusterCount++] = { .firstTriangle = begin };
+		u32 missCount = 0;
+		for (u32 t = begin; t < end; ++t)
+		{
+			MeshCluster &cluster = clusters[clusterCount - 1];
+			missCount += MeshCacheMissCount(indices + 3 * t, timestamps, time);
+			cluster.triangleCount++;
+
+			if ( t + 1 < end && missCount <= threshold * cluster.triangleCount )
+			{
+				time += MESH_ACMR_CACHE_SIZE + 1;
+				clusters[clusterCount++] = { .firstTriangle = t + 1 };
+				missCount = 0;
+			}
+		}
+	}
+
+	float3 meshCenter = {};
+	for (u32 v = 0; v < vertexCount; ++v) {
+		meshCenter = meshCenter + positions[v];
+	}
+	meshCenter = Mul(meshCenter, 1.0f / vertexCount);
+
+	for (u32 c = 0; c < clusterCount; ++c)
+	{
+		MeshCluster &cluster = clusters[c];
+
+		float3 center = {};
+		float3 normal = {};
+		f32 area = 0.0f;
+		for (u32 t = cluster.firstTriangle; t < cluster.firstTriangle + cluster.triangleCount; ++t)
+		{
+			const float3 &p0 = positions[indices[3 * t + 0]];
+			const float3 &p1 = positions[indices[3 * t + 1]];
+			const float3 &p2 = positions[indices[3 * t + 2]];
+			const float3 triangleNormal = Cross(Sub(p1, p0), Sub(p2, p0));
+			const f32 triangleArea = Length(triangleNormal);
+			center = center + Mul(p0 + p1 + p2, triangleArea / 3.0f);
+			normal = normal + triangleNormal;
+			area += triangleArea;
+		}
+
+		cluster.sortKey = area > 0.0f ?
+			Dot(Sub(Mul(center, 1.0f / area), meshCenter), NormalizeIfNotZero(normal)) :
+			0.0f;
+	}
+
+	// Insertion sort by descending key, stable to keep the cache order of similar clusters
+	for (u32 i = 1; i < clusterCount; ++i)
+	{
+		const MeshCluster cluster = clusters[i];
+		u32 j = i;
+		while ( j > 0 && clusters[j - 1].sortKey < cluster.sortKey ) {
+			clusters[j] = clusters[j - 1];
+			j--;
+		}
+		clusters[j] = cluster;
+	}
+
+	u32 *output = PushArray(scratch, u32, indexCount);
+	u32 outputCount = 0;
+	for (u32 c = 0; c < clusterCount; ++c)
+	{
+		const MeshCluster &cluster = clusters[c];
+		const u32 size = 3 * cluster.triangleCount;
+		MemCopy(output + outputCount, indices + 3 * cluster.firstTriangle, size * sizeof(u32));
+		outputCount += size;
+	}
+
+	MemCopy(indices, output, indexCount * sizeof(u32));
+}
+
+static u16 QuantizeUnorm16(f32 value, f32 min, f32 max)
+{
+	const f32 t = max > min ? ( value - min ) / ( max - min ) : 0.0f;
+	const u16 res = (u16)Round(Clamp(t, 0.0f, 1.0f) * 65535.0f);
+	return res;
+}
+
+static i16 QuantizeSnorm16(f32 value)
+{
+	const i16 res = (i16)Round(Clamp(value, -1.0f, 1.0f) * 32767.0f);
+	return res;
+}
+
+// Octahedral encoding: projects the unit sphere onto an octahedron and unfolds it into a square
+static float2 OctahedralEncode(float3 n)
+{
+	const f32 l1 = ( n.x < 0.0f ? -n.x : n.x ) + ( n.y < 0.0f ? -n.y : n.y ) + ( n.z < 0.0f ? -n.z : n.z );
+	float2 p = l1 > 0.0f ? float2{ n.x / l1, n.y / l1 } : float2{ 0.0f, 0.0f };
+	if ( n.z < 0.0f )
+	{
+		const float2 folded = {
+			( 1.0f - ( p.y < 0.0f ? -p.y : p.y ) ) * ( p.x >= 0.0f ? 1.0f : -1.0f ),
+			( 1.0f - ( p.x < 0.0f ? -p.x : p.x ) ) * ( p.y >= 0.0f ? 1.0f : -1.0f ),
+		};
+		p = folded;
+	}
+	return p;
+}
+
+// Imports a Wavefront OBJ file (v/vt/vn/f) as an optimized and quantized mesh payload.
+// Both the temporary data and the payload are pushed to the given arena.
+bool ImportMesh(Arena &arena, const char *filepath, BinMeshDesc &desc, byte *&data)
+{
+	DataChunk *chunk = PushFile(arena, filepath);
+	if ( !chunk )
+	{
+		LOG(Error, "Could not read mesh file %s\n", filepath);
+		return false;
+	}
+
+	const char *begin = chunk->chars;
+	const char *end = chunk->chars + chunk->size;
+
+	// Count elements
+	u32 posCount = 0;
+	u32 texCoordCount = 0;
+	u32 normalCount = 0;
+	u32 cornerCount = 0; // Corners of triangulated faces
+	for (const char *line = begin; line < end; line = ObjNextLine(line, end))
+	{
+		line = ObjSkipBlanks(line, end);
+		if ( ObjIsKeyword(line, end, "v") ) posCount++;
+		else if ( ObjIsKeyword(line, end, "vt") ) texCoordCount++;
+		else if ( ObjIsKeyword(line, end, "vn") ) normalCount++;
+		else if ( ObjIsKeyword(line, end, "f") )
+		{
+			u32 faceCornerCount = 0;
+			for (const char *str = ObjSkipBlanks(line + 1, end); str < end && *str != '\n'; str = ObjSkipBlanks(str, end))
+			{
+				while ( str < end && *str != ' ' && *str != '\t' && *str != '\r' && *str != '\n' ) str++;
+				faceCornerCount++;
+			}
+			cornerCount += faceCornerCount >= 3 ? 3 * ( faceCornerCount - 2 ) : 0;
+		}
+	}
+
+	float3 *positions = PushArray(arena, float3, posCount);
+	float2 *texCoords = PushArray(arena, float2, texCoordCount);
+	float3 *normals = PushArray(arena, float3, normalCount);
+	ObjCorner *corners = PushArray(arena, ObjCorner, cornerCount);
+	posCount = texCoordCount = normalCount = cornerCount = 0;
+
+	// Parse elements, triangulating faces as fans
+	for (const char *line = begin; line < end; line = ObjNextLine(line, end))
+	{
+		line = ObjSkipBlanks(line, end);
+		if ( ObjIsKeyword(line, end, "v") )
+		{
+			float3 &p = positions[posCount++];
+			const char *str = ObjParseF32(line + 1, end, p.x);
+			str = ObjParseF32(str, end, p.y);
+			ObjParseF32(str, end, p.z);
+		}
+		else if ( ObjIsKeyword(line, end, "vt") )
+		{
+			float2 &uv = texCoords[texCoordCount++];
+			const char *str = ObjParseF32(line + 2, end, uv.x);
+			ObjParseF32(str, end, uv.y);
+			uv.y = 1.0f - uv.y; // OBJ texture coordinates start at the bottom
+		}
+		else if ( ObjIsKeyword(line, end, "vn") )
+		{
+			float3 &n = normals[normalCount++];
+			const char *str = ObjParseF32(line + 2, end, n.x);
+			str = ObjParseF32(str, end, n.y);
+			ObjParseF32(str, end, n.z);
+		}
+		else if ( ObjIsKeyword(line, end, "f") )
+		{
+			ObjCorner first = {};
+			ObjCorner previous = {};
+			u32 faceCornerCount = 0;
+			for (const char *str = ObjSkipBlanks(line + 1, end); str < end && *str != '\n'; str = ObjSkipBlanks(str, end))
+			{
+				ObjCorner corner = {};
+				str = ObjParseIndex(str, end, posCount, corner.pos);
+				if ( str < end && *str == '/' ) {
+					str = ObjParseIndex(str + 1, end, texCoordCount, corner.texCoord);
+				}
+				if ( str < end && *str == '/' ) {
+					str = ObjParseIndex(str + 1, end, normalCount, corner.normal);
+				}
+				while ( str < end && *str != ' ' && *str != '\t' && *str != '\r' && *str != '\n' ) str++;
+
+				if ( corner.pos == 0 )
+				{
+					LOG(Error, "Invalid face in mesh file %s\n", filepath);
+					return false;
+				}
+
+				if ( faceCornerCount == 0 ) {
+					first = corner;
+				} else if ( faceCornerCount >= 2 ) {
+					corners[cornerCount++] = first;
+					corners[cornerCount++] = previous;
+					corners[cornerCount++] = corner;
+				}
+				previous = corner;
+				faceCornerCount++;
+			}
+		}
+	}
+
+	// Deduplicate vertices sharing the same position, texture coordinate and normal
+	u32 tableSize = 64;
+	while ( tableSize < 2 * cornerCount ) tableSize *= 2;
+	i32 *table = PushArray(arena, i32, tableSize);
+	for (u32 i = 0; i < tableSize; ++i) table[i] = -1;
+
+	ObjCorner *uniqueCorners = PushArray(arena, ObjCorner, cornerCount);
+	u32 *indices = PushArray(arena, u32, cornerCount);
+	u32 vertexCount = 0;
+
+	for (u32 i = 0; i < cornerCount; ++i)
+	{
+		const ObjCorner &corner = corners[i];
+		u32 slot = ObjCornerHash(corner) & ( tableSize - 1 );
+		while ( table[slot] >= 0 )
+		{
+			const ObjCorner &other = uniqueCorners[table[slot]];
+			if ( other.pos == corner.pos && other.texCoord == corner.texCoord && other.normal == corner.normal ) {
+				break;
+			}
+			slot = ( slot + 1 ) & ( tableSize - 1 );
+		}
+
+		if ( table[slot] < 0 ) {
+			table[slot] = vertexCount;
+			uniqueCorners[vertexCount++] = corner;
+		}
+		indices[i] = table[slot];
+	}
+
+	const u32 indexCount = cornerCount;
+	if ( vertexCount > U16_MAX )
+	{
+		LOG(Error, "Mesh file %s has too many vertices (%u, max %u)\n", filepath, vertexCount, U16_MAX);
+		return false;
+	}
+
+	// Smooth normals from the faces for vertices without one
+	float3 *faceNormals = PushZeroArray(arena, float3, posCount);
+	for (u32 i = 0; i + 2 < indexCount; i += 3)
+	{
+		const u32 p0 = uniqueCorners[indices[i + 0]].pos - 1;
+		const u32 p1 = uniqueCorners[indices[i + 1]].pos - 1;
+		const u32 p2 = uniqueCorners[indices[i + 2]].pos - 1;
+		const float3 n = Cross(Sub(positions[p1], positions[p0]), Sub(positions[p2], positions[p0]));
+		faceNormals[p0] = faceNormals[p0] + n;
+		faceNormals[p1] = faceNormals[p1] + n;
+		faceNormals[p2] = faceNormals[p2] + n;
+	}
+
+	float3 *vertexPositions = PushArray(arena, float3, vertexCount);
+	float3 *vertexNormals = PushArray(arena, float3, vertexCount);
+	float2 *vertexTexCoords = PushArray(arena, float2, vertexCount);
+	for (u32 v = 0; v < vertexCount; ++v)
+	{
+		const ObjCorner &corner = uniqueCorners[v];
+		vertexPositions[v] = positions[corner.pos - 1];
+		vertexNormals[v] = NormalizeIfNotZero(corner.normal ? normals[corner.normal - 1] : faceNormals[corner.pos - 1]);
+		vertexTexCoords[v] = corner.texCoord ? texCoords[corner.texCoord - 1] : float2{ 0.0f, 0.0f };
+	}
+
+	// Optimize the triangle order
+	const f32 acmrBefore = MeshACMR(indices, indexCount, vertexCount, arena);
+	OptimizeVertexCache(indices, indexCount, vertexCount, arena);
+	const f32 acmrCache = MeshACMR(indices, indexCount, vertexCount, arena);
+	OptimizeOverdraw(indices, indexCount, vertexPositions, vertexCount, arena);
+	const f32 acmrAfter = MeshACMR(indices, indexCount, vertexCount, arena);
+
+	// Reorder vertices by first use, so that vertex fetches are sequential too
+	i32 *remap = PushArray(arena, i32, vertexCount);
+	for (u32 v = 0; v < vertexCount; ++v) remap[v] = -1;
+	u32 *vertexOrder = PushArray(arena, u32, vertexCount);
+	u32 usedVertexCount = 0;
+	for (u32 i = 0; i < indexCount; ++i)
+	{
+		const u32 v = indices[i];
+		if ( remap[v] < 0 ) {
+			remap[v] = usedVertexCount;
+			vertexOrder[usedVertexCount++] = v;
+		}
+		indices[i] = remap[v];
+	}
+	vertexCount = usedVertexCount;
+
+	// Bounds
+	desc = {};
+	desc.vertexCount = vertexCount;
+	desc.indexCount = indexCount;
+	if ( vertexCount > 0 )
+	{
+		desc.boundsMin = desc.boundsMax = vertexPositions[vertexOrder[0]];
+		desc.texCoordMin = desc.texCoordMax = vertexTexCoords[vertexOrder[0]];
+	}
+	for (u32 i = 0; i < vertexCount; ++i)
+	{
+		const float3 &p = vertexPositions[vertexOrder[i]];
+		const float2 &uv = vertexTexCoords[vertexOrder[i]];
+		desc.boundsMin = { Min(desc.boundsMin.x, p.x), Min(desc.boundsMin.y, p.y), Min(desc.boundsMin.z, p.z) };
+		desc.boundsMax = { Max(desc.boundsMax.x, p.x), Max(desc.boundsMax.y, p.y), Max(desc.boundsMax.z, p.z) };
+		desc.texCoordMin = { Min(desc.texCoordMin.x, uv.x), Min(desc.texCoordMin.y, uv.y) };
+		desc.texCoordMax = { Max(desc.texCoordMax.x, uv.x), Max(desc.texCoordMax.y, uv.y) };
+	}
+
+	// Quantized payload
+	const u32 verticesSize = vertexCount * sizeof(BinMeshVertex);
+	const u32 indicesSize = indexCount * sizeof(u16);
+	data = PushSize(arena, verticesSize + indicesSize);
+
+	BinMeshVertex *vertices = (BinMeshVertex*)data;
+	for (u32 i = 0; i < vertexCount; ++i)
+	{
+		const u32 v = vertexOrder[i];
+		const float3 &p = vertexPositions[v];
+		const float2 &uv = vertexTexCoords[v];
+		const float2 n = OctahedralEncode(vertexNormals[v]);
+
+		BinMeshVertex &vertex = vertices[i];
+		vertex.pos[0] = QuantizeUnorm16(p.x, desc.boundsMin.x, desc.boundsMax.x);
+		vertex.pos[1] = QuantizeUnorm16(p.y, desc.boundsMin.y, desc.boundsMax.y);
+		vertex.pos[2] = QuantizeUnorm16(p.z, desc.boundsMin.z, desc.boundsMax.z);
+		vertex.normal[0] = QuantizeSnorm16(n.x);
+		vertex.normal[1] = QuantizeSnorm16(n.y);
+		vertex.texCoord[0] = QuantizeUnorm16(uv.x, desc.texCoordMin.x, desc.texCoordMax.x);
+		vertex.texCoord[1] = QuantizeUnorm16(uv.y, desc.texCoordMin.y, desc.texCoordMax.y);
+		vertex._pad = 0;
+	}
+
+	u16 *vertexIndices = (u16*)(data + verticesSize);
+	for (u32 i = 0; i < indexCount; ++i) {
+		vertexIndices[i] = (u16)indices[i];
+	}
+
+	LOG(Info, "Mesh %s: %u vertices, %u triangles, ACMR %.3f -> %.3f (vertex cache) -> %.3f (overdraw)\n",
+			filepath, vertexCount, indexCount / 3, acmrBefore, acmrCache, acmrAfter);
+
+	return true;
+}
+
+
+
+
+
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Atlas baking
+//
+// Sprites whose texture is marked with .atlas are packed into shared pages,
+// so that tiles and sprites from different textures can be drawn with the
+// same bind group. Each sprite region (all its frames) goes into a cell with
+// its border pixels extruded up to the cell edges. Cells are aligned to
+// ATLAS_ALIGNMENT pixels and pages are limited to the mip levels where no
+// texel covers more than one cell, so no level blends neighbouring sprites.
+
+#define ATLAS_PAGE_SIZE 2048
+#define ATLAS_ALIGNMENT 4      // Cell alignment in pixels
+#define ATLAS_EXTRUSION 4      // Minimum border around each sprite region
+#define ATLAS_MAX_MIP_LEVELS 3 // log2(ATLAS_ALIGNMENT) + 1
+
+struct AtlasRegion
+{
+	u32 textureIndex;
+	uint2 pos;  // Within the source texture
+	uint2 size;
+	u32 page;   // U32_MAX if it could not be packed
+	uint2 atlasPos;
+};
+
+struct AtlasPage
+{
+	const char *name;
+	u32 width;
+	u32 height;
+	u8 mipmap;
+	byte *pixels; // RGBA
+};
+
+struct AtlasBake
+{
+	AtlasPage *pages;
+	u32 pageCount;
+	SpriteDesc *spriteDescs; // Copy of the sprite descriptors, remapped to the atlas pages
+	bool *textureBaked;      // Textures fully replaced by atlas pages
+	u32 textureBakedCount;
+};
+
+static i32 FindTextureDescIndex(const AssetDescriptors &descriptors, const char *name)
+{
+	for (u32 i = 0; name && i < descriptors.textureDescCount; ++i) {
+		if ( StrEq(descriptors.textureDescs[i].name, name) ) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+static uint2 AtlasCellSize(const AtlasRegion &region)
+{
+	const uint2 size = {
+		AlignUp(region.size.x + 2 * ATLAS_EXTRUSION, ATLAS_ALIGNMENT),
+		AlignUp(region.size.y + 2 * ATLAS_EXTRUSION, ATLAS_ALIGNMENT),
+	};
+	return size;
+}
+
+static AtlasBake BakeAtlases(const AssetDescriptors &descriptors, Arena &arena)
+{
+	const u32 textureCount = descriptors.textureDescCount;
+	const u32 spriteCount = descriptors.spriteDescCount;
+
+	AtlasBake bake = {};
+	bake.spriteDescs = PushArray(arena, SpriteDesc, spriteCount);
+	bake.textureBaked = PushZeroArray(arena, bool, textureCount);
+	MemCopy(bake.spriteDescs, descriptors.spriteDescs, spriteCount * sizeof(SpriteDesc));
+
+	Scratch scratchMemory(MB(64)); // Source image files and packing state
+	Arena &scratch = scratchMemory.arena;
+
+	ImagePixels *images = PushZeroArray(scratch, ImagePixels, textureCount);
+	bool *imageLoaded = PushZeroArray(scratch, bool, textureCount);
+	AtlasRegion *regions = PushArray(scratch, AtlasRegion, spriteCount);
+	u32 *spriteRegions = PushArray(scratch, u32, spriteCount);
+	u32 regionCount = 0;
+
+	// Collect the regions used by sprites, loading their textures on first use
+	for (u32 s = 0; s < spriteCount; ++s)
+	{
+		const SpriteDesc &sprite = descriptors.spriteDescs[s];
+		spriteRegions[s] = U32_MAX;
+
+		const i32 t = FindTextureDescIndex(descriptors, sprite.textureName);
+		if ( t < 0 || !descriptors.textureDescs[t].atlas ) {
+			continue;
+		}
+
+		if ( !imageLoaded[t] )
+		{
+			const FilePath imagePath = MakePath(AssetDir, descriptors.textureDescs[t].filename);
+			if ( !ReadImagePixels(scratch, imagePath.str, images[t]) ) {
+				images[t] = {};
+			}
+			imageLoaded[t] = true;
+		}
+
+		const ImagePixels &image = images[t];
+		const uint2 imageSize = { (u32)image.width, (u32)image.height };
+		const uint2 size = ( sprite.size.x > 0 || sprite.size.y > 0 ) ? sprite.size : imageSize;
+		const u32 frameCount = Max(sprite.frameCount, 1U);
+
+		AtlasRegion region = {
+			.textureIndex = (u32)t,
+			.pos = sprite.pos,
+			.size = { size.x * frameCount, size.y },
+			.page = U32_MAX,
+		};
+		if ( region.size.x == 0 || region.size.y == 0 ||
+			region.pos.x + region.size.x > imageSize.x || region.pos.y + region.size.y > imageSize.y )
+		{
+			LOG(Warning, "Sprite %s lies outside of texture %s, not added to the atlas\n", sprite.name, sprite.textureName);
+			continue;
+		}
+
+		// Sprites sharing a region share the cell
+		u32 r = 0;
+		while ( r < regionCount &&
+			!( regions[r].textureIndex == region.textureIndex &&
+			   regions[r].pos.x == region.pos.x && regions[r].pos.y == region.pos.y &&
+			   regions[r].size.x == region.size.x && regions[r].size.y == region.size.y ) )
+		{
+			r++;
+		}
+		if ( r == regionCount ) {
+			regions[regionCount++] = region;
+		}
+		spriteRegions[s] = r;
+	}
+
+	if ( regionCount == 0 ) {
+		return bake;
+	}
+
+	// Pack cells in units of ATLAS_ALIGNMENT, so they all land on aligned positions
+	constexpr u32 pageCells = ATLAS_PAGE_SIZE / ATLAS_ALIGNMENT;
+	stbrp_node *nodes = PushArray(scratch, stbrp_node, pageCells);
+	stbrp_rect *rects = PushArray(scratch, stbrp_rect, regionCount);
+	u32 rectCount = 0;
+
+	for (u32 r = 0; r < regionCount; ++r)
+	{
+		const uint2 cellSize = AtlasCellSize(regions[r]);
+		if ( cellSize.x > ATLAS_PAGE_SIZE || cellSize.y > ATLAS_PAGE_SIZE ) {
+			LOG(Warning, "Region of texture %s too large for an atlas page\n", descriptors.textureDescs[regions[r].textureIndex].name);
+			continue;
+		}
+		rects[rectCount++] = {
+			.id = (int)r,
+			.w = (stbrp_coord)( cellSize.x / ATLAS_ALIGNMENT ),
+			.h = (stbrp_coord)( cellSize.y / ATLAS_ALIGNMENT ),
+		};
+	}
+
+	bake.pages = PushZeroArray(arena, AtlasPage, rectCount);
+
+	while ( rectCount > 0 )
+	{
+		stbrp_context context;
+		stbrp_init_target(&context, pageCells, pageCells, nodes, pageCells);
+		stbrp_pack_rects(&context, rects, rectCount);
+
+		AtlasPage &page = bake.pages[bake.pageCount];
+		const u32 pageIndex = bake.pageCount++;
+
+		// Place packed cells, keeping the rest for the next page
+		u32 pendingCount = 0;
+		for (u32 i = 0; i < rectCount; ++i)
+		{
+			const stbrp_rect &rect = rects[i];
+			if ( rect.was_packed )
+			{
+				AtlasRegion &region = regions[rect.id];
+				region.page = pageIndex;
+				region.atlasPos = {
+					(u32)rect.x * ATLAS_ALIGNMENT + ATLAS_EXTRUSION,
+					(u32)rect.y * ATLAS_ALIGNMENT + ATLAS_EXTRUSION,
+				};
+				page.width = Max(page.width, (u32)( rect.x + rect.w ) * ATLAS_ALIGNMENT);
+				page.height = Max(page.height, (u32)( rect.y + rect.h ) * ATLAS_ALIGNMENT);
+				page.mipmap |= descriptors.textureDescs[region.textureIndex].mipmap;
+			}
+			else
+			{
+				rects[pendingCount++] = rect;
+			}
+		}
+		ASSERT(pendingCount < rectCount);
+		rectCount = pendingCount;
+
+		char name[32];
+		SPrintf(name, "atlas_%u", pageIndex);
+		page.name = PushString(arena, name);
+		page.pixels = PushZeroArray(arena, byte, page.width * page.height * 4);
+	}
+
+	// Fill the cells, clamping to the region so that its borders extend up to the cell edges
+	for (u32 r = 0; r < regionCount; ++r)
+	{
+		const AtlasRegion &region = regions[r];
+		if ( region.page == U32_MAX ) {
+			continue;
+		}
+
+		const ImagePixels &image = images[region.textureIndex];
+		const AtlasPage &page = bake.pages[region.page];
+		const uint2 cellSize = AtlasCellSize(region);
+		const u32 cellX = region.atlasPos.x - ATLAS_EXTRUSION;
+		const u32 cellY = region.atlasPos.y - ATLAS_EXTRUSION;
+
+		for (u32 y = 0; y < cellSize.y; ++y)
+		{
+			const i32 regionY = Clamp((i32)y - ATLAS_EXTRUSION, 0, (i32)region.size.y - 1);
+			const u32 srcY = region.pos.y + regionY;
+			for (u32 x = 0; x < cellSize.x; ++x)
+			{
+				const i32 regionX = Clamp((i32)x - ATLAS_EXTRUSION, 0, (i32)region.size.x - 1);
+				const u32 srcX = region.pos.x + regionX;
+				const byte *src = image.pixels + 4 * ( srcY * image.width + srcX );
+				byte *dst = page.pixels + 4 * ( ( cellY + y ) * page.width + cellX + x );
+				MemCopy(dst, src, 4);
+			}
+		}
+	}
+
+	// Remap sprites, and drop the textures that are not needed anymore
+	bool *textureNeeded = PushZeroArray(scratch, bool, textureCount);
+	for (u32 s = 0; s < spriteCount; ++s)
+	{
+		SpriteDesc &sprite = bake.spriteDescs[s];
+		const u32 r = spriteRegions[s];
+		if ( r != U32_MAX && regions[r].page != U32_MAX )
+		{
+			sprite.textureName = bake.pages[regions[r].page].name;
+			sprite.pos = regions[r].atlasPos;
+			if ( sprite.size.x == 0 && sprite.size.y == 0 ) {
+				sprite.size = regions[r].size;
+			}
+		}
+		else
+		{
+			const i32 t = FindTextureDescIndex(descriptors, sprite.textureName);
+			if ( t >= 0 ) textureNeeded[t] = true;
+		}
+	}
+	for (u32 m = 0; m < descriptors.materialDescCount; ++m)
+	{
+		const i32 t = FindTextureDescIndex(descriptors, descriptors.materialDescs[m].textureName);
+		if ( t >= 0 ) textureNeeded[t] = true;
+	}
+
+	for (u32 t = 0; t < textureCount; ++t)
+	{
+		if ( imageLoaded[t] && !textureNeeded[t] ) {
+			bake.textureBaked[t] = true;
+			bake.textureBakedCount++;
+		}
+		if ( imageLoaded[t] && !images[t].constPixels ) {
+			stbi_image_free(images[t].pixels);
+		}
+	}
+
+	for (u32 p = 0; p < bake.pageCount; ++p)
+	{
+		LOG(Info, "Atlas page %s: %ux%u px\n", bake.pages[p].name, bake.pages[p].width, bake.pages[p].height);
+	}
+	LOG(Info, "Atlas: %u sprite regions in %u pages, replacing %u textures\n", regionCount, bake.pageCount, bake.textureBakedCount);
+
+	return bake;
+}
+
+
+
+
+
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Binary output
+
+struct DataStringPool
+{
+	char *str;
+	u32 size;
+};
+
+static const char *DataInternString( DataStringPool &stringPool, const char *str )
+{
+	if (!str) { return nullptr; }
+
+	u32 offset = stringPool.size;
+	char *dst = stringPool.str + offset;
+	while (*str) { *dst++ = *str++; stringPool.size++; }
+	*dst = '\0';
+	stringPool.size++;
+	const char *offsetPtr = (const char*)(uintptr_t)offset;
+	return offsetPtr;
+}
+
+static const char *DataGetString( const char *stringPool, const char *offsetPtr )
+{
+	const char *str = offsetPtr ? stringPool + (uintptr_t)offsetPtr : nullptr;
+	return str;
+}
+
+static void BinBeginSection(BinSection *sections, BinSectionType type, u32 &offset)
+{
+	const BinSectionInfo &info = BinSectionInfos[type];
+	offset = AlignUp(offset, info.alignment);
+
+	BinSection &section = sections[type];
+	section = {};
+	section.type      = type;
+	section.version   = info.version;
+	section.alignment = info.alignment;
+	section.offset    = offset;
+}
+
+static void BinEndSection(BinSection *sections, BinSectionType type, u32 offset)
+{
+	BinSection &section = sections[type];
+	section.size = offset - section.offset;
+}
+
+static void BinReserveDescSection(BinSection *sections, BinSectionType type, u32 &offset, u32 count, u32 descSize)
+{
+	BinBeginSection(sections, type, offset);
+	sections[type].count = count;
+	offset += count * descSize;
+	BinEndSection(sections, type, offset);
+}
+
+static BinLocation BinWritePayload(FILE *file, BinSection &section, u32 &offset, const void *data, u64 size)
+{
+	offset = AlignUp(offset, section.alignment);
+
+	const BinLocation location = {
+		.offset   = offset,
+		.size     = U64ToU32(size),
+		.checksum = HashXX64(data, size),
+	};
+
+	if ( size > 0 ) {
+		fseek(file, offset, SEEK_SET);
+		fwrite(data, size, 1, file);
+	}
+
+	offset += location.size;
+	section.count++;
+	return location;
+}
+
+static u64 BinChecksumFromFile(FILE *file, const BinSection &section, Arena scratch)
+{
+	byte *bytes = PushSize(scratch, section.size);
+	fseek(file, section.offset, SEEK_SET);
+	if ( section.size > 0 && fread(bytes, section.size, 1, file) != 1 ) {
+		LOG(Error, "Could not read back section %s\n", BinSectionInfos[section.type].name);
+	}
+	const u64 checksum = HashXX64(bytes, section.size);
+	return checksum;
+}
+
+void BuildAssets(const AssetDescriptors &descriptors, const char *filepath, Arena tempArena)
+{
+	LOG(Info, "Build assets: %s\n", filepath);
 
 	CreateDirectory( MakePath(ProjectDir, "build").str );
 
-	FILE *file = fopen(filepath, "wb");
+	FILE *file = fopen(filepath, "w+b");
 	if ( file )
 	{
-		u32 offset = sizeof( BinAssetsHeader );
+		BinSection sections[BinSectionType_COUNT] = {};
 
-		const u32 shaderCount = descriptors.shaderDescCount;
-		const u32 shadersSize = shaderCount * sizeof(BinShaderDesc);
-		const u32 shadersOffset = PostIncrement(&offset, shadersSize);
+		const u32 tocOffset = sizeof(BinAssetsHeader);
+		u32 offset = tocOffset + sizeof(sections);
 
-		const u32 imageCount = descriptors.textureDescCount;
-		const u32 imagesSize = imageCount * sizeof(BinImageDesc);
-		const u32 imagesOffset = PostIncrement(&offset, imagesSize);
+		const AtlasBake atlas = BakeAtlases(descriptors, tempArena);
 
+		const u32 shaderCount = descriptors.shaderDescCount;
+		const u32 textureCount = descriptors.textureDescCount;
+		const u32 imageCount = textureCount - atlas.textureBakedCount + atlas.pageCount;
+		const u32 meshCount = descriptors.meshDescCount;
 		const u32 audioClipCount = descriptors.audioClipDescCount;
-		const u32 audioClipsSize = audioClipCount * sizeof(BinAudioClipDesc);
-		const u32 audioClipsOffset = PostIncrement(&offset, audioClipsSize);
-
 		const u32 musicFileCount = descriptors.musicFileDescCount;
-		const u32 musicFilesSize = musicFileCount * sizeof(BinMusicFileDesc);
-		const u32 musicFilesOffset = PostIncrement(&offset, musicFilesSize);
-
 		const u32 materialCount = descriptors.materialDescCount;
-		const u32 materialsSize = materialCount * sizeof(BinMaterialDesc);
-		const u32 materialsOffset = PostIncrement(&offset, materialsSize);
-
 		const u32 spriteCount = descriptors.spriteDescCount;
-		const u32 spritesSize = spriteCount * sizeof(BinSpriteDesc);
-		const u32 spritesOffset = PostIncrement(&offset, spritesSize);
-
 		const u32 entityCount = descriptors.entityDescCount;
-		const u32 entitiesSize = entityCount * sizeof(BinEntityDesc);
-		const u32 entitiesOffset = PostIncrement(&offset, entitiesSize);
-
 		const u32 roomCount = descriptors.roomDescCount;
-		const u32 roomsSize = roomCount * sizeof(BinRoomDesc);
-		const u32 roomsOffset = PostIncrement(&offset, roomsSize);
+
+		BinReserveDescSection(sections, BinSectionType_ShaderDescs,    offset, shaderCount,    sizeof(BinShaderDesc));
+		BinReserveDescSection(sections, BinSectionType_ImageDescs,     offset, imageCount,     sizeof(BinImageDesc));
+		BinReserveDescSection(sections, BinSectionType_AudioClipDescs, offset, audioClipCount, sizeof(BinAudioClipDesc));
+		BinReserveDescSection(sections, BinSectionType_MusicFileDescs, offset, musicFileCount, sizeof(BinMusicFileDesc));
+		BinReserveDescSection(sections, BinSectionType_MaterialDescs,  offset, materialCount,  sizeof(BinMaterialDesc));
+		BinReserveDescSection(sections, BinSectionType_SpriteDescs,    offset, spriteCount,    sizeof(BinSpriteDesc));
+		BinReserveDescSection(sections, BinSectionType_EntityDescs,    offset, entityCount,    sizeof(BinEntityDesc));
+		BinReserveDescSection(sections, BinSectionType_RoomDescs,      offset, roomCount,      sizeof(BinRoomDesc));
+		BinReserveDescSection(sections, BinSectionType_MeshDescs,      offset, meshCount,      sizeof(BinMeshDesc));
 
 		const u32 maxStringPoolSize = KB(128);
 		char *stringPoolBase = PushArray(tempArena, char, maxStringPoolSize);
 		DataStringPool stringPool = { stringPoolBase, 1 }; // offset 0 is reserved for nullptr
+		stringPoolBase[0] = '\0';
 
 		// Reserve space for asset descs
-		BinShaderDesc *binShaderDescs = PushArray(tempArena, BinShaderDesc, shaderCount);
-		BinImageDesc *binImageDescs = PushArray(tempArena, BinImageDesc, imageCount);
-		BinAudioClipDesc *binAudioClipDescs = PushArray(tempArena, BinAudioClipDesc, audioClipCount);
-		BinMusicFileDesc *binMusicFileDescs = PushArray(tempArena, BinMusicFileDesc, musicFileCount);
-		BinMaterialDesc *binMaterialDescs = PushArray(tempArena, BinMaterialDesc, materialCount);
-		BinSpriteDesc *binSpriteDescs = PushArray(tempArena, BinSpriteDesc, spriteCount);
-		BinEntityDesc *binEntityDescs = PushArray(tempArena, BinEntityDesc, entityCount);
-		BinRoomDesc *binRoomDescs = PushArray(tempArena, BinRoomDesc, roomCount);
+		BinShaderDesc *binShaderDescs = PushZeroArray(tempArena, BinShaderDesc, shaderCount);
+		BinImageDesc *binImageDescs = PushZeroArray(tempArena, BinImageDesc, imageCount);
+		BinMeshDesc *binMeshDescs = PushZeroArray(tempArena, BinMeshDesc, meshCount);
+		BinAudioClipDesc *binAudioClipDescs = PushZeroArray(tempArena, BinAudioClipDesc, audioClipCount);
+		BinMusicFileDesc *binMusicFileDescs = PushZeroArray(tempArena, BinMusicFileDesc, musicFileCount);
+		BinMaterialDesc *binMaterialDescs = PushZeroArray(tempArena, BinMaterialDesc, materialCount);
+		BinSpriteDesc *binSpriteDescs = PushZeroArray(tempArena, BinSpriteDesc, spriteCount);
+		BinEntityDesc *binEntityDescs = PushZeroArray(tempArena, BinEntityDesc, entityCount);
+		BinRoomDesc *binRoomDescs = PushZeroArray(tempArena, BinRoomDesc, roomCount);
 
 		// Prepare asset descs and write asset payloads
 
-		fseek(file, offset, SEEK_SET);
-
 		// Shaders
+		BinBeginSection(sections, BinSectionType_ShaderData, offset);
 		for (u32 i = 0; i < shaderCount; ++i)
 		{
 			const ShaderSourceDesc &desc = descriptors.shaderDescs[i];
@@ -1438,24 +2698,27 @@ void BuildAssets(const AssetDescriptors &descriptors, const char *filepath, Aren
 			u64 payloadSize = 0;
 			GetFileSize(filepath, payloadSize);
 
-			BinShaderDesc &d = binShaderDescs[i];
-			d.name       = DataInternString(stringPool, desc.name);
-			d.entryPoint = DataInternString(stringPool, desc.entryPoint);
-			d.type = desc.type;
-			d.location.offset = PostIncrement(&offset, payloadSize);
-			d.location.size = U64ToU32(payloadSize);
-
 			Arena scratch = MakeSubArena(tempArena, "Scratch - BuildAssets");
 			void *shaderPayload = PushSize(scratch, payloadSize);
 			ReadEntireFile(filepath, shaderPayload, payloadSize);
 
-			fwrite(shaderPayload, payloadSize, 1, file);
+			BinShaderDesc &d = binShaderDescs[i];
+			d.name       = DataInternString(stringPool, desc.name);
+			d.entryPoint = DataInternString(stringPool, desc.entryPoint);
+			d.type = desc.type;
+			d.location = BinWritePayload(file, sections[BinSectionType_ShaderData], offset, shaderPayload, payloadSize);
 		}
+		BinEndSection(sections, BinSectionType_ShaderData, offset);
 
 		// Images
-		for (u32 i = 0; i < imageCount; ++i)
+		BinBeginSection(sections, BinSectionType_ImageData, offset);
+		u32 imageIndex = 0;
+		for (u32 i = 0; i < textureCount; ++i)
 		{
 			const TextureDesc &desc = descriptors.textureDescs[i];
+			if ( atlas.textureBaked[i] ) {
+				continue;
+			}
 
 			const FilePath imagePath = MakePath(AssetDir, desc.filename);
 
@@ -1481,53 +2744,108 @@ void BuildAssets(const AssetDescriptors &descriptors, const char *filepath, Aren
 
 			const u64 payloadSize = texWidth * texHeight * texChannels;
 
-			BinImageDesc &d = binImageDescs[i];
+			BinImageDesc &d = binImageDescs[imageIndex++];
 			d.name     = DataInternString(stringPool, desc.name);
 			d.width    = I32ToU16(texWidth);
 			d.height   = I32ToU16(texHeight);
 			d.channels = I32ToU8(texChannels);
 			d.mipmap   = desc.mipmap;
+			d.maxMipLevels = 0;
+			d.unused   = 0;
+			d.location = BinWritePayload(file, sections[BinSectionType_ImageData], offset, pixels, payloadSize);
+		}
+		for (u32 i = 0; i < atlas.pageCount; ++i)
+		{
+			const AtlasPage &page = atlas.pages[i];
+			const u64 payloadSize = page.width * page.height * 4;
+
+			BinImageDesc &d = binImageDescs[imageIndex++];
+			d.name     = DataInternString(stringPool, page.name);
+			d.width    = (u16)page.width;
+			d.height   = (u16)page.height;
+			d.channels = 4;
+			d.mipmap   = page.mipmap;
+			d.maxMipLevels = ATLAS_MAX_MIP_LEVELS;
 			d.unused   = 0;
-			d.location.offset = PostIncrement(&offset, payloadSize);
-			d.location.size   = U64ToU32(payloadSize);
+			d.location = BinWritePayload(file, sections[BinSectionType_ImageData], offset, page.pixels, payloadSize);
+		}
+		ASSERT(imageIndex == imageCount);
+		BinEndSection(sections, BinSectionType_ImageData, offset);
+
+		// Meshes
+		BinBeginSection(sections, BinSectionType_MeshData, offset);
+		for (u32 i = 0; i < meshCount; ++i)
+		{
+			const MeshDesc &desc = descriptors.meshDescs[i];
+
+			const FilePath meshPath = MakePath(AssetDir, desc.filename);
 
-			fwrite(pixels, payloadSize, 1, file);
+			Arena scratch = MakeSubArena(tempArena, "Scratch - BuildAssets");
+			BinMeshDesc &d = binMeshDescs[i];
+			byte *meshPayload = nullptr;
+			if ( !ImportMesh(scratch, meshPath.str, d, meshPayload) ) {
+				d = {};
+			}
+
+			const u64 payloadSize = d.vertexCount * sizeof(BinMeshVertex) + d.indexCount * sizeof(u16);
+
+			d.name     = DataInternString(stringPool, desc.name);
+			d.location = BinWritePayload(file, sections[BinSectionType_MeshData], offset, meshPayload, payloadSize);
 		}
+		BinEndSection(sections, BinSectionType_MeshData, offset);
 
 		// AudioClips
+		BinBeginSection(sections, BinSectionType_AudioClipData, offset);
 		for (u32 i = 0; i < audioClipCount; ++i)
 		{
 			const AudioClipDesc &desc = descriptors.audioClipDescs[i];
 
 			const FilePath path = MakePath(AssetDir, desc.filename);
 
-			AudioClip audioClip;
+			AudioClip audioClip = {};
 			Arena scratch = MakeSubArena(tempArena, "Scratch - BuildAssets");
 			void *samples = nullptr;
-			const bool ok = LoadAudioClipFromWAVFile(path.str, scratch, audioClip, &samples);
+			if ( !LoadAudioClipFromWAVFile(path.str, scratch, audioClip, &samples) ) {
+				LOG(Error, "Could not load audio clip %s\n", path.str);
+				audioClip = {};
+			}
+			else if ( audioClip.samplingRate != AUDIO_SAMPLE_RATE || audioClip.channelCount != 2 )
+			{
+				// Clips are streamed and mixed as stereo at the mix rate
+				i16 *resampled = nullptr;
+				const u32 frameCount = audioClip.sampleCount / audioClip.channelCount;
+				const u32 resampledFrameCount = ResampleClip(scratch, (const i16*)samples, frameCount, audioClip.channelCount, audioClip.samplingRate, AUDIO_SAMPLE_RATE, &resampled);
+				LOG(Info, "- Resampled audio clip %s from %u Hz (%u channels) to %u Hz\n", desc.filename, audioClip.samplingRate, audioClip.channelCount, AUDIO_SAMPLE_RATE);
+				audioClip.samplingRate = AUDIO_SAMPLE_RATE;
+				audioClip.channelCount = 2;
+				audioClip.sampleCount = resampledFrameCount * 2;
+				samples = resampled;
+			}
 
-			const u64 payloadSize = audioClip.sampleCount * audioClip.sampleSize;
+			// Clips are stored as ADPCM, the streamer decodes them
+			const u32 frameCount = audioClip.sampleCount / 2;
+			const u64 payloadSize = AdpcmEncodedSize(frameCount);
+			byte *blocks = PushArray(scratch, byte, payloadSize);
+			EncodeAdpcm((const i16*)samples, frameCount, blocks);
+			if ( frameCount > 0 ) {
+				LOG(Info, "- Encoded audio clip %s as ADPCM (%u KB -> %u KB)\n", desc.filename,
+						audioClip.sampleCount * audioClip.sampleSize / 1024, (u32)payloadSize / 1024);
+			}
 
 			const BinAudioClipDesc d = {
 				.sampleCount = audioClip.sampleCount,
 				.samplingRate = audioClip.samplingRate,
 				.sampleSize = audioClip.sampleSize,
 				.channelCount = audioClip.channelCount,
-				.location = {
-					.offset = PostIncrement(&offset, payloadSize),
-					.size = U64ToU32(payloadSize),
-				},
+				.format = AudioClipFormat_ADPCM,
+				.location = BinWritePayload(file, sections[BinSectionType_AudioClipData], offset, blocks, payloadSize),
 			};
 			binAudioClipDescs[i] = d;
-
-			if ( ok ) {
-				fwrite(samples, payloadSize, 1, file);
-			} else {
-				fseek(file, payloadSize, SEEK_CUR);
-			}
 		}
+		BinEndSection(sections, BinSectionType_AudioClipData, offset);
 
 		// MusicFiles
+		BinBeginSection(sections, BinSectionType_MusicFileData, offset);
 		for (u32 i = 0; i < musicFileCount; ++i)
 		{
 			const MusicFileDesc &desc = descriptors.musicFileDescs[i];
@@ -1540,15 +2858,11 @@ void BuildAssets(const AssetDescriptors &descriptors, const char *filepath, Aren
 				continue;
 			}
 
-			const u64 payloadSize = fileChunk->size;
-
 			BinMusicFileDesc &d = binMusicFileDescs[i];
-			d.name            = DataInternString(stringPool, desc.name);
-			d.location.offset = PostIncrement(&offset, payloadSize);
-			d.location.size   = U64ToU32(payloadSize);
-
-			fwrite(fileChunk->bytes, payloadSize, 1, file);
+			d.name     = DataInternString(stringPool, desc.name);
+			d.location = BinWritePayload(file, sections[BinSectionType_MusicFileData], offset, fileChunk->bytes, fileChunk->size);
 		}
+		BinEndSection(sections, BinSectionType_MusicFileData, offset);
 
 		// Materials
 		for (u32 i = 0; i < materialCount; ++i)
@@ -1565,7 +2879,7 @@ void BuildAssets(const AssetDescriptors &descriptors, const char *filepath, Aren
 		// Sprites
 		for (u32 i = 0; i < spriteCount; ++i)
 		{
-			const SpriteDesc &desc = descriptors.spriteDescs[i];
+			const SpriteDesc &desc = atlas.spriteDescs[i];
 
 			BinSpriteDesc &d = binSpriteDescs[i];
 			d.name        = DataInternString(stringPool, desc.name);
@@ -1587,13 +2901,15 @@ void BuildAssets(const AssetDescriptors &descriptors, const char *filepath, Aren
 			d.name         = DataInternString(stringPool, desc.name);
 			d.materialName = DataInternString(stringPool, desc.materialName);
 			d.spriteName   = DataInternString(stringPool, desc.spriteName);
+			d.meshName     = DataInternString(stringPool, desc.meshName);
 			d.pos          = desc.pos;
 			d.scale        = desc.scale;
 			d.layer        = desc.layer;
 			d.geometryType = desc.geometryType;
 		}
 
-		// Rooms (tile payloads continue after the last written payload)
+		// Rooms
+		BinBeginSection(sections, BinSectionType_TileData, offset);
 		for (u32 i = 0; i < roomCount; ++i)
 		{
 			const RoomDesc &desc = descriptors.roomDescs[i];
@@ -1615,53 +2931,56 @@ void BuildAssets(const AssetDescriptors &descriptors, const char *filepath, Aren
 				ld.visible      = layer.visible ? 1 : 0;
 				ld.isCollider   = layer.isCollider ? 1 : 0;
 				ld.tileCount    = layer.tileCount;
-				ld.tiles.offset = PostIncrement(&offset, payloadSize);
-				ld.tiles.size   = U64ToU32(payloadSize);
-
-				if ( payloadSize > 0 ) {
-					fwrite(layer.tiles, payloadSize, 1, file);
-				}
+				ld.tiles        = BinWritePayload(file, sections[BinSectionType_TileData], offset, layer.tiles, payloadSize);
 			}
 		}
+		BinEndSection(sections, BinSectionType_TileData, offset);
 
 		// Write string pool after payloads
-		const u32 stringPoolOffset = offset;
-		const u32 stringPoolSize   = stringPool.size;
-		fwrite(stringPool.str, stringPoolSize, 1, file);
+		BinBeginSection(sections, BinSectionType_StringPool, offset);
+		sections[BinSectionType_StringPool].count = 1;
+		fseek(file, offset, SEEK_SET);
+		fwrite(stringPool.str, stringPool.size, 1, file);
+		offset += stringPool.size;
+		BinEndSection(sections, BinSectionType_StringPool, offset);
 
 		// Write asset descs
-		fseek(file, sizeof(BinAssetsHeader), SEEK_SET);
-		fwrite(binShaderDescs,    sizeof(binShaderDescs[0]),    shaderCount,    file);
-		fwrite(binImageDescs,     sizeof(binImageDescs[0]),     imageCount,     file);
-		fwrite(binAudioClipDescs, sizeof(binAudioClipDescs[0]), audioClipCount, file);
-		fwrite(binMusicFileDescs, sizeof(binMusicFileDescs[0]), musicFileCount, file);
-		fwrite(binMaterialDescs,  sizeof(binMaterialDescs[0]),  materialCount,  file);
-		if (spriteCount) fwrite(binSpriteDescs, sizeof(binSpriteDescs[0]), spriteCount, file);
-		fwrite(binEntityDescs, sizeof(binEntityDescs[0]), entityCount, file);
-		if (roomCount) fwrite(binRoomDescs, sizeof(binRoomDescs[0]), roomCount, file);
-
-		// Write file header last (string pool offset is now known)
+		const struct { BinSectionType type; const void *descs; } descArrays[] = {
+			{ BinSectionType_ShaderDescs, binShaderDescs },
+			{ BinSectionType_ImageDescs, binImageDescs },
+			{ BinSectionType_AudioClipDescs, binAudioClipDescs },
+			{ BinSectionType_MusicFileDescs, binMusicFileDescs },
+			{ BinSectionType_MaterialDescs, binMaterialDescs },
+			{ BinSectionType_SpriteDescs, binSpriteDescs },
+			{ BinSectionType_EntityDescs, binEntityDescs },
+			{ BinSectionType_RoomDescs, binRoomDescs },
+			{ BinSectionType_MeshDescs, binMeshDescs },
+		};
+		for (u32 i = 0; i < ARRAY_COUNT(descArrays); ++i)
+		{
+			const BinSection &section = sections[descArrays[i].type];
+			if ( section.size > 0 ) {
+				fseek(file, section.offset, SEEK_SET);
+				fwrite(descArrays[i].descs, section.size, 1, file);
+			}
+		}
+
+		// Section checksums are computed from the file contents, alignment padding included
+		for (u32 i = 0; i < BinSectionType_COUNT; ++i)
+		{
+			sections[i].checksum = BinChecksumFromFile(file, sections[i], tempArena);
+		}
+
+		fseek(file, tocOffset, SEEK_SET);
+		fwrite(sections, sizeof(sections), 1, file);
+
+		// Write file header last (the table of contents is now known)
 		const BinAssetsHeader fileHeader = {
-			.magicNumber      = U32FromChars('I', 'R', 'I', 'S'),
-			.version          = BinAssetsVersion,
-			.shadersOffset    = shadersOffset,
-			.shaderCount      = shaderCount,
-			.imagesOffset     = imagesOffset,
-			.imageCount       = imageCount,
-			.audioClipsOffset = audioClipsOffset,
-			.audioClipCount   = audioClipCount,
-			.musicFilesOffset = musicFilesOffset,
-			.musicFileCount   = musicFileCount,
-			.materialsOffset  = materialsOffset,
-			.materialCount    = materialCount,
-			.spritesOffset    = spritesOffset,
-			.spriteCount      = spriteCount,
-			.entitiesOffset   = entitiesOffset,
-			.entityCount      = entityCount,
-			.roomsOffset      = roomsOffset,
-			.roomCount        = roomCount,
-			.stringPoolOffset = stringPoolOffset,
-			.stringPoolSize   = stringPoolSize,
+			.magicNumber  = BinAssetsMagicNumber,
+			.version      = BinAssetsVersion,
+			.sectionCount = BinSectionType_COUNT,
+			.tocOffset    = tocOffset,
+			.tocChecksum  = HashXX64(sections, sizeof(sections)),
 		};
 		fseek(file, 0, SEEK_SET);
 		fwrite(&fileHeader, sizeof(fileHeader), 1, file);
@@ -1670,6 +2989,135 @@ void BuildAssets(const AssetDescriptors &descriptors, const char *filepath, Aren
 	}
 }
 
+
+
+
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Descriptors benchmark
+
+static bool EqualTiles(const LayerDesc &a, const LayerDesc &b)
+{
+	bool equal = a.tileCount == b.tileCount;
+	for (u32 t = 0; t < a.tileCount && equal; ++t) {
+		equal = a.tiles[t].x == b.tiles[t].x && a.tiles[t].y == b.tiles[t].y && a.tiles[t].spriteIndex == b.tiles[t].spriteIndex;
+	}
+	return equal;
+}
+
+void BenchmarkDescriptors(const char *filepath)
+{
+	constexpr u32 roomCount = 256;
+	constexpr u32 layerCount = 4;
+	constexpr u32 spriteCount = 64;
+	constexpr u32 iterationCount = 8;
+	CT_ASSERT(layerCount <= MAX_LAYERS);
+
+	const u32 memorySize = MB(512);
+	byte *memory = (byte*)AllocateVirtualMemory(memorySize);
+	Arena arena = MakeArena(memory, memorySize, "BenchmarkDescriptors");
+
+	// Generate rooms with about half of the grid cells filled in every layer
+	AssetDescriptors assets = {};
+	assets.roomDescs = PushZeroArray(arena, RoomDesc, roomCount);
+	assets.roomDescCount = roomCount;
+
+	u32 random = 0x2545F491;
+	u32 tileCount = 0;
+
+	for (u32 r = 0; r < roomCount; ++r)
+	{
+		char name[64];
+		SPrintf(name, "room_%u", r);
+
+		RoomDesc &room = assets.roomDescs[r];
+		room.name = PushString(arena, name);
+		room.pos = { (i32)(r % 16) - 8, (i32)(r / 16) - 8 };
+		room.layerCount = layerCount;
+
+		for (u32 l = 0; l < layerCount; ++l)
+		{
+			SPrintf(name, "layer_%u", l);
+
+			LayerDesc &layer = room.layers[l];
+			layer.name = PushString(arena, name);
+			layer.order = l;
+			layer.visible = true;
+			layer.isCollider = l == 0;
+			layer.tiles = PushArray(arena, TileDesc, TILE_GRID_SIZE_X * TILE_GRID_SIZE_Y);
+
+			for (u32 x = 0; x < TILE_GRID_SIZE_X; ++x)
+			{
+				for (u32 y = 0; y < TILE_GRID_SIZE_Y; ++y)
+				{
+					random ^= random << 13;
+					random ^= random >> 17;
+					random ^= random << 5;
+					if ( random & 1 )
+					{
+						TileDesc &tile = layer.tiles[layer.tileCount++];
+						tile.x = x;
+						tile.y = y;
+						tile.spriteIndex = (random >> 8) % spriteCount;
+					}
+				}
+			}
+
+			tileCount += layer.tileCount;
+		}
+	}
+
+	LOG(Info, "Descriptors benchmark: %u rooms, %u layers per room, %u tiles\n", roomCount, layerCount, tileCount);
+
+	f32 saveMillis = 0.0f;
+	f32 parseMillis = 0.0f;
+	bool valid = true;
+
+	for (u32 i = 0; i < iterationCount; ++i)
+	{
+		const Clock saveBegin = GetClock();
+		SaveAssetDescriptors(filepath, assets);
+		saveMillis += 1000.0f * GetSecondsElapsed(saveBegin, GetClock());
+
+		const u32 used = arena.used;
+
+		const Clock parseBegin = GetClock();
+		const AssetDescriptors parsed = ParseDescriptors(filepath, arena);
+		parseMillis += 1000.0f * GetSecondsElapsed(parseBegin, GetClock());
+
+		valid = valid && parsed.roomDescCount == roomCount;
+		for (u32 r = 0; r < parsed.roomDescCount && valid; ++r)
+		{
+			const RoomDesc &expected = assets.roomDescs[r];
+			const RoomDesc &room = parsed.roomDescs[r];
+			valid = StrEq(room.name, expected.name) && room.pos.x == expected.pos.x && room.pos.y == expected.pos.y && room.layerCount == expected.layerCount;
+			for (u32 l = 0; l < room.layerCount && valid; ++l) {
+				valid = StrEq(room.layers[l].name, expected.layers[l].name) && EqualTiles(room.layers[l], expected.layers[l]);
+			}
+		}
+
+		arena.used = used;
+	}
+
+	u64 fileSize = 0;
+	GetFileSize(filepath, fileSize);
+	const f32 megabytes = (f32)fileSize / MB(1);
+	const f32 averageSaveMillis = saveMillis / iterationCount;
+	const f32 averageParseMillis = parseMillis / iterationCount;
+
+	LOG(Info, "- File size: %.2f MB\n", megabytes);
+	LOG(Info, "- Save:  %8.3f ms (%.0f MB/s)\n", averageSaveMillis, 1000.0f * megabytes / averageSaveMillis);
+	LOG(Info, "- Parse: %8.3f ms (%.0f MB/s)\n", averageParseMillis, 1000.0f * megabytes / averageParseMillis);
+	LOG(Info, "- Round trip: %s\n", valid ? "ok" : "MISMATCH");
+
+	FreeVirtualMemory(memory, memorySize);
+}
+
 #endif // USE_DATA_BUILD
 
 
@@ -1684,7 +3132,49 @@ void BuildAssets(const AssetDescriptors &descriptors, const char *filepath, Aren
 ////////////////////////////////////////////////////////////////////////
 // Binary loading
 
-BinAssets OpenAssets(Arena &dataArena, const char *filepath)
+bool CheckAssetPayload(const BinLocation &location, const void *bytes)
+{
+	bool ok = bytes != nullptr || location.size == 0;
+#if USE_ASSET_CHECKSUMS
+	if ( ok && HashXX64(bytes, location.size) != location.checksum )
+	{
+		LOG(Error, "Checksum mismatch in payload at offset %u (%u bytes)\n", location.offset, location.size);
+		ok = false;
+	}
+#endif
+	return ok;
+}
+
+static byte *PushSectionFromFile(Arena &dataArena, File file, const BinSection &section, const char *filepath)
+{
+	byte *bytes = PushDataFromFile(dataArena, file, section.offset, section.size);
+	if ( !bytes && section.size > 0 )
+	{
+		LOG( Error, "Could not read section %s from file %s\n", BinSectionInfos[section.type].name, filepath );
+		QUIT_ABNORMALLY();
+	}
+#if USE_ASSET_CHECKSUMS
+	if ( HashXX64(bytes, section.size) != section.checksum )
+	{
+		LOG( Error, "Checksum mismatch in section %s of file %s. Rebuild the data files.\n", BinSectionInfos[section.type].name, filepath );
+		QUIT_ABNORMALLY();
+	}
+#endif
+	return bytes;
+}
+
+static byte *PushPayloadFromFile(Arena &dataArena, File file, const BinLocation &location, const char *filepath)
+{
+	byte *bytes = PushDataFromFile(dataArena, file, location.offset, location.size);
+	if ( !CheckAssetPayload(location, bytes) )
+	{
+		LOG( Error, "Corrupted payload in file %s. Rebuild the data files.\n", filepath );
+		QUIT_ABNORMALLY();
+	}
+	return bytes;
+}
+
+BinAssets OpenAssetDescriptors(Arena &dataArena, const char *filepath)
 {
 	BinAssets assets = {};
 
@@ -1700,7 +3190,7 @@ BinAssets OpenAssets(Arena &dataArena, const char *filepath)
 		QUIT_ABNORMALLY();
 	}
 
-	if (assets.header.magicNumber != U32FromChars('I', 'R', 'I', 'S'))
+	if (assets.header.magicNumber != BinAssetsMagicNumber)
 	{
 		LOG( Error, "Wrong magic number in file %s\n", filepath );
 		QUIT_ABNORMALLY();
@@ -1712,53 +3202,109 @@ BinAssets OpenAssets(Arena &dataArena, const char *filepath)
 		QUIT_ABNORMALLY();
 	}
 
-	assets.shaders = PushArray(dataArena, BinShader, assets.header.shaderCount);
-	assets.images = PushArray(dataArena, BinImage, assets.header.imageCount);
-	assets.audioClips = PushArray(dataArena, BinAudioClip, assets.header.audioClipCount);
-	assets.musicFiles = PushArray(dataArena, BinMusicFile, assets.header.musicFileCount);
-	assets.materials = PushArray(dataArena, BinMaterial, assets.header.materialCount);
-	assets.sprites = PushArray(dataArena, BinSprite, assets.header.spriteCount + 1);
-	assets.entities = PushArray(dataArena, BinEntity, assets.header.entityCount);
-	assets.rooms = PushZeroArray(dataArena, BinRoom, assets.header.roomCount);
+	// Table of contents
+	{
+		Arena scratch = dataArena;
+		const u32 tocSize = assets.header.sectionCount * sizeof(BinSection);
+		const BinSection *toc = (const BinSection*)PushDataFromFile(scratch, file, assets.header.tocOffset, tocSize);
+		if ( !toc || HashXX64(toc, tocSize) != assets.header.tocChecksum )
+		{
+			LOG( Error, "Corrupted table of contents in file %s. Rebuild the data files.\n", filepath );
+			QUIT_ABNORMALLY();
+		}
+
+		for (u32 i = 0; i < assets.header.sectionCount; ++i)
+		{
+			const BinSection &section = toc[i];
+			if ( section.type >= BinSectionType_COUNT ) {
+				continue; // Unknown section, written by a newer tool
+			}
+
+			const BinSectionInfo &info = BinSectionInfos[section.type];
+			if ( section.version != info.version )
+			{
+				LOG( Error, "Wrong version of section %s (%u, expected %u) in file %s. Rebuild the data files.\n", info.name, section.version, info.version, filepath );
+				QUIT_ABNORMALLY();
+			}
+			if ( (u64)section.offset + section.size > file.size )
+			{
+				LOG( Error, "Section %s exceeds the size of file %s (truncated?)\n", info.name, filepath );
+				QUIT_ABNORMALLY();
+			}
+
+			assets.sections[section.type] = section;
+		}
+	}
 
-	const char *stringPool = (const char*)PushDataFromFile(
-		dataArena, file, assets.header.stringPoolOffset, assets.header.stringPoolSize);
+	assets.shaderCount = assets.sections[BinSectionType_ShaderDescs].count;
+	assets.imageCount = assets.sections[BinSectionType_ImageDescs].count;
+	assets.meshCount = assets.sections[BinSectionType_MeshDescs].count;
+	assets.audioClipCount = assets.sections[BinSectionType_AudioClipDescs].count;
+	assets.musicFileCount = assets.sections[BinSectionType_MusicFileDescs].count;
+	assets.materialCount = assets.sections[BinSectionType_MaterialDescs].count;
+	assets.spriteCount = assets.sections[BinSectionType_SpriteDescs].count;
+	assets.entityCount = assets.sections[BinSectionType_EntityDescs].count;
+	assets.roomCount = assets.sections[BinSectionType_RoomDescs].count;
+
+	assets.shaders = PushArray(dataArena, BinShader, assets.shaderCount);
+	assets.images = PushArray(dataArena, BinImage, assets.imageCount);
+	assets.meshes = PushArray(dataArena, BinMesh, assets.meshCount);
+	assets.audioClips = PushArray(dataArena, BinAudioClip, assets.audioClipCount);
+	assets.musicFiles = PushArray(dataArena, BinMusicFile, assets.musicFileCount);
+	assets.materials = PushArray(dataArena, BinMaterial, assets.materialCount);
+	assets.sprites = PushArray(dataArena, BinSprite, assets.spriteCount + 1);
+	assets.entities = PushArray(dataArena, BinEntity, assets.entityCount);
+	assets.rooms = PushZeroArray(dataArena, BinRoom, assets.roomCount);
+
+	const char *stringPool = (const char*)PushSectionFromFile(
+		dataArena, file, assets.sections[BinSectionType_StringPool], filepath);
 
 	// Shaders
-	BinShaderDesc *binShaderDescs = (BinShaderDesc*)PushDataFromFile(
-		dataArena, file, assets.header.shadersOffset, assets.header.shaderCount * sizeof(BinShaderDesc));
-	for (u32 i = 0; i < assets.header.shaderCount; ++i)
+	BinShaderDesc *binShaderDescs = (BinShaderDesc*)PushSectionFromFile(
+		dataArena, file, assets.sections[BinSectionType_ShaderDescs], filepath);
+	for (u32 i = 0; i < assets.shaderCount; ++i)
 	{
 		BinShaderDesc &d = binShaderDescs[i];
 		d.name       = DataGetString( stringPool, d.name );
 		d.entryPoint = DataGetString( stringPool, d.entryPoint );
 		assets.shaders[i].desc  = &d;
-		assets.shaders[i].spirv = PushDataFromFile(dataArena, file, d.location.offset, d.location.size);
+		assets.shaders[i].spirv = nullptr;
 	}
 
 	// Images
-	BinImageDesc *binImageDescs = (BinImageDesc*)PushDataFromFile(
-		dataArena, file, assets.header.imagesOffset, assets.header.imageCount * sizeof(BinImageDesc));
-	for (u32 i = 0; i < assets.header.imageCount; ++i)
+	BinImageDesc *binImageDescs = (BinImageDesc*)PushSectionFromFile(
+		dataArena, file, assets.sections[BinSectionType_ImageDescs], filepath);
+	for (u32 i = 0; i < assets.imageCount; ++i)
 	{
 		BinImageDesc &d = binImageDescs[i];
 		d.name = DataGetString( stringPool, d.name );
 		assets.images[i].desc   = &d;
-		assets.images[i].pixels = PushDataFromFile(dataArena, file, d.location.offset, d.location.size);
+		assets.images[i].pixels = nullptr;
+	}
+
+	// Meshes
+	BinMeshDesc *binMeshDescs = (BinMeshDesc*)PushSectionFromFile(
+		dataArena, file, assets.sections[BinSectionType_MeshDescs], filepath);
+	for (u32 i = 0; i < assets.meshCount; ++i)
+	{
+		BinMeshDesc &d = binMeshDescs[i];
+		d.name = DataGetString( stringPool, d.name );
+		assets.meshes[i].desc = &d;
+		assets.meshes[i].data = nullptr;
 	}
 
-	// AudioClips
-	BinAudioClipDesc *binAudioClipDescs = (BinAudioClipDesc*)PushDataFromFile(
-		dataArena, file, assets.header.audioClipsOffset, assets.header.audioClipCount * sizeof(BinAudioClipDesc));
-	for (u32 i = 0; i < assets.header.audioClipCount; ++i)
+	// AudioClips (payloads are streamed from the file while playing)
+	BinAudioClipDesc *binAudioClipDescs = (BinAudioClipDesc*)PushSectionFromFile(
+		dataArena, file, assets.sections[BinSectionType_AudioClipDescs], filepath);
+	for (u32 i = 0; i < assets.audioClipCount; ++i)
 	{
 		assets.audioClips[i].desc = binAudioClipDescs + i;
 	}
 
-	// MusicFiles
-	BinMusicFileDesc *binMusicFileDescs = (BinMusicFileDesc*)PushDataFromFile(
-		dataArena, file, assets.header.musicFilesOffset, assets.header.musicFileCount * sizeof(BinMusicFileDesc));
-	for (u32 i = 0; i < assets.header.musicFileCount; ++i)
+	// MusicFiles (payloads are loaded on play, see CheckAssetPayload)
+	BinMusicFileDesc *binMusicFileDescs = (BinMusicFileDesc*)PushSectionFromFile(
+		dataArena, file, assets.sections[BinSectionType_MusicFileDescs], filepath);
+	for (u32 i = 0; i < assets.musicFileCount; ++i)
 	{
 		BinMusicFileDesc &d = binMusicFileDescs[i];
 		d.name = DataGetString( stringPool, d.name );
@@ -1766,9 +3312,9 @@ BinAssets OpenAssets(Arena &dataArena, const char *filepath)
 	}
 
 	// Materials
-	BinMaterialDesc *materialDescs = (BinMaterialDesc*)PushDataFromFile(
-		dataArena, file, assets.header.materialsOffset, assets.header.materialCount * sizeof(BinMaterialDesc));
-	for (u32 i = 0; i < assets.header.materialCount; ++i)
+	BinMaterialDesc *materialDescs = (BinMaterialDesc*)PushSectionFromFile(
+		dataArena, file, assets.sections[BinSectionType_MaterialDescs], filepath);
+	for (u32 i = 0; i < assets.materialCount; ++i)
 	{
 		BinMaterialDesc &d = materialDescs[i];
 		d.name         = DataGetString( stringPool, d.name );
@@ -1778,51 +3324,41 @@ BinAssets OpenAssets(Arena &dataArena, const char *filepath)
 	}
 
 	// Sprites
-	if (assets.header.spriteCount > 0)
+	BinSpriteDesc *spriteDescs = (BinSpriteDesc*)PushSectionFromFile(
+		dataArena, file, assets.sections[BinSectionType_SpriteDescs], filepath);
+	for (u32 i = 0; i < assets.spriteCount; ++i)
 	{
-		BinSpriteDesc *spriteDescs = (BinSpriteDesc*)PushDataFromFile(
-			dataArena, file, assets.header.spritesOffset, assets.header.spriteCount * sizeof(BinSpriteDesc));
-		for (u32 i = 0; i < assets.header.spriteCount; ++i)
-		{
-			BinSpriteDesc &d = spriteDescs[i];
-			d.name        = DataGetString(stringPool, d.name);
-			d.textureName = DataGetString(stringPool, d.textureName);
-			assets.sprites[i].desc = &d;
-		}
+		BinSpriteDesc &d = spriteDescs[i];
+		d.name        = DataGetString(stringPool, d.name);
+		d.textureName = DataGetString(stringPool, d.textureName);
+		assets.sprites[i].desc = &d;
 	}
 
 	// Entities
-	BinEntityDesc *entityDescs = (BinEntityDesc*)PushDataFromFile(
-		dataArena, file, assets.header.entitiesOffset, assets.header.entityCount * sizeof(BinEntityDesc));
-	for (u32 i = 0; i < assets.header.entityCount; ++i)
+	BinEntityDesc *entityDescs = (BinEntityDesc*)PushSectionFromFile(
+		dataArena, file, assets.sections[BinSectionType_EntityDescs], filepath);
+	for (u32 i = 0; i < assets.entityCount; ++i)
 	{
 		BinEntityDesc &d = entityDescs[i];
 		d.name         = DataGetString(stringPool, d.name);
 		d.materialName = DataGetString(stringPool, d.materialName);
 		d.spriteName   = DataGetString(stringPool, d.spriteName);
+		d.meshName     = DataGetString(stringPool, d.meshName);
 		assets.entities[i].desc = &d;
 	}
 
 	// Rooms
-	if (assets.header.roomCount > 0)
+	BinRoomDesc *roomDescs = (BinRoomDesc*)PushSectionFromFile(
+		dataArena, file, assets.sections[BinSectionType_RoomDescs], filepath);
+	for (u32 i = 0; i < assets.roomCount; ++i)
 	{
-		BinRoomDesc *roomDescs = (BinRoomDesc*)PushDataFromFile(
-			dataArena, file, assets.header.roomsOffset, assets.header.roomCount * sizeof(BinRoomDesc));
-		for (u32 i = 0; i < assets.header.roomCount; ++i)
+		BinRoomDesc &d = roomDescs[i];
+		d.name = DataGetString(stringPool, d.name);
+		assets.rooms[i].desc = &d;
+		for (u32 l = 0; l < d.layerCount && l < ARRAY_COUNT(d.layers); ++l)
 		{
-			BinRoomDesc &d = roomDescs[i];
-			d.name = DataGetString(stringPool, d.name);
-			assets.rooms[i].desc = &d;
-			for (u32 l = 0; l < d.layerCount && l < ARRAY_COUNT(d.layers); ++l)
-			{
-				BinLayerDesc &ld = d.layers[l];
-				ld.name = DataGetString(stringPool, ld.name);
-				if (ld.tiles.size > 0)
-				{
-					assets.rooms[i].tiles[l] = (TileDesc*)PushDataFromFile(
-						dataArena, file, ld.tiles.offset, ld.tiles.size);
-				}
-			}
+			BinLayerDesc &ld = d.layers[l];
+			ld.name = DataGetString(stringPool, ld.name);
 		}
 	}
 
@@ -1831,6 +3367,53 @@ BinAssets OpenAssets(Arena &dataArena, const char *filepath)
 	return assets;
 }
 
+BinAssets OpenAssets(Arena &dataArena, const char *filepath)
+{
+	BinAssets assets = OpenAssetDescriptors(dataArena, filepath);
+
+	for (u32 i = 0; i < assets.shaderCount; ++i)
+	{
+		BinShader &shader = assets.shaders[i];
+		shader.spirv = PushPayloadFromFile(dataArena, assets.file, shader.desc->location, filepath);
+	}
+
+	for (u32 i = 0; i < assets.imageCount; ++i)
+	{
+		BinImage &image = assets.images[i];
+		image.pixels = PushPayloadFromFile(dataArena, assets.file, image.desc->location, filepath);
+	}
+
+	for (u32 i = 0; i < assets.meshCount; ++i)
+	{
+		BinMesh &mesh = assets.meshes[i];
+		mesh.data = PushPayloadFromFile(dataArena, assets.file, mesh.desc->location, filepath);
+	}
+
+	for (u32 i = 0; i < assets.roomCount; ++i)
+	{
+		BinRoom &room = assets.rooms[i];
+		for (u32 l = 0; l < room.desc->layerCount && l < ARRAY_COUNT(room.desc->layers); ++l)
+		{
+			const BinLocation &tiles = room.desc->layers[l].tiles;
+			if (tiles.size > 0)
+			{
+				room.tiles[l] = (TileDesc*)PushPayloadFromFile(dataArena, assets.file, tiles, filepath);
+			}
+		}
+	}
+
+	return assets;
+}
+
+bool ReadAssetPayload(File file, const BinLocation &location, void *bytes)
+{
+	const bool ok =
+		FileSeek(file, location.offset) &&
+		ReadFromFile(file, bytes, location.size) &&
+		CheckAssetPayload(location, bytes);
+	return ok;
+}
+
 void CloseAssets(BinAssets &assets)
 {
 	if ( assets.file.isOpen )
@@ -32,6 +32,14 @@ struct TextureDesc
 	const char *name;
 	const char *filename;
 	u8 mipmap;
+	u8 atlas; // Sprites using this texture are packed into atlas pages when building assets
+	AssetFlags flags;
+};
+
+struct MeshDesc
+{
+	const char *name;
+	const char *filename; // Wavefront OBJ file
 	AssetFlags flags;
 };
 
@@ -70,6 +78,7 @@ struct EntityDesc
 	// 3D entity
 	const char *materialName;
 	GeometryType geometryType;
+	const char *meshName; // Overrides geometryType
 	// Sprite entity
 	const char *spriteName;
 	i32 layer;
@@ -127,6 +136,9 @@ struct AssetDescriptors
 	TextureDesc *textureDescs;
 	u32 textureDescCount;
 
+	MeshDesc *meshDescs;
+	u32 meshDescCount;
+
 	SpriteDesc *spriteDescs;
 	u32 spriteDescCount;
 
@@ -153,6 +165,7 @@ void CompileShaders();
 bool CompileModifiedShaders();
 void SaveAssetDescriptors(const char *path, const AssetDescriptors &assetDescriptors);
 AssetDescriptors ParseDescriptors(const char *filepath, Arena &arena);
+void BenchmarkDescriptors(const char *filepath);
 #endif // USE_DATA_BUILD
 
 
@@ -168,6 +181,7 @@ struct BinLocation
 {
 	u32 offset;
 	u32 size;
+	u64 checksum; // HashXX64 of the payload bytes
 };
 
 struct BinShaderDesc
@@ -185,16 +199,38 @@ struct BinImageDesc
 	u16 height;
 	u8  channels;
 	u8  mipmap;
-	u16 unused;
+	u8  maxMipLevels; // 0 for the full mip chain
+	u8  unused;
 	BinLocation location;
 };
 
+enum AudioClipFormat : u32
+{
+	AudioClipFormat_PCM16, // Interleaved i16 samples
+	AudioClipFormat_ADPCM, // IMA-ADPCM blocks of stereo frames
+};
+
+// ADPCM blocks start with the decoder state of each channel, so any block can be
+// decoded on its own. Each byte after the headers holds the 4-bit codes of a
+// stereo frame, left channel in the low nibble. Only the last block of a clip
+// may have less frames.
+struct AudioAdpcmHeader
+{
+	i16 predictor;
+	u8 stepIndex;
+	u8 unused;
+};
+
+#define AUDIO_ADPCM_BLOCK_FRAMES 500u // Stereo frames per ADPCM block, the unit of decoding and seeking
+#define AUDIO_ADPCM_BLOCK_SIZE ( 2 * sizeof(AudioAdpcmHeader) + AUDIO_ADPCM_BLOCK_FRAMES )
+
 struct BinAudioClipDesc
 {
-	u32 sampleCount;
+	u32 sampleCount; // Decoded samples
 	u32 samplingRate;
-	u16 sampleSize;
+	u16 sampleSize;  // Of the decoded samples
 	u16 channelCount;
+	AudioClipFormat format;
 	BinLocation location;
 };
 
@@ -204,6 +240,28 @@ struct BinMusicFileDesc
 	BinLocation location;
 };
 
+// Mesh vertices are quantized within the bounds of their mesh
+struct BinMeshVertex
+{
+	u16 pos[3];      // unorm16 within [boundsMin, boundsMax]
+	i16 normal[2];   // snorm16 octahedral encoding
+	u16 texCoord[2]; // unorm16 within [texCoordMin, texCoordMax]
+	u16 _pad;
+};
+CT_ASSERT(sizeof(BinMeshVertex) == 16);
+
+struct BinMeshDesc
+{
+	const char *name;
+	float3 boundsMin;
+	float3 boundsMax;
+	float2 texCoordMin;
+	float2 texCoordMax;
+	u32 vertexCount;
+	u32 indexCount;
+	BinLocation location; // vertexCount BinMeshVertex followed by indexCount u16 indices
+};
+
 struct BinMaterialDesc
 {
 	const char *name;
@@ -229,6 +287,7 @@ struct BinEntityDesc
 	const char *name;
 	const char *materialName;
 	const char *spriteName;
+	const char *meshName;
 	float3 pos;
 	float scale;
 	i32 layer;
@@ -253,30 +312,81 @@ struct BinRoomDesc
 	BinLayerDesc layers[MAX_LAYERS];
 };
 
-constexpr u32 BinAssetsVersion = 1;
+constexpr u32 BinAssetsMagicNumber = 'I' | 'R' << 8 | 'I' << 16 | 'S' << 24;
+constexpr u32 BinAssetsVersion = 2;
+
+// The file is a header followed by a table of contents (TOC) of typed sections.
+// Readers look sections up by type and skip the ones they don't know, so new
+// asset types only add a section instead of changing the header layout.
+enum BinSectionType : u32
+{
+	BinSectionType_StringPool,
+	BinSectionType_ShaderDescs,
+	BinSectionType_ImageDescs,
+	BinSectionType_AudioClipDescs,
+	BinSectionType_MusicFileDescs,
+	BinSectionType_MaterialDescs,
+	BinSectionType_SpriteDescs,
+	BinSectionType_EntityDescs,
+	BinSectionType_RoomDescs,
+	BinSectionType_ShaderData,
+	BinSectionType_ImageData,
+	BinSectionType_AudioClipData,
+	BinSectionType_MusicFileData,
+	BinSectionType_TileData,
+	BinSectionType_MeshDescs,
+	BinSectionType_MeshData,
+	BinSectionType_COUNT,
+};
+
+struct BinSectionInfo
+{
+	const char *name;
+	u16 version;   // Bumped whenever the layout of the section contents changes
+	u16 alignment; // Alignment of the section and of every payload within it
+};
+
+// Image payloads are aligned for direct copies into GPU staging memory,
+// the rest to a cache line, so any section can be memory-mapped and used in place.
+constexpr BinSectionInfo BinSectionInfos[] = {
+	{ "StringPool",     1, 64 },
+	{ "ShaderDescs",    1, 64 },
+	{ "ImageDescs",     1, 64 },
+	{ "AudioClipDescs", 2, 64 },
+	{ "MusicFileDescs", 1, 64 },
+	{ "MaterialDescs",  1, 64 },
+	{ "SpriteDescs",    1, 64 },
+	{ "EntityDescs",    2, 64 },
+	{ "RoomDescs",      1, 64 },
+	{ "ShaderData",     1, 64 },
+	{ "ImageData",      1, 256 },
+	{ "AudioClipData",  2, 64 },
+	{ "MusicFileData",  1, 64 },
+	{ "TileData",       1, 64 },
+	{ "MeshDescs",      1, 64 },
+	{ "MeshData",       1, 64 },
+};
+CT_ASSERT(ARRAY_COUNT(BinSectionInfos) == BinSectionType_COUNT);
+
+struct BinSection
+{
+	BinSectionType type;
+	u16 version;
+	u16 alignment;
+	u32 offset;
+	u32 size;
+	u32 count;    // Number of descs or payloads in the section
+	u32 _pad;
+	u64 checksum; // HashXX64 of the whole section
+};
 
 struct BinAssetsHeader
 {
 	u32 magicNumber;
 	u32 version;
-	u32 shadersOffset;
-	u32 shaderCount;
-	u32 imagesOffset;
-	u32 imageCount;
-	u32 audioClipsOffset;
-	u32 audioClipCount;
-	u32 musicFilesOffset;
-	u32 musicFileCount;
-	u32 materialsOffset;
-	u32 materialCount;
-	u32 spritesOffset;
-	u32 spriteCount;
-	u32 entitiesOffset;
-	u32 entityCount;
-	u32 roomsOffset;
-	u32 roomCount;
-	u32 stringPoolOffset;
-	u32 stringPoolSize;
+	u32 sectionCount;
+	u32 tocOffset;
+	u64 tocChecksum; // HashXX64 of the sectionCount BinSection entries
 };
 
 struct BinShader
@@ -301,6 +411,12 @@ struct BinMusicFile
 	BinMusicFileDesc *desc;
 };
 
+struct BinMesh
+{
+	BinMeshDesc *desc;
+	byte *data;
+};
+
 struct BinMaterial
 {
 	BinMaterialDesc *desc;
@@ -330,9 +446,21 @@ struct BinAssets
 	File file;
 
 	BinAssetsHeader header;
+	BinSection sections[BinSectionType_COUNT];
+
+	u32 shaderCount;
+	u32 imageCount;
+	u32 meshCount;
+	u32 audioClipCount;
+	u32 musicFileCount;
+	u32 materialCount;
+	u32 spriteCount;
+	u32 entityCount;
+	u32 roomCount;
 
 	BinShader *shaders;
 	BinImage *images;
+	BinMesh *meshes;
 	BinAudioClip *audioClips;
 	BinMusicFile *musicFiles;
 	BinMaterial *materials;
@@ -345,9 +473,13 @@ struct BinAssets
 
 #if USE_DATA_BUILD
 void BuildAssets(const AssetDescriptors &assetDescriptors, const char *filepath, Arena tempArena);
+bool ImportMesh(Arena &arena, const char *filepath, BinMeshDesc &desc, byte *&data);
 #endif // USE_DATA_BUILD
 
 BinAssets OpenAssets(Arena &dataArena, const char *filepath);
+BinAssets OpenAssetDescriptors(Arena &dataArena, const char *filepath); // Payload pointers are left null
+bool ReadAssetPayload(File file, const BinLocation &location, void *bytes);
+bool CheckAssetPayload(const BinLocation &location, const void *bytes);
 void CloseAssets(BinAssets &assets);
 
 #endif // DATA_H
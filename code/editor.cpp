@@ -763,7 +763,7 @@ static void EditorUpdateUI_Inspector(Engine &engine)
 	UI_SetNextWindowDefaultDisplacement(ui, displacement);
 	UI_SetNextWindowAnchor(ui, {1, 0});
 
-	static u32 audioSourceIndex = U32_MAX;
+	static AudioVoiceH audioVoice = InvalidHandle;
 
 	const bool refresh =
 		inspector.selected.type != inspector.nextSelected.type ||
@@ -778,7 +778,7 @@ static void EditorUpdateUI_Inspector(Engine &engine)
 			RemoveTexture(engine.gfx, inspector.tmpHandle);
 		}
 		if (inspector.selected.type == EditorSelectedType_FileAudio) {
-			audioSourceIndex = U32_MAX;
+			audioVoice = InvalidHandle;
 			RemoveAudioClip(engine, inspector.tmpHandle);
 		}
 		if (inspector.selected.type == EditorSelectedType_FileMusic) {
@@ -866,11 +866,11 @@ static void EditorUpdateUI_Inspector(Engine &engine)
 			if (inspector.tmpHandle != InvalidHandle)
 			{
 				if (UI_Button(ui, "Play")) {
-					audioSourceIndex = PlayAudioClip(engine, inspector.tmpHandle);
+					audioVoice = PlayAudioClip(engine, inspector.tmpHandle);
 				}
 				if (UI_Button(ui, "Stop")) {
-					StopAudioSource(engine, audioSourceIndex);
-					audioSourceIndex = U32_MAX;
+					StopAudioVoice(engine, audioVoice);
+					audioVoice = InvalidHandle;
 				}
 			}
 		}
@@ -969,11 +969,11 @@ static void EditorUpdateUI_Inspector(Engine &engine)
 			if (inspector.selected.handle != InvalidHandle)
 			{
 				if (UI_Button(ui, "Play")) {
-					audioSourceIndex = PlayAudioClip(engine, inspector.selected.handle);
+					audioVoice = PlayAudioClip(engine, inspector.selected.handle);
 				}
 				if (UI_Button(ui, "Stop")) {
-					StopAudioSource(engine, audioSourceIndex);
-					audioSourceIndex = U32_MAX;
+					StopAudioVoice(engine, audioVoice);
+					audioVoice = InvalidHandle;
 				}
 			}
 		}
@@ -1035,6 +1035,104 @@ static void EditorUpdateUI_Inspector(Engine &engine)
 }
 
 #if USE_PROFILE
+struct FrameTimePercentiles
+{
+	f32 p50;
+	f32 p95;
+	f32 p99;
+	f32 max;
+};
+
+static FrameTimePercentiles GetFrameTimePercentiles(const f32 *millis, u32 count)
+{
+	FrameTimePercentiles percentiles = {};
+	if ( count == 0 )
+	{
+		return percentiles;
+	}
+
+	// Insertion sort, there are only a few samples
+	f32 sorted[FRAME_PACER_HISTORY];
+	ASSERT(count <= ARRAY_COUNT(sorted));
+	for (u32 i = 0; i < count; ++i)
+	{
+		u32 j = i;
+		for (; j > 0 && sorted[j - 1] > millis[i]; --j)
+		{
+			sorted[j] = sorted[j - 1];
+		}
+		sorted[j] = millis[i];
+	}
+
+	percentiles.p50 = sorted[( count - 1 ) * 50 / 100];
+	percentiles.p95 = sorted[( count - 1 ) * 95 / 100];
+	percentiles.p99 = sorted[( count - 1 ) * 99 / 100];
+	percentiles.max = sorted[count - 1];
+	return percentiles;
+}
+
+static void EditorUpdateUI_FramePacing(UI &ui, FramePacer &pacer)
+{
+	UI_BeginLayout(ui, UiLayoutHorizontal);
+	const char *targetNames[] = { "Uncapped", "30 Hz", "60 Hz", "120 Hz" };
+	const f32 targetMillis[] = { 0.0f, 1000.0f / 30.0f, 1000.0f / 60.0f, 1000.0f / 120.0f };
+	for (u32 i = 0; i < ARRAY_COUNT(targetNames); ++i) {
+		if ( UI_Radio(ui, targetNames[i], pacer.targetMillis == targetMillis[i]) ) {
+			pacer.targetMillis = targetMillis[i];
+		}
+	}
+	UI_EndLayout(ui);
+
+	UI_BeginLayout(ui, UiLayoutHorizontal);
+	const char *latencyNames[] = { "1 frame", "2 frames", "3 frames" };
+	CT_ASSERT(ARRAY_COUNT(latencyNames) == MAX_FRAMES_IN_FLIGHT);
+	for (u32 i = 0; i < ARRAY_COUNT(latencyNames); ++i) {
+		if ( UI_Radio(ui, latencyNames[i], pacer.frameLatency == i + 1) ) {
+			pacer.frameLatency = i + 1;
+		}
+	}
+	UI_EndLayout(ui);
+
+	// Copy the history in chronological order, oldest first
+	const u32 count = pacer.frameCount < FRAME_PACER_HISTORY ? (u32)pacer.frameCount : FRAME_PACER_HISTORY;
+	f32 cpuMillis[FRAME_PACER_HISTORY];
+	f32 gpuMillis[FRAME_PACER_HISTORY];
+	f32 presentMillis[FRAME_PACER_HISTORY];
+	f32 waitMillis[FRAME_PACER_HISTORY];
+	for (u32 i = 0; i < count; ++i)
+	{
+		const FrameTiming &timing = pacer.frames[( pacer.frameCount - count + i ) % FRAME_PACER_HISTORY];
+		cpuMillis[i] = timing.cpuMillis;
+		gpuMillis[i] = timing.gpuMillis;
+		presentMillis[i] = timing.presentMillis;
+		waitMillis[i] = timing.waitMillis;
+	}
+
+	// Present jitter as the standard deviation of the present intervals
+	f32 meanMillis = 0.0f;
+	for (u32 i = 0; i < count; ++i) {
+		meanMillis += presentMillis[i];
+	}
+	meanMillis = count > 0 ? meanMillis / count : 0.0f;
+	f32 variance = 0.0f;
+	for (u32 i = 0; i < count; ++i) {
+		variance += ( presentMillis[i] - meanMillis ) * ( presentMillis[i] - meanMillis );
+	}
+	variance = count > 0 ? variance / count : 0.0f;
+
+	const f32 graphMillis = 2.0f * ( pacer.targetMillis > 0.0f ? pacer.targetMillis : 1000.0f / 60.0f );
+	UI_Label(ui, "Present interval %.2f ms / %.00f fps, jitter %.2f ms", meanMillis, meanMillis > 0.0f ? 1000.0f / meanMillis : 0.0f, Sqrt(variance));
+	UI_Histogram(ui, presentMillis, count, graphMillis);
+
+	const char *names[] = { "Present", "CPU", "GPU", "Wait" };
+	const f32 *samples[] = { presentMillis, cpuMillis, gpuMillis, waitMillis };
+	for (u32 i = 0; i < ARRAY_COUNT(names); ++i)
+	{
+		const FrameTimePercentiles percentiles = GetFrameTimePercentiles(samples[i], count);
+		UI_Text(ui, names[i], "p50 %.2f  p95 %.2f  p99 %.2f  max %.2f ms", percentiles.p50, percentiles.p95, percentiles.p99, percentiles.max);
+	}
+}
+
 static void EditorUpdateUI_Profiler(Engine &engine)
 {
 	UI &ui = engine.ui;
@@ -1093,6 +1191,26 @@ static void EditorUpdateUI_Profiler(Engine &engine)
 		}
 	}
 
+	if ( UI_Section(ui, "Scene loading") )
+	{
+		const SceneLoader &loader = engine.sceneLoader;
+		const bool loading = IsLoadingScene(engine);
+		const f32 elapsedMillis = loading ?
+			1000.0f * GetSecondsElapsed(loader.beginClock, GetClock()) :
+			loader.totalMillis;
+		const f32 progress = loader.assetCount > 0 ? 100.0f * loader.timingCount / loader.assetCount : 100.0f;
+
+		UI_Label(ui, "%s: %u / %u assets (%.0f %%)", SceneLoadStageNames[loader.stage], loader.timingCount, loader.assetCount, progress);
+		UI_Label(ui, "Elapsed %.2f ms, max commit %.2f ms / frame", elapsedMillis, loader.maxFrameCommitMillis);
+
+		for (u32 i = 0; i < loader.timingCount; ++i)
+		{
+			const SceneLoadTiming &timing = loader.timings[i];
+			UI_Text(ui, timing.name ? timing.name : "<unnamed>", "%s read %.3f ms, commit %.3f ms",
+					SceneLoadStageNames[timing.stage], timing.readMillis, timing.commitMillis);
+		}
+	}
+
 	if ( UI_Section(ui, "Profiling" ) )
 	{
 		constexpr f32 maxExpectedMillis = 1000.0f / 60.0f; // Like expecting to reach 60 fps
@@ -1108,6 +1226,24 @@ static void EditorUpdateUI_Profiler(Engine &engine)
 		const TimeSamples &cpuTimes = gfx.cpuFrameTimes;
 		UI_Label(ui, "CPU %.02f ms / %.00f fps ", cpuTimes.average, 1000.0f / cpuTimes.average);
 		UI_Histogram(ui, cpuTimes.samples, ARRAY_COUNT(cpuTimes.samples), maxExpectedMillis + 1.0f);
+
+		UI_Label(ui, "Draw calls: %u, bind group switches: %u", gfx.drawCallCount, gfx.bindGroupSwitchCount);
+		UI_Label(ui, "Audio chunks streamed: %u, underruns: %u", engine.audio.streamer.loadedChunkCount, engine.audio.streamer.underrunCount);
+		UI_Label(ui, "Audio voices real: %u, virtual: %u, stolen: %u", engine.audio.realVoiceCount, engine.audio.virtualVoiceCount, engine.audio.stolenVoiceCount);
+
+		const AudioMusicRing &musicRing = engine.audio.musicRing;
+		const u32 musicFill = musicRing.sampleCount > 0 ? 100 * ( musicRing.writeIndex - musicRing.readIndex ) / musicRing.sampleCount : 0;
+		UI_Label(ui, "Music producer: %.3f ms (max %.3f ms), ring: %u %%, underruns: %u",
+				engine.audio.musicProducerMillis, engine.audio.maxMusicProducerMillis, musicFill, engine.audio.musicUnderrunCount);
+
+		const AudioBus *buses = engine.audio.buses;
+		UI_Label(ui, "Audio buses: music %.3f ms, sfx %.3f ms, reverb %.3f ms, master %.3f ms",
+				buses[AudioBus_Music].millis, buses[AudioBus_Sfx].millis, buses[AudioBus_Reverb].millis, buses[AudioBus_Master].millis);
+	}
+
+	if ( UI_Section(ui, "Frame pacing") )
+	{
+		EditorUpdateUI_FramePacing(ui, *sPlatform->framePacer);
 	}
 
 	if ( UI_Section(ui, "Memory") )
@@ -1125,10 +1261,26 @@ static void EditorUpdateUI_Profiler(Engine &engine)
 
 		const char *unitsStr = unitsStrArray[units];
 		const u32 unitsSize = unitsSizeArray[units];
-		UI_Label(ui, "- Global Arena: %u / %u %s", GlobalArena.used / unitsSize, GlobalArena.size / unitsSize, unitsStr);
-		UI_Label(ui, "- Frame Arena: %u / %u %s", FrameArena.used / unitsSize, FrameArena.size / unitsSize, unitsStr);
-		UI_Label(ui, "- String Arena: %u / %u %s", StringArena.used / unitsSize, StringArena.size / unitsSize, unitsStr);
-		UI_Label(ui, "- Data Arena: %u / %u %s", DataArena.used / unitsSize, DataArena.size / unitsSize, unitsStr);
+		UI_Label(ui, "- Global Arena: %llu / %llu %s", GlobalArena.used / unitsSize, GlobalArena.committed / unitsSize, unitsStr);
+		UI_Label(ui, "- Frame Arena: %llu / %llu %s", FrameArena.used / unitsSize, FrameArena.committed / unitsSize, unitsStr);
+		UI_Label(ui, "- String Arena: %llu / %llu %s", StringArena.used / unitsSize, StringArena.committed / unitsSize, unitsStr);
+		UI_Label(ui, "- Data Arena: %llu / %llu %s", DataArena.used / unitsSize, DataArena.committed / unitsSize, unitsStr);
+
+		// Scratch arenas are per thread, one per nesting level
+		const ScratchStacks &scratchStacks = *sPlatform->scratchStacks;
+		const u32 scratchThreadCount = Min(AtomicLoadAcquire(&scratchStacks.count), (u32)MAX_SCRATCH_THREADS);
+		for (u32 i = 0; i < scratchThreadCount; ++i)
+		{
+			const ScratchStack &stack = scratchStacks.stacks[i];
+			u64 highWater = 0;
+			u64 committed = 0;
+			for (u32 level = 0; level < SCRATCH_STACK_DEPTH; ++level) {
+				highWater = stack.highWater[level] > highWater ? stack.highWater[level] : highWater;
+				committed += stack.arenas[level].committed;
+			}
+			UI_Label(ui, "- Scratch %s: %llu / %llu %s, %u levels", stack.name ? stack.name : "Thread",
+					highWater / unitsSize, committed / unitsSize, unitsStr, stack.maxDepth);
+		}
 	}
 
 	UI_EndWindow(ui);
@@ -1956,7 +2108,7 @@ static void EditorProcessCommands(Engine &engine, Arena scratch)
 				case EditorCommandLoadBin:
 				{
 					CleanScene(engine);
-					LoadSceneFromBin(engine);
+					BeginLoadSceneFromBin(engine);
 					break;
 				}
 				case EditorCommandBuildBin:
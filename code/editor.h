@@ -162,6 +162,10 @@ struct Editor
 
 	FileNode *root;
 	FileNode *freeNodes;
+
+	// Hot reload of these directories follows the platform file changes, else they are polled
+	bool watchingShaders;
+	bool watchingAssets;
 };
 
 struct Engine;
@@ -11,6 +11,7 @@
 #define USE_EDITOR ( PLATFORM_LINUX || PLATFORM_WINDOWS )
 #define USE_UI ( PLATFORM_LINUX || PLATFORM_WINDOWS )
 #define USE_DATA_BUILD ( PLATFORM_LINUX || PLATFORM_WINDOWS )
+#define USE_ASSET_CHECKSUMS DEVELOPMENT_BUILD
 
 #if USE_UI
 
@@ -70,6 +71,7 @@ struct Engine
 
 	BinAssets shaderAssets;
 	BinAssets assets;
+	SceneLoader sceneLoader;
 
 	Arena dataArenaStates[1];
 	u32 dataArenaStateCount;
@@ -685,7 +687,7 @@ static StagedData StageData(Graphics &gfx, const void *data, u32 size, u32 align
 
 	Heap &stagingHeap = gfx.device.heaps[HeapType_Staging];
 	void* stagingData = stagingHeap.data + staging.offset;
-	MemCopy(stagingData, data, size);
+	MemCopyToDevice(stagingData, data, size);
 
 	gfx.stagingBufferOffset = staging.offset + size;
 
@@ -787,14 +789,15 @@ void GenerateMipmaps(const GraphicsDevice &device, const CommandList &commandLis
 	TransitionImageLayout(commandList, imageH, ImageStateTransferDst, ImageStateShaderInput, image.mipLevels - 1, 1);
 }
 
-ImageH EngineCreateImage(Graphics &gfx, const char *name, int width, int height, int channels, bool mipmap, const byte *pixels)
+ImageH EngineCreateImage(Graphics &gfx, const char *name, int width, int height, int channels, bool mipmap, const byte *pixels, u32 maxMipLevels)
 {
 	const u32 pixelSize = channels * sizeof(byte);
 	const u32 size = width * height * pixelSize;
 	const u32 alignment = channels == 1 ? 1 : 4;
 
+	const u32 fullMipLevels = static_cast<uint32_t>(Floor(Log2(Max(width, height)))) + 1;
 	const u32 mipLevels = mipmap ?
-		static_cast<uint32_t>(Floor(Log2(Max(width, height)))) + 1 :
+		( maxMipLevels > 0 ? Min(fullMipLevels, maxMipLevels) : fullMipLevels ) :
 		1;
 
 	ASSERT(channels >= 1 && channels <= 4);
@@ -837,6 +840,12 @@ ImageH EngineCreateImage(Graphics &gfx, const char *name, int width, int height,
 	return image;
 }
 
+ImageH EngineCreateImage(Graphics &gfx, const char *name, int width, int height, int channels, bool mipmap, const byte *pixels)
+{
+	const ImageH image = EngineCreateImage(gfx, name, width, height, channels, mipmap, pixels, 0);
+	return image;
+}
+
 ImageH EngineCreateImage(Graphics &gfx, const ImagePixels &img, const char *name, bool createMipmaps)
 {
 	const ImageH imageHandle = EngineCreateImage(gfx, name, img.width, img.height, img.channelCount, createMipmaps, img.pixels);
@@ -945,7 +954,7 @@ TextureH CreateTexture(Graphics &gfx, const BinImage &binImage)
 	const u32 mipmap = desc.mipmap;
 	const u8 *pixels = binImage.pixels;
 
-	const ImageH imageHandle = EngineCreateImage(gfx, name, width, height, channels, mipmap, pixels);
+	const ImageH imageHandle = EngineCreateImage(gfx, name, width, height, channels, mipmap, pixels, desc.maxMipLevels);
 
 	const TextureH textureHandle = CreateTexture(gfx);
 
@@ -954,6 +963,7 @@ TextureH CreateTexture(Graphics &gfx, const BinImage &binImage)
 	Texture &texture = GetTexture(gfx, textureHandle);
 	texture.name = desc.name;
 	texture.image = imageHandle;
+	texture.size = { width, height };
 
 	return textureHandle;
 }
@@ -1005,9 +1015,16 @@ void RemoveTexture(Graphics &gfx, TextureH textureH)
 	}
 }
 
+struct TextureReloadContext
+{
+	Engine *engine;
+	const FileChanges *changes;
+};
+
 static void RecreateTextureIfModifed(Handle handle, void* data)
 {
-	Engine &engine = *(Engine*)data;
+	const TextureReloadContext &context = *(TextureReloadContext*)data;
+	Engine &engine = *context.engine;
 	Graphics &gfx = engine.gfx;
 
 	Texture &texture = GetTexture(gfx, handle);
@@ -1018,6 +1035,16 @@ static void RecreateTextureIfModifed(Handle handle, void* data)
 
 	const FilePath imagePath = MakePath(AssetDir, desc.filename);
 
+	if ( context.changes )
+	{
+		bool changed = false;
+		for (u32 i = 0; i < context.changes->count && !changed; ++i)
+		{
+			changed = StrEq(context.changes->paths[i], imagePath.str);
+		}
+		if ( !changed ) { return; }
+	}
+
 	u64 ts;
 	GetFileLastWriteTimestamp(imagePath.str, ts);
 
@@ -1043,9 +1070,159 @@ static void RecreateTextureIfModifed(Handle handle, void* data)
 	}
 }
 
-void RecreateModifiedTextures(Engine &engine)
+// Checks the textures among the file changes, or all of them if changes is null
+void RecreateModifiedTextures(Engine &engine, const FileChanges *changes)
 {
-	ForAllHandles(engine.gfx.textureHandles, RecreateTextureIfModifed, &engine);
+	TextureReloadContext context = {
+		.engine = &engine,
+		.changes = changes,
+	};
+	ForAllHandles(engine.gfx.textureHandles, RecreateTextureIfModifed, &context);
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// Mesh management
+
+Mesh &GetMesh(Graphics &gfx, MeshH handle)
+{
+	ASSERT( IsValidHandle(gfx.meshHandles, handle) );
+	Mesh &mesh = gfx.meshes[handle.idx];
+	return mesh;
+}
+
+MeshDesc &GetMeshDesc(Graphics &gfx, MeshH handle)
+{
+	ASSERT( IsValidHandle(gfx.meshHandles, handle) );
+	MeshDesc &meshDesc = gfx.meshDescs[handle.idx];
+	return meshDesc;
+}
+
+static f32 DequantizeUnorm16(u16 value, f32 min, f32 max)
+{
+	const f32 res = min + ( max - min ) * ( value / 65535.0f );
+	return res;
+}
+
+static float3 OctahedralDecode(i16 x, i16 y)
+{
+	float3 n = { Max(x / 32767.0f, -1.0f), Max(y / 32767.0f, -1.0f), 0.0f };
+	n.z = 1.0f - ( n.x < 0.0f ? -n.x : n.x ) - ( n.y < 0.0f ? -n.y : n.y );
+	const f32 t = Max(-n.z, 0.0f);
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+	return NormalizeIfNotZero(n);
+}
+
+// Vertices are stored quantized in the assets, and expanded to the Vertex layout all pipelines use
+MeshH CreateMesh(Graphics &gfx, const BinMeshDesc &desc, const byte *data)
+{
+	const u32 verticesSize = desc.vertexCount * sizeof(Vertex);
+	const u32 indicesSize = desc.indexCount * sizeof(Index);
+	const u32 vertexBufferSize = GetBufferConst(gfx.device, gfx.globalVertexArena.buffer).size;
+	const u32 indexBufferSize = GetBufferConst(gfx.device, gfx.globalIndexArena.buffer).size;
+	if ( gfx.globalVertexArena.used + verticesSize > vertexBufferSize ||
+		gfx.globalIndexArena.used + indicesSize > indexBufferSize )
+	{
+		LOG(Error, "Not enough space in the geometry buffers for mesh %s\n", desc.name);
+		return InvalidHandle;
+	}
+
+	Scratch scratch(Max(verticesSize, MB(1)));
+	Vertex *vertices = PushArray(scratch.arena, Vertex, desc.vertexCount);
+
+	const BinMeshVertex *binVertices = (const BinMeshVertex*)data;
+	for (u32 i = 0; i < desc.vertexCount; ++i)
+	{
+		const BinMeshVertex &v = binVertices[i];
+		vertices[i].pos = {
+			DequantizeUnorm16(v.pos[0], desc.boundsMin.x, desc.boundsMax.x),
+			DequantizeUnorm16(v.pos[1], desc.boundsMin.y, desc.boundsMax.y),
+			DequantizeUnorm16(v.pos[2], desc.boundsMin.z, desc.boundsMax.z),
+		};
+		vertices[i].normal = OctahedralDecode(v.normal[0], v.normal[1]);
+		vertices[i].texCoord = {
+			DequantizeUnorm16(v.texCoord[0], desc.texCoordMin.x, desc.texCoordMax.x),
+			DequantizeUnorm16(v.texCoord[1], desc.texCoordMin.y, desc.texCoordMax.y),
+		};
+	}
+
+	const Index *indices = (const Index*)(data + desc.vertexCount * sizeof(BinMeshVertex));
+
+	const MeshH meshHandle = NewHandle(gfx.meshHandles);
+	ZeroStruct( &gfx.meshDescs[meshHandle.idx] );
+
+	Mesh &mesh = GetMesh(gfx, meshHandle);
+	mesh.name = desc.name;
+	mesh.boundsMin = desc.boundsMin;
+	mesh.boundsMax = desc.boundsMax;
+
+	CommandList commandList = BeginUploadCommandList(gfx);
+	mesh.vertices = PushData(gfx, commandList, gfx.globalVertexArena, vertices, verticesSize);
+	mesh.indices = PushData(gfx, commandList, gfx.globalIndexArena, indices, indicesSize);
+	EndUploadCommandList(gfx, commandList);
+
+	return meshHandle;
+}
+
+MeshH CreateMesh(Graphics &gfx, const BinMesh &binMesh)
+{
+	const MeshH meshHandle = CreateMesh(gfx, *binMesh.desc, binMesh.data);
+	return meshHandle;
+}
+
+#if USE_DATA_BUILD
+MeshH CreateMesh(Graphics &gfx, const MeshDesc &desc)
+{
+	MeshH meshHandle = InvalidHandle;
+
+	Scratch scratch(MB(64));
+	const FilePath meshPath = MakePath(AssetDir, desc.filename);
+	BinMeshDesc binDesc;
+	byte *data;
+	if ( ImportMesh(scratch.arena, meshPath.str, binDesc, data) )
+	{
+		binDesc.name = desc.name;
+		meshHandle = CreateMesh(gfx, binDesc, data);
+		if ( IsValidHandle(gfx.meshHandles, meshHandle) ) {
+			gfx.meshDescs[meshHandle.idx] = desc;
+		}
+	}
+
+	return meshHandle;
+}
+#endif // USE_DATA_BUILD
+
+static bool IsMeshName( Handle handle, const char *name, void *data )
+{
+	Graphics &gfx = *(Graphics*)data;
+	Mesh &mesh = GetMesh(gfx, handle);
+	const bool equals = StrEq(mesh.name, name);
+	return equals;
+}
+
+MeshH FindMeshHandle(Graphics &gfx, const char *name)
+{
+	if (!name) return InvalidHandle;
+	const HandleFinder finder = {
+		.checkHandle = IsMeshName,
+		.name = name,
+		.data = &gfx,
+	};
+	const MeshH handle = FindHandle(gfx.meshHandles, finder);
+	return handle;
+}
+
+// Geometry buffer space is only reclaimed when cleaning the whole scene
+void RemoveMesh(Graphics &gfx, MeshH meshH)
+{
+	if (IsValidHandle(gfx.meshHandles, meshH))
+	{
+		Mesh &mesh = GetMesh(gfx, meshH);
+		mesh = {};
+
+		FreeHandle(gfx.meshHandles, meshH);
+	}
 }
 
 
@@ -1323,6 +1500,9 @@ EntityDesc GetEntityDesc(Scene &scene, Handle handle)
 		const Material &material = GetMaterial(engine->gfx, entity.materialH);
 		entityDesc.materialName = material.name;
 		entityDesc.geometryType = entity.geometryType;
+		if (IsValidHandle(engine->gfx.meshHandles, entity.meshH)) {
+			entityDesc.meshName = GetMesh(engine->gfx, entity.meshH).name;
+		}
 	}
 	return entityDesc;
 }
@@ -1334,6 +1514,14 @@ Handle CreateEntity(Engine &engine, const EntityDesc &desc)
 	BufferChunk vertices = GetVerticesForGeometryType(engine.gfx, desc.geometryType);
 	BufferChunk indices = GetIndicesForGeometryType(engine.gfx, desc.geometryType);
 
+	const MeshH meshH = FindMeshHandle(engine.gfx, desc.meshName);
+	if ( IsValidHandle(engine.gfx.meshHandles, meshH) )
+	{
+		const Mesh &mesh = GetMesh(engine.gfx, meshH);
+		vertices = mesh.vertices;
+		indices = mesh.indices;
+	}
+
 	Handle handle = NewHandle(scene.entityHandles);
 	Entity &entity = GetEntity(scene, handle);
 	entity.name = desc.name;
@@ -1342,6 +1530,7 @@ Handle CreateEntity(Engine &engine, const EntityDesc &desc)
 	entity.scale = desc.scale;
 	entity.layer = desc.layer;
 	entity.geometryType = desc.geometryType;
+	entity.meshH = meshH;
 	entity.vertices = vertices;
 	entity.indices = indices;
 	entity.materialH = FindMaterialHandle(engine.gfx, desc.materialName);
@@ -1356,6 +1545,7 @@ Handle CreateEntity(Engine &engine, const BinEntityDesc &desc)
 		.name = desc.name,
 		.materialName = desc.materialName,
 		.geometryType = desc.geometryType,
+		.meshName = desc.meshName,
 		.spriteName = desc.spriteName,
 		.layer = desc.layer,
 		.pos = desc.pos,
@@ -1724,7 +1914,7 @@ static ShaderSource GetShaderSource(BinAssets &assets, const char *shaderName)
 {
 	byte *bytes = 0;
 	u32 size = 0;
-	for (u32 i = 0; i < assets.header.shaderCount; ++i)
+	for (u32 i = 0; i < assets.shaderCount; ++i)
 	{
 		BinShader &loadedShader = assets.shaders[i];
 		if ( StrEq( loadedShader.desc->name, shaderName) )
@@ -1736,7 +1926,7 @@ static ShaderSource GetShaderSource(BinAssets &assets, const char *shaderName)
 	if ( !bytes ) {
 		LOG( Error, "Could not find shader in assets: %s\n", shaderName );
 		LOG( Error, "Shaders in assets:\n");
-		for (u32 i = 0; i < assets.header.shaderCount; ++i)
+		for (u32 i = 0; i < assets.shaderCount; ++i)
 		{
 			BinShader &loadedShader = assets.shaders[i];
 			LOG( Error, "- %s\n", loadedShader.desc->name);
@@ -1982,6 +2172,8 @@ bool InitializeGraphics(Engine &engine, Arena &globalArena)
 	gfx.spriteIndices = PushData(gfx, commandList, gfx.globalIndexArena, spriteIndices, sizeof(spriteIndices));
 	gfx.screenTriangleVertices = PushData(gfx, commandList, gfx.globalVertexArena, screenTriangleVertices, sizeof(screenTriangleVertices));
 	gfx.screenTriangleIndices = PushData(gfx, commandList, gfx.globalIndexArena, screenTriangleIndices, sizeof(screenTriangleIndices));
+	gfx.sceneVertexArenaBase = gfx.globalVertexArena.used;
+	gfx.sceneIndexArenaBase = gfx.globalIndexArena.used;
 
 	EndUploadCommandList(gfx, commandList);
 
@@ -2097,6 +2289,7 @@ bool InitializeGraphics(Engine &engine, Arena &globalArena)
 
 	// Handle managers
 	Initialize(gfx.textureHandles, globalArena, MAX_TEXTURES);
+	Initialize(gfx.meshHandles, globalArena, MAX_MESHES);
 	Initialize(gfx.materialHandles, globalArena, MAX_MATERIALS);
 
 	// Graphics pipelines
@@ -2330,6 +2523,15 @@ AssetDescriptors GetAssetDescriptors(Engine &engine, Arena &arena)
 		}
 	}
 
+	static MeshDesc meshDescs[MAX_MESHES];
+	u32 meshCount = 0;
+	for (HandleIter it = BeginIter(engine.gfx.meshHandles); it; it++) {
+		meshDescs[meshCount] = GetMeshDesc(engine.gfx, *it);
+		if ( meshDescs[meshCount].filename && !( meshDescs[meshCount].flags & AssetFlag_Builtin ) ) {
+			meshCount++;
+		}
+	}
+
 	static SpriteDesc spriteDescs[MAX_SPRITES];
 	static u16 spriteIndexByHandleIdx[MAX_SPRITES];
 	u32 spriteCount = 0;
@@ -2389,7 +2591,7 @@ AssetDescriptors GetAssetDescriptors(Engine &engine, Arena &arena)
 		}
 	}
 
-	static AudioClipDesc audioClipDescs[MAX_AUDIO_CLIPS];
+	AudioClipDesc *audioClipDescs = PushArray(arena, AudioClipDesc, engine.audio.clipHandles.handleCount);
 	u32 audioClipCount = 0;
 	for (HandleIter it = BeginIter(engine.audio.clipHandles); it; it++) {
 		audioClipDescs[audioClipCount] = GetAudioClipDesc(engine.audio, *it);
@@ -2400,6 +2602,8 @@ AssetDescriptors GetAssetDescriptors(Engine &engine, Arena &arena)
 		.shaderDescCount = 0, //ARRAY_COUNT(shaderSourceDescs),
 		.textureDescs = textureDescs,
 		.textureDescCount = textureCount,
+		.meshDescs = meshDescs,
+		.meshDescCount = meshCount,
 		.spriteDescs = spriteDescs,
 		.spriteDescCount = spriteCount,
 		.materialDescs = materialDescs,
@@ -2460,6 +2664,12 @@ void LoadSceneFromTxt(Engine &engine, const char *filepath)
 			CreateTexture(engine.gfx, assetDescriptors.textureDescs[i]);
 		}
 
+		// Meshes (must be before entities)
+		for (u32 i = 0; i < assetDescriptors.meshDescCount; ++i)
+		{
+			CreateMesh(engine.gfx, assetDescriptors.meshDescs[i]);
+		}
+
 		// Materials
 		for (u32 i = 0; i < assetDescriptors.materialDescCount; ++i)
 		{
@@ -2520,62 +2730,354 @@ void LoadShadersFromBin(Engine &engine)
 	engine.shaderAssets = OpenAssets(DataArena, filepath.str);
 }
 
-void LoadSceneFromBin(Engine &engine)
+////////////////////////////////////////////////////////////////////////
+// Scene loading
+
+static const char *SceneLoadStageNames[] = {
+	"Idle",
+	"Textures",
+	"Meshes",
+	"Materials",
+	"Sprites",
+	"Entities",
+	"Rooms",
+	"AudioClips",
+	"MusicFiles",
+	"Finish",
+};
+CT_ASSERT(ARRAY_COUNT(SceneLoadStageNames) == SceneLoadStage_COUNT);
+
+static WORK_QUEUE_CALLBACK(SceneLoadJobCallback)
 {
-	if (PushDataArenaState(engine))
+	SceneLoadJob &job = *(SceneLoadJob*)data;
+
+	// Jobs cancelled before being picked up, or already run from a stale queue entry
+	if ( !AtomicSwap(&job.state, SceneLoadJobState_Pending, SceneLoadJobState_Running) ) {
+		return;
+	}
+
+	ProfileRegisterThread("Worker");
+
+	SceneLoader &loader = *job.loader;
+
 	{
-		const FilePath filepath = MakePath(DataDir, "assets.dat");
-		engine.assets = OpenAssets(DataArena, filepath.str);
+		PROFILE_BLOCK(SceneLoadJob);
 
-		// Textures
-		for (u32 i = 0; i < engine.assets.header.imageCount; ++i)
+		File file = OpenFile(loader.filepath.str, FileModeRead);
+
+		for (u32 i = job.firstPayload; i < loader.payloadCount && !loader.cancelled; i += loader.jobCount)
 		{
-			CreateTexture(engine.gfx, engine.assets.images[i]);
+			SceneLoadPayload &payload = loader.payloads[i];
+
+			const Clock begin = GetClock();
+			const bool ok = file.isOpen && ReadAssetPayload(file, *payload.location, payload.bytes);
+			payload.readMillis = 1000.0f * GetSecondsElapsed(begin, GetClock());
+			payload.failed = ok ? 0 : 1;
+
+			FullWriteBarrier();
+			payload.loaded = 1;
 		}
 
-		// Materials
-		for (u32 i = 0; i < engine.assets.header.materialCount; ++i)
+		CloseFile(file);
+	}
+
+	// Each job is a profiler frame on the worker thread
+	ProfileFlush();
+
+	FullWriteBarrier();
+	job.state = SceneLoadJobState_Finished;
+}
+
+static u32 SceneLoadStageAssetCount(const BinAssets &assets, SceneLoadStage stage)
+{
+	const u32 count =
+		stage == SceneLoadStage_Textures ? assets.imageCount :
+		stage == SceneLoadStage_Meshes ? assets.meshCount :
+		stage == SceneLoadStage_Materials ? assets.materialCount :
+		stage == SceneLoadStage_Sprites ? assets.spriteCount :
+		stage == SceneLoadStage_Entities ? assets.entityCount :
+		stage == SceneLoadStage_Rooms ? assets.roomCount :
+		stage == SceneLoadStage_AudioClips ? assets.audioClipCount :
+		stage == SceneLoadStage_MusicFiles ? assets.musicFileCount :
+		0;
+	return count;
+}
+
+static bool SceneLoadPayloadReady(const SceneLoader &loader, u32 payloadIndex, f32 &readMillis)
+{
+	const SceneLoadPayload &payload = loader.payloads[payloadIndex];
+	if ( !payload.loaded ) {
+		return false;
+	}
+
+	FullReadBarrier();
+
+	if ( payload.failed )
+	{
+		LOG( Error, "Could not load payload at offset %u from file %s. Rebuild the data files.\n", payload.location->offset, loader.filepath.str );
+		QUIT_ABNORMALLY();
+	}
+
+	readMillis += payload.readMillis;
+	return true;
+}
+
+// Commits the next asset of the current stage. Returns false if its payload is still being read.
+static bool SceneLoadCommitAsset(Engine &engine, SceneLoader &loader, SceneLoadTiming &timing)
+{
+	const BinAssets &assets = engine.assets;
+	const u32 i = loader.stageIndex;
+
+	switch (loader.stage)
+	{
+		case SceneLoadStage_Textures:
 		{
-			CreateMaterial(engine.gfx, *engine.assets.materials[i].desc);
+			if ( !SceneLoadPayloadReady(loader, i, timing.readMillis) ) {
+				return false;
+			}
+			timing.name = assets.images[i].desc->name;
+			CreateTexture(engine.gfx, assets.images[i]);
+			break;
 		}
-
-		// Sprites (must be before entities and rooms)
-		static SpriteH spriteHandles[MAX_SPRITES];
-		for (u32 i = 0; i < engine.assets.header.spriteCount; ++i)
+		case SceneLoadStage_Meshes:
 		{
-			spriteHandles[i] = CreateSprite(engine, *engine.assets.sprites[i].desc);
+			if ( !SceneLoadPayloadReady(loader, assets.imageCount + i, timing.readMillis) ) {
+				return false;
+			}
+			timing.name = assets.meshes[i].desc->name;
+			CreateMesh(engine.gfx, assets.meshes[i]);
+			break;
 		}
-
-		// Entities
-		for (u32 i = 0; i < engine.assets.header.entityCount; ++i)
+		case SceneLoadStage_Materials:
 		{
-			CreateEntity(engine, *engine.assets.entities[i].desc);
+			timing.name = assets.materials[i].desc->name;
+			CreateMaterial(engine.gfx, *assets.materials[i].desc);
+			break;
 		}
-
-		// Rooms (grid cells reference sprites by index into the sprite list)
-		if (engine.assets.header.roomCount > 0)
+		case SceneLoadStage_Sprites:
+		{
+			timing.name = assets.sprites[i].desc->name;
+			loader.spriteHandles[i] = CreateSprite(engine, *assets.sprites[i].desc);
+			break;
+		}
+		case SceneLoadStage_Entities:
+		{
+			timing.name = assets.entities[i].desc->name;
+			CreateEntity(engine, *assets.entities[i].desc);
+			break;
+		}
+		case SceneLoadStage_Rooms:
 		{
-			for (u32 i = 0; i < engine.assets.header.roomCount; ++i)
+			const BinRoom &room = assets.rooms[i];
+			const u32 layerCount = Min(room.desc->layerCount, (u32)MAX_LAYERS);
+			const u32 firstPayload = loader.roomFirstPayload[i];
+			for (u32 l = 0; l < layerCount; ++l)
 			{
-				CreateRoom(engine, engine.assets.rooms[i], spriteHandles, engine.assets.header.spriteCount);
+				if ( !SceneLoadPayloadReady(loader, firstPayload + l, timing.readMillis) ) {
+					timing.readMillis = 0.0f;
+					return false;
+				}
 			}
+			timing.name = room.desc->name;
+			CreateRoom(engine, room, loader.spriteHandles, assets.spriteCount);
+			break;
+		}
+		case SceneLoadStage_AudioClips:
+		{
+			timing.name = "AudioClip";
+			CreateAudioClip(engine, assets.audioClips[i]);
+			break;
+		}
+		case SceneLoadStage_MusicFiles:
+		{
+			timing.name = assets.musicFiles[i].desc->name;
+			CreateMusicFile(engine, assets.musicFiles[i]);
+			break;
 		}
+		default:
+		{
+			INVALID_CODE_PATH();
+		}
+	}
 
-		// Audio clips
-		for (u32 i = 0; i < engine.assets.header.audioClipCount; ++i)
+	return true;
+}
+
+void BeginLoadSceneFromBin(Engine &engine)
+{
+	SceneLoader &loader = engine.sceneLoader;
+	ASSERT(loader.stage == SceneLoadStage_Idle);
+
+	if ( !PushDataArenaState(engine) ) {
+		return;
+	}
+
+	Arena &dataArena = DataArena;
+
+	loader.stage = SceneLoadStage_Idle;
+	loader.stageIndex = 0;
+	loader.filepath = MakePath(DataDir, "assets.dat");
+	loader.cancelled = 0;
+	loader.timingCount = 0;
+	loader.totalMillis = 0.0f;
+	loader.maxFrameCommitMillis = 0.0f;
+	loader.beginClock = GetClock();
+
+	engine.assets = OpenAssetDescriptors(dataArena, loader.filepath.str);
+	BinAssets &assets = engine.assets;
+
+	// Before any audio clip of the scene exists
+	SetAudioAssetsFilepath(engine.audio, loader.filepath.str);
+
+	// Payload memory is reserved up front so that worker jobs never touch the arena
+	u32 payloadCount = assets.imageCount + assets.meshCount;
+	loader.roomFirstPayload = PushArray(dataArena, u32, assets.roomCount);
+	for (u32 i = 0; i < assets.roomCount; ++i)
+	{
+		loader.roomFirstPayload[i] = payloadCount;
+		payloadCount += Min(assets.rooms[i].desc->layerCount, (u32)MAX_LAYERS);
+	}
+
+	loader.payloads = PushZeroArray(dataArena, SceneLoadPayload, payloadCount);
+	loader.payloadCount = payloadCount;
+
+	for (u32 i = 0; i < assets.imageCount; ++i)
+	{
+		BinImage &image = assets.images[i];
+		SceneLoadPayload &payload = loader.payloads[i];
+		payload.location = &image.desc->location;
+		payload.bytes = PushArray(dataArena, byte, payload.location->size);
+		image.pixels = payload.bytes;
+	}
+
+	for (u32 i = 0; i < assets.meshCount; ++i)
+	{
+		BinMesh &mesh = assets.meshes[i];
+		SceneLoadPayload &payload = loader.payloads[assets.imageCount + i];
+		payload.location = &mesh.desc->location;
+		payload.bytes = PushArray(dataArena, byte, payload.location->size);
+		mesh.data = payload.bytes;
+	}
+
+	for (u32 i = 0; i < assets.roomCount; ++i)
+	{
+		BinRoom &room = assets.rooms[i];
+		const u32 layerCount = Min(room.desc->layerCount, (u32)MAX_LAYERS);
+		for (u32 l = 0; l < layerCount; ++l)
 		{
-			CreateAudioClip(engine, engine.assets.audioClips[i]);
+			SceneLoadPayload &payload = loader.payloads[loader.roomFirstPayload[i] + l];
+			payload.location = &room.desc->layers[l].tiles;
+			payload.bytes = payload.location->size > 0 ? PushArray(dataArena, byte, payload.location->size) : nullptr;
+			room.tiles[l] = (TileDesc*)payload.bytes;
 		}
+	}
 
-		// Music files
-		for (u32 i = 0; i < engine.assets.header.musicFileCount; ++i)
+	loader.assetCount = 0;
+	for (u32 stage = 0; stage < SceneLoadStage_COUNT; ++stage) {
+		loader.assetCount += SceneLoadStageAssetCount(assets, (SceneLoadStage)stage);
+	}
+	loader.timings = PushZeroArray(dataArena, SceneLoadTiming, loader.assetCount);
+
+	// Payloads are interleaved among jobs so that the first ones to be committed arrive first
+	loader.jobCount = Min(payloadCount, (u32)MAX_SCENE_LOAD_JOBS);
+	for (u32 j = 0; j < loader.jobCount; ++j)
+	{
+		SceneLoadJob &job = loader.jobs[j];
+		job.loader = &loader;
+		job.firstPayload = j;
+		job.state = SceneLoadJobState_Pending;
+		PushWork(SceneLoadJobCallback, &job);
+	}
+
+	loader.stage = SceneLoadStage_Textures;
+}
+
+// Commits loaded assets until the frame budget is spent. Returns true while loading.
+bool UpdateSceneLoading(Engine &engine)
+{
+	SceneLoader &loader = engine.sceneLoader;
+	if ( loader.stage == SceneLoadStage_Idle ) {
+		return false;
+	}
+
+	PROFILE_BLOCK(SceneLoadCommit);
+
+	const Clock frameBegin = GetClock();
+
+	while ( loader.stage != SceneLoadStage_Idle )
+	{
+		const Clock assetBegin = GetClock();
+		if ( GetSecondsElapsed(frameBegin, assetBegin) > SCENE_LOAD_BUDGET_SECONDS ) {
+			break;
+		}
+
+		if ( loader.stageIndex >= SceneLoadStageAssetCount(engine.assets, loader.stage) )
 		{
-			CreateMusicFile(engine, engine.assets.musicFiles[i]);
+			if ( loader.stage == SceneLoadStage_Finish )
+			{
+				UploadMaterialData(engine.gfx);
+				LinkHandles(engine.gfx);
+
+				loader.totalMillis = 1000.0f * GetSecondsElapsed(loader.beginClock, GetClock());
+				loader.stage = SceneLoadStage_Idle;
+				LOG(Info, "Scene loaded in %.2f ms (%u assets, %.2f ms max commit per frame)\n",
+						loader.totalMillis, loader.timingCount, loader.maxFrameCommitMillis);
+			}
+			else
+			{
+				loader.stage = (SceneLoadStage)(loader.stage + 1);
+				loader.stageIndex = 0;
+			}
+			continue;
 		}
 
-		UploadMaterialData(engine.gfx);
-		LinkHandles(engine.gfx);
+		SceneLoadTiming timing = { .stage = loader.stage };
+		if ( !SceneLoadCommitAsset(engine, loader, timing) ) {
+			break; // Waiting for workers
+		}
+
+		timing.commitMillis = 1000.0f * GetSecondsElapsed(assetBegin, GetClock());
+		ASSERT(loader.timingCount < loader.assetCount);
+		loader.timings[loader.timingCount++] = timing;
+		loader.stageIndex++;
 	}
+
+	const f32 frameMillis = 1000.0f * GetSecondsElapsed(frameBegin, GetClock());
+	loader.maxFrameCommitMillis = Max(loader.maxFrameCommitMillis, frameMillis);
+
+	return loader.stage != SceneLoadStage_Idle;
+}
+
+bool IsLoadingScene(const Engine &engine)
+{
+	const bool loading = engine.sceneLoader.stage != SceneLoadStage_Idle;
+	return loading;
+}
+
+void CancelSceneLoading(Engine &engine)
+{
+	SceneLoader &loader = engine.sceneLoader;
+	if ( loader.stage == SceneLoadStage_Idle ) {
+		return;
+	}
+
+	loader.cancelled = 1;
+	FullWriteBarrier();
+
+	for (u32 j = 0; j < loader.jobCount; ++j)
+	{
+		SceneLoadJob &job = loader.jobs[j];
+
+		// Jobs still in the queue are retired here, running ones stop after their current payload
+		if ( !AtomicSwap(&job.state, SceneLoadJobState_Pending, SceneLoadJobState_Finished) )
+		{
+			while ( job.state != SceneLoadJobState_Finished ) {
+				Yield();
+			}
+		}
+	}
+
+	loader.stage = SceneLoadStage_Idle;
 }
 
 void CleanTexture(Handle handle, void* data)
@@ -2587,6 +3089,15 @@ void CleanTexture(Handle handle, void* data)
 	}
 }
 
+void CleanMesh(Handle handle, void* data)
+{
+	Engine &engine = *(Engine*)data;
+	const MeshDesc &desc = GetMeshDesc( engine.gfx, handle);
+	if ( !(desc.flags & AssetFlag_Builtin) ) {
+		RemoveMesh(engine.gfx, handle);
+	}
+}
+
 void CleanMaterial(Handle handle, void* data)
 {
 	Engine &engine = *(Engine*)data;
@@ -2754,13 +3265,19 @@ void CreateScene(Engine &engine)
 
 void CleanScene(Engine &engine)
 {
+	CancelSceneLoading(engine);
+
 	WaitDeviceIdle(engine.gfx.device);
 
 	if (PopDataArenaState(engine))
 	{
+		// Loader stats were allocated in the popped data arena
+		engine.sceneLoader.timingCount = 0;
+		engine.sceneLoader.assetCount = 0;
 	}
 
 	ForAllHandles(engine.gfx.textureHandles, CleanTexture, &engine);
+	ForAllHandles(engine.gfx.meshHandles, CleanMesh, &engine);
 	ForAllHandles(engine.gfx.materialHandles, CleanMaterial, &engine);
 	ForAllHandles(engine.scene.roomHandles, CleanRoom, &engine);
 	ForAllHandles(engine.scene.entityHandles, CleanEntity, &engine);
@@ -2768,6 +3285,10 @@ void CleanScene(Engine &engine)
 	ForAllHandles(engine.audio.clipHandles, CleanAudioClip, &engine);
 	CloseAssets(engine.assets);
 
+	// Scene meshes were pushed after the builtin geometry
+	engine.gfx.globalVertexArena.used = engine.gfx.sceneVertexArenaBase;
+	engine.gfx.globalIndexArena.used = engine.gfx.sceneIndexArenaBase;
+
 	engine.gfx.shouldUpdateMaterials = true;
 	engine.gfx.shouldUpdateMaterialBindGroups = true;
 }
@@ -2972,6 +3493,19 @@ static bool EntityIsInFrustum3D(Scene &scene, const Entity &entity, const Frustu
 			points[pointCount++] = Float3(sbounds[i], 0.0f);
 		}
 	}
+	else if (IsValidHandle(engine->gfx.meshHandles, entity.meshH))
+	{
+		const Mesh &mesh = GetMesh(engine->gfx, entity.meshH);
+		const float3 boundsMin = Add(entity.position, Mul(mesh.boundsMin, entity.scale));
+		const float3 boundsMax = Add(entity.position, Mul(mesh.boundsMax, entity.scale));
+
+		for (u32 i = 0; i < 8; ++i) {
+			points[pointCount++] = Float3(
+				i & 1 ? boundsMax.x : boundsMin.x,
+				i & 2 ? boundsMax.y : boundsMin.y,
+				i & 4 ? boundsMax.z : boundsMin.z);
+		}
+	}
 	else
 	{
 		float x = 0.5f * entity.scale;
@@ -3067,6 +3601,7 @@ bool RenderGraphics(Engine &engine)
 		const Timestamp t1 = ReadTimestamp(timestampPool, 1);
 		ASSERT(t1.millis >= t0.millis);
 		AddTimeSample(gfx.gpuFrameTimes, t1.millis - t0.millis);
+		sPlatform->framePacer->gpuMillis = t1.millis - t0.millis;
 	}
 
 #if USE_UI
@@ -3281,7 +3816,7 @@ bool RenderGraphics(Engine &engine)
 	}
 
 	STileData *gpuTileDataPtr = (STileData*)GetBufferPtr(gfx.device, gfx.tileDataBuffer[frameIndex]);
-	MemCopy(gpuTileDataPtr, tileDataPtr, tileCount * sizeof(STileData));
+	MemCopyToDevice(gpuTileDataPtr, tileDataPtr, tileCount * sizeof(STileData));
 
 	// Update entity data
 	SEntity *entities = (SEntity*)GetBufferPtr(gfx.device, gfx.entityBuffer[frameIndex]);
@@ -3469,7 +4004,10 @@ bool RenderGraphics(Engine &engine)
 			SetVertexBuffer(commandList, vertexBuffer);
 			SetIndexBuffer(commandList, indexBuffer);
 
+			// Consecutive tiles sharing a texture (or an atlas page) are drawn as one instanced batch
 			u32 tileIndex = 0;
+			u32 batchFirstTile = 0;
+			ImageH batchImageH = {};
 			for (HandleIter it = BeginIter(scene.roomHandles); it; it++)
 			{
 				const Room &room = GetRoom(scene, *it);
@@ -3485,20 +4023,28 @@ bool RenderGraphics(Engine &engine)
 						for (u32 x = 0; x < layer.grid.size.x; ++x)
 						{
 							const Handle spriteH = layer.grid.cells[x][y].handle;
-							if (!IsValidHandle(scene.spriteHandles, spriteH)) continue;
+							if (!IsValidHandle(scene.spriteHandles, spriteH) || tileIndex >= tileCount) continue;
 
 							const Sprite &sprite = GetSprite(scene, spriteH);
 							const ImageH imageH = GetTextureImage(gfx, sprite.textureH, gfx.pinkImageH);
-							const BindGroupDesc textureBindGroupDesc = {
-								.layout = tilePipeline.layout.bindGroupLayouts[2],
-								.bindings = {
-									{ .index = 0, .image = imageH },
-								},
-							};
-							const BindGroup textureBindGroup = GetOrCreateDynamicBindGroup(gfx, textureBindGroupDesc);
-
-							SetBindGroup(commandList, 2, textureBindGroup);
-							DrawIndexed(commandList, tileIndexCount, tileFirstIndex, tileFirstVertex, tileIndex);
+							if ( tileIndex > batchFirstTile && imageH.index != batchImageH.index )
+							{
+								DrawIndexedInstanced(commandList, tileIndexCount, tileFirstIndex, tileFirstVertex, batchFirstTile, tileIndex - batchFirstTile);
+								batchFirstTile = tileIndex;
+							}
+
+							if ( tileIndex == batchFirstTile )
+							{
+								const BindGroupDesc textureBindGroupDesc = {
+									.layout = tilePipeline.layout.bindGroupLayouts[2],
+									.bindings = {
+										{ .index = 0, .image = imageH },
+									},
+								};
+								const BindGroup textureBindGroup = GetOrCreateDynamicBindGroup(gfx, textureBindGroupDesc);
+								SetBindGroup(commandList, 2, textureBindGroup);
+								batchImageH = imageH;
+							}
 
 							tileIndex++;
 						}
@@ -3506,6 +4052,11 @@ bool RenderGraphics(Engine &engine)
 				}
 			}
 
+			if ( tileIndex > batchFirstTile )
+			{
+				DrawIndexedInstanced(commandList, tileIndexCount, tileFirstIndex, tileFirstVertex, batchFirstTile, tileIndex - batchFirstTile);
+			}
+
 			EndDebugGroup(commandList);
 		}
 
@@ -3633,7 +4184,7 @@ bool RenderGraphics(Engine &engine)
 		{ // Debug draw
 			PROFILE_BLOCK(DebugDraw);
 
-			MemCopy(gfx.debugDrawVertices[frameIndex], gfx.debugDrawVerticesCPU, gfx.debugDrawVertexCount * sizeof(DebugDrawVertex));
+			MemCopyToDevice(gfx.debugDrawVertices[frameIndex], gfx.debugDrawVerticesCPU, gfx.debugDrawVertexCount * sizeof(DebugDrawVertex));
 
 			BeginDebugGroup(commandList, "DebugDraw", ColorBlack);
 
@@ -3792,6 +4343,9 @@ bool RenderGraphics(Engine &engine)
 
 	EndCommandList(commandList);
 
+	gfx.drawCallCount = commandList.drawCount;
+	gfx.bindGroupSwitchCount = commandList.bindGroupSwitchCount;
+
 	SubmitResult submitRes;
 
 	{
@@ -3972,7 +4526,7 @@ ENGINE_API u32 OnPlatformGetStateSignature()
 #endif
 	};
 
-	const u32 signature = HashFNV(layout, sizeof(layout));
+	const u32 signature = HashWY32(layout, sizeof(layout));
 	return signature;
 }
 
@@ -3998,11 +4552,22 @@ ENGINE_API bool OnPlatformPreInit(Plat &platform)
 #if USE_DATA_BUILD
 	bool buildAssets = false;
 	bool exitAfterBuild = false;
+	bool benchDescriptors = false;
 	for ( u32 i = 0; i < platform.argc; ++i ) {
 		if ( StrEq(platform.argv[i], "--build-assets") ) {
 			buildAssets = true;
 			exitAfterBuild = true;
 		}
+		if ( StrEq(platform.argv[i], "--bench-descriptors") ) {
+			benchDescriptors = true;
+		}
+	}
+
+	if ( benchDescriptors ) {
+		const FilePath benchFilepath = MakePath(DataDir, "bench_descriptors.txt");
+		BenchmarkDescriptors(benchFilepath.str);
+		PlatformQuit();
+		return true;
 	}
 
 	const FilePath assetsFilepath = MakePath(DataDir, "assets.dat");
@@ -4035,6 +4600,10 @@ ENGINE_API bool OnPlatformInit(Plat &platform)
 
 #if USE_EDITOR
 	CompileModifiedShaders();
+
+	const FilePath shaderDir = MakePath(ProjectDir, "code/shaders");
+	engine.editor.watchingShaders = WatchDirectory(shaderDir.str);
+	engine.editor.watchingAssets = WatchDirectory(AssetDir);
 #endif
 
 	// Initialize graphics
@@ -4099,17 +4668,31 @@ ENGINE_API bool OnPlatformWindowInit(Plat &platform)
 		EditorInitialize(engine);
 #else
 		engine.mode = EngineModeGame3D;
-		LoadSceneFromBin(engine);
+		BeginLoadSceneFromBin(engine);
 #endif
 	}
 
 	return true;
 }
 
-ENGINE_API void OnPlatformUpdate(Plat &platform)
+// Begins the profiler frame too, so the wait shows up in the frame it delays
+ENGINE_API void OnPlatformWaitFrame(Plat &platform)
 {
 	ProfileRegisterThread("UpdateAndRender");
 	PROFILE_FRAME();
+	PROFILE_BLOCK(WaitFrame);
+
+	Engine &engine = GetEngine(platform);
+	Graphics &gfx = engine.gfx;
+
+	if ( gfx.deviceInitialized && IsValidSwapchain(gfx.device) )
+	{
+		WaitFrame(gfx.device, platform.framePacer->frameLatency);
+	}
+}
+
+ENGINE_API void OnPlatformUpdate(Plat &platform)
+{
 	PROFILE_BLOCK(Update);
 
 	Engine &engine = GetEngine(platform);
@@ -4125,7 +4708,7 @@ ENGINE_API void OnPlatformUpdate(Plat &platform)
 	if ( firstUpdate )
 	{
 		firstUpdate = false;
-		//LoadSceneFromBin(engine);
+		//BeginLoadSceneFromBin(engine);
 		MusicPlay(engine, 0);
 	}
 #endif
@@ -4135,14 +4718,25 @@ ENGINE_API void OnPlatformUpdate(Plat &platform)
 #endif
 
 #if USE_EDITOR
+	// Watched directories are only checked when they report changes, the rest are polled
 	static Clock lastClock = GetClock();
 	const Clock currentClock = GetClock();
 	const f32 secondsSinceLastCheck  = GetSecondsElapsed(lastClock, currentClock);
-
-	if ( secondsSinceLastCheck > 0.2 )
+	const bool poll = secondsSinceLastCheck > 0.2;
+	if ( poll )
 	{
 		lastClock = currentClock;
+	}
 
+	const FileChanges &changes = *platform.fileChanges;
+	bool shadersChanged = changes.overflow;
+	for (u32 i = 0; i < changes.count; ++i)
+	{
+		shadersChanged = shadersChanged || HasFileExtension(changes.paths[i], "hlsl");
+	}
+
+	if ( engine.editor.watchingShaders ? shadersChanged : poll )
+	{
 		if ( CompileModifiedShaders() )
 		{
 			// NOTE(jesus): Recompiling all pipelines here even if likely only a shader was recompiled :-S
@@ -4150,13 +4744,27 @@ ENGINE_API void OnPlatformUpdate(Plat &platform)
 			Scratch scratch;
 			RecompilePipelines(engine, scratch.arena);
 		}
+	}
 
-		RecreateModifiedTextures(engine);
+	if ( engine.editor.watchingAssets )
+	{
+		if ( changes.count > 0 || changes.overflow )
+		{
+			RecreateModifiedTextures(engine, changes.overflow ? nullptr : &changes);
+		}
+	}
+	else if ( poll )
+	{
+		RecreateModifiedTextures(engine, nullptr);
 	}
 
 	EditorUpdate(engine);
 #endif
 
+	UpdateSceneLoading(engine);
+
+	UpdateAudio(engine);
+
 	{
 		PROFILE_BLOCK(GameUpdate);
 		GameUpdate(engine, platform);
@@ -4256,6 +4864,8 @@ ENGINE_API void OnPlatformCleanup(Plat &platform)
 	Graphics &gfx = engine.gfx;
 	Game &game = engine.game;
 
+	CancelSceneLoading(engine);
+
 	EngineWaitDeviceIdle(gfx);
 
 #if USE_UI
@@ -4319,9 +4929,9 @@ AudioClipH GetAudioClip(const char *name)
 	return handle;
 }
 
-u32 PlayAudioClip(Handle handle)
+AudioVoiceH PlayAudioClip(Handle handle)
 {
-	u32 ret = PlayAudioClip(*engine, handle);
+	AudioVoiceH ret = PlayAudioClip(*engine, handle);
 	return ret;
 }
 
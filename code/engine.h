@@ -34,6 +34,17 @@ struct Texture
 
 typedef Handle TextureH;
 
+struct Mesh
+{
+	const char *name;
+	BufferChunk vertices;
+	BufferChunk indices;
+	float3 boundsMin;
+	float3 boundsMax;
+};
+
+typedef Handle MeshH;
+
 struct Material
 {
 	const char *name;
@@ -110,6 +121,7 @@ struct Entity
 	bool culled;
 	// 3D entity
 	GeometryType geometryType;
+	MeshH meshH; // Overrides geometryType if valid
 	BufferChunk vertices;
 	BufferChunk indices;
 	MaterialH materialH;
@@ -130,6 +142,7 @@ struct TimeSamples
 };
 
 #define MAX_TEXTURES 4092
+#define MAX_MESHES 1024
 #define MAX_MATERIALS 4092
 #define MAX_DYNAMIC_BIND_GROUPS 4092
 #define MAX_DEBUG_DRAW_BATCHES 64
@@ -158,6 +171,10 @@ struct Graphics
 	BufferChunk screenTriangleVertices;
 	BufferChunk screenTriangleIndices;
 
+	// Meshes are pushed after the builtin geometry, which is kept when cleaning the scene
+	u32 sceneVertexArenaBase;
+	u32 sceneIndexArenaBase;
+
 	BufferH globalsBuffer[MAX_FRAMES_IN_FLIGHT];
 	BufferH entityBuffer[MAX_FRAMES_IN_FLIGHT];
 	BufferH materialBuffer;
@@ -193,6 +210,10 @@ struct Graphics
 	TextureDesc textureDescs[MAX_TEXTURES];
 	HandleManager textureHandles;
 
+	Mesh meshes[MAX_MESHES];
+	MeshDesc meshDescs[MAX_MESHES];
+	HandleManager meshHandles;
+
 	Material materials[MAX_MATERIALS];
 	MaterialDesc materialDescs[MAX_MATERIALS];
 	HandleManager materialHandles;
@@ -254,6 +275,10 @@ struct Graphics
 	TimeSamples cpuFrameTimes;
 	TimeSamples gpuFrameTimes;
 
+	// Last frame stats
+	u32 drawCallCount;
+	u32 bindGroupSwitchCount;
+
 	f32 deltaSeconds;
 
 	Camera camera;
@@ -319,4 +344,83 @@ struct Scene
 	SpriteAnimState spriteAnimStates[MAX_SPRITES];
 };
 
+// Scene loading runs in two phases: worker jobs read and verify the asset payloads
+// from disk, and the update thread commits the loaded assets within a time budget
+// per frame (creating images, materials, sprites, entities, rooms...).
+
+#define MAX_SCENE_LOAD_JOBS 8
+constexpr f32 SCENE_LOAD_BUDGET_SECONDS = 0.004f;
+
+enum SceneLoadStage
+{
+	SceneLoadStage_Idle,
+	SceneLoadStage_Textures,
+	SceneLoadStage_Meshes,
+	SceneLoadStage_Materials,
+	SceneLoadStage_Sprites,
+	SceneLoadStage_Entities,
+	SceneLoadStage_Rooms,
+	SceneLoadStage_AudioClips,
+	SceneLoadStage_MusicFiles,
+	SceneLoadStage_Finish,
+	SceneLoadStage_COUNT,
+};
+
+struct SceneLoadPayload
+{
+	const BinLocation *location;
+	byte *bytes;
+	f32 readMillis;
+	volatile_u32 loaded;
+	volatile_u32 failed;
+};
+
+enum SceneLoadJobState
+{
+	SceneLoadJobState_Pending,
+	SceneLoadJobState_Running,
+	SceneLoadJobState_Finished,
+};
+
+struct SceneLoadJob
+{
+	struct SceneLoader *loader;
+	u32 firstPayload;
+	volatile_u32 state; // SceneLoadJobState
+};
+
+struct SceneLoadTiming
+{
+	const char *name;
+	SceneLoadStage stage;
+	f32 readMillis;
+	f32 commitMillis;
+};
+
+struct SceneLoader
+{
+	SceneLoadStage stage;
+	u32 stageIndex;
+
+	FilePath filepath;
+	volatile_u32 cancelled;
+
+	SceneLoadPayload *payloads; // Images first, then meshes, then the tiles of all room layers
+	u32 payloadCount;
+	u32 *roomFirstPayload;
+
+	SceneLoadJob jobs[MAX_SCENE_LOAD_JOBS];
+	u32 jobCount;
+
+	SpriteH spriteHandles[MAX_SPRITES];
+
+	SceneLoadTiming *timings; // One per asset, in commit order
+	u32 timingCount;
+	u32 assetCount;
+
+	Clock beginClock;
+	f32 totalMillis;
+	f32 maxFrameCommitMillis;
+};
+
 #endif // ENGINE_H
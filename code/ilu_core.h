@@ -62,7 +62,9 @@
 #include <sys/mman.h> // mmap
 #include <dirent.h>   // opendir/readdir/closedir
 #include <pthread.h>
-#include <semaphore.h>
+#include <sched.h>    // sched_yield
+#include <sys/syscall.h> // syscall
+#include <linux/futex.h> // FUTEX_WAIT_PRIVATE, FUTEX_WAKE_PRIVATE
 #endif
 
 #if PLATFORM_LINUX || PLATFORM_ANDROID
@@ -74,6 +76,8 @@
 #if PLATFORM_LINUX
 #include <linux/ioctl.h> // ioctl
 #include <linux/input.h> // input_event
+#include <sys/inotify.h> // inotify_init1, inotify_add_watch
+#include <poll.h>        // poll
 #endif
 
 #if PLATFORM_ANDROID
@@ -510,6 +514,84 @@ inline void AtomicIncrement(volatile_i64 *value)
 	AtomicPreIncrement(value);
 }
 
+// Returns the previous value
+u32 AtomicExchange(volatile_u32 *value, u32 newValue)
+{
+#if PLATFORM_WINDOWS
+	const u32 oldValue = (u32)InterlockedExchange((volatile LONG*)value, (LONG)newValue);
+#elif PLATFORM_LINUX || PLATFORM_ANDROID
+	const u32 oldValue = __atomic_exchange_n(value, newValue, __ATOMIC_SEQ_CST);
+#else
+#error "Missing implementation"
+#endif
+	return oldValue;
+}
+
+// Returns the previous value
+u32 AtomicFetchAdd(volatile_u32 *value, i32 addend)
+{
+#if PLATFORM_WINDOWS
+	const u32 oldValue = (u32)InterlockedExchangeAdd((volatile LONG*)value, addend);
+#elif PLATFORM_LINUX || PLATFORM_ANDROID
+	const u32 oldValue = __atomic_fetch_add(value, (u32)addend, __ATOMIC_SEQ_CST);
+#else
+#error "Missing implementation"
+#endif
+	return oldValue;
+}
+
+// Loads and stores that order the surrounding memory accesses, for publishing data to
+// readers that do not take any lock. On x86 these only prevent compiler reordering.
+inline u32 AtomicLoadAcquire(const volatile_u32 *value)
+{
+#if PLATFORM_WINDOWS
+	const u32 res = *value;
+	_ReadWriteBarrier();
+#elif PLATFORM_LINUX || PLATFORM_ANDROID
+	const u32 res = __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#else
+#error "Missing implementation"
+#endif
+	return res;
+}
+
+inline void AtomicStoreRelease(volatile_u32 *value, u32 newValue)
+{
+#if PLATFORM_WINDOWS
+	_ReadWriteBarrier();
+	*value = newValue;
+#elif PLATFORM_LINUX || PLATFORM_ANDROID
+	__atomic_store_n(value, newValue, __ATOMIC_RELEASE);
+#else
+#error "Missing implementation"
+#endif
+}
+
+inline void *AtomicLoadAcquire(void * volatile const *value)
+{
+#if PLATFORM_WINDOWS
+	void *res = *value;
+	_ReadWriteBarrier();
+#elif PLATFORM_LINUX || PLATFORM_ANDROID
+	void *res = __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#else
+#error "Missing implementation"
+#endif
+	return res;
+}
+
+inline void AtomicStoreRelease(void * volatile *value, void *newValue)
+{
+#if PLATFORM_WINDOWS
+	_ReadWriteBarrier();
+	*value = newValue;
+#elif PLATFORM_LINUX || PLATFORM_ANDROID
+	__atomic_store_n(value, newValue, __ATOMIC_RELEASE);
+#else
+#error "Missing implementation"
+#endif
+}
+
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -839,270 +921,1433 @@ u32 HashStringFNV(const char *data, u32 initial = 0, u32 prime = TOOLS_HASH_FNV_
 	return hash;
 }
 
+// 64-bit xxHash (XXH64). Processes 32-byte stripes in four independent lanes, so it
+// runs at memory speed on large payloads. Output matches the reference implementation.
 
+#define TOOLS_XXH64_PRIME1 0x9E3779B185EBCA87ULL
+#define TOOLS_XXH64_PRIME2 0xC2B2AE3D27D4EB4FULL
+#define TOOLS_XXH64_PRIME3 0x165667B19E3779F9ULL
+#define TOOLS_XXH64_PRIME4 0x85EBCA77C2B2AE63ULL
+#define TOOLS_XXH64_PRIME5 0x27D4EB2F165667C5ULL
 
-////////////////////////////////////////////////////////////////////////////////////////////////////
-// Memory
-
-#if PLATFORM_LINUX || PLATFORM_ANDROID || PLATFORM_APPLE
-
-void* AllocateVirtualMemory(u32 size)
+internal u64 XXH64_Rotl(u64 x, u32 r)
 {
-	void* baseAddress = 0;
-	i32 prot = PROT_READ | PROT_WRITE;
-	i32 flags = MAP_PRIVATE | MAP_ANONYMOUS;
-	i32 fd = -1;
-	off_t offset = 0;
-	void *allocatedMemory = mmap(baseAddress, size, prot, flags, fd, offset);
-	ASSERT( allocatedMemory != MAP_FAILED && "Failed to allocate memory." );
-	return allocatedMemory;
+	return (x << r) | (x >> (64 - r));
 }
 
-#elif PLATFORM_WINDOWS
-
-void* AllocateVirtualMemory(u32 size)
+// Written out so compilers fold the bytes into one unaligned load
+internal inline u64 XXH64_Read64(const unsigned char *p)
 {
-	void *data = VirtualAlloc(0, size, MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE);
-	return data;
+	const u64 value =
+		(u64)p[0] | ((u64)p[1] << 8) | ((u64)p[2] << 16) | ((u64)p[3] << 24) |
+		((u64)p[4] << 32) | ((u64)p[5] << 40) | ((u64)p[6] << 48) | ((u64)p[7] << 56);
+	return value;
 }
 
-#endif
+internal inline u32 XXH64_Read32(const unsigned char *p)
+{
+	const u32 value = (u32)p[0] | ((u32)p[1] << 8) | ((u32)p[2] << 16) | ((u32)p[3] << 24);
+	return value;
+}
 
-void MemSet(void *ptr, u32 size, byte value)
+internal u64 XXH64_Round(u64 acc, u64 input)
 {
-	byte *bytePtr = (byte*)ptr;
-	while (size-- > 0) *bytePtr++ = value;
+	acc += input * TOOLS_XXH64_PRIME2;
+	acc = XXH64_Rotl(acc, 31);
+	acc *= TOOLS_XXH64_PRIME1;
+	return acc;
 }
 
-void MemCopy(void *dst, const void *src, u32 size)
+internal u64 XXH64_MergeRound(u64 acc, u64 val)
 {
-	const byte *pSrc = (byte*) src;
-	const byte *pEnd = pSrc + size;
-	byte *pDst = (byte*) dst;
-	while (pSrc != pEnd) *pDst++ = *pSrc++;
+	acc ^= XXH64_Round(0, val);
+	acc = acc * TOOLS_XXH64_PRIME1 + TOOLS_XXH64_PRIME4;
+	return acc;
 }
 
-i32 MemCompare(const void *a, const void *b, u32 size)
+// Consumes the last bytes (less than a stripe) and avalanches the result
+internal u64 XXH64_Finalize(u64 hash, const unsigned char *p, const unsigned char *end)
 {
-	const byte *pA = (const byte*) a;
-	const byte *pB = (const byte*) b;
-	const byte *pEnd = pA + size;
-	while (pA != pEnd) {
-		const byte valueA = *pA++;
-		const byte valueB = *pB++;
-		if (valueA != valueB) {
-			return valueA - valueB;
-		}
+	while (p + 8 <= end) {
+		hash ^= XXH64_Round(0, XXH64_Read64(p));
+		hash = XXH64_Rotl(hash, 27) * TOOLS_XXH64_PRIME1 + TOOLS_XXH64_PRIME4;
+		p += 8;
 	}
-	return 0;
+	if (p + 4 <= end) {
+		hash ^= (u64)XXH64_Read32(p) * TOOLS_XXH64_PRIME1;
+		hash = XXH64_Rotl(hash, 23) * TOOLS_XXH64_PRIME2 + TOOLS_XXH64_PRIME3;
+		p += 4;
+	}
+	while (p < end) {
+		hash ^= (*p) * TOOLS_XXH64_PRIME5;
+		hash = XXH64_Rotl(hash, 11) * TOOLS_XXH64_PRIME1;
+		p++;
+	}
+
+	hash ^= hash >> 33;
+	hash *= TOOLS_XXH64_PRIME2;
+	hash ^= hash >> 29;
+	hash *= TOOLS_XXH64_PRIME3;
+	hash ^= hash >> 32;
+	return hash;
 }
 
+u64 HashXX64(const void *data, u64 size, u64 seed = 0)
+{
+	const unsigned char *p = (const unsigned char *)data;
+	const unsigned char *end = p + size;
+	u64 hash;
+
+	if (size >= 32)
+	{
+		u64 v1 = seed + TOOLS_XXH64_PRIME1 + TOOLS_XXH64_PRIME2;
+		u64 v2 = seed + TOOLS_XXH64_PRIME2;
+		u64 v3 = seed;
+		u64 v4 = seed - TOOLS_XXH64_PRIME1;
+		const unsigned char *limit = end - 32;
+		do {
+			v1 = XXH64_Round(v1, XXH64_Read64(p)); p += 8;
+			v2 = XXH64_Round(v2, XXH64_Read64(p)); p += 8;
+			v3 = XXH64_Round(v3, XXH64_Read64(p)); p += 8;
+			v4 = XXH64_Round(v4, XXH64_Read64(p)); p += 8;
+		} while (p <= limit);
+
+		hash = XXH64_Rotl(v1, 1) + XXH64_Rotl(v2, 7) + XXH64_Rotl(v3, 12) + XXH64_Rotl(v4, 18);
+		hash = XXH64_MergeRound(hash, v1);
+		hash = XXH64_MergeRound(hash, v2);
+		hash = XXH64_MergeRound(hash, v3);
+		hash = XXH64_MergeRound(hash, v4);
+	}
+	else
+	{
+		hash = seed + TOOLS_XXH64_PRIME5;
+	}
 
+	hash += size;
+	hash = XXH64_Finalize(hash, p, end);
+	return hash;
+}
 
-////////////////////////////////////////////////////////////////////////////////////////////////////
-// Arena
+// Streaming XXH64, for content that arrives in pieces (asset files read in chunks).
+// Any split of the input gives the same value as HashXX64 over all of it.
 
-struct Arena
+struct HashXX64State
 {
-	byte* base;
-	u32 used;
-	u32 size;
-	const char *name;
+	u64 v[4];
+	u64 totalSize;
+	u64 seed;
+	unsigned char buffer[32];
+	u32 bufferSize;
 };
 
-Arena MakeArena(byte* base, u32 size, const char *name)
+HashXX64State HashXX64Begin(u64 seed = 0)
 {
-	ASSERTMSG(base != NULL, "MakeArena needs a non-null base pointer.");
-	ASSERTMSG(size > 0, "MakeArena needs a size greater-than-zero.");
-	Arena arena = {};
-	arena.base = base;
-	arena.size = size;
-	arena.used = 0;
-	arena.name = name;
-	return arena;
+	HashXX64State state = {};
+	state.v[0] = seed + TOOLS_XXH64_PRIME1 + TOOLS_XXH64_PRIME2;
+	state.v[1] = seed + TOOLS_XXH64_PRIME2;
+	state.v[2] = seed;
+	state.v[3] = seed - TOOLS_XXH64_PRIME1;
+	state.seed = seed;
+	return state;
 }
 
-Arena MakeSubArena(Arena &arena, u32 size, const char *name)
+internal void XXH64_Stripe(u64 v[4], const unsigned char *p)
 {
-	ASSERTMSG(arena.used + size <= arena.size,
-			"MakeSubArena out of bounds of the memory arena.\n"
-			"- Arena: %s\n"
-			"- Subarena: %s\n",
-			arena.name, name);
-	Arena subarena = {};
-	subarena.base = arena.base + arena.used;
-	subarena.size = size;
-	subarena.used = 0;
-	subarena.name = name;
-	return subarena;
+	v[0] = XXH64_Round(v[0], XXH64_Read64(p));
+	v[1] = XXH64_Round(v[1], XXH64_Read64(p + 8));
+	v[2] = XXH64_Round(v[2], XXH64_Read64(p + 16));
+	v[3] = XXH64_Round(v[3], XXH64_Read64(p + 24));
 }
 
-Arena MakeSubArena(Arena &arena, const char *name)
+void HashXX64Update(HashXX64State &state, const void *data, u64 size)
 {
-	u32 remainingSize = arena.size - arena.used;
-	Arena subarena = MakeSubArena(arena, remainingSize, name);
-	return subarena;
-}
+	const unsigned char *p = (const unsigned char *)data;
+	const unsigned char *end = p + size;
+	state.totalSize += size;
 
-Arena PushSubArena(Arena &arena, u32 size, const char *name)
-{
-	Arena subArena = MakeSubArena(arena, size, name);
-	arena.used += size;
-	return subArena;
-}
+	if (state.bufferSize > 0)
+	{
+		while (state.bufferSize < 32 && p < end) {
+			state.buffer[state.bufferSize++] = *p++;
+		}
+		if (state.bufferSize < 32) {
+			return;
+		}
+		XXH64_Stripe(state.v, state.buffer);
+		state.bufferSize = 0;
+	}
 
-Arena PushSubArena(Arena &arena, const char *name)
-{
-	Arena subArena = MakeSubArena(arena, name);
-	arena.used = arena.size;
-	return subArena;
+	u64 v[4] = { state.v[0], state.v[1], state.v[2], state.v[3] };
+	while (end - p >= 32) {
+		XXH64_Stripe(v, p);
+		p += 32;
+	}
+	state.v[0] = v[0]; state.v[1] = v[1]; state.v[2] = v[2]; state.v[3] = v[3];
+
+	while (p < end) {
+		state.buffer[state.bufferSize++] = *p++;
+	}
 }
 
-byte* PushSize(Arena &arena, u32 size)
+u64 HashXX64End(const HashXX64State &state)
 {
-	ASSERTMSG(arena.used + size <= arena.size,
-		"PushSize out of bounds of the memory arena.\n"
-		"- Arena: %s\n"
-		"- push size: %u\n- arena size: %u\n- arena remaining size: %u\n).",
-		arena.name,
-		size, arena.size, arena.size - arena.used);
-	byte* head = arena.base + arena.used;
-	arena.used += size;
-	return head;
+	u64 hash;
+	if (state.totalSize >= 32)
+	{
+		const u64 *v = state.v;
+		hash = XXH64_Rotl(v[0], 1) + XXH64_Rotl(v[1], 7) + XXH64_Rotl(v[2], 12) + XXH64_Rotl(v[3], 18);
+		hash = XXH64_MergeRound(hash, v[0]);
+		hash = XXH64_MergeRound(hash, v[1]);
+		hash = XXH64_MergeRound(hash, v[2]);
+		hash = XXH64_MergeRound(hash, v[3]);
+	}
+	else
+	{
+		hash = state.seed + TOOLS_XXH64_PRIME5;
+	}
+	hash += state.totalSize;
+	hash = XXH64_Finalize(hash, state.buffer, state.buffer + state.bufferSize);
+	return hash;
 }
 
-byte* PushZeroSize(Arena &arena, u32 size)
+// 64-bit hash built like wyhash (final 4): each step multiplies two 64-bit words into a
+// 128-bit product and folds its halves, consuming 48 bytes per iteration in three
+// chains. It passes the SMHasher-style avalanche, sparse key and distribution checks of
+// the unit tests and outruns XXH64, but its values are not stable across versions of
+// this file, so use HashXX64 for anything stored on disk.
+
+#define TOOLS_WYHASH_SECRET0 0x2d358dccaa6c78a5ULL
+#define TOOLS_WYHASH_SECRET1 0x8bb84b93962eacc9ULL
+#define TOOLS_WYHASH_SECRET2 0x4b33a62ed433d4a3ULL
+#define TOOLS_WYHASH_SECRET3 0x4d5a2da51de1aa47ULL
+
+internal void WY_Multiply(u64 *a, u64 *b)
 {
-	byte *bytes = PushSize(arena, size);
-	MemSet(bytes, size, 0);
-	return bytes;
+#if defined(__SIZEOF_INT128__)
+	const unsigned __int128 product = (unsigned __int128)*a * *b;
+	*a = (u64)product;
+	*b = (u64)(product >> 64);
+#elif PLATFORM_WINDOWS && defined(_M_X64)
+	*a = _umul128(*a, *b, b);
+#else
+	const u64 ha = *a >> 32, hb = *b >> 32, la = (u32)*a, lb = (u32)*b;
+	const u64 rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	const u64 t = rl + (rm0 << 32);
+	u64 hi = rh + (rm0 >> 32) + (rm1 >> 32) + (t < rl);
+	const u64 lo = t + (rm1 << 32);
+	hi += lo < t;
+	*a = lo;
+	*b = hi;
+#endif
 }
 
-char *PushStringN(Arena &arena, const char *str, u32 len)
+internal u64 WY_Mix(u64 a, u64 b)
 {
-	char *bytes = (char*)PushSize(arena, len+1);
-	MemCopy(bytes, str, len);
-	bytes[len] = 0;
-	return bytes;
+	WY_Multiply(&a, &b);
+	return a ^ b;
 }
 
-char *PushString(Arena &arena, const char *str)
+internal u64 WY_Read3(const unsigned char *p, u64 size)
 {
-	u32 len = StrLen(str);
-	char *bytes = PushStringN(arena, str, len);
-	return bytes;
+	const u64 value = ((u64)p[0] << 16) | ((u64)p[size >> 1] << 8) | p[size - 1];
+	return value;
 }
 
-char *PushString(Arena &arena, String str)
+u64 HashWY64(const void *data, u64 size, u64 seed = 0)
 {
-	char *bytes = PushStringN(arena, str.str, str.size);
-	return bytes;
+	const unsigned char *p = (const unsigned char *)data;
+	seed ^= WY_Mix(seed ^ TOOLS_WYHASH_SECRET0, TOOLS_WYHASH_SECRET1);
+	u64 a, b;
+
+	if (size <= 16)
+	{
+		if (size >= 4) {
+			// Two overlapping reads from each end cover every size from 4 to 16
+			const u64 offset = (size >> 3) << 2;
+			a = ((u64)XXH64_Read32(p) << 32) | XXH64_Read32(p + offset);
+			b = ((u64)XXH64_Read32(p + size - 4) << 32) | XXH64_Read32(p + size - 4 - offset);
+		} else if (size > 0) {
+			a = WY_Read3(p, size);
+			b = 0;
+		} else {
+			a = b = 0;
+		}
+	}
+	else
+	{
+		u64 remaining = size;
+		if (remaining >= 48)
+		{
+			u64 seed1 = seed;
+			u64 seed2 = seed;
+			do {
+				seed = WY_Mix(XXH64_Read64(p) ^ TOOLS_WYHASH_SECRET1, XXH64_Read64(p + 8) ^ seed);
+				seed1 = WY_Mix(XXH64_Read64(p + 16) ^ TOOLS_WYHASH_SECRET2, XXH64_Read64(p + 24) ^ seed1);
+				seed2 = WY_Mix(XXH64_Read64(p + 32) ^ TOOLS_WYHASH_SECRET3, XXH64_Read64(p + 40) ^ seed2);
+				p += 48;
+				remaining -= 48;
+			} while (remaining >= 48);
+			seed ^= seed1 ^ seed2;
+		}
+		while (remaining > 16) {
+			seed = WY_Mix(XXH64_Read64(p) ^ TOOLS_WYHASH_SECRET1, XXH64_Read64(p + 8) ^ seed);
+			p += 16;
+			remaining -= 16;
+		}
+		// The last 16 bytes, overlapping the previous block if needed
+		a = XXH64_Read64(p + remaining - 16);
+		b = XXH64_Read64(p + remaining - 8);
+	}
+
+	a ^= TOOLS_WYHASH_SECRET1;
+	b ^= seed;
+	WY_Multiply(&a, &b);
+	const u64 hash = WY_Mix(a ^ TOOLS_WYHASH_SECRET0 ^ size, b ^ TOOLS_WYHASH_SECRET1);
+	return hash;
 }
 
-char *PushChar(Arena &arena, char c)
+// 32-bit hash for short keys such as names and hash table lookups. Strings up to 16
+// bytes take two or three loads and three multiplies, instead of one multiply per byte.
+u32 HashWY32(const void *data, u32 size, u32 seed = 0)
 {
-	char *bytes = (char*)PushSize(arena, sizeof(c));
-	*bytes = c;
-	return bytes;
+	const u64 hash = HashWY64(data, size, seed);
+	return (u32)(hash ^ (hash >> 32));
 }
 
-void ResetArena(Arena &arena)
+u32 HashStringWY32(const char *str, u32 seed = 0)
 {
-	// This tells the OS we don't need these pages
-	//madvise(arena.base, arena.size, MADV_DONTNEED);
-	arena.used = 0;
+	const u32 hash = HashWY32(str, StrLen(str), seed);
+	return hash;
 }
 
-#define ZeroStruct( pointer ) MemSet(pointer, sizeof(*pointer), 0)
-#define PushStruct( arena, struct_type ) (struct_type*)PushSize(arena, sizeof(struct_type))
-#define PushArray( arena, type, count ) (type*)PushSize(arena, sizeof(type) * (count))
-#define PushZeroStruct( arena, struct_type ) (struct_type*)PushZeroSize(arena, sizeof(struct_type))
-#define PushZeroArray( arena, type, count ) (type*)PushZeroSize(arena, sizeof(type) * (count))
-
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-// String interning
+// Memory
 
-struct StringIntern
-{
-	char *str;
-	u32 hash;
-};
+#if PLATFORM_LINUX || PLATFORM_ANDROID || PLATFORM_APPLE
 
-struct StringInterningNode
+void* AllocateVirtualMemory(u64 size)
 {
-	StringIntern stringIntern;
-	StringInterningNode *next;
-};
+	void* baseAddress = 0;
+	i32 prot = PROT_READ | PROT_WRITE;
+	i32 flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	i32 fd = -1;
+	off_t offset = 0;
+	void *allocatedMemory = mmap(baseAddress, size, prot, flags, fd, offset);
+	ASSERT( allocatedMemory != MAP_FAILED && "Failed to allocate memory." );
+	return allocatedMemory;
+}
 
-struct StringInterningTable
+// Reserves address space without backing it, any access faults until it is committed
+void* ReserveVirtualMemory(u64 size)
 {
-	StringInterningNode* bins[1024];
-};
+	void *reservedMemory = mmap(0, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	return reservedMemory != MAP_FAILED ? reservedMemory : NULL;
+}
 
-struct StringInterning
+bool CommitVirtualMemory(void *ptr, u64 size)
 {
-	Arena *arena;
-	StringInterningTable *table;
-};
+	const bool ok = mprotect(ptr, size, PROT_READ | PROT_WRITE) == 0;
+	return ok;
+}
 
-StringInterning StringInterningCreate(Arena *arena)
+// Gives the physical pages back to the OS but keeps the range committed, so it reads as
+// zeros when touched again. Copies of an arena can then never see a decommitted page.
+void ReleaseVirtualMemoryPages(void *ptr, u64 size)
 {
-	StringInterning interning = {
-		.arena = arena,
-		.table = PushZeroStruct(*arena, StringInterningTable),
-	};
-	return interning;
+	madvise(ptr, size, MADV_DONTNEED);
 }
 
-const char *MakeStringIntern(StringInterning *context, const char *str, u32 len)
+void FreeVirtualMemory(void *ptr, u64 size)
 {
-	ASSERT(context && context->table);
-	const u32 hash = HashFNV(str, len);
-	const u32 index = hash % ARRAY_COUNT(context->table->bins);
-
-	StringInterningNode *next = NULL;
+	munmap(ptr, size);
+}
 
-	if (context->table->bins[index])
-	{
-		StringInterningNode *node = context->table->bins[index];
-		while (node)
-		{
-			if (node->stringIntern.hash == hash) // same hash?
-			{
-				if (StrEq(node->stringIntern.str, str)) // same string?
-				{
-					return node->stringIntern.str; // found!
-				}
-			}
-			node = node->next; // collision! keep searching...
-		}
-		next = context->table->bins[index];
+u32 GetVirtualMemoryPageSize()
+{
+	static u32 pageSize = 0;
+	if ( pageSize == 0 ) {
+		pageSize = (u32)sysconf(_SC_PAGESIZE);
 	}
+	return pageSize;
+}
 
-	// No coincidence found, insert a new node
-	StringInterningNode *node = PushZeroStruct(*(context->arena), StringInterningNode);
-	node->stringIntern.str = PushStringN(*(context->arena), str, len);
-	node->stringIntern.hash = hash;
-	node->next = next;
-	context->table->bins[index] = node;
-	return node->stringIntern.str;
+#elif PLATFORM_WINDOWS
+
+void* AllocateVirtualMemory(u64 size)
+{
+	void *data = VirtualAlloc(0, size, MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE);
+	return data;
 }
 
-const char *MakeStringIntern(StringInterning *context, const char *str)
+// Reserves address space without backing it, any access faults until it is committed
+void* ReserveVirtualMemory(u64 size)
 {
-	const u32 len = StrLen(str);
-	const char *internStr = MakeStringIntern(context, str, len);
-	return internStr;
+	void *data = VirtualAlloc(0, size, MEM_RESERVE, PAGE_NOACCESS);
+	return data;
 }
 
+bool CommitVirtualMemory(void *ptr, u64 size)
+{
+	const bool ok = VirtualAlloc(ptr, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+	return ok;
+}
 
+// Gives the physical pages back to the OS but keeps the range committed, so copies of
+// an arena can never see a decommitted page. The contents are undefined afterwards.
+void ReleaseVirtualMemoryPages(void *ptr, u64 size)
+{
+	VirtualAlloc(ptr, size, MEM_RESET, PAGE_READWRITE);
+}
 
-////////////////////////////////////////////////////////////////////////////////////////////////////
-// Files
+void FreeVirtualMemory(void *ptr, u64 size)
+{
+	VirtualFree(ptr, 0, MEM_RELEASE);
+}
 
-struct DataChunk
+u32 GetVirtualMemoryPageSize()
+{
+	static u32 pageSize = 0;
+	if ( pageSize == 0 ) {
+		SYSTEM_INFO systemInfo;
+		GetSystemInfo(&systemInfo);
+		pageSize = systemInfo.dwPageSize;
+	}
+	return pageSize;
+}
+
+#endif
+
+// MemCopy, MemSet and MemCompare move 8 bytes at a time, or 16/32 with SSE2/AVX2 on x86-64.
+// The widest version the CPU supports is selected on the first call. Buffers are handled
+// as an unaligned head, aligned vectors and an unaligned tail that may overlap them, so
+// the source and the destination of a copy must not overlap. The loops are kept from
+// being turned back into libc calls, so the engine does not depend on them.
+
+#if defined(__x86_64__) || defined(_M_X64)
+#	define USE_MEMORY_SSE2 1
+#	include <immintrin.h>
+#	if !PLATFORM_WINDOWS
+#		include <cpuid.h>
+#	endif
+#endif
+
+#if PLATFORM_WINDOWS
+#	define MEM_TARGET_AVX2
+#	define MEM_NO_LIBC
+typedef u16 unaligned_u16;
+typedef u32 unaligned_u32;
+typedef u64 unaligned_u64;
+#else
+#	define MEM_TARGET_AVX2 __attribute__((target("avx2")))
+#	if defined(__clang__)
+#		define MEM_NO_LIBC __attribute__((no_builtin))
+#	else
+#		define MEM_NO_LIBC __attribute__((optimize("no-tree-loop-distribute-patterns")))
+#	endif
+typedef u16 __attribute__((may_alias, aligned(1))) unaligned_u16;
+typedef u32 __attribute__((may_alias, aligned(1))) unaligned_u32;
+typedef u64 __attribute__((may_alias, aligned(1))) unaligned_u64;
+#endif
+
+// Copies at least this size bypass the caches, as they would evict more than they reuse
+#define MEM_NON_TEMPORAL_THRESHOLD MB(2)
+
+enum CpuFeature
+{
+	CpuFeature_SSE2 = 1 << 0,
+	CpuFeature_AVX2 = 1 << 1,
+	CpuFeature_Detected = 1u << 31,
+};
+
+static u32 gCpuFeatures = 0;
+
+u32 GetCpuFeatures()
+{
+	if ( !(gCpuFeatures & CpuFeature_Detected) )
+	{
+		u32 features = CpuFeature_Detected;
+#if USE_MEMORY_SSE2
+		features |= CpuFeature_SSE2; // Part of x86-64
+#if PLATFORM_WINDOWS
+		int info[4];
+		__cpuid(info, 0);
+		const u32 maxLeaf = info[0];
+		__cpuid(info, 1);
+		const u32 ecx1 = info[2];
+		u32 ebx7 = 0;
+		if ( maxLeaf >= 7 ) {
+			__cpuidex(info, 7, 0);
+			ebx7 = info[1];
+		}
+#else
+		u32 eax = 0, ebx = 0, ecx = 0, edx = 0, ecx1 = 0, ebx7 = 0;
+		if ( __get_cpuid(1, &eax, &ebx, &ecx1, &edx) )
+		{
+			if ( __get_cpuid_max(0, 0) >= 7 ) {
+				__cpuid_count(7, 0, eax, ebx7, ecx, edx);
+			}
+		}
+		else
+		{
+			features &= ~CpuFeature_SSE2; // CPUID is not available, use the scalar paths
+		}
+#endif
+		// AVX2 needs the OS to save the YMM registers (OSXSAVE and XCR0 bits 1 and 2)
+		const bool osxsave = ecx1 & (1 << 27);
+		const bool avx = ecx1 & (1 << 28);
+		if ( osxsave && avx && (ebx7 & (1 << 5)) )
+		{
+#if PLATFORM_WINDOWS
+			const u64 xcr0 = _xgetbv(0);
+#else
+			u32 xcr0Low, xcr0High;
+			__asm__ volatile ("xgetbv" : "=a"(xcr0Low), "=d"(xcr0High) : "c"(0));
+			const u64 xcr0 = xcr0Low;
+#endif
+			if ( (xcr0 & 6) == 6 ) {
+				features |= CpuFeature_AVX2;
+			}
+		}
+#endif
+		gCpuFeatures = features;
+	}
+	return gCpuFeatures;
+}
+
+// Sizes up to 16 bytes, with two overlapping loads and stores of the widest word that fits
+inline void MemCopySmall(byte *dst, const byte *src, u32 size)
+{
+	if ( size >= 8 ) {
+		const u64 head = *(const unaligned_u64*)src;
+		const u64 tail = *(const unaligned_u64*)(src + size - 8);
+		*(unaligned_u64*)dst = head;
+		*(unaligned_u64*)(dst + size - 8) = tail;
+	} else if ( size >= 4 ) {
+		const u32 head = *(const unaligned_u32*)src;
+		const u32 tail = *(const unaligned_u32*)(src + size - 4);
+		*(unaligned_u32*)dst = head;
+		*(unaligned_u32*)(dst + size - 4) = tail;
+	} else if ( size >= 2 ) {
+		const u16 head = *(const unaligned_u16*)src;
+		const u16 tail = *(const unaligned_u16*)(src + size - 2);
+		*(unaligned_u16*)dst = head;
+		*(unaligned_u16*)(dst + size - 2) = tail;
+	} else if ( size == 1 ) {
+		*dst = *src;
+	}
+}
+
+inline void MemSetSmall(byte *ptr, u32 size, byte value)
+{
+	const u64 pattern = value * 0x0101010101010101ull;
+	if ( size >= 8 ) {
+		*(unaligned_u64*)ptr = pattern;
+		*(unaligned_u64*)(ptr + size - 8) = pattern;
+	} else if ( size >= 4 ) {
+		*(unaligned_u32*)ptr = (u32)pattern;
+		*(unaligned_u32*)(ptr + size - 4) = (u32)pattern;
+	} else if ( size >= 2 ) {
+		*(unaligned_u16*)ptr = (u16)pattern;
+		*(unaligned_u16*)(ptr + size - 2) = (u16)pattern;
+	} else if ( size == 1 ) {
+		*ptr = value;
+	}
+}
+
+MEM_NO_LIBC i32 MemCompareBytes(const byte *a, const byte *b, u32 size)
+{
+	for (u32 i = 0; i < size; ++i) {
+		if ( a[i] != b[i] ) {
+			return a[i] - b[i];
+		}
+	}
+	return 0;
+}
+
+// Sizes up to 16 bytes, finding the first different byte only when the words differ
+inline i32 MemCompareSmall(const byte *a, const byte *b, u32 size)
+{
+	if ( size >= 8 ) {
+		if ( *(const unaligned_u64*)a != *(const unaligned_u64*)b ) {
+			return MemCompareBytes(a, b, 8);
+		}
+		const u32 tail = size - 8;
+		if ( *(const unaligned_u64*)(a + tail) != *(const unaligned_u64*)(b + tail) ) {
+			return MemCompareBytes(a + tail, b + tail, 8);
+		}
+		return 0;
+	}
+	return MemCompareBytes(a, b, size);
+}
+
+// Portable versions, 8 bytes at a time
+
+MEM_NO_LIBC void MemCopyWords(void *dst, const void *src, u32 size)
+{
+	byte *pDst = (byte*)dst;
+	const byte *pSrc = (const byte*)src;
+	if ( size <= 16 ) {
+		MemCopySmall(pDst, pSrc, size);
+		return;
+	}
+	const u64 head = *(const unaligned_u64*)pSrc;
+	const u64 tail0 = *(const unaligned_u64*)(pSrc + size - 16);
+	const u64 tail1 = *(const unaligned_u64*)(pSrc + size - 8);
+	*(unaligned_u64*)pDst = head;
+	const u32 end = size - 16;
+	for (u32 i = 8 - ((u64)pDst & 7); i < end; i += 8) {
+		*(u64*)(pDst + i) = *(const unaligned_u64*)(pSrc + i);
+	}
+	*(unaligned_u64*)(pDst + end) = tail0;
+	*(unaligned_u64*)(pDst + end + 8) = tail1;
+}
+
+MEM_NO_LIBC void MemSetWords(void *ptr, u32 size, byte value)
+{
+	byte *pDst = (byte*)ptr;
+	if ( size <= 16 ) {
+		MemSetSmall(pDst, size, value);
+		return;
+	}
+	const u64 pattern = value * 0x0101010101010101ull;
+	*(unaligned_u64*)pDst = pattern;
+	const u32 end = size - 8;
+	for (u32 i = 8 - ((u64)pDst & 7); i < end; i += 8) {
+		*(u64*)(pDst + i) = pattern;
+	}
+	*(unaligned_u64*)(pDst + end) = pattern;
+}
+
+MEM_NO_LIBC i32 MemCompareWords(const void *a, const void *b, u32 size)
+{
+	const byte *pA = (const byte*)a;
+	const byte *pB = (const byte*)b;
+	if ( size <= 16 ) {
+		return MemCompareSmall(pA, pB, size);
+	}
+	u32 i = 0;
+	for (; i + 8 <= size; i += 8) {
+		if ( *(const unaligned_u64*)(pA + i) != *(const unaligned_u64*)(pB + i) ) {
+			return MemCompareBytes(pA + i, pB + i, 8);
+		}
+	}
+	return MemCompareBytes(pA + i, pB + i, size - i);
+}
+
+#if USE_MEMORY_SSE2
+
+// SSE2 versions, 16 bytes at a time with aligned stores, unrolled four times
+
+MEM_NO_LIBC void MemCopyVectorsSSE2(byte *dst, const byte *src, u32 size, bool nonTemporal)
+{
+	const __m128i head = _mm_loadu_si128((const __m128i*)src);
+	const __m128i tail = _mm_loadu_si128((const __m128i*)(src + size - 16));
+	_mm_storeu_si128((__m128i*)dst, head);
+	const u32 end = size - 16;
+	u32 i = 16 - ((u64)dst & 15);
+	if ( nonTemporal )
+	{
+		for (; i < end; i += 16) {
+			_mm_stream_si128((__m128i*)(dst + i), _mm_loadu_si128((const __m128i*)(src + i)));
+		}
+		_mm_sfence();
+	}
+	else
+	{
+		for (; i + 64 <= end; i += 64) {
+			const __m128i v0 = _mm_loadu_si128((const __m128i*)(src + i));
+			const __m128i v1 = _mm_loadu_si128((const __m128i*)(src + i + 16));
+			const __m128i v2 = _mm_loadu_si128((const __m128i*)(src + i + 32));
+			const __m128i v3 = _mm_loadu_si128((const __m128i*)(src + i + 48));
+			_mm_store_si128((__m128i*)(dst + i), v0);
+			_mm_store_si128((__m128i*)(dst + i + 16), v1);
+			_mm_store_si128((__m128i*)(dst + i + 32), v2);
+			_mm_store_si128((__m128i*)(dst + i + 48), v3);
+		}
+		for (; i < end; i += 16) {
+			_mm_store_si128((__m128i*)(dst + i), _mm_loadu_si128((const __m128i*)(src + i)));
+		}
+	}
+	_mm_storeu_si128((__m128i*)(dst + end), tail);
+}
+
+void MemCopySSE2(void *dst, const void *src, u32 size)
+{
+	if ( size <= 16 ) {
+		MemCopySmall((byte*)dst, (const byte*)src, size);
+	} else {
+		MemCopyVectorsSSE2((byte*)dst, (const byte*)src, size, size >= MEM_NON_TEMPORAL_THRESHOLD);
+	}
+}
+
+void MemCopyStreamSSE2(void *dst, const void *src, u32 size)
+{
+	if ( size <= 16 ) {
+		MemCopySmall((byte*)dst, (const byte*)src, size);
+	} else {
+		MemCopyVectorsSSE2((byte*)dst, (const byte*)src, size, true);
+	}
+}
+
+MEM_NO_LIBC void MemSetSSE2(void *ptr, u32 size, byte value)
+{
+	byte *pDst = (byte*)ptr;
+	if ( size <= 16 ) {
+		MemSetSmall(pDst, size, value);
+		return;
+	}
+	const __m128i pattern = _mm_set1_epi8((char)value);
+	_mm_storeu_si128((__m128i*)pDst, pattern);
+	const u32 end = size - 16;
+	u32 i = 16 - ((u64)pDst & 15);
+	for (; i + 64 <= end; i += 64) {
+		_mm_store_si128((__m128i*)(pDst + i), pattern);
+		_mm_store_si128((__m128i*)(pDst + i + 16), pattern);
+		_mm_store_si128((__m128i*)(pDst + i + 32), pattern);
+		_mm_store_si128((__m128i*)(pDst + i + 48), pattern);
+	}
+	for (; i < end; i += 16) {
+		_mm_store_si128((__m128i*)(pDst + i), pattern);
+	}
+	_mm_storeu_si128((__m128i*)(pDst + end), pattern);
+}
+
+MEM_NO_LIBC i32 MemCompareSSE2(const void *a, const void *b, u32 size)
+{
+	const byte *pA = (const byte*)a;
+	const byte *pB = (const byte*)b;
+	if ( size <= 16 ) {
+		return MemCompareSmall(pA, pB, size);
+	}
+	// Four vectors are checked with a single mask, and the tail overlaps bytes already
+	// known to be equal
+	u32 i = 0;
+	for (; i + 64 <= size; i += 64) {
+		const __m128i e0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(pA + i)), _mm_loadu_si128((const __m128i*)(pB + i)));
+		const __m128i e1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(pA + i + 16)), _mm_loadu_si128((const __m128i*)(pB + i + 16)));
+		const __m128i e2 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(pA + i + 32)), _mm_loadu_si128((const __m128i*)(pB + i + 32)));
+		const __m128i e3 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(pA + i + 48)), _mm_loadu_si128((const __m128i*)(pB + i + 48)));
+		const __m128i all = _mm_and_si128(_mm_and_si128(e0, e1), _mm_and_si128(e2, e3));
+		if ( _mm_movemask_epi8(all) != 0xffff ) {
+			break;
+		}
+	}
+	const u32 end = size - 16;
+	for (i = i < end ? i : end; ; i = i + 16 < end ? i + 16 : end) {
+		const __m128i va = _mm_loadu_si128((const __m128i*)(pA + i));
+		const __m128i vb = _mm_loadu_si128((const __m128i*)(pB + i));
+		const u32 equal = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb));
+		if ( equal != 0xffff ) {
+			const u32 index = i + CTZ(~equal);
+			return pA[index] - pB[index];
+		}
+		if ( i == end ) {
+			return 0;
+		}
+	}
+}
+
+// AVX2 versions, 32 bytes at a time, compiled for AVX2 but only called when the CPU has it
+
+MEM_TARGET_AVX2 MEM_NO_LIBC void MemCopyVectorsAVX2(byte *dst, const byte *src, u32 size, bool nonTemporal)
+{
+	const __m256i head = _mm256_loadu_si256((const __m256i*)src);
+	const __m256i tail = _mm256_loadu_si256((const __m256i*)(src + size - 32));
+	_mm256_storeu_si256((__m256i*)dst, head);
+	const u32 end = size - 32;
+	u32 i = 32 - ((u64)dst & 31);
+	if ( nonTemporal )
+	{
+		for (; i < end; i += 32) {
+			_mm256_stream_si256((__m256i*)(dst + i), _mm256_loadu_si256((const __m256i*)(src + i)));
+		}
+		_mm_sfence();
+	}
+	else
+	{
+		for (; i + 128 <= end; i += 128) {
+			const __m256i v0 = _mm256_loadu_si256((const __m256i*)(src + i));
+			const __m256i v1 = _mm256_loadu_si256((const __m256i*)(src + i + 32));
+			const __m256i v2 = _mm256_loadu_si256((const __m256i*)(src + i + 64));
+			const __m256i v3 = _mm256_loadu_si256((const __m256i*)(src + i + 96));
+			_mm256_store_si256((__m256i*)(dst + i), v0);
+			_mm256_store_si256((__m256i*)(dst + i + 32), v1);
+			_mm256_store_si256((__m256i*)(dst + i + 64), v2);
+			_mm256_store_si256((__m256i*)(dst + i + 96), v3);
+		}
+		for (; i < end; i += 32) {
+			_mm256_store_si256((__m256i*)(dst + i), _mm256_loadu_si256((const __m256i*)(src + i)));
+		}
+	}
+	_mm256_storeu_si256((__m256i*)(dst + end), tail);
+}
+
+MEM_TARGET_AVX2 void MemCopyAVX2(void *dst, const void *src, u32 size)
+{
+	if ( size <= 32 ) {
+		MemCopySSE2(dst, src, size);
+	} else {
+		MemCopyVectorsAVX2((byte*)dst, (const byte*)src, size, size >= MEM_NON_TEMPORAL_THRESHOLD);
+	}
+}
+
+MEM_TARGET_AVX2 void MemCopyStreamAVX2(void *dst, const void *src, u32 size)
+{
+	if ( size <= 32 ) {
+		MemCopySSE2(dst, src, size);
+	} else {
+		MemCopyVectorsAVX2((byte*)dst, (const byte*)src, size, true);
+	}
+}
+
+MEM_TARGET_AVX2 MEM_NO_LIBC void MemSetAVX2(void *ptr, u32 size, byte value)
+{
+	byte *pDst = (byte*)ptr;
+	if ( size <= 32 ) {
+		MemSetSSE2(ptr, size, value);
+		return;
+	}
+	const __m256i pattern = _mm256_set1_epi8((char)value);
+	_mm256_storeu_si256((__m256i*)pDst, pattern);
+	const u32 end = size - 32;
+	u32 i = 32 - ((u64)pDst & 31);
+	for (; i + 128 <= end; i += 128) {
+		_mm256_store_si256((__m256i*)(pDst + i), pattern);
+		_mm256_store_si256((__m256i*)(pDst + i + 32), pattern);
+		_mm256_store_si256((__m256i*)(pDst + i + 64), pattern);
+		_mm256_store_si256((__m256i*)(pDst + i + 96), pattern);
+	}
+	for (; i < end; i += 32) {
+		_mm256_store_si256((__m256i*)(pDst + i), pattern);
+	}
+	_mm256_storeu_si256((__m256i*)(pDst + end), pattern);
+}
+
+MEM_TARGET_AVX2 MEM_NO_LIBC i32 MemCompareAVX2(const void *a, const void *b, u32 size)
+{
+	const byte *pA = (const byte*)a;
+	const byte *pB = (const byte*)b;
+	if ( size <= 32 ) {
+		return MemCompareSSE2(a, b, size);
+	}
+	u32 i = 0;
+	for (; i + 128 <= size; i += 128) {
+		const __m256i e0 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(pA + i)), _mm256_loadu_si256((const __m256i*)(pB + i)));
+		const __m256i e1 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(pA + i + 32)), _mm256_loadu_si256((const __m256i*)(pB + i + 32)));
+		const __m256i e2 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(pA + i + 64)), _mm256_loadu_si256((const __m256i*)(pB + i + 64)));
+		const __m256i e3 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(pA + i + 96)), _mm256_loadu_si256((const __m256i*)(pB + i + 96)));
+		const __m256i all = _mm256_and_si256(_mm256_and_si256(e0, e1), _mm256_and_si256(e2, e3));
+		if ( (u32)_mm256_movemask_epi8(all) != 0xffffffff ) {
+			break;
+		}
+	}
+	const u32 end = size - 32;
+	for (i = i < end ? i : end; ; i = i + 32 < end ? i + 32 : end) {
+		const __m256i va = _mm256_loadu_si256((const __m256i*)(pA + i));
+		const __m256i vb = _mm256_loadu_si256((const __m256i*)(pB + i));
+		const u32 equal = (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb));
+		if ( equal != 0xffffffff ) {
+			const u32 index = i + CTZ(~equal);
+			return pA[index] - pB[index];
+		}
+		if ( i == end ) {
+			return 0;
+		}
+	}
+}
+
+#endif // USE_MEMORY_SSE2
+
+typedef void MemCopyFunc(void *dst, const void *src, u32 size);
+typedef void MemSetFunc(void *ptr, u32 size, byte value);
+typedef i32 MemCompareFunc(const void *a, const void *b, u32 size);
+
+struct MemFunctions
+{
+	MemCopyFunc *copy;
+	MemCopyFunc *copyStream;
+	MemSetFunc *set;
+	MemCompareFunc *compare;
+};
+
+void MemCopyResolve(void *dst, const void *src, u32 size);
+void MemCopyStreamResolve(void *dst, const void *src, u32 size);
+void MemSetResolve(void *ptr, u32 size, byte value);
+i32 MemCompareResolve(const void *a, const void *b, u32 size);
+
+static MemFunctions gMemFunctions = { MemCopyResolve, MemCopyStreamResolve, MemSetResolve, MemCompareResolve };
+
+// Selects the widest versions among the given CPU features that the CPU also supports.
+// Called on first use with all of them, and by tests and benchmarks to pick a version.
+u32 MemUseCpuFeatures(u32 features)
+{
+	features &= GetCpuFeatures();
+	MemFunctions functions = { MemCopyWords, MemCopyWords, MemSetWords, MemCompareWords };
+#if USE_MEMORY_SSE2
+	if ( features & CpuFeature_AVX2 ) {
+		functions = { MemCopyAVX2, MemCopyStreamAVX2, MemSetAVX2, MemCompareAVX2 };
+	} else if ( features & CpuFeature_SSE2 ) {
+		functions = { MemCopySSE2, MemCopyStreamSSE2, MemSetSSE2, MemCompareSSE2 };
+	}
+#endif
+	gMemFunctions = functions;
+	return features;
+}
+
+void MemCopyResolve(void *dst, const void *src, u32 size)
+{
+	MemUseCpuFeatures(GetCpuFeatures());
+	gMemFunctions.copy(dst, src, size);
+}
+
+void MemCopyStreamResolve(void *dst, const void *src, u32 size)
+{
+	MemUseCpuFeatures(GetCpuFeatures());
+	gMemFunctions.copyStream(dst, src, size);
+}
+
+void MemSetResolve(void *ptr, u32 size, byte value)
+{
+	MemUseCpuFeatures(GetCpuFeatures());
+	gMemFunctions.set(ptr, size, value);
+}
+
+i32 MemCompareResolve(const void *a, const void *b, u32 size)
+{
+	MemUseCpuFeatures(GetCpuFeatures());
+	return gMemFunctions.compare(a, b, size);
+}
+
+void MemSet(void *ptr, u32 size, byte value)
+{
+	if ( size <= 16 ) {
+		MemSetSmall((byte*)ptr, size, value);
+	} else {
+		gMemFunctions.set(ptr, size, value);
+	}
+}
+
+void MemCopy(void *dst, const void *src, u32 size)
+{
+	if ( size <= 16 ) {
+		MemCopySmall((byte*)dst, (const byte*)src, size);
+	} else {
+		gMemFunctions.copy(dst, src, size);
+	}
+}
+
+// Copies into write-combined memory, like mapped GPU buffers, with non-temporal stores
+// at any size. Reading the destination back afterwards is slow.
+void MemCopyToDevice(void *dst, const void *src, u32 size)
+{
+	gMemFunctions.copyStream(dst, src, size);
+}
+
+i32 MemCompare(const void *a, const void *b, u32 size)
+{
+	if ( size <= 16 ) {
+		return MemCompareSmall((const byte*)a, (const byte*)b, size);
+	}
+	return gMemFunctions.compare(a, b, size);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Arena
+
+enum ArenaFlags
+{
+	ArenaFlag_Growable = 1 << 0,   // Commits pages of its reserved range as they are pushed
+	ArenaFlag_GuardPages = 1 << 1, // Commits page by page, so overruns past the last page fault
+};
+
+struct Arena
+{
+	byte* base;
+	u64 used;
+	u64 size;      // Reserved size for growable arenas
+	u64 committed; // Bytes from base that can be written, the size for fixed arenas
+	u64 retained;  // ResetArena releases the pages used past this high-water mark
+	u32 flags;
+	const char *name;
+};
+
+// Growable arenas commit at least this much at a time, unless they have guard pages
+#define ARENA_COMMIT_SIZE KB(64)
+
+Arena MakeArena(byte* base, u64 size, const char *name)
+{
+	ASSERTMSG(base != NULL, "MakeArena needs a non-null base pointer.");
+	ASSERTMSG(size > 0, "MakeArena needs a size greater-than-zero.");
+	Arena arena = {};
+	arena.base = base;
+	arena.size = size;
+	arena.used = 0;
+	arena.committed = size;
+	arena.retained = size;
+	arena.name = name;
+	return arena;
+}
+
+// Reserves reserveSize bytes of address space and commits none of it. ResetArena gives
+// the pages used past retainSize back to the OS. With ArenaFlag_GuardPages, a page after
+// the reserved range is never committed either.
+Arena MakeGrowableArena(u64 reserveSize, u64 retainSize, const char *name, u32 flags = 0)
+{
+	ASSERTMSG(reserveSize > 0, "MakeGrowableArena needs a size greater-than-zero.");
+	const u64 pageSize = GetVirtualMemoryPageSize();
+	reserveSize = ( reserveSize + pageSize - 1 ) & ~( pageSize - 1 );
+	const u64 guardSize = ( flags & ArenaFlag_GuardPages ) ? pageSize : 0;
+	byte *base = (byte*)ReserveVirtualMemory(reserveSize + guardSize);
+	ASSERTMSG(base != NULL, "MakeGrowableArena could not reserve %llu bytes for %s.\n", reserveSize, name);
+	Arena arena = {};
+	arena.base = base;
+	arena.size = reserveSize;
+	arena.retained = retainSize;
+	arena.flags = flags | ArenaFlag_Growable;
+	arena.name = name;
+	return arena;
+}
+
+// Releases the whole reserved range of a growable arena
+void FreeGrowableArena(Arena &arena)
+{
+	ASSERT(arena.flags & ArenaFlag_Growable);
+	const u64 guardSize = ( arena.flags & ArenaFlag_GuardPages ) ? GetVirtualMemoryPageSize() : 0;
+	FreeVirtualMemory(arena.base, arena.size + guardSize);
+	arena = {};
+}
+
+// Makes the first used bytes of the arena writable, committing pages if it is growable
+void CommitArena(Arena &arena, u64 used)
+{
+	ASSERTMSG(used <= arena.size,
+		"PushSize out of bounds of the memory arena.\n"
+		"- Arena: %s\n"
+		"- push size: %llu\n- arena size: %llu\n- arena remaining size: %llu\n).",
+		arena.name,
+		used - arena.used, arena.size, arena.size - arena.used);
+	if ( arena.flags & ArenaFlag_Growable )
+	{
+		// Whole pages from the first one not committed yet
+		const u64 pageSize = GetVirtualMemoryPageSize();
+		const u64 pageMask = pageSize - 1;
+		const u64 commitSize = ( arena.flags & ArenaFlag_GuardPages ) ? pageSize : ARENA_COMMIT_SIZE;
+		const u64 baseOffset = (u64)arena.base & pageMask;
+		const u64 begin = ( baseOffset + arena.committed + pageMask ) & ~pageMask;
+		u64 end = ( baseOffset + used + commitSize - 1 ) / commitSize * commitSize;
+		end = ( end + pageMask ) & ~pageMask;
+		if ( end > baseOffset + arena.size ) {
+			end = ( baseOffset + arena.size + pageMask ) & ~pageMask;
+		}
+		if ( end > begin ) {
+			const bool committed = CommitVirtualMemory(arena.base - baseOffset + begin, end - begin);
+			ASSERTMSG(committed, "CommitArena could not commit %llu bytes for %s.\n", end - begin, arena.name);
+		}
+		const u64 committedEnd = end - baseOffset;
+		arena.committed = committedEnd < arena.size ? committedEnd : arena.size;
+	}
+	else
+	{
+		arena.committed = arena.size;
+	}
+}
+
+Arena MakeSubArena(Arena &arena, u64 size, const char *name)
+{
+	ASSERTMSG(arena.used + size <= arena.size,
+			"MakeSubArena out of bounds of the memory arena.\n"
+			"- Arena: %s\n"
+			"- Subarena: %s\n",
+			arena.name, name);
+	// Sub-arenas of growable arenas also grow into their part of the reserved range
+	Arena subarena = {};
+	subarena.base = arena.base + arena.used;
+	subarena.size = size;
+	subarena.used = 0;
+	subarena.committed = arena.committed > arena.used ? arena.committed - arena.used : 0;
+	subarena.committed = subarena.committed < size ? subarena.committed : size;
+	subarena.retained = arena.retained;
+	subarena.flags = arena.flags;
+	subarena.name = name;
+	return subarena;
+}
+
+Arena MakeSubArena(Arena &arena, const char *name)
+{
+	u64 remainingSize = arena.size - arena.used;
+	Arena subarena = MakeSubArena(arena, remainingSize, name);
+	return subarena;
+}
+
+Arena PushSubArena(Arena &arena, u64 size, const char *name)
+{
+	Arena subArena = MakeSubArena(arena, size, name);
+	arena.used += size;
+	return subArena;
+}
+
+Arena PushSubArena(Arena &arena, const char *name)
+{
+	Arena subArena = MakeSubArena(arena, name);
+	arena.used = arena.size;
+	return subArena;
+}
+
+byte* PushSize(Arena &arena, u64 size)
+{
+	const u64 used = arena.used + size;
+	if ( used > arena.committed ) {
+		CommitArena(arena, used);
+	}
+	byte* head = arena.base + arena.used;
+	arena.used = used;
+	return head;
+}
+
+// Returns the next size bytes of the arena, committed but not pushed, for code that writes
+// first and pushes what it wrote afterwards
+byte* PeekSize(Arena &arena, u64 size)
+{
+	const u64 used = arena.used + size;
+	if ( used > arena.committed ) {
+		CommitArena(arena, used);
+	}
+	byte* head = arena.base + arena.used;
+	return head;
+}
+
+byte* PushZeroSize(Arena &arena, u64 size)
+{
+	byte *bytes = PushSize(arena, size);
+	for (u64 offset = 0; offset < size; offset += GB(1)) {
+		const u64 remaining = size - offset;
+		MemSet(bytes + offset, remaining < GB(1) ? (u32)remaining : GB(1), 0);
+	}
+	return bytes;
+}
+
+char *PushStringN(Arena &arena, const char *str, u32 len)
+{
+	char *bytes = (char*)PushSize(arena, len+1);
+	MemCopy(bytes, str, len);
+	bytes[len] = 0;
+	return bytes;
+}
+
+char *PushString(Arena &arena, const char *str)
+{
+	u32 len = StrLen(str);
+	char *bytes = PushStringN(arena, str, len);
+	return bytes;
+}
+
+char *PushString(Arena &arena, String str)
+{
+	char *bytes = PushStringN(arena, str.str, str.size);
+	return bytes;
+}
+
+char *PushChar(Arena &arena, char c)
+{
+	char *bytes = (char*)PushSize(arena, sizeof(c));
+	*bytes = c;
+	return bytes;
+}
+
+void ResetArena(Arena &arena)
+{
+	// Tell the OS we don't need the pages used past the high-water mark. They stay
+	// committed, so the next pushes only fault them back in.
+	if ( (arena.flags & ArenaFlag_Growable) && arena.used > arena.retained )
+	{
+		const u64 pageMask = GetVirtualMemoryPageSize() - 1;
+		const u64 begin = ( (u64)arena.base + arena.retained + pageMask ) & ~pageMask;
+		const u64 end = ( (u64)arena.base + arena.used ) & ~pageMask;
+		if ( end > begin ) {
+			ReleaseVirtualMemoryPages((void*)begin, end - begin);
+		}
+	}
+	arena.used = 0;
+}
+
+#define ZeroStruct( pointer ) MemSet(pointer, sizeof(*pointer), 0)
+#define PushStruct( arena, struct_type ) (struct_type*)PushSize(arena, sizeof(struct_type))
+#define PushArray( arena, type, count ) (type*)PushSize(arena, sizeof(type) * (count))
+#define PushZeroStruct( arena, struct_type ) (struct_type*)PushZeroSize(arena, sizeof(struct_type))
+#define PushZeroArray( arena, type, count ) (type*)PushZeroSize(arena, sizeof(type) * (count))
+
+// Scratch arenas of one thread, one per nesting level of scratches, so a nested scratch
+// never writes over the one it is nested in. Only its own thread pushes and pops, so it
+// takes no lock and no atomic operation.
+#define SCRATCH_STACK_DEPTH 4
+#define SCRATCH_ARENA_RESERVE GB(1)
+
+struct ScratchStack
+{
+	const char *name;
+	u32 depth;
+	u32 maxDepth; // Deepest nesting seen
+	Arena arenas[SCRATCH_STACK_DEPTH];
+	u64 highWater[SCRATCH_STACK_DEPTH]; // Most bytes used at each nesting level
+};
+
+// Returns the nesting level, to be given back to PopScratchArena with the arena copy
+u32 PushScratchArena(ScratchStack &stack, Arena &outArena, u64 minSize)
+{
+	ASSERTMSG(stack.depth < SCRATCH_STACK_DEPTH, "Scratches nested deeper than %u levels.\n", SCRATCH_STACK_DEPTH);
+	const u32 index = stack.depth++;
+	stack.maxDepth = stack.depth > stack.maxDepth ? stack.depth : stack.maxDepth;
+
+	Arena &arena = stack.arenas[index];
+	if ( !arena.base ) {
+		arena = MakeGrowableArena(SCRATCH_ARENA_RESERVE, SCRATCH_ARENA_RESERVE, "Scratch arena");
+	}
+	if ( arena.committed < minSize ) {
+		CommitArena(arena, minSize);
+	}
+
+	outArena = arena;
+	outArena.used = 0;
+	return index;
+}
+
+// Keeps what the copy committed, so later scratches do not commit the same pages again
+void PopScratchArena(ScratchStack &stack, u32 index, const Arena &arena)
+{
+	ASSERTMSG(index + 1 == stack.depth, "Scratches must be released in reverse order.\n");
+	stack.depth = index;
+
+	Arena &stackArena = stack.arenas[index];
+	stackArena.committed = arena.committed > stackArena.committed ? arena.committed : stackArena.committed;
+	stack.highWater[index] = arena.used > stack.highWater[index] ? arena.used : stack.highWater[index];
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// String interning
+
+// Open addressing table with linear probing. Slots keep the hash and the length inline,
+// so probing only touches the string bytes on a full hash match. A zero hash marks an
+// empty slot, and it is written last so lock-free readers never see a half-filled slot.
+//
+// When the load factor reaches 3/4 the table doubles, but the entries are not rehashed
+// all at once: the previous table stays readable and every insert moves a few of its
+// slots into the new one. Old tables are never freed (they live in the arena), so
+// readers can keep probing a table while it is being replaced. Each table links the
+// one it replaced, and readers probe it after a miss, as the migration may finish
+// while they probe the current table.
+
+#define STRING_INTERNING_INITIAL_CAPACITY 1024
+#define STRING_INTERNING_MIGRATE_STEP 8
+
+struct StringIntern
+{
+	volatile_u32 hash;
+	u32 len;
+	const char *str;
+};
+
+struct StringInterningTable
+{
+	StringIntern *slots;
+	u32 capacity; // Power of two
+	u32 count;
+	const StringInterningTable *prev; // Table it replaced, or NULL
+};
+
+struct StringInterning
+{
+	Arena *arena;
+	StringInterningTable * volatile table;
+	StringInterningTable *oldTable; // Being migrated into table, or NULL (writers only)
+	u32 migrateIndex;
+	volatile_u32 lock;
+	bool threadSafe;
+};
+
+static u32 StringInternHash(const char *str, u32 len)
+{
+	const u32 hash = HashWY32(str, len);
+	return hash ? hash : 1;
+}
+
+static StringInterningTable *StringInterningTableCreate(Arena *arena, u32 capacity)
+{
+	ASSERT((capacity & (capacity - 1)) == 0);
+	StringInterningTable *table = PushZeroStruct(*arena, StringInterningTable);
+	table->slots = PushZeroArray(*arena, StringIntern, capacity);
+	table->capacity = capacity;
+	return table;
+}
+
+StringInterning StringInterningCreate(Arena *arena, bool threadSafe = false)
+{
+	StringInterning interning = {
+		.arena = arena,
+		.table = StringInterningTableCreate(arena, STRING_INTERNING_INITIAL_CAPACITY),
+		.threadSafe = threadSafe,
+	};
+	return interning;
+}
+
+static const char *FindStringIntern(const StringInterningTable *table, const char *str, u32 len, u32 hash)
+{
+	const u32 mask = table->capacity - 1;
+	for (u32 index = hash & mask;; index = (index + 1) & mask)
+	{
+		const StringIntern &slot = table->slots[index];
+		const u32 slotHash = AtomicLoadAcquire(&slot.hash);
+		if ( slotHash == 0 ) {
+			return NULL;
+		}
+		if ( slotHash == hash && slot.len == len && MemCompare(slot.str, str, len) == 0 ) {
+			return slot.str;
+		}
+	}
+}
+
+static const char *FindStringIntern(const StringInterning *context, const char *str, u32 len, u32 hash)
+{
+	// Strings not migrated yet are in the previous table. The one before it was fully
+	// migrated before the previous table was replaced, so there is no need to go further.
+	const StringInterningTable *table = (const StringInterningTable *)AtomicLoadAcquire((void * volatile *)&context->table);
+	const char *intern = FindStringIntern(table, str, len, hash);
+	if ( !intern && table->prev ) {
+		intern = FindStringIntern(table->prev, str, len, hash);
+	}
+	return intern;
+}
+
+// Returns the interned string, or NULL if it was never interned. It takes no lock, so
+// workers can call it concurrently with MakeStringIntern on a thread-safe interner.
+const char *FindStringIntern(const StringInterning *context, const char *str, u32 len)
+{
+	ASSERT(context && context->table);
+	const u32 hash = StringInternHash(str, len);
+	const char *intern = FindStringIntern(context, str, len, hash);
+	return intern;
+}
+
+const char *FindStringIntern(const StringInterning *context, const char *str)
+{
+	const u32 len = StrLen(str);
+	const char *intern = FindStringIntern(context, str, len);
+	return intern;
+}
+
+static void StringInterningTableInsert(StringInterningTable *table, const char *str, u32 len, u32 hash)
+{
+	const u32 mask = table->capacity - 1;
+	u32 index = hash & mask;
+	while ( table->slots[index].hash != 0 ) {
+		index = (index + 1) & mask;
+	}
+	StringIntern &slot = table->slots[index];
+	slot.str = str;
+	slot.len = len;
+	AtomicStoreRelease(&slot.hash, hash);
+	table->count++;
+}
+
+static void StringInterningMigrate(StringInterning *context, u32 slotCount)
+{
+	StringInterningTable *oldTable = context->oldTable;
+	StringInterningTable *table = context->table;
+	const u32 end = context->migrateIndex + slotCount < oldTable->capacity ?
+		context->migrateIndex + slotCount : oldTable->capacity;
+
+	for (u32 i = context->migrateIndex; i < end; ++i)
+	{
+		const StringIntern &slot = oldTable->slots[i];
+		if ( slot.hash != 0 ) {
+			StringInterningTableInsert(table, slot.str, slot.len, slot.hash);
+		}
+	}
+
+	context->migrateIndex = end;
+	if ( end == oldTable->capacity ) {
+		context->oldTable = NULL;
+	}
+}
+
+static void StringInterningLock(StringInterning *context)
+{
+	if ( context->threadSafe ) {
+		while ( !AtomicSwap(&context->lock, 0, 1) ) {
+			while ( AtomicLoadAcquire(&context->lock) != 0 ) {}
+		}
+	}
+}
+
+static void StringInterningUnlock(StringInterning *context)
+{
+	if ( context->threadSafe ) {
+		AtomicStoreRelease(&context->lock, 0);
+	}
+}
+
+const char *MakeStringIntern(StringInterning *context, const char *str, u32 len)
+{
+	ASSERT(context && context->table);
+	const u32 hash = StringInternHash(str, len);
+
+	// Most calls find an existing string, so look it up before taking the lock
+	const char *intern = FindStringIntern(context, str, len, hash);
+	if ( intern ) {
+		return intern;
+	}
+
+	StringInterningLock(context);
+
+	intern = FindStringIntern(context, str, len, hash);
+	if ( !intern )
+	{
+		if ( context->oldTable ) {
+			StringInterningMigrate(context, STRING_INTERNING_MIGRATE_STEP);
+		}
+
+		StringInterningTable *table = context->table;
+		if ( 4 * (table->count + 1) > 3 * table->capacity )
+		{
+			// Migration outpaces inserts, this only finishes it off for very small tables
+			if ( context->oldTable ) {
+				StringInterningMigrate(context, context->oldTable->capacity);
+			}
+
+			StringInterningTable *newTable = StringInterningTableCreate(context->arena, 2 * table->capacity);
+			newTable->prev = table;
+			context->migrateIndex = 0;
+			context->oldTable = table;
+			AtomicStoreRelease((void * volatile *)&context->table, newTable);
+			table = newTable;
+		}
+
+		intern = PushStringN(*context->arena, str, len);
+		StringInterningTableInsert(table, intern, len, hash);
+	}
+
+	StringInterningUnlock(context);
+	return intern;
+}
+
+const char *MakeStringIntern(StringInterning *context, const char *str)
+{
+	const u32 len = StrLen(str);
+	const char *internStr = MakeStringIntern(context, str, len);
+	return internStr;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Files
+
+struct DataChunk
 {
 	union {
 		byte *bytes;
@@ -1187,7 +2432,7 @@ File OpenFile(const char *filename, FileMode mode)
 		}
 #else
 		ASSERT(mode == FileModeRead); // TODO: Implement for write-only
-		file.handle = CreateFileA( filename, GENERIC_READ, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_READONLY, NULL );
+		file.handle = CreateFileA( filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_READONLY, NULL );
 		if ( file.handle == INVALID_HANDLE_VALUE  ) {
 			Win32ReportError("CreateFileA");
 		} else {
@@ -1439,7 +2684,8 @@ bool GetFileLastWriteTimestamp(const char* filename, u64 &ts)
 	struct stat attrib;
 	if ( stat(filename, &attrib) == 0 )
 	{
-		ts = attrib.st_mtime;
+		// Nanoseconds, so files written twice within a second still compare newer
+		ts = (u64)attrib.st_mtim.tv_sec * 1000000000ull + (u64)attrib.st_mtim.tv_nsec;
 	}
 	else
 	{
@@ -1668,6 +2914,131 @@ void CloseDir(Dir &dir)
 
 
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// File watch
+
+// Kernel notifications for files written in a set of directories. Only Linux implements it
+// (inotify); CreateFileWatch fails elsewhere and callers poll timestamps instead.
+
+#if PLATFORM_LINUX
+#define USE_FILE_WATCH 1
+#else
+#define USE_FILE_WATCH 0
+#endif
+
+#define MAX_FILE_WATCH_DIRS 64
+
+struct FileWatchDir
+{
+	i32 handle;
+	const char *path;
+};
+
+struct FileWatch
+{
+	i32 fd;
+	FileWatchDir dirs[MAX_FILE_WATCH_DIRS];
+	volatile_u32 dirCount; // Directories can be added while another thread reads events
+};
+
+bool CreateFileWatch(FileWatch &watch)
+{
+	watch.fd = -1;
+	watch.dirCount = 0;
+#if USE_FILE_WATCH
+	watch.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if ( watch.fd == -1 ) {
+		LinuxReportError("inotify_init1");
+	}
+#endif
+	return watch.fd != -1;
+}
+
+void DestroyFileWatch(FileWatch &watch)
+{
+#if USE_FILE_WATCH
+	if ( watch.fd != -1 ) {
+		close(watch.fd);
+		watch.fd = -1;
+	}
+#endif
+}
+
+// Watches the files directly in the given directory, not in its subdirectories. The path
+// string must outlive the watch. Only one thread can add directories.
+bool AddFileWatchDirectory(FileWatch &watch, const char *path)
+{
+	bool ok = false;
+#if USE_FILE_WATCH
+	const u32 dirCount = watch.dirCount;
+	if ( watch.fd != -1 && dirCount < MAX_FILE_WATCH_DIRS )
+	{
+		// Written and moved-in files only: editors and compilers save through either
+		const i32 handle = inotify_add_watch(watch.fd, path, IN_CLOSE_WRITE | IN_MOVED_TO);
+		if ( handle != -1 ) {
+			watch.dirs[dirCount] = { .handle = handle, .path = path };
+			AtomicStoreRelease(&watch.dirCount, dirCount + 1);
+			ok = true;
+		} else {
+			char text[MAX_PATH_LENGTH];
+			SPrintf(text, "inotify_add_watch %s", path);
+			LinuxReportError(text);
+		}
+	}
+#endif
+	return ok;
+}
+
+// Waits up to timeoutMillis for changes, and returns the number of changed files written
+// to paths. The same file can appear more than once. Overflow is set if the kernel or the
+// paths array dropped changes, so the caller has to check all of its files.
+u32 ReadFileWatchEvents(FileWatch &watch, u32 timeoutMillis, FilePath *paths, u32 maxPaths, bool &overflow)
+{
+	u32 pathCount = 0;
+	overflow = false;
+#if USE_FILE_WATCH
+	pollfd pollFd = { .fd = watch.fd, .events = POLLIN };
+	if ( poll(&pollFd, 1, timeoutMillis) <= 0 ) {
+		return 0;
+	}
+
+	alignas(inotify_event) char buffer[KB(4)];
+	for (;;)
+	{
+		const ssize_t size = read(watch.fd, buffer, sizeof(buffer));
+		if ( size <= 0 ) {
+			break; // EAGAIN, no more events queued
+		}
+
+		const u32 dirCount = AtomicLoadAcquire(&watch.dirCount);
+		for (ssize_t offset = 0; offset < size; )
+		{
+			const inotify_event *event = (const inotify_event *)(buffer + offset);
+			offset += sizeof(inotify_event) + event->len;
+
+			if ( event->mask & IN_Q_OVERFLOW ) {
+				overflow = true;
+			}
+			if ( event->len == 0 ) {
+				continue;
+			}
+			if ( pathCount == maxPaths ) {
+				overflow = true;
+				continue;
+			}
+			for (u32 i = 0; i < dirCount; ++i) {
+				if ( watch.dirs[i].handle == event->wd ) {
+					SPrintf(paths[pathCount++].str, "%s/%s", watch.dirs[i].path, event->name);
+					break;
+				}
+			}
+		}
+	}
+#endif
+	return pathCount;
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // Process execution
 
@@ -1943,6 +3314,112 @@ static constexpr f32 TwoPi = 2.0f * Pi;
 static constexpr f32 ToRadians = Pi / 180.0f;
 static constexpr f32 ToDegrees = 180.0f / Pi;
 
+// Axis-aligned bounding box
+struct AABB
+{
+	float3 min;
+	float3 max;
+};
+
+// Matrix products, transposes, inverses and point and box transforms use SSE2 on x86-64
+// and NEON on AArch64, and the scalar versions (the *Scalar functions) elsewhere. Each
+// column of a float4x4 (mat[0] to mat[3]) fills one register. The SIMD products add in
+// the same order as the scalar code, so they match it bit for bit unless the target
+// fuses multiply-adds, as AArch64 does.
+
+#if defined(__x86_64__) || defined(_M_X64)
+#	define USE_MATH_SSE 1
+#	include <immintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#	define USE_MATH_NEON 1
+#	include <arm_neon.h>
+#endif
+
+#if USE_MATH_SSE
+
+typedef __m128 v4f;
+
+// Lanes i0 and i1 of a, then lanes i2 and i3 of b
+#define V4Shuffle(a, b, i0, i1, i2, i3) _mm_shuffle_ps(a, b, _MM_SHUFFLE(i3, i2, i1, i0))
+
+inline v4f V4Load(const f32 *p) { return _mm_loadu_ps(p); }
+inline void V4Store(f32 *p, v4f v) { _mm_storeu_ps(p, v); }
+inline v4f V4Splat(f32 s) { return _mm_set1_ps(s); }
+inline v4f V4Add(v4f a, v4f b) { return _mm_add_ps(a, b); }
+inline v4f V4Sub(v4f a, v4f b) { return _mm_sub_ps(a, b); }
+inline v4f V4Mul(v4f a, v4f b) { return _mm_mul_ps(a, b); }
+inline v4f V4MulAdd(v4f a, v4f b, v4f c) { return _mm_add_ps(_mm_mul_ps(a, b), c); } // a * b + c
+inline v4f V4Abs(v4f a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+
+// float3 loads and stores that do not touch the 4 bytes past the vector
+inline v4f V4LoadFloat3(const float3 &v)
+{
+	const v4f xy = _mm_castpd_ps(_mm_load_sd((const double*)v.vec));
+	return _mm_movelh_ps(xy, _mm_load_ss(&v.z));
+}
+
+inline void V4StoreFloat3(float3 &v, v4f a)
+{
+	_mm_storel_pi((__m64*)v.vec, a);
+	_mm_store_ss(&v.z, _mm_movehl_ps(a, a));
+}
+
+#elif USE_MATH_NEON
+
+typedef float32x4_t v4f;
+
+inline v4f V4Load(const f32 *p) { return vld1q_f32(p); }
+inline void V4Store(f32 *p, v4f v) { vst1q_f32(p, v); }
+inline v4f V4Splat(f32 s) { return vdupq_n_f32(s); }
+inline v4f V4Add(v4f a, v4f b) { return vaddq_f32(a, b); }
+inline v4f V4Sub(v4f a, v4f b) { return vsubq_f32(a, b); }
+inline v4f V4Mul(v4f a, v4f b) { return vmulq_f32(a, b); }
+inline v4f V4MulAdd(v4f a, v4f b, v4f c) { return vfmaq_f32(c, a, b); } // a * b + c, fused
+inline v4f V4Abs(v4f a) { return vabsq_f32(a); }
+
+inline v4f V4LoadFloat3(const float3 &v)
+{
+	return vcombine_f32(vld1_f32(v.vec), vset_lane_f32(v.z, vdup_n_f32(0.0f), 0));
+}
+
+inline void V4StoreFloat3(float3 &v, v4f a)
+{
+	vst1_f32(v.vec, vget_low_f32(a));
+	vst1q_lane_f32(&v.z, a, 2);
+}
+
+#endif
+
+#if USE_MATH_SSE || USE_MATH_NEON
+#	define USE_MATH_SIMD 1
+
+// Column-wise matrix times vector: ((c0 * x + c1 * y) + c2 * z) + c3 * w
+inline v4f V4Transform(const v4f c[4], v4f v)
+{
+#if USE_MATH_SSE
+	v4f res = V4Mul(c[0], V4Shuffle(v, v, 0, 0, 0, 0));
+	res = V4MulAdd(c[1], V4Shuffle(v, v, 1, 1, 1, 1), res);
+	res = V4MulAdd(c[2], V4Shuffle(v, v, 2, 2, 2, 2), res);
+	res = V4MulAdd(c[3], V4Shuffle(v, v, 3, 3, 3, 3), res);
+#else
+	v4f res = vmulq_laneq_f32(c[0], v, 0);
+	res = vfmaq_laneq_f32(res, c[1], v, 1);
+	res = vfmaq_laneq_f32(res, c[2], v, 2);
+	res = vfmaq_laneq_f32(res, c[3], v, 3);
+#endif
+	return res;
+}
+
+inline void V4LoadColumns(v4f c[4], const float4x4 &m)
+{
+	c[0] = V4Load(m.mat[0]);
+	c[1] = V4Load(m.mat[1]);
+	c[2] = V4Load(m.mat[2]);
+	c[3] = V4Load(m.mat[3]);
+}
+
+#endif // USE_MATH_SSE || USE_MATH_NEON
+
 bool operator!=(uint2 a, uint2 b)
 {
 	const bool res = a.x != b.x || a.y != b.y;
@@ -2174,7 +3651,7 @@ float3 Mul(const float3 &a, f32 b)
 	return res;
 }
 
-float4 Mul(const float4x4 &a, const float4 &b)
+float4 MulScalar(const float4x4 &a, const float4 &b)
 {
 #define USE_ROWS_TIMES_COLUMNS_MATRIX_MULTIPLICATION 1
 #if USE_ROWS_TIMES_COLUMNS_MATRIX_MULTIPLICATION
@@ -2190,6 +3667,19 @@ float4 Mul(const float4x4 &a, const float4 &b)
 #endif
 }
 
+float4 Mul(const float4x4 &a, const float4 &b)
+{
+#if USE_MATH_SIMD
+	v4f columns[4];
+	V4LoadColumns(columns, a);
+	float4 res;
+	V4Store(res.vec, V4Transform(columns, V4Load(b.vec)));
+	return res;
+#else
+	return MulScalar(a, b);
+#endif
+}
+
 float3 MulVector(const float4x4 &a, const float3 &b)
 {
 	const float3 res = Mul(a, Float4(b, 0.0)).xyz;
@@ -2202,7 +3692,7 @@ float3 MulPoint(const float4x4 &a, const float3 &b)
 	return res;
 }
 
-float4x4 Mul(const float4x4 &a, const float4x4 &b)
+float4x4 MulScalar(const float4x4 &a, const float4x4 &b)
 {
 #define USE_ROWS_TIMES_COLUMNS_MATRIX_MULTIPLICATION 1
 #if USE_ROWS_TIMES_COLUMNS_MATRIX_MULTIPLICATION
@@ -2253,6 +3743,21 @@ float4x4 Mul(const float4x4 &a, const float4x4 &b)
 	return res;
 }
 
+float4x4 Mul(const float4x4 &a, const float4x4 &b)
+{
+#if USE_MATH_SIMD
+	v4f columns[4];
+	V4LoadColumns(columns, a);
+	float4x4 res;
+	for (u32 i = 0; i < 4; ++i) {
+		V4Store(res.mat[i], V4Transform(columns, V4Load(b.mat[i])));
+	}
+	return res;
+#else
+	return MulScalar(a, b);
+#endif
+}
+
 float3 Negate(const float3 &v)
 {
 	const float3 res = { -v.x, -v.y, -v.z };
@@ -2449,57 +3954,318 @@ float4x4 Perspective(float fov, float aspect, float Near, float Far)
 	return mat;
 }
 
-float4x4 Orthogonal(f32 l, f32 r, f32 b, f32 t, f32 n, f32 f)
+float4x4 Orthogonal(f32 l, f32 r, f32 b, f32 t, f32 n, f32 f)
+{
+#if USE_REVERSE_Z
+#if USE_DEPTH_ZERO_TO_ONE
+	float tmp = n;
+	n = f;
+	f = tmp;
+#else
+#error "Check reverse-z for OpenGL implementations"
+#endif
+#endif
+
+	float4x4 mat = {};
+	const f32 RminusL = r - l;
+	const f32 TminusB = t - b;
+	const f32 FminusN = f - n;
+
+	mat.m00 = 2.0f / RminusL;
+	mat.m30 = -(r + l)/RminusL;
+	mat.m11 = 2.0f / TminusB;
+	mat.m31 = -(t + b)/TminusB;
+#if USE_DEPTH_ZERO_TO_ONE
+	mat.m22 = -1.0f / FminusN;
+	mat.m32 = - n /FminusN;
+#else
+	mat.m22 = -2.0f / FminusN;
+	mat.m32 = -(f + n)/FminusN;
+#endif
+	mat.m33 = 1.0f;
+
+	return mat;
+}
+
+float3x3 Transpose(const float3x3 &m)
+{
+	const float3x3 res = {
+		m.m00, m.m10, m.m20,
+		m.m01, m.m11, m.m21,
+		m.m02, m.m12, m.m22,
+	};
+	return res;
+}
+
+float4x4 TransposeScalar(const float4x4 &m)
+{
+	const float4x4 res = {
+		m.m00, m.m10, m.m20, m.m30,
+		m.m01, m.m11, m.m21, m.m31,
+		m.m02, m.m12, m.m22, m.m32,
+		m.m03, m.m13, m.m23, m.m33,
+	};
+	return res;
+}
+
+float4x4 Transpose(const float4x4 &m)
+{
+#if USE_MATH_SSE
+	v4f c0 = V4Load(m.mat[0]), c1 = V4Load(m.mat[1]), c2 = V4Load(m.mat[2]), c3 = V4Load(m.mat[3]);
+	_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+	float4x4 res;
+	V4Store(res.mat[0], c0);
+	V4Store(res.mat[1], c1);
+	V4Store(res.mat[2], c2);
+	V4Store(res.mat[3], c3);
+	return res;
+#elif USE_MATH_NEON
+	const float32x4x4_t rows = vld4q_f32(&m.m00);
+	float4x4 res;
+	V4Store(res.mat[0], rows.val[0]);
+	V4Store(res.mat[1], rows.val[1]);
+	V4Store(res.mat[2], rows.val[2]);
+	V4Store(res.mat[3], rows.val[3]);
+	return res;
+#else
+	return TransposeScalar(m);
+#endif
+}
+
+// Cofactor expansion over 2x2 sub-determinants of the first and last two columns.
+// The matrix must be invertible.
+float4x4 InverseScalar(const float4x4 &m)
+{
+	const f32 (*a)[4] = m.mat;
+	const f32 s0 = a[0][0] * a[1][1] - a[1][0] * a[0][1];
+	const f32 s1 = a[0][0] * a[1][2] - a[1][0] * a[0][2];
+	const f32 s2 = a[0][0] * a[1][3] - a[1][0] * a[0][3];
+	const f32 s3 = a[0][1] * a[1][2] - a[1][1] * a[0][2];
+	const f32 s4 = a[0][1] * a[1][3] - a[1][1] * a[0][3];
+	const f32 s5 = a[0][2] * a[1][3] - a[1][2] * a[0][3];
+
+	const f32 c5 = a[2][2] * a[3][3] - a[3][2] * a[2][3];
+	const f32 c4 = a[2][1] * a[3][3] - a[3][1] * a[2][3];
+	const f32 c3 = a[2][1] * a[3][2] - a[3][1] * a[2][2];
+	const f32 c2 = a[2][0] * a[3][3] - a[3][0] * a[2][3];
+	const f32 c1 = a[2][0] * a[3][2] - a[3][0] * a[2][2];
+	const f32 c0 = a[2][0] * a[3][1] - a[3][0] * a[2][1];
+
+	const f32 det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+	ASSERT(det != 0.0f);
+	const f32 invDet = 1.0f / det;
+
+	const float4x4 res = {
+		( a[1][1] * c5 - a[1][2] * c4 + a[1][3] * c3) * invDet,
+		(-a[0][1] * c5 + a[0][2] * c4 - a[0][3] * c3) * invDet,
+		( a[3][1] * s5 - a[3][2] * s4 + a[3][3] * s3) * invDet,
+		(-a[2][1] * s5 + a[2][2] * s4 - a[2][3] * s3) * invDet,
+
+		(-a[1][0] * c5 + a[1][2] * c2 - a[1][3] * c1) * invDet,
+		( a[0][0] * c5 - a[0][2] * c2 + a[0][3] * c1) * invDet,
+		(-a[3][0] * s5 + a[3][2] * s2 - a[3][3] * s1) * invDet,
+		( a[2][0] * s5 - a[2][2] * s2 + a[2][3] * s1) * invDet,
+
+		( a[1][0] * c4 - a[1][1] * c2 + a[1][3] * c0) * invDet,
+		(-a[0][0] * c4 + a[0][1] * c2 - a[0][3] * c0) * invDet,
+		( a[3][0] * s4 - a[3][1] * s2 + a[3][3] * s0) * invDet,
+		(-a[2][0] * s4 + a[2][1] * s2 - a[2][3] * s0) * invDet,
+
+		(-a[1][0] * c3 + a[1][1] * c1 - a[1][2] * c0) * invDet,
+		( a[0][0] * c3 - a[0][1] * c1 + a[0][2] * c0) * invDet,
+		(-a[3][0] * s3 + a[3][1] * s1 - a[3][2] * s0) * invDet,
+		( a[2][0] * s3 - a[2][1] * s1 + a[2][2] * s0) * invDet,
+	};
+	return res;
+}
+
+#if USE_MATH_SSE
+// 2x2 matrices packed as (m00, m01, m10, m11): a * b, adj(a) * b and a * adj(b)
+inline v4f Mat2Mul(v4f a, v4f b)
+{
+	return V4Add(V4Mul(a, V4Shuffle(b, b, 0, 3, 0, 3)), V4Mul(V4Shuffle(a, a, 1, 0, 3, 2), V4Shuffle(b, b, 2, 1, 2, 1)));
+}
+
+inline v4f Mat2AdjMul(v4f a, v4f b)
+{
+	return V4Sub(V4Mul(V4Shuffle(a, a, 3, 3, 0, 0), b), V4Mul(V4Shuffle(a, a, 1, 1, 2, 2), V4Shuffle(b, b, 2, 3, 0, 1)));
+}
+
+inline v4f Mat2MulAdj(v4f a, v4f b)
+{
+	return V4Sub(V4Mul(a, V4Shuffle(b, b, 3, 0, 3, 0)), V4Mul(V4Shuffle(a, a, 1, 0, 3, 2), V4Shuffle(b, b, 2, 1, 2, 1)));
+}
+#endif
+
+// Inverse through the 2x2 blocks of the matrix (the block-wise adjugate), with a single
+// division. The matrix must be invertible.
+float4x4 Inverse(const float4x4 &m)
+{
+#if USE_MATH_SSE
+	const v4f c0 = V4Load(m.mat[0]), c1 = V4Load(m.mat[1]), c2 = V4Load(m.mat[2]), c3 = V4Load(m.mat[3]);
+
+	// The four 2x2 blocks and their determinants
+	const v4f A = _mm_movelh_ps(c0, c1);
+	const v4f B = _mm_movehl_ps(c1, c0);
+	const v4f C = _mm_movelh_ps(c2, c3);
+	const v4f D = _mm_movehl_ps(c3, c2);
+	const v4f detSub = V4Sub(
+		V4Mul(V4Shuffle(c0, c2, 0, 2, 0, 2), V4Shuffle(c1, c3, 1, 3, 1, 3)),
+		V4Mul(V4Shuffle(c0, c2, 1, 3, 1, 3), V4Shuffle(c1, c3, 0, 2, 0, 2)));
+	const v4f detA = V4Shuffle(detSub, detSub, 0, 0, 0, 0);
+	const v4f detB = V4Shuffle(detSub, detSub, 1, 1, 1, 1);
+	const v4f detC = V4Shuffle(detSub, detSub, 2, 2, 2, 2);
+	const v4f detD = V4Shuffle(detSub, detSub, 3, 3, 3, 3);
+
+	const v4f D_C = Mat2AdjMul(D, C);
+	const v4f A_B = Mat2AdjMul(A, B);
+	v4f X = V4Sub(V4Mul(detD, A), Mat2Mul(B, D_C));
+	v4f W = V4Sub(V4Mul(detA, D), Mat2Mul(C, A_B));
+	v4f Y = V4Sub(V4Mul(detB, C), Mat2MulAdj(D, A_B));
+	v4f Z = V4Sub(V4Mul(detC, B), Mat2MulAdj(A, D_C));
+
+	// |M| = |A| |D| + |B| |C| - tr((A# B) (D# C))
+	v4f trace = V4Mul(A_B, V4Shuffle(D_C, D_C, 0, 2, 1, 3));
+	trace = V4Add(trace, V4Shuffle(trace, trace, 2, 3, 0, 1));
+	trace = V4Add(trace, V4Shuffle(trace, trace, 1, 0, 3, 2));
+	const v4f det = V4Sub(V4Add(V4Mul(detA, detD), V4Mul(detB, detC)), trace);
+	ASSERT(_mm_cvtss_f32(det) != 0.0f);
+	const v4f invDet = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), det);
+
+	X = V4Mul(X, invDet);
+	Y = V4Mul(Y, invDet);
+	Z = V4Mul(Z, invDet);
+	W = V4Mul(W, invDet);
+
+	float4x4 res;
+	V4Store(res.mat[0], V4Shuffle(X, Y, 3, 1, 3, 1));
+	V4Store(res.mat[1], V4Shuffle(X, Y, 2, 0, 2, 0));
+	V4Store(res.mat[2], V4Shuffle(Z, W, 3, 1, 3, 1));
+	V4Store(res.mat[3], V4Shuffle(Z, W, 2, 0, 2, 0));
+	return res;
+#else
+	return InverseScalar(m);
+#endif
+}
+
+// Transforms count points by m, as MulPoint does. in and out may be the same array.
+void MulPoints(const float4x4 &m, const float3 *in, float3 *out, u32 count)
 {
-#if USE_REVERSE_Z
-#if USE_DEPTH_ZERO_TO_ONE
-	float tmp = n;
-	n = f;
-	f = tmp;
+	u32 i = 0;
+#if USE_MATH_SIMD
+	const v4f m00 = V4Splat(m.m00), m01 = V4Splat(m.m01), m02 = V4Splat(m.m02);
+	const v4f m10 = V4Splat(m.m10), m11 = V4Splat(m.m11), m12 = V4Splat(m.m12);
+	const v4f m20 = V4Splat(m.m20), m21 = V4Splat(m.m21), m22 = V4Splat(m.m22);
+	const v4f m30 = V4Splat(m.m30), m31 = V4Splat(m.m31), m32 = V4Splat(m.m32);
+
+	// Four points at a time, as x, y and z registers
+	for (; i + 4 <= count; i += 4)
+	{
+		const f32 *src = in[i].vec;
+		f32 *dst = out[i].vec;
+#if USE_MATH_SSE
+		const v4f a = V4Load(src), b = V4Load(src + 4), c = V4Load(src + 8);
+		const v4f x = V4Shuffle(a, V4Shuffle(b, c, 2, 2, 1, 1), 0, 3, 0, 2);
+		const v4f y = V4Shuffle(V4Shuffle(a, b, 1, 1, 0, 0), V4Shuffle(b, c, 3, 3, 2, 2), 0, 2, 0, 2);
+		const v4f z = V4Shuffle(V4Shuffle(a, b, 2, 2, 1, 1), c, 0, 2, 0, 3);
 #else
-#error "Check reverse-z for OpenGL implementations"
+		const float32x4x3_t p = vld3q_f32(src);
+		const v4f x = p.val[0], y = p.val[1], z = p.val[2];
 #endif
+		const v4f rx = V4Add(V4MulAdd(m20, z, V4MulAdd(m10, y, V4Mul(m00, x))), m30);
+		const v4f ry = V4Add(V4MulAdd(m21, z, V4MulAdd(m11, y, V4Mul(m01, x))), m31);
+		const v4f rz = V4Add(V4MulAdd(m22, z, V4MulAdd(m12, y, V4Mul(m02, x))), m32);
+#if USE_MATH_SSE
+		V4Store(dst, V4Shuffle(V4Shuffle(rx, ry, 0, 0, 0, 0), V4Shuffle(rz, rx, 0, 0, 1, 1), 0, 2, 0, 2));
+		V4Store(dst + 4, V4Shuffle(V4Shuffle(ry, rz, 1, 1, 1, 1), V4Shuffle(rx, ry, 2, 2, 2, 2), 0, 2, 0, 2));
+		V4Store(dst + 8, V4Shuffle(V4Shuffle(rz, rx, 2, 2, 3, 3), V4Shuffle(ry, rz, 3, 3, 3, 3), 0, 2, 0, 2));
+#else
+		const float32x4x3_t r = { rx, ry, rz };
+		vst3q_f32(dst, r);
 #endif
+	}
+#endif
+	for (; i < count; ++i) {
+		out[i] = MulScalar(m, Float4(in[i], 1.0f)).xyz;
+	}
+}
 
-	float4x4 mat = {};
-	const f32 RminusL = r - l;
-	const f32 TminusB = t - b;
-	const f32 FminusN = f - n;
-
-	mat.m00 = 2.0f / RminusL;
-	mat.m30 = -(r + l)/RminusL;
-	mat.m11 = 2.0f / TminusB;
-	mat.m31 = -(t + b)/TminusB;
-#if USE_DEPTH_ZERO_TO_ONE
-	mat.m22 = -1.0f / FminusN;
-	mat.m32 = - n /FminusN;
+// out[i] = a * b[i], for chains such as view-projection times each world matrix
+void MulMatrices(const float4x4 &a, const float4x4 *b, float4x4 *out, u32 count)
+{
+#if USE_MATH_SIMD
+	v4f columns[4];
+	V4LoadColumns(columns, a);
+	for (u32 i = 0; i < count; ++i) {
+		const v4f b0 = V4Load(b[i].mat[0]), b1 = V4Load(b[i].mat[1]), b2 = V4Load(b[i].mat[2]), b3 = V4Load(b[i].mat[3]);
+		V4Store(out[i].mat[0], V4Transform(columns, b0));
+		V4Store(out[i].mat[1], V4Transform(columns, b1));
+		V4Store(out[i].mat[2], V4Transform(columns, b2));
+		V4Store(out[i].mat[3], V4Transform(columns, b3));
+	}
 #else
-	mat.m22 = -2.0f / FminusN;
-	mat.m32 = -(f + n)/FminusN;
+	for (u32 i = 0; i < count; ++i) {
+		out[i] = MulScalar(a, b[i]);
+	}
 #endif
-	mat.m33 = 1.0f;
-
-	return mat;
 }
 
-float3x3 Transpose(const float3x3 &m)
+// Box around the transformed box (Arvo): the center is transformed as a point and the
+// half extents by the absolute values of the linear part of m
+AABB TransformAABBScalar(const float4x4 &m, const AABB &box)
 {
-	const float3x3 res = {
-		m.m00, m.m10, m.m20,
-		m.m01, m.m11, m.m21,
-		m.m02, m.m12, m.m22,
+	const float3 center = Float3(0.5f * (box.min.x + box.max.x), 0.5f * (box.min.y + box.max.y), 0.5f * (box.min.z + box.max.z));
+	const float3 extent = Float3(0.5f * (box.max.x - box.min.x), 0.5f * (box.max.y - box.min.y), 0.5f * (box.max.z - box.min.z));
+	const float3 newCenter = MulScalar(m, Float4(center, 1.0f)).xyz;
+	float3 newExtent;
+	for (u32 i = 0; i < 3; ++i) {
+		newExtent.vec[i] = ::fabsf(m.mat[0][i]) * extent.x + ::fabsf(m.mat[1][i]) * extent.y + ::fabsf(m.mat[2][i]) * extent.z;
+	}
+	const AABB res = {
+		.min = Float3(newCenter.x - newExtent.x, newCenter.y - newExtent.y, newCenter.z - newExtent.z),
+		.max = Float3(newCenter.x + newExtent.x, newCenter.y + newExtent.y, newCenter.z + newExtent.z),
 	};
 	return res;
 }
 
-float4x4 Transpose(const float4x4 &m)
+// Transforms count boxes by m, as TransformAABB does. in and out may be the same array.
+void TransformAABBs(const float4x4 &m, const AABB *in, AABB *out, u32 count)
 {
-	const float4x4 res = {
-		m.m00, m.m10, m.m20, m.m30,
-		m.m01, m.m11, m.m21, m.m31,
-		m.m02, m.m12, m.m22, m.m32,
-		m.m03, m.m13, m.m23, m.m33,
-	};
+#if USE_MATH_SIMD
+	v4f columns[4];
+	V4LoadColumns(columns, m);
+	const v4f abs0 = V4Abs(columns[0]), abs1 = V4Abs(columns[1]), abs2 = V4Abs(columns[2]);
+	const v4f half = V4Splat(0.5f);
+	for (u32 i = 0; i < count; ++i)
+	{
+		const v4f boxMin = V4LoadFloat3(in[i].min);
+		const v4f boxMax = V4LoadFloat3(in[i].max);
+		const v4f center = V4Mul(half, V4Add(boxMin, boxMax));
+		const v4f extent = V4Mul(half, V4Sub(boxMax, boxMin));
+#if USE_MATH_SSE
+		const v4f newCenter = V4Add(V4MulAdd(columns[2], V4Shuffle(center, center, 2, 2, 2, 2),
+			V4MulAdd(columns[1], V4Shuffle(center, center, 1, 1, 1, 1), V4Mul(columns[0], V4Shuffle(center, center, 0, 0, 0, 0)))), columns[3]);
+		const v4f newExtent = V4MulAdd(abs2, V4Shuffle(extent, extent, 2, 2, 2, 2),
+			V4MulAdd(abs1, V4Shuffle(extent, extent, 1, 1, 1, 1), V4Mul(abs0, V4Shuffle(extent, extent, 0, 0, 0, 0))));
+#else
+		const v4f newCenter = V4Add(vfmaq_laneq_f32(vfmaq_laneq_f32(vmulq_laneq_f32(columns[0], center, 0), columns[1], center, 1), columns[2], center, 2), columns[3]);
+		const v4f newExtent = vfmaq_laneq_f32(vfmaq_laneq_f32(vmulq_laneq_f32(abs0, extent, 0), abs1, extent, 1), abs2, extent, 2);
+#endif
+		AABB &box = out[i];
+		V4StoreFloat3(box.min, V4Sub(newCenter, newExtent));
+		V4StoreFloat3(box.max, V4Add(newCenter, newExtent));
+	}
+#else
+	for (u32 i = 0; i < count; ++i) {
+		out[i] = TransformAABBScalar(m, in[i]);
+	}
+#endif
+}
+
+AABB TransformAABB(const float4x4 &m, const AABB &box)
+{
+	AABB res;
+	TransformAABBs(m, &box, &res, 1);
 	return res;
 }
 
@@ -2659,13 +4425,55 @@ struct ThreadInfo
 #define WORK_QUEUE_CALLBACK(name) void name(const ThreadInfo &threadInfo, void *data)
 typedef WORK_QUEUE_CALLBACK(WorkQueueCallback);
 
+// Iterations a thread polls a lock or a counter before it goes to sleep in the kernel. A
+// wake-up costs a few microseconds, and most waits in the engine are shorter than that.
+#define THREAD_SPIN_COUNT 32
+
+// Tells the CPU this is a spin-wait loop, to save power and leave the core to the
+// hyper-thread sibling
+inline void CpuRelax()
+{
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	_mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+	__asm__ __volatile__("yield");
+#elif defined(_M_ARM64) || defined(_M_ARM)
+	__yield();
+#endif
+}
+
 #if PLATFORM_WINDOWS
 
+#pragma comment(lib, "Synchronization.lib") // WaitOnAddress
+
 #define THREAD_FUNCTION(name) DWORD WINAPI name(LPVOID arguments)
 
 #define FullWriteBarrier() _WriteBarrier(); _mm_sfence()
 #define FullReadBarrier() _ReadBarrier()
 
+// Wait-on-address: sleeps while *address equals expected, until FutexWake is called on
+// the same address. It may return spuriously, so callers check their condition again.
+static void FutexWait( volatile_u32 *address, u32 expected )
+{
+	WaitOnAddress(address, &expected, sizeof(expected), INFINITE);
+}
+
+// Returns false if the time ran out
+static bool FutexWait( volatile_u32 *address, u32 expected, u32 timeoutMillis )
+{
+	const bool woken = WaitOnAddress(address, &expected, sizeof(expected), timeoutMillis) || GetLastError() != ERROR_TIMEOUT;
+	return woken;
+}
+
+static void FutexWake( volatile_u32 *address, u32 count )
+{
+	if ( count == 1 ) {
+		WakeByAddressSingle((void*)address);
+	} else {
+		WakeByAddressAll((void*)address);
+	}
+}
+
 typedef HANDLE Semaphore;
 
 static bool CreateSemaphore( Semaphore &semaphore, u32 iniCount, u32 maxCount )
@@ -2718,11 +4526,27 @@ static void SleepMillis(u32 millis)
 	Sleep(millis);
 }
 
+static bool SetThreadRealtimePriority()
+{
+	const bool success = SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+	if ( !success ) {
+		Win32ReportError("SetThreadPriority");
+	}
+	return success;
+}
+
 static void Yield()
 {
 	SwitchToThread();
 }
 
+// Gives the rest of the time slice to another ready thread, or returns right away
+static void YieldTimeSlice()
+{
+	SwitchToThread();
+}
+
+// Slim reader/writer locks already spin before they sleep
 typedef SRWLOCK Mutex;
 
 static bool CreateMutex( Mutex &mutex )
@@ -2735,6 +4559,11 @@ static void DestroyMutex( Mutex &mutex )
 {
 }
 
+static bool TryLockMutex( Mutex &mutex )
+{
+	return TryAcquireSRWLockExclusive(&mutex);
+}
+
 static void LockMutex( Mutex &mutex )
 {
 	AcquireSRWLockExclusive(&mutex);
@@ -2753,36 +4582,78 @@ static void UnlockMutex( Mutex &mutex )
 #define FullWriteBarrier() __sync_synchronize()
 #define FullReadBarrier() __sync_synchronize()
 
-typedef sem_t Semaphore;
+// Wait-on-address: sleeps while *address equals expected, until FutexWake is called on
+// the same address. It may return spuriously, so callers check their condition again.
+static void FutexWait( volatile_u32 *address, u32 expected )
+{
+	syscall(SYS_futex, (u32*)address, FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+}
+
+// Returns false if the time ran out
+static bool FutexWait( volatile_u32 *address, u32 expected, u32 timeoutMillis )
+{
+	const timespec timeout = { .tv_sec = timeoutMillis / 1000, .tv_nsec = (long)(timeoutMillis % 1000) * 1000000 };
+	const long res = syscall(SYS_futex, (u32*)address, FUTEX_WAIT_PRIVATE, expected, &timeout, nullptr, 0);
+	return res == 0 || errno != ETIMEDOUT;
+}
+
+static void FutexWake( volatile_u32 *address, u32 count )
+{
+	syscall(SYS_futex, (u32*)address, FUTEX_WAKE_PRIVATE, count < I32_MAX ? count : I32_MAX, nullptr, nullptr, 0);
+}
+
+// Counting semaphore. Sleepers register in waiterCount, so signals only enter the kernel
+// when someone sleeps. There is no maximum count.
+struct Semaphore
+{
+	volatile_u32 count;
+	volatile_u32 waiterCount;
+};
 
 static bool CreateSemaphore( Semaphore &semaphore, u32 iniCount, u32 maxCount )
 {
-	bool success = true;
-	if ( sem_init(&semaphore, 0, iniCount) != 0 ) { // TODO(jediaz): use sem_init_np to set maxCount
-		LinuxReportError("sem_init");
-		success = false;
-	}
-	return success;
+	semaphore.count = iniCount;
+	semaphore.waiterCount = 0;
+	return true;
 }
 
 static bool SignalSemaphore( Semaphore &semaphore )
 {
-	bool success = true;
-	if ( sem_post(&semaphore) != 0 ) {
-		LinuxReportError("sem_post");
-		success = false;
+	AtomicFetchAdd(&semaphore.count, 1);
+	if ( AtomicLoadAcquire(&semaphore.waiterCount) != 0 ) {
+		FutexWake(&semaphore.count, 1);
 	}
-	return success;
+	return true;
+}
+
+static bool TryWaitSemaphore( Semaphore &semaphore )
+{
+	u32 count = AtomicLoadAcquire(&semaphore.count);
+	while ( count > 0 ) {
+		if ( AtomicSwap(&semaphore.count, count, count - 1) ) {
+			return true;
+		}
+		count = AtomicLoadAcquire(&semaphore.count);
+	}
+	return false;
 }
 
 static bool WaitSemaphore( Semaphore &semaphore )
 {
-	bool success = true;
-	if ( sem_wait(&semaphore) != 0 ) {
-		LinuxReportError("sem_wait");
-		success = false;
+	for (u32 spin = 0; spin < THREAD_SPIN_COUNT; ++spin) {
+		if ( TryWaitSemaphore(semaphore) ) {
+			return true;
+		}
+		CpuRelax();
 	}
-	return success;
+	while ( !TryWaitSemaphore(semaphore) ) {
+		// The kernel only sleeps if the count is still zero, so a signal between the
+		// check above and this call is not lost
+		AtomicFetchAdd(&semaphore.waiterCount, 1);
+		FutexWait(&semaphore.count, 0);
+		AtomicFetchAdd(&semaphore.waiterCount, -1);
+	}
+	return true;
 }
 
 static bool CreateDetachedThread( THREAD_FUNCTION(threadFunc), const ThreadInfo &threadInfo )
@@ -2811,36 +4682,77 @@ static void SleepMillis(u32 millis)
 	}
 }
 
+// Moves the calling thread to the FIFO real-time policy, which needs the CAP_SYS_NICE
+// capability or a non-zero RLIMIT_RTPRIO (see /etc/security/limits.conf)
+static bool SetThreadRealtimePriority()
+{
+	sched_param param = {};
+	param.sched_priority = ( sched_get_priority_min(SCHED_FIFO) + sched_get_priority_max(SCHED_FIFO) ) / 2;
+	const int res = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+	if ( res != 0 ) {
+		errno = res;
+		LinuxReportError("pthread_setschedparam");
+	}
+	return res == 0;
+}
+
 static void Yield()
 {
 	SleepMillis(1);
 }
 
-typedef pthread_mutex_t Mutex;
+// Gives the rest of the time slice to another ready thread, or returns right away, so
+// unlike Yield it keeps the core busy when nothing else is ready to run
+static void YieldTimeSlice()
+{
+	sched_yield();
+}
+
+// Spin-then-park mutex (Drepper, "Futexes Are Tricky"). The state is 0 when unlocked, 1
+// when locked and 2 when locked with threads sleeping on it, so unlocking only enters
+// the kernel if there is someone to wake.
+struct Mutex
+{
+	volatile_u32 state;
+};
 
 static bool CreateMutex( Mutex &mutex )
 {
-	bool success = true;
-	if ( pthread_mutex_init(&mutex, nullptr) != 0 ) {
-		LinuxReportError("pthread_mutex_init");
-		success = false;
-	}
-	return success;
+	mutex.state = 0;
+	return true;
 }
 
 static void DestroyMutex( Mutex &mutex )
 {
-	pthread_mutex_destroy(&mutex);
+}
+
+static bool TryLockMutex( Mutex &mutex )
+{
+	return AtomicSwap(&mutex.state, 0, 1);
 }
 
 static void LockMutex( Mutex &mutex )
 {
-	pthread_mutex_lock(&mutex);
+	if ( AtomicSwap(&mutex.state, 0, 1) ) {
+		return;
+	}
+	for (u32 spin = 0; spin < THREAD_SPIN_COUNT; ++spin) {
+		CpuRelax();
+		if ( AtomicLoadAcquire(&mutex.state) == 0 && AtomicSwap(&mutex.state, 0, 1) ) {
+			return;
+		}
+	}
+	// Mark the mutex contended before sleeping, the owner wakes one sleeper on unlock
+	while ( AtomicExchange(&mutex.state, 2) != 0 ) {
+		FutexWait(&mutex.state, 2);
+	}
 }
 
 static void UnlockMutex( Mutex &mutex )
 {
-	pthread_mutex_unlock(&mutex);
+	if ( AtomicExchange(&mutex.state, 0) == 2 ) {
+		FutexWake(&mutex.state, 1);
+	}
 }
 
 #else
@@ -2856,6 +4768,324 @@ struct MutexScope
 	MutexScope &operator=( const MutexScope & ) = delete;
 };
 
+// Auto-reset event: a signal releases one waiter, or the next thread to wait if none is
+// waiting yet. Signals do not accumulate.
+struct Event
+{
+	volatile_u32 signaled;
+	volatile_u32 waiterCount;
+};
+
+static void CreateEvent( Event &event, bool signaled = false )
+{
+	event.signaled = signaled ? 1 : 0;
+	event.waiterCount = 0;
+}
+
+static void SignalEvent( Event &event )
+{
+	AtomicExchange(&event.signaled, 1);
+	if ( AtomicLoadAcquire(&event.waiterCount) != 0 ) {
+		FutexWake(&event.signaled, 1);
+	}
+}
+
+static bool TryWaitEvent( Event &event )
+{
+	return AtomicLoadAcquire(&event.signaled) != 0 && AtomicSwap(&event.signaled, 1, 0);
+}
+
+static void WaitEvent( Event &event )
+{
+	for (u32 spin = 0; spin < THREAD_SPIN_COUNT; ++spin) {
+		if ( TryWaitEvent(event) ) {
+			return;
+		}
+		CpuRelax();
+	}
+	while ( !TryWaitEvent(event) ) {
+		AtomicFetchAdd(&event.waiterCount, 1);
+		FutexWait(&event.signaled, 0);
+		AtomicFetchAdd(&event.waiterCount, -1);
+	}
+}
+
+// Returns false if the event was not signaled in time
+static bool WaitEvent( Event &event, u32 timeoutMillis )
+{
+	const Clock begin = GetClock();
+	while ( !TryWaitEvent(event) )
+	{
+		const u32 elapsedMillis = (u32)(GetSecondsElapsed(begin, GetClock()) * 1000.0f);
+		if ( elapsedMillis >= timeoutMillis ) {
+			return false;
+		}
+		AtomicFetchAdd(&event.waiterCount, 1);
+		FutexWait(&event.signaled, 0, timeoutMillis - elapsedMillis);
+		AtomicFetchAdd(&event.waiterCount, -1);
+	}
+	return true;
+}
+
+// Exponential backoff for waits on a flag another thread sets soon: it spins with pause
+// instructions first and then yields the core, but never sleeps a whole time slice
+struct SpinBackoff
+{
+	u32 count;
+};
+
+static void SpinBackoffWait( SpinBackoff &backoff )
+{
+	if ( backoff.count < 10 ) {
+		for (u32 i = 0; i < (1u << backoff.count); ++i) {
+			CpuRelax();
+		}
+		backoff.count++;
+	} else {
+		YieldTimeSlice();
+	}
+}
+
+// Lock-free multi-producer single-consumer queue of fixed-size elements. Elements live in
+// pages chained in push order, so a burst grows the queue a page at a time instead of
+// dropping elements. Producers claim a slot with an atomic add on the tail page and mark
+// it ready once written; the consumer reads the ready slots in order, so elements pushed
+// by one thread come out in the order that thread pushed them.
+//
+// The consumer cannot reuse a drained page right away, because a producer may have read
+// the tail page before it moved and still be about to look at it. Producers count
+// themselves in the users of the tail page before using it, and drained pages wait in a
+// retired list until they have no users, then join the free list that producers take
+// new pages from. Other producers pushing meanwhile do not keep a page from being reused.
+
+#define MPSC_QUEUE_PAGE_SIZE KB(4)
+#define MPSC_QUEUE_SLOT_HEADER 8 // Ready flag, padded so elements stay 8-byte aligned
+
+struct MpscQueuePage
+{
+	volatile_u32 writeIndex; // Slots claimed so far, it goes past the slot count once full
+	volatile_u32 next; // Page index + 1 of the following page, 0 if none
+	volatile_u32 nextFree; // Page index + 1 of the next page in the free or retired list
+	volatile_u32 users; // Producers that read the page as the tail and may still write to it
+};
+
+struct MpscQueue
+{
+	byte *pages; // Reserved range of maxPages, committed as pages are first used
+	u32 pageSize;
+	u32 maxPages;
+	u32 elementSize;
+	u32 slotSize;
+	u32 slotsPerPage;
+
+	volatile_u32 tailPage;
+	volatile_u32 pageCount; // Pages committed so far
+	volatile_i64 freeList; // Count of changes << 32 | page index + 1, against ABA on pops
+
+	// Consumer only
+	u32 headPage;
+	u32 readIndex;
+	u32 retiredList;
+};
+
+static MpscQueuePage *MpscQueueGetPage( const MpscQueue &queue, u32 pageIndex )
+{
+	ASSERT( pageIndex < queue.maxPages );
+	return (MpscQueuePage *)(queue.pages + (u64)pageIndex * queue.pageSize);
+}
+
+static byte *MpscQueueGetSlot( const MpscQueue &queue, u32 pageIndex, u32 slotIndex )
+{
+	byte *page = (byte *)MpscQueueGetPage(queue, pageIndex);
+	return page + sizeof(MpscQueuePage) + slotIndex * queue.slotSize;
+}
+
+// Pushes a chain of pages linked with nextFree, from first to last, to the free list
+static void MpscQueueFreePages( MpscQueue &queue, u32 first, u32 last )
+{
+	MpscQueuePage *lastPage = MpscQueueGetPage(queue, last);
+	for (;;) {
+		const i64 freeList = queue.freeList;
+		lastPage->nextFree = (u32)freeList;
+		const i64 newFreeList = (i64)(((u64)freeList >> 32) + 1) << 32 | (first + 1);
+		if ( AtomicSwap(&queue.freeList, freeList, newFreeList) ) {
+			break;
+		}
+	}
+}
+
+// Returns a page index + 1, or 0 if all pages are in use
+static u32 MpscQueueAllocatePage( MpscQueue &queue )
+{
+	for (;;) {
+		const i64 freeList = queue.freeList;
+		const u32 first = (u32)freeList;
+		if ( first == 0 ) {
+			break;
+		}
+		// The page may be taken and reused meanwhile, then nextFree is stale but the
+		// count in the list head changed and the swap fails
+		const u32 nextFree = MpscQueueGetPage(queue, first - 1)->nextFree;
+		const i64 newFreeList = (i64)(((u64)freeList >> 32) + 1) << 32 | nextFree;
+		if ( AtomicSwap(&queue.freeList, freeList, newFreeList) ) {
+			MpscQueuePage *page = MpscQueueGetPage(queue, first - 1);
+			page->writeIndex = 0;
+			page->next = 0;
+			return first;
+		}
+	}
+
+	u32 pageIndex;
+	do {
+		pageIndex = queue.pageCount;
+		if ( pageIndex >= queue.maxPages ) {
+			return 0;
+		}
+	} while ( !AtomicSwap(&queue.pageCount, pageIndex, pageIndex + 1) );
+
+	MpscQueuePage *page = MpscQueueGetPage(queue, pageIndex);
+	if ( !CommitVirtualMemory(page, queue.pageSize) ) {
+		return 0;
+	}
+	return pageIndex + 1;
+}
+
+// Reserves maxSize bytes of address space, and commits pages as the queue grows into it
+static bool CreateMpscQueue( MpscQueue &queue, u32 elementSize, u32 maxSize )
+{
+	queue = {};
+	queue.pageSize = Max((u32)MPSC_QUEUE_PAGE_SIZE, GetVirtualMemoryPageSize());
+	queue.maxPages = maxSize / queue.pageSize;
+	queue.elementSize = elementSize;
+	queue.slotSize = AlignUp(MPSC_QUEUE_SLOT_HEADER + elementSize, 8);
+	queue.slotsPerPage = (queue.pageSize - (u32)sizeof(MpscQueuePage)) / queue.slotSize;
+	ASSERT( queue.maxPages > 0 && queue.slotsPerPage > 0 );
+
+	queue.pages = (byte *)ReserveVirtualMemory((u64)queue.maxPages * queue.pageSize);
+	if ( !queue.pages ) {
+		return false;
+	}
+
+	const u32 firstPage = MpscQueueAllocatePage(queue);
+	ASSERT( firstPage == 1 );
+	return firstPage != 0;
+}
+
+static void DestroyMpscQueue( MpscQueue &queue )
+{
+	if ( queue.pages ) {
+		FreeVirtualMemory(queue.pages, (u64)queue.maxPages * queue.pageSize);
+	}
+	queue = {};
+}
+
+// Can be called from any thread. Returns false if the queue is at its maximum size.
+static bool MpscQueuePush( MpscQueue &queue, const void *element )
+{
+	for (;;)
+	{
+		// Once counted in the users, the page is not reused until this push leaves it. If
+		// the tail moved before that, the page may be retired already, so try again.
+		const u32 pageIndex = AtomicLoadAcquire(&queue.tailPage);
+		MpscQueuePage *page = MpscQueueGetPage(queue, pageIndex);
+		AtomicFetchAdd(&page->users, 1);
+		if ( AtomicLoadAcquire(&queue.tailPage) != pageIndex ) {
+			AtomicFetchAdd(&page->users, -1);
+			continue;
+		}
+
+		const u32 slotIndex = AtomicFetchAdd(&page->writeIndex, 1);
+		if ( slotIndex < queue.slotsPerPage )
+		{
+			byte *slot = MpscQueueGetSlot(queue, pageIndex, slotIndex);
+			MemCopy(slot + MPSC_QUEUE_SLOT_HEADER, element, queue.elementSize);
+			AtomicStoreRelease((volatile_u32 *)slot, 1);
+			AtomicFetchAdd(&page->users, -1);
+			return true;
+		}
+
+		// The page is full: link a new one unless another producer did, and move the tail
+		u32 next = AtomicLoadAcquire(&page->next);
+		if ( next == 0 )
+		{
+			const u32 newPage = MpscQueueAllocatePage(queue);
+			if ( newPage == 0 ) {
+				AtomicFetchAdd(&page->users, -1);
+				return false;
+			}
+			if ( AtomicSwap(&page->next, 0, newPage) ) {
+				next = newPage;
+			} else {
+				MpscQueueFreePages(queue, newPage - 1, newPage - 1);
+				next = AtomicLoadAcquire(&page->next);
+			}
+		}
+		AtomicSwap(&queue.tailPage, pageIndex, next - 1);
+		AtomicFetchAdd(&page->users, -1);
+	}
+}
+
+// Consumer only. Returns the oldest element without removing it, or NULL if there is none
+// ready. The element stays valid until MpscQueuePop.
+static void *MpscQueuePeek( MpscQueue &queue )
+{
+	for (;;)
+	{
+		if ( queue.readIndex < queue.slotsPerPage )
+		{
+			byte *slot = MpscQueueGetSlot(queue, queue.headPage, queue.readIndex);
+			const bool ready = AtomicLoadAcquire((volatile_u32 *)slot) != 0;
+			return ready ? slot + MPSC_QUEUE_SLOT_HEADER : NULL;
+		}
+
+		MpscQueuePage *page = MpscQueueGetPage(queue, queue.headPage);
+		const u32 next = AtomicLoadAcquire(&page->next);
+		if ( next == 0 ) {
+			return NULL;
+		}
+
+		// Producers still on the drained page must not find it as the tail once it is reused
+		AtomicSwap(&queue.tailPage, queue.headPage, next - 1);
+		page->nextFree = queue.retiredList;
+		queue.retiredList = queue.headPage + 1;
+		queue.headPage = next - 1;
+		queue.readIndex = 0;
+	}
+}
+
+// Consumer only. Moves the retired pages no producer uses anymore to the free list.
+static void MpscQueueRecyclePages( MpscQueue &queue )
+{
+	u32 retiredList = 0;
+	u32 pageIndex = queue.retiredList;
+	while ( pageIndex != 0 )
+	{
+		MpscQueuePage *page = MpscQueueGetPage(queue, pageIndex - 1);
+		const u32 nextFree = page->nextFree;
+		if ( AtomicLoadAcquire(&page->users) == 0 ) {
+			MpscQueueFreePages(queue, pageIndex - 1, pageIndex - 1);
+		} else {
+			page->nextFree = retiredList;
+			retiredList = pageIndex;
+		}
+		pageIndex = nextFree;
+	}
+	queue.retiredList = retiredList;
+}
+
+// Consumer only. Removes the element returned by the last MpscQueuePeek.
+static void MpscQueuePop( MpscQueue &queue )
+{
+	ASSERT( queue.readIndex < queue.slotsPerPage );
+	byte *slot = MpscQueueGetSlot(queue, queue.headPage, queue.readIndex);
+	*(volatile_u32 *)slot = 0; // Reused pages start with no slot ready
+	queue.readIndex++;
+
+	if ( queue.retiredList != 0 ) {
+		MpscQueueRecyclePages(queue);
+	}
+}
+
 
 
 #endif // #ifndef ILU_CORE_H
@@ -46,6 +46,7 @@
  * - SetIndexBuffer
  * - Draw
  * - DrawIndexed
+ * - DrawIndexedInstanced
  * - Dispatch
  *
  * Timestamp queries:
@@ -114,7 +115,7 @@
 #define MAX_SWAPCHAIN_IMAGE_COUNT 4
 #endif
 #define FIRST_SWAPCHAIN_IMAGE_INDEX MAX_IMAGES
-#define MAX_FRAMES_IN_FLIGHT 2
+#define MAX_FRAMES_IN_FLIGHT 3 // Also the maximum frame latency, see WaitFrame
 
 
 ////////////////////////////////////////////////////////////////////////
@@ -551,6 +552,10 @@ struct CommandList
 			VkBuffer indexBufferHandle;
 		};
 	};
+
+	// Stats
+	u32 drawCount;
+	u32 bindGroupSwitchCount; // Descriptor set binds actually recorded
 };
 
 struct SubmitResult
@@ -744,6 +749,7 @@ typedef void FN_SetVertexBuffer(CommandList &commandList, BufferH bufferH);
 typedef void FN_SetIndexBuffer(CommandList &commandList, BufferH bufferH);
 typedef void FN_Draw(CommandList &commandList, u32 vertexCount, u32 firstVertex);
 typedef void FN_DrawIndexed(CommandList &commandList, u32 indexCount, u32 firstIndex, u32 firstVertex, u32 instanceIndex);
+typedef void FN_DrawIndexedInstanced(CommandList &commandList, u32 indexCount, u32 firstIndex, u32 firstVertex, u32 firstInstance, u32 instanceCount);
 typedef void FN_Dispatch(CommandList &commandList, u32 x, u32 y, u32 z);
 typedef void FN_EndRenderPass(const CommandList &commandList);
 typedef TimestampPool FN_CreateTimestampPool(const GraphicsDevice &device, u32 maxQueries);
@@ -753,6 +759,7 @@ typedef u32 FN_WriteTimestamp(const CommandList &commandBuffer, TimestampPool &p
 typedef Timestamp FN_ReadTimestamp(const TimestampPool &pool, u32 queryIndex);
 typedef SubmitResult FN_Submit(GraphicsDevice &device, const CommandList &commandList);
 typedef bool FN_Present(GraphicsDevice &device, SubmitResult submitResult);
+typedef void FN_WaitFrame(GraphicsDevice &device, u32 frameLatency);
 typedef bool FN_BeginFrame(GraphicsDevice &device);
 typedef void FN_EndFrame(GraphicsDevice &device);
 typedef void FN_CleanupGraphicsDevice(const GraphicsDevice &device, Arena scratch);
@@ -837,6 +844,7 @@ typedef const char* FN_FormatName(Format format);
 	EXPAND_MACRO(SetIndexBuffer) \
 	EXPAND_MACRO(Draw) \
 	EXPAND_MACRO(DrawIndexed) \
+	EXPAND_MACRO(DrawIndexedInstanced) \
 	EXPAND_MACRO(Dispatch) \
 	EXPAND_MACRO(EndRenderPass) \
 	EXPAND_MACRO(CreateTimestampPool) \
@@ -846,6 +854,7 @@ typedef const char* FN_FormatName(Format format);
 	EXPAND_MACRO(ReadTimestamp) \
 	EXPAND_MACRO(Submit) \
 	EXPAND_MACRO(Present) \
+	EXPAND_MACRO(WaitFrame) \
 	EXPAND_MACRO(BeginFrame) \
 	EXPAND_MACRO(EndFrame) \
 	EXPAND_MACRO(CleanupGraphicsDevice) \
@@ -1781,8 +1790,10 @@ struct ShaderBindings
 
 static ShaderBindings ReflectShaderBindings( Arena scratch, byte* microcodeData[], const u64 microcodeSize[], u32 microcodeCount )
 {
-	void *tempMem = scratch.base + scratch.used;
-	const u32 tempMemSize = scratch.size - scratch.used;
+	// Sub-arenas of growable arenas may span gigabytes, which the parser does not need
+	const u64 remainingSize = scratch.size - scratch.used;
+	const u32 tempMemSize = remainingSize < MB(1) ? (u32)remainingSize : MB(1);
+	void *tempMem = PushSize(scratch, tempMemSize);
 
 	SpvDescriptorSetList spvDescriptorList = {};
 	for (u32 i = 0; i < microcodeCount; ++i)
@@ -1880,6 +1891,7 @@ static void BindDescriptorSets(CommandList &commandList)
 			VkPipelineBindPoint bindPoint = pipeline.bindPoint;
 			VkPipelineLayout pipelineLayout = pipeline.layout.handle;
 			vkCmdBindDescriptorSets(commandList.handle, bindPoint, pipelineLayout, descriptorSetFirst, descriptorSetCount, descriptorSets, 0, NULL);
+			commandList.bindGroupSwitchCount++;
 		}
 	}
 }
@@ -4370,6 +4382,7 @@ void Draw(CommandList &commandList, u32 vertexCount, u32 firstVertex)
 	BindDescriptorSets(commandList);
 
 	vkCmdDraw(commandList.handle, vertexCount, 1, firstVertex, 0);
+	commandList.drawCount++;
 }
 
 void DrawIndexed(CommandList &commandList, u32 indexCount, u32 firstIndex, u32 firstVertex, u32 instanceIndex)
@@ -4377,6 +4390,15 @@ void DrawIndexed(CommandList &commandList, u32 indexCount, u32 firstIndex, u32 f
 	BindDescriptorSets(commandList);
 
 	vkCmdDrawIndexed(commandList.handle, indexCount, 1, firstIndex, firstVertex, instanceIndex);
+	commandList.drawCount++;
+}
+
+void DrawIndexedInstanced(CommandList &commandList, u32 indexCount, u32 firstIndex, u32 firstVertex, u32 firstInstance, u32 instanceCount)
+{
+	BindDescriptorSets(commandList);
+
+	vkCmdDrawIndexed(commandList.handle, indexCount, instanceCount, firstIndex, firstVertex, firstInstance);
+	commandList.drawCount++;
 }
 
 void Dispatch(CommandList &commandList, u32 x, u32 y, u32 z)
@@ -4570,11 +4592,11 @@ bool Present(GraphicsDevice &device, SubmitResult submitResult)
 // Frame
 //////////////////////////////
 
-void WaitFrameFences(GraphicsDevice &device)
+void WaitFrameFences(GraphicsDevice &device, u32 frameIndex)
 {
 	// Catch-up frame fences
 	VkFence fences[MAX_FENCES] = {};
-	GraphicsDevice::FrameData &frameData = device.frameData[device.frameIndex];
+	GraphicsDevice::FrameData &frameData = device.frameData[frameIndex];
 
 	if ( frameData.usedFenceCount > 0 )
 	{
@@ -4625,13 +4647,36 @@ bool AcquireSwapchainImage(GraphicsDevice &device)
 	return true;
 }
 
+// Blocks until at most frameLatency frames are pending on the GPU, and until the next
+// swapchain image is available. Call it right before sampling input for the frame, so
+// the time blocked here does not add to the input latency.
+void WaitFrame(GraphicsDevice &device, u32 frameLatency)
+{
+	ASSERT(frameLatency >= 1 && frameLatency <= MAX_FRAMES_IN_FLIGHT);
+
+	// Frame slots are waited oldest first, as their fences were taken from the ring. The
+	// oldest one is this frame's slot, which is always waited before it is reused.
+	for (u32 age = MAX_FRAMES_IN_FLIGHT; age >= frameLatency; --age)
+	{
+		const u32 frameIndex = ( device.frameIndex + MAX_FRAMES_IN_FLIGHT - age ) % MAX_FRAMES_IN_FLIGHT;
+		WaitFrameFences(device, frameIndex);
+	}
+
+	// With FIFO/MAILBOX and a full present queue this is where the CPU blocks
+	// waiting for a free image.
+	if ( device.swapchain.valid && !device.swapchain.imageAcquired )
+	{
+		AcquireSwapchainImage(device);
+	}
+}
+
 bool BeginFrame(GraphicsDevice &device)
 {
-	// No-op if this frame slot fences were already waited after the previous present
-	WaitFrameFences(device);
+	// No-op if this frame slot fences were already waited in WaitFrame
+	WaitFrameFences(device, device.frameIndex);
 
-	// The image is normally acquired at EndFrame already. Acquire here only on
-	// the first frame or right after a swapchain recreation.
+	// The image is normally acquired at WaitFrame already. Acquire here only if
+	// it was not called, or right after a swapchain recreation.
 	if ( !device.swapchain.imageAcquired )
 	{
 		if ( !AcquireSwapchainImage(device) )
@@ -4654,19 +4699,6 @@ void EndFrame(GraphicsDevice &device)
 
 	device.frameIndex = ( device.frameIndex + 1 ) % MAX_FRAMES_IN_FLIGHT;
 	device.presentationIndex = ( device.presentationIndex + 1 ) % MAX_SWAPCHAIN_IMAGE_COUNT;
-
-	// Throttle here, after present, instead of at BeginFrame. This way the CPU
-	// blocks before the platform samples input for the next frame, not after,
-	// which reduces input latency when frames are produced faster than vsync.
-	WaitFrameFences(device);
-
-	// Acquire the next image here too: with FIFO/MAILBOX and a full present
-	// queue this is where the CPU blocks waiting for a free image, so the block
-	// happens before input sampling for the next frame, not after it.
-	if ( device.swapchain.valid )
-	{
-		AcquireSwapchainImage(device);
-	}
 }
 
 
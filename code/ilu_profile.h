@@ -166,7 +166,7 @@ u16 ProfileRegisterName(const char *name)
 	}
 
 	// Find existing id
-	const u32 hash = HashStringFNV(name);
+	const u32 hash = HashStringWY32(name);
 	u32 slot = hash & (MAX_PROFILE_NAME_SLOTS - 1);
 	while (p.nameSlots[slot] != 0)
 	{
@@ -791,7 +791,7 @@ void UI_UploadVerticesToGPU(UI &ui)
 			const UIVertexRange &range = drawList.vertexRanges[j];
 			const UIVertex *srcVertex = srcVertexBase + range.index;
 			UIVertex *dstVertex = dstVertexBase + totalVertexCount;
-			MemCopy(dstVertex, srcVertex, range.count * sizeof(UIVertex));
+			MemCopyToDevice(dstVertex, srcVertex, range.count * sizeof(UIVertex));
 			drawListVertexCount += range.count;
 			totalVertexCount += range.count;
 		}
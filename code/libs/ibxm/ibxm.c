@@ -5,6 +5,9 @@ const char *IBXM_VERSION = "ibxm/ac mod/xm/s3m replay 20191214 (c)mumart@gmail.c
 
 static const int FP_SHIFT = 15, FP_ONE = 32768, FP_MASK = 32767;
 
+/* Samples allocated after the end of the sample data, see sample_loop_guard(). */
+#define SAMPLE_GUARD_LEN 2
+
 static const int exp2_table[] = {
 	32768, 32946, 33125, 33305, 33486, 33667, 33850, 34034,
 	34219, 34405, 34591, 34779, 34968, 35158, 35349, 35541,
@@ -54,7 +57,7 @@ struct channel {
 };
 
 struct replay {
-	int sample_rate, interpolation, global_vol;
+	int sample_rate, interpolation, global_vol, simd;
 	int seq_pos, break_pos, row, next_row, tick;
 	int speed, tempo, pl_count, pl_chan;
 	int *ramp_buf;
@@ -216,7 +219,15 @@ static void sample_ping_pong( struct sample *sample ) {
 		sample_data[ loop_end + idx ] = sample_data[ loop_end - idx - 1 ];
 	}
 	sample->loop_length *= 2;
-	sample->data[ loop_start + sample->loop_length ] = sample->data[ loop_start ];
+}
+
+/* Copies the first two samples of the loop after its end, so the interpolation can
+   read past the last sample. Samples without a loop end with silence. */
+static void sample_loop_guard( struct sample *sample ) {
+	int loop_end = sample->loop_start + sample->loop_length;
+	short *sample_data = sample->data;
+	sample_data[ loop_end ] = sample_data[ sample->loop_start ];
+	sample_data[ loop_end + 1 ] = sample->loop_length > 1 ? sample_data[ sample->loop_start + 1 ] : 0;
 }
 
 static struct module* module_load_xm( struct data *data, char *message, struct Arena *arena ) {
@@ -407,7 +418,7 @@ static struct module* module_load_xm( struct data *data, char *message, struct A
 				sample->loop_start = sam_loop_start;
 				sample->loop_length = sam_loop_length;
 				sam_ping_pong_loop_length = ping_pong ? sam_loop_length : 0;
-				sample->data = PushZeroArray(*arena, short, sam_data_samples + sam_ping_pong_loop_length + 1);
+				sample->data = PushZeroArray(*arena, short, sam_data_samples + sam_ping_pong_loop_length + SAMPLE_GUARD_LEN);
 				if( sample->data ) {
 					if( sixteen_bit ) {
 						data_sam_s16le( data, offset, sam_data_samples, sample->data );
@@ -420,10 +431,10 @@ static struct module* module_load_xm( struct data *data, char *message, struct A
 						amp = ( amp & 0x7FFF ) - ( amp & 0x8000 );
 						sample->data[ idx ] = amp;
 					}
-					sample->data[ sam_loop_start + sam_loop_length ] = sample->data[ sam_loop_start ];
 					if( ping_pong ) {
 						sample_ping_pong( sample );
 					}
+					sample_loop_guard( sample );
 				} else {
 					return NULL;
 				}
@@ -525,7 +536,7 @@ static struct module* module_load_s3m( struct data *data, char *message, struct
 				tune = ( log_2( data_u32le( data, inst_offset + 32 ) ) - log_2( module->c2_rate ) ) * 12;
 				sample->rel_note = tune >> FP_SHIFT;
 				sample->fine_tune = ( tune & FP_MASK ) >> ( FP_SHIFT - 7 );
-				sample->data = PushZeroArray(*arena, short, sample_length + 1);
+				sample->data = PushZeroArray(*arena, short, sample_length + SAMPLE_GUARD_LEN);
 				if( sample->data ) {
 					if( sixteen_bit ) {
 						data_sam_s16le( data, sample_offset, sample_length, sample->data );
@@ -537,7 +548,7 @@ static struct module* module_load_s3m( struct data *data, char *message, struct
 							sample->data[ idx ] = ( sample->data[ idx ] & 0xFFFF ) - 32768;
 						}
 					}
-					sample->data[ loop_start + loop_length ] = sample->data[ loop_start ];
+					sample_loop_guard( sample );
 				} else {
 					return NULL;
 				}
@@ -784,10 +795,10 @@ static struct module* module_load_mod( struct data *data, char *message, struct
 			}
 			sample->loop_start = loop_start;
 			sample->loop_length = loop_length;
-			sample->data = PushZeroArray(*arena, short, sample_length + 1);
+			sample->data = PushZeroArray(*arena, short, sample_length + SAMPLE_GUARD_LEN);
 			if( sample->data ) {
 				data_sam_s8( data, module_data_idx, sample_length, sample->data );
-				sample->data[ loop_start + loop_length ] = sample->data[ loop_start ];
+				sample_loop_guard( sample );
 			} else {
 				return NULL;
 			}
@@ -1504,11 +1515,142 @@ static void channel_row( struct channel *channel, struct note *note ) {
 	channel_update_envelopes( channel );
 }
 
+/* Catmull-Rom spline through the samples around idx, at the fraction fra of the way
+   to the next one, saturated to 16 bits as it may overshoot. */
+static int channel_cubic( const short *sample_data, int idx, int fra ) {
+	float s0 = sample_data[ idx > 0 ? idx - 1 : 0 ];
+	float s1 = sample_data[ idx ];
+	float s2 = sample_data[ idx + 1 ];
+	float s3 = sample_data[ idx + 2 ];
+	float t = fra * ( 1.0f / FP_ONE );
+	float a = 1.5f * ( s1 - s2 ) + 0.5f * ( s3 - s0 );
+	float b = s0 - 2.5f * s1 + 2.0f * s2 - 0.5f * s3;
+	float c = 0.5f * ( s2 - s0 );
+	int y = ( int ) ( ( ( a * t + b ) * t + c ) * t + s1 );
+	return y < -32768 ? -32768 : ( y > 32767 ? 32767 : y );
+}
+
+/* Mixes count output frames of a sample without crossing its loop end, which the
+   position (sam_idx, sam_fra) must not reach before the last frame. */
+static void channel_mix_scalar( const short *sample_data, int sam_idx, int sam_fra, int step,
+		int *mix_buf, int count, int l_gain, int r_gain, int interpolation ) {
+	int idx, y, m, c;
+	for( idx = 0; idx < count * 2; idx += 2 ) {
+		if( interpolation == 2 ) {
+			y = channel_cubic( sample_data, sam_idx, sam_fra );
+		} else if( interpolation ) {
+			c = sample_data[ sam_idx ];
+			m = sample_data[ sam_idx + 1 ] - c;
+			y = ( ( m * sam_fra ) >> FP_SHIFT ) + c;
+		} else {
+			y = sample_data[ sam_idx ];
+		}
+		mix_buf[ idx     ] += ( y * l_gain ) >> FP_SHIFT;
+		mix_buf[ idx + 1 ] += ( y * r_gain ) >> FP_SHIFT;
+		sam_fra += step;
+		sam_idx += sam_fra >> FP_SHIFT;
+		sam_fra &= FP_MASK;
+	}
+}
+
+#if USE_AUDIO_SSE2
+/* Low 32 bits of the products, SSE2 only multiplies two lanes at a time. Used by the
+   volume ramp, whose samples do not fit in 16 bits. */
+static __m128i mullo_epi32( __m128i a, __m128i b ) {
+#if USE_AUDIO_AVX2
+	return _mm_mullo_epi32( a, b );
+#else
+	__m128i even = _mm_mul_epu32( a, b );
+	__m128i odd = _mm_mul_epu32( _mm_srli_epi64( a, 32 ), _mm_srli_epi64( b, 32 ) );
+	return _mm_unpacklo_epi32( _mm_shuffle_epi32( even, _MM_SHUFFLE( 0, 0, 2, 0 ) ),
+		_mm_shuffle_epi32( odd, _MM_SHUFFLE( 0, 0, 2, 0 ) ) );
+#endif
+}
+
+/* Same as channel_mix_scalar() and bit-exact with it, four frames at a time. The gains
+   must be below FP_ONE, so the products are computed with _mm_madd_epi16(). The linear
+   interpolation also uses it, as c * ( FP_MASK - fra ) + n * fra + c, which equals
+   ( c << FP_SHIFT ) + ( n - c ) * fra. */
+static void channel_mix( const short *sample_data, int sam_idx, int sam_fra, int step,
+		int *mix_buf, int count, int l_gain, int r_gain, int interpolation ) {
+	int idx, lane, pair, offsets[ 4 ];
+	const short *data;
+	__m128i fra, y, out;
+	__m128i gains = _mm_setr_epi32( l_gain, r_gain, l_gain, r_gain );
+	__m128i mask = _mm_set1_epi32( FP_MASK );
+	__m128i step4 = _mm_set1_epi32( step * 4 );
+	/* Fractional positions of the four frames, relative to sam_idx. */
+	__m128i pos = _mm_setr_epi32( sam_fra, sam_fra + step, sam_fra + step * 2, sam_fra + step * 3 );
+	for( idx = 0; idx + 4 <= count; idx += 4 ) {
+		_mm_storeu_si128( ( __m128i * ) offsets, _mm_srai_epi32( pos, FP_SHIFT ) );
+		fra = _mm_and_si128( pos, mask );
+		data = &sample_data[ sam_idx ];
+		if( interpolation == 2 ) {
+			int i0 = sam_idx + offsets[ 0 ], i1 = sam_idx + offsets[ 1 ];
+			int i2 = sam_idx + offsets[ 2 ], i3 = sam_idx + offsets[ 3 ];
+			{
+				__m128 s0 = _mm_setr_ps( sample_data[ i0 > 0 ? i0 - 1 : 0 ], sample_data[ i1 > 0 ? i1 - 1 : 0 ],
+					sample_data[ i2 > 0 ? i2 - 1 : 0 ], sample_data[ i3 > 0 ? i3 - 1 : 0 ] );
+				__m128 s1 = _mm_setr_ps( sample_data[ i0 ], sample_data[ i1 ], sample_data[ i2 ], sample_data[ i3 ] );
+				__m128 s2 = _mm_setr_ps( sample_data[ i0 + 1 ], sample_data[ i1 + 1 ], sample_data[ i2 + 1 ], sample_data[ i3 + 1 ] );
+				__m128 s3 = _mm_setr_ps( sample_data[ i0 + 2 ], sample_data[ i1 + 2 ], sample_data[ i2 + 2 ], sample_data[ i3 + 2 ] );
+				__m128 t = _mm_mul_ps( _mm_cvtepi32_ps( fra ), _mm_set1_ps( 1.0f / FP_ONE ) );
+				__m128 a = _mm_add_ps( _mm_mul_ps( _mm_set1_ps( 1.5f ), _mm_sub_ps( s1, s2 ) ),
+					_mm_mul_ps( _mm_set1_ps( 0.5f ), _mm_sub_ps( s3, s0 ) ) );
+				__m128 b = _mm_sub_ps( _mm_add_ps( _mm_sub_ps( s0, _mm_mul_ps( _mm_set1_ps( 2.5f ), s1 ) ),
+					_mm_mul_ps( _mm_set1_ps( 2.0f ), s2 ) ), _mm_mul_ps( _mm_set1_ps( 0.5f ), s3 ) );
+				__m128 c = _mm_mul_ps( _mm_set1_ps( 0.5f ), _mm_sub_ps( s2, s0 ) );
+				__m128 v = _mm_add_ps( _mm_mul_ps( _mm_add_ps( _mm_mul_ps( _mm_add_ps(
+					_mm_mul_ps( a, t ), b ), t ), c ), t ), s1 );
+				/* Saturated to 16 bits like channel_cubic(). */
+				y = _mm_cvttps_epi32( v );
+				y = _mm_packs_epi32( y, y );
+				y = _mm_unpacklo_epi16( y, y );
+			}
+		} else if( interpolation ) {
+			/* Each lane holds the sample c in its low half and the next one n in its high half. */
+			__m128i pairs, c, weights;
+			int p[ 4 ];
+			for( lane = 0; lane < 4; lane++ ) {
+				memcpy( &p[ lane ], &data[ offsets[ lane ] ], sizeof( int ) );
+			}
+			pairs = _mm_setr_epi32( p[ 0 ], p[ 1 ], p[ 2 ], p[ 3 ] );
+			c = _mm_srai_epi32( _mm_slli_epi32( pairs, 16 ), 16 );
+			weights = _mm_or_si128( _mm_slli_epi32( fra, 16 ), _mm_xor_si128( fra, mask ) );
+			y = _mm_srai_epi32( _mm_add_epi32( _mm_madd_epi16( pairs, weights ), c ), FP_SHIFT );
+		} else {
+			y = _mm_setr_epi32( data[ offsets[ 0 ] ], data[ offsets[ 1 ] ],
+				data[ offsets[ 2 ] ], data[ offsets[ 3 ] ] );
+		}
+		/* The high half of each sample lane is multiplied by the zero high half of the gain. */
+		out = _mm_srai_epi32( _mm_madd_epi16( _mm_unpacklo_epi32( y, y ), gains ), FP_SHIFT );
+		_mm_storeu_si128( ( __m128i * ) &mix_buf[ idx * 2 ],
+			_mm_add_epi32( _mm_loadu_si128( ( __m128i * ) &mix_buf[ idx * 2 ] ), out ) );
+		out = _mm_srai_epi32( _mm_madd_epi16( _mm_unpackhi_epi32( y, y ), gains ), FP_SHIFT );
+		_mm_storeu_si128( ( __m128i * ) &mix_buf[ idx * 2 + 4 ],
+			_mm_add_epi32( _mm_loadu_si128( ( __m128i * ) &mix_buf[ idx * 2 + 4 ] ), out ) );
+		/* Move sam_idx to the fifth frame, the first one of the next iteration. */
+		pos = _mm_add_epi32( pos, step4 );
+		pair = _mm_cvtsi128_si32( pos );
+		sam_idx += pair >> FP_SHIFT;
+		sam_fra = pair & FP_MASK;
+		pos = _mm_sub_epi32( pos, _mm_set1_epi32( pair & ~FP_MASK ) );
+	}
+	channel_mix_scalar( sample_data, sam_idx, sam_fra, step,
+		&mix_buf[ idx * 2 ], count - idx, l_gain, r_gain, interpolation );
+}
+#else
+#define channel_mix channel_mix_scalar
+#endif
+
+/* Interpolation: 0 nearest, 1 linear, 2 cubic. The frames are mixed in runs that end
+   at the loop end, so the mixing loops do not check it for every frame. */
 static void channel_resample( struct channel *channel, int *mix_buf,
-		int offset, int count, int sample_rate, int interpolate ) {
+		int offset, int count, int sample_rate, int interpolate, int simd ) {
 	struct sample *sample = channel->sample;
 	int l_gain, r_gain, sam_idx, sam_fra, step;
-	int loop_len, loop_end, out_idx, out_end, y, m, c;
+	int loop_len, loop_end, out_idx, out_end, run;
+	long long pos;
 	short *sample_data = channel->sample->data;
 	if( channel->ampl > 0 ) {
 		l_gain = channel->ampl * ( 255 - channel->pann ) >> 8;
@@ -1520,44 +1662,35 @@ static void channel_resample( struct channel *channel, int *mix_buf,
 		loop_end = sample->loop_start + loop_len;
 		out_idx = offset * 2;
 		out_end = ( offset + count ) * 2;
-		if( interpolate ) {
-			while( out_idx < out_end ) {
-				if( sam_idx >= loop_end ) {
-					if( loop_len > 1 ) {
-						while( sam_idx >= loop_end ) {
-							sam_idx -= loop_len;
-						}
-					} else {
-						break;
+		while( out_idx < out_end ) {
+			if( sam_idx >= loop_end ) {
+				if( loop_len > 1 ) {
+					while( sam_idx >= loop_end ) {
+						sam_idx -= loop_len;
 					}
+				} else {
+					break;
 				}
-				c = sample_data[ sam_idx ];
-				m = sample_data[ sam_idx + 1 ] - c;
-				y = ( ( m * sam_fra ) >> FP_SHIFT ) + c;
-				mix_buf[ out_idx++ ] += ( y * l_gain ) >> FP_SHIFT;
-				mix_buf[ out_idx++ ] += ( y * r_gain ) >> FP_SHIFT;
-				sam_fra += step;
-				sam_idx += sam_fra >> FP_SHIFT;
-				sam_fra &= FP_MASK;
 			}
-		} else {
-			while( out_idx < out_end ) {
-				if( sam_idx >= loop_end ) {
-					if( loop_len > 1 ) {
-						while( sam_idx >= loop_end ) {
-							sam_idx -= loop_len;
-						}
-					} else {
-						break;
-					}
+			/* Frames before the position reaches the loop end. */
+			run = ( out_end - out_idx ) >> 1;
+			if( step > 0 ) {
+				pos = ( ( ( long long ) ( loop_end - sam_idx ) << FP_SHIFT ) - sam_fra + step - 1 ) / step;
+				if( pos < run ) {
+					run = ( int ) pos;
 				}
-				y = sample_data[ sam_idx ];
-				mix_buf[ out_idx++ ] += ( y * l_gain ) >> FP_SHIFT;
-				mix_buf[ out_idx++ ] += ( y * r_gain ) >> FP_SHIFT;
-				sam_fra += step;
-				sam_idx += sam_fra >> FP_SHIFT;
-				sam_fra &= FP_MASK;
 			}
+			if( simd && l_gain < FP_ONE && r_gain < FP_ONE ) {
+				channel_mix( sample_data, sam_idx, sam_fra, step,
+					&mix_buf[ out_idx ], run, l_gain, r_gain, interpolate );
+			} else {
+				channel_mix_scalar( sample_data, sam_idx, sam_fra, step,
+					&mix_buf[ out_idx ], run, l_gain, r_gain, interpolate );
+			}
+			out_idx += run * 2;
+			pos = sam_fra + ( long long ) step * run;
+			sam_idx += ( int ) ( pos >> FP_SHIFT );
+			sam_fra = ( int ) ( pos & FP_MASK );
 		}
 	}
 }
@@ -1759,6 +1892,7 @@ struct replay* new_replay( struct module *module, int sample_rate, int interpola
 		replay->module = module;
 		replay->sample_rate = sample_rate;
 		replay->interpolation = interpolation;
+		replay->simd = 1;
 		replay->ramp_buf = PushZeroArray(*arena, int, 128);
 		replay->channels = PushZeroArray(*arena, struct channel, module->num_channels);
 		replay->play_count = PushZeroArray(*arena, char*, module->sequence_len);
@@ -1817,7 +1951,23 @@ int replay_seek( struct replay *replay, int sample_pos ) {
 
 static void replay_volume_ramp( struct replay *replay, int *mix_buf, int tick_len ) {
 	int idx, a1, a2, ramp_rate = 256 * 2048 / replay->sample_rate;
-	for( idx = 0, a1 = 0; a1 < 256; idx += 2, a1 += ramp_rate ) {
+	idx = 0, a1 = 0;
+#if USE_AUDIO_SSE2
+	/* Two frames at a time, while both of them ramp. */
+	if( replay->simd ) {
+		__m128i a1_2 = _mm_setr_epi32( 0, 0, ramp_rate, ramp_rate );
+		__m128i rate_2 = _mm_set1_epi32( ramp_rate * 2 );
+		__m128i one = _mm_set1_epi32( 256 );
+		for( ; a1 + ramp_rate < 256; idx += 4, a1 += ramp_rate * 2 ) {
+			__m128i mix = _mm_loadu_si128( ( __m128i * ) &mix_buf[ idx ] );
+			__m128i ramp = _mm_loadu_si128( ( __m128i * ) &replay->ramp_buf[ idx ] );
+			__m128i sum = _mm_add_epi32( mullo_epi32( mix, a1_2 ), mullo_epi32( ramp, _mm_sub_epi32( one, a1_2 ) ) );
+			_mm_storeu_si128( ( __m128i * ) &mix_buf[ idx ], _mm_srai_epi32( sum, 8 ) );
+			a1_2 = _mm_add_epi32( a1_2, rate_2 );
+		}
+	}
+#endif
+	for( ; a1 < 256; idx += 2, a1 += ramp_rate ) {
 		a2 = 256 - a1;
 		mix_buf[ idx     ] = ( mix_buf[ idx     ] * a1 + replay->ramp_buf[ idx     ] * a2 ) >> 8;
 		mix_buf[ idx + 1 ] = ( mix_buf[ idx + 1 ] * a1 + replay->ramp_buf[ idx + 1 ] * a2 ) >> 8;
@@ -1826,9 +1976,24 @@ static void replay_volume_ramp( struct replay *replay, int *mix_buf, int tick_le
 }
 
 /* 2:1 downsampling with simple but effective anti-aliasing. Buf must contain count * 2 + 1 stereo samples. */
-static void downsample( int *buf, int count ) {
-	int idx, out_idx, out_len = count * 2;
-	for( idx = 0, out_idx = 0; out_idx < out_len; idx += 4, out_idx += 2 ) {
+static void downsample( int *buf, int count, int simd ) {
+	int idx = 0, out_idx = 0, out_len = count * 2;
+#if USE_AUDIO_SSE2
+	/* Two output frames from five input frames at a time, the stores stay behind the loads.
+	   The last pair reads one frame more than the scalar code, which the buffer has. */
+	if( simd ) {
+		for( ; out_idx + 4 <= out_len; idx += 8, out_idx += 4 ) {
+			__m128i a = _mm_loadu_si128( ( __m128i * ) &buf[ idx     ] );
+			__m128i b = _mm_loadu_si128( ( __m128i * ) &buf[ idx + 4 ] );
+			__m128i c = _mm_loadu_si128( ( __m128i * ) &buf[ idx + 8 ] );
+			__m128i x0 = _mm_srai_epi32( _mm_unpacklo_epi64( a, b ), 2 );
+			__m128i x1 = _mm_srai_epi32( _mm_unpackhi_epi64( a, b ), 1 );
+			__m128i x2 = _mm_srai_epi32( _mm_unpacklo_epi64( b, c ), 2 );
+			_mm_storeu_si128( ( __m128i * ) &buf[ out_idx ], _mm_add_epi32( _mm_add_epi32( x0, x1 ), x2 ) );
+		}
+	}
+#endif
+	for( ; out_idx < out_len; idx += 4, out_idx += 2 ) {
 		buf[ out_idx     ] = ( buf[ idx     ] >> 2 ) + ( buf[ idx + 2 ] >> 1 ) + ( buf[ idx + 4 ] >> 2 );
 		buf[ out_idx + 1 ] = ( buf[ idx + 1 ] >> 2 ) + ( buf[ idx + 3 ] >> 1 ) + ( buf[ idx + 5 ] >> 2 );
 	}
@@ -1847,17 +2012,22 @@ int replay_get_audio( struct replay *replay, int *mix_buf, int mute ) {
 		channel = &replay->channels[ idx ];
 		if( !( mute & 1 ) ) {
 			channel_resample( channel, mix_buf, 0, ( tick_len + 65 ) * 2,
-				replay->sample_rate * 2, replay->interpolation );
+				replay->sample_rate * 2, replay->interpolation, replay->simd );
 		}
 		channel_update_sample_idx( channel, tick_len * 2, replay->sample_rate * 2 );
 		mute >>= 1;
 	}
-	downsample( mix_buf, tick_len + 64 );
+	downsample( mix_buf, tick_len + 64, replay->simd );
 	replay_volume_ramp( replay, mix_buf, tick_len );
 	replay_tick( replay );
 	return tick_len;
 }
 
+/* Mixes with the SIMD code (the default) or with the scalar reference code. */
+void replay_set_simd( struct replay *replay, int simd ) {
+	replay->simd = simd;
+}
+
 /* Returns the currently playing pattern in the sequence.*/
 int replay_get_sequence_pos( struct replay *replay ) {
 	return replay->seq_pos;
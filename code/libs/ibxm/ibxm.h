@@ -9,6 +9,9 @@ allocation based on linear arenas instead.
   only needed at module and replay objects creation time.
 - free is not needed, deallocation happens at once when resetting the arena.
   Consequently, dispose methods have also been removed from the libray.
+- The channel mixer, the volume ramp and the downsampling have SSE2 versions,
+  selectable with replay_set_simd(), and a cubic interpolation mode. Samples
+  carry two guard samples after the loop end for the interpolation.
 */
 
 #ifndef IBXM_H
@@ -60,7 +63,8 @@ struct module {
 /* Allocate and initialize a module from the specified data, returns NULL on error.
    Message must point to a 64-character buffer to receive error messages. */
 struct module* module_load( struct data *data, char *message, struct Arena *arena );
-/* Allocate and initialize a replay with the specified module and sampling rate. */
+/* Allocate and initialize a replay with the specified module and sampling rate.
+   Interpolation is 0 for nearest, 1 for linear and 2 for cubic. */
 struct replay* new_replay( struct module *module, int sample_rate, int interpolation, struct Arena *arena );
 /* Returns the song duration in samples at the current sampling rate. */
 int replay_calculate_duration( struct replay *replay );
@@ -72,6 +76,8 @@ void replay_set_sequence_pos( struct replay *replay, int pos );
 /* Generates audio and returns the number of stereo samples written into mix_buf.
    Individual channels may be excluded using the mute bitmask. */
 int replay_get_audio( struct replay *replay, int *mix_buf, int mute );
+/* Mixes with the SIMD code (the default) or with the scalar reference code. */
+void replay_set_simd( struct replay *replay, int simd );
 /* Returns the currently playing pattern in the sequence.*/
 int replay_get_sequence_pos( struct replay *replay );
 /* Returns the currently playing row in the pattern. */
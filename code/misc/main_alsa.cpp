@@ -22,6 +22,11 @@ typedef int SND_PCM_HW_PARAMS_GET_PERIOD_TIME(const snd_pcm_hw_params_t *params,
 typedef int SND_PCM_HW_PARAMS_GET_PERIOD_SIZE(const snd_pcm_hw_params_t *params, snd_pcm_uframes_t *frames, int *dir);
 typedef int SND_PCM_AVAIL_DELAY(snd_pcm_t *pcm, snd_pcm_sframes_t *availp, snd_pcm_sframes_t *delayp);
 typedef snd_pcm_sframes_t SND_PCM_WRITEI(snd_pcm_t *pcm, const void *buffer, snd_pcm_uframes_t size);
+typedef int SND_PCM_MMAP_BEGIN(snd_pcm_t *pcm, const snd_pcm_channel_area_t **areas, snd_pcm_uframes_t *offset, snd_pcm_uframes_t *frames);
+typedef snd_pcm_sframes_t SND_PCM_MMAP_COMMIT(snd_pcm_t *pcm, snd_pcm_uframes_t offset, snd_pcm_uframes_t frames);
+typedef snd_pcm_sframes_t SND_PCM_AVAIL_UPDATE(snd_pcm_t *pcm);
+typedef snd_pcm_state_t SND_PCM_STATE(snd_pcm_t *pcm);
+typedef int SND_PCM_START(snd_pcm_t *pcm);
 typedef int SND_PCM_PREPARE(snd_pcm_t *pcm);
 typedef int SND_PCM_CLOSE(snd_pcm_t *pcm);
 typedef int SND_PCM_DRAIN(snd_pcm_t *pcm);
@@ -44,12 +49,53 @@ SND_PCM_HW_PARAMS_GET_PERIOD_TIME* FP_snd_pcm_hw_params_get_period_time;
 SND_PCM_HW_PARAMS_GET_PERIOD_SIZE* FP_snd_pcm_hw_params_get_period_size;
 SND_PCM_AVAIL_DELAY* FP_snd_pcm_avail_delay;
 SND_PCM_WRITEI* FP_snd_pcm_writei;
+SND_PCM_MMAP_BEGIN* FP_snd_pcm_mmap_begin;
+SND_PCM_MMAP_COMMIT* FP_snd_pcm_mmap_commit;
+SND_PCM_AVAIL_UPDATE* FP_snd_pcm_avail_update;
+SND_PCM_STATE* FP_snd_pcm_state;
+SND_PCM_START* FP_snd_pcm_start;
 SND_PCM_PREPARE* FP_snd_pcm_prepare;
 SND_PCM_CLOSE* FP_snd_pcm_close;
 SND_PCM_DRAIN* FP_snd_pcm_drain;
 
-int main()
+// Sin wave
+struct Tone
 {
+	float wavePeriod;
+	float tSine;
+	i16 volume;
+};
+
+static void RenderTone(Tone &tone, i16 *samples, snd_pcm_uframes_t frameCount)
+{
+	for (u32 i = 0; i < frameCount; ++i)
+	{
+		tone.tSine += TwoPi / tone.wavePeriod;
+		while ( tone.tSine >= TwoPi ) { tone.tSine -= TwoPi; }
+		const float sinValue = Sin( tone.tSine );
+		const i16 sample = (i16)(sinValue * tone.volume);
+
+		*samples++ = sample;
+		*samples++ = sample;
+	}
+}
+
+static u64 NowNanos()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+}
+
+// Mirrors the mmap transfer and the adaptive write-ahead of platform_linux.cpp, so they can
+// be tried on their own, also on a headless machine with the null or file plugins:
+//   ./build/main_alsa null 10
+//   ./build/main_alsa file:FILE=out.raw,FORMAT=raw 10
+int main(int argc, char **argv)
+{
+	const char *deviceName = argc > 1 ? argv[1] : "default";
+	const u32 seconds = argc > 2 ? (u32)atoi(argv[2]) : 3;
+
 	// Load ALSA library
 	DynamicLibrary alsa = OpenLibrary("libasound.so");
 	if (!alsa)
@@ -77,6 +123,11 @@ int main()
 	FP_snd_pcm_hw_params_get_period_size = (SND_PCM_HW_PARAMS_GET_PERIOD_SIZE*) LoadSymbol(alsa, "snd_pcm_hw_params_get_period_size");
 	FP_snd_pcm_avail_delay = (SND_PCM_AVAIL_DELAY*) LoadSymbol(alsa, "snd_pcm_avail_delay");
 	FP_snd_pcm_writei = (SND_PCM_WRITEI*) LoadSymbol(alsa, "snd_pcm_writei");
+	FP_snd_pcm_mmap_begin = (SND_PCM_MMAP_BEGIN*) LoadSymbol(alsa, "snd_pcm_mmap_begin");
+	FP_snd_pcm_mmap_commit = (SND_PCM_MMAP_COMMIT*) LoadSymbol(alsa, "snd_pcm_mmap_commit");
+	FP_snd_pcm_avail_update = (SND_PCM_AVAIL_UPDATE*) LoadSymbol(alsa, "snd_pcm_avail_update");
+	FP_snd_pcm_state = (SND_PCM_STATE*) LoadSymbol(alsa, "snd_pcm_state");
+	FP_snd_pcm_start = (SND_PCM_START*) LoadSymbol(alsa, "snd_pcm_start");
 	FP_snd_pcm_prepare = (SND_PCM_PREPARE*) LoadSymbol(alsa, "snd_pcm_prepare");
 	FP_snd_pcm_close = (SND_PCM_CLOSE*) LoadSymbol(alsa, "snd_pcm_close");
 	FP_snd_pcm_drain = (SND_PCM_DRAIN*) LoadSymbol(alsa, "snd_pcm_drain");
@@ -85,7 +136,7 @@ int main()
 
 	// Open PCM device
 	snd_pcm_t *handle;
-	res = FP_snd_pcm_open(&handle, "default", SND_PCM_STREAM_PLAYBACK, SND_PCM_NONBLOCK);
+	res = FP_snd_pcm_open(&handle, deviceName, SND_PCM_STREAM_PLAYBACK, SND_PCM_NONBLOCK);
 	if (res < 0) {
 		LOG(Error, "unable to open pcm device: %s\n", FP_snd_strerror(res));
 		return 1;
@@ -95,7 +146,7 @@ int main()
 	unsigned int sampleRate = 48000; // bits/second (CD quality)
 	unsigned int channelCount = 2;
 	unsigned int bytesPerSample = 2;
-	snd_pcm_uframes_t frames = 32; // period size of 32 frames
+	snd_pcm_uframes_t frames = 96; // period size of 2 ms
 
 	// Allocate and configure hardware parameters
 	snd_pcm_hw_params_t *params;
@@ -104,7 +155,10 @@ int main()
 	FP_snd_pcm_hw_params_set_channels(handle, params, channelCount);
 	FP_snd_pcm_hw_params_set_rate_near(handle, params, &sampleRate, &dir);
 	FP_snd_pcm_hw_params_set_format(handle, params, SND_PCM_FORMAT_S16_LE); // 16 bit little endian
-	FP_snd_pcm_hw_params_set_access(handle, params, SND_PCM_ACCESS_RW_INTERLEAVED);
+	const bool mmap = FP_snd_pcm_hw_params_set_access(handle, params, SND_PCM_ACCESS_MMAP_INTERLEAVED) == 0;
+	if ( !mmap ) {
+		FP_snd_pcm_hw_params_set_access(handle, params, SND_PCM_ACCESS_RW_INTERLEAVED);
+	}
 	FP_snd_pcm_hw_params_set_period_size_near(handle, params, &frames, &dir);
 
 	// Write the parameters to the driver
@@ -146,68 +200,134 @@ int main()
 	LOG(Debug, "Frames per period: %u\n", framesPerPeriod);
 	#endif
 
-	// Sin wave parameters
-	const u32 toneHz = 261;
-	const u32 toneVolume = 12000;
-	const float wavePeriod = finalSampleRate / toneHz;
-	float tSine = 0.0f;
+	LOG(Info, "Device %s (%s) at %u Hz\n", deviceName, mmap ? "mmap" : "read/write", finalSampleRate);
+
+	Tone tone = {};
+	tone.wavePeriod = finalSampleRate / 261.0f;
+	tone.volume = 12000;
 
-	// Target frames per iteration
-	const float time = 2.0f / 30.0f; // Two times what's needed to render two game frames
-	const snd_pcm_uframes_t maxFramesToRender = finalSampleRate * time;
+	// Write-ahead bounds, as in platform_linux.cpp with 4 ms and 33 ms
+	const u64 periodNanos = 2000000;
+	const snd_pcm_sframes_t minWriteAheadFrames = finalSampleRate * 4 / 1000;
+	const snd_pcm_sframes_t maxWriteAheadFrames = finalSampleRate * 33 / 1000;
+	snd_pcm_sframes_t writeAheadFrames = maxWriteAheadFrames;
+	f32 peakDelayMillis = 16.0f;
 
-	// Buffer allocation
-	const int bufferSize = maxFramesToRender * channelCount * bytesPerSample;
+	// Buffer allocation, for the read/write transfer
+	const int bufferSize = maxWriteAheadFrames * channelCount * bytesPerSample;
 	char * buffer = (char *) malloc(bufferSize);
 
-	// Iterate for 3 seconds
-	long frameCount = 0;
-	const long maxFrames = finalSampleRate * 3;
+	// Host clock, for devices without one
+	u32 clocklessUpdateCount = 0;
+	bool hostClock = false;
+	u64 startNanos = 0;
+	u64 writtenFrames = 0;
 
-	while (frameCount < maxFrames)
-	{
-		snd_pcm_sframes_t availableFrames;
-		snd_pcm_sframes_t delayFrames;
-		if ( FP_snd_pcm_avail_delay(handle, &availableFrames, &delayFrames) == 0 ) {
-			//LOG(Debug, "avail:%u / delay:%u\n", availableFrames, delayFrames);
-		}
+	// Stats
+	u32 updateCount = 0;
+	u32 underrunCount = 0;
+	f32 maxLateMillis = 0.0f;
+	f64 latencyMillisSum = 0.0;
 
-		snd_pcm_uframes_t framesToRender = maxFramesToRender - delayFrames;
+	const u64 endNanos = NowNanos() + seconds * 1000000000ull;
+	u64 deadlineNanos = NowNanos();
 
-		framesToRender = framesToRender < availableFrames ? framesToRender : availableFrames;
+	while (NowNanos() < endNanos)
+	{
+		// Sleep until the next deadline
+		deadlineNanos += periodNanos;
+		const timespec deadline = { (time_t)(deadlineNanos / 1000000000ull), (long)(deadlineNanos % 1000000000ull) };
+		while ( clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR );
+		const u64 wakeNanos = NowNanos();
+		maxLateMillis = Max(maxLateMillis, (wakeNanos - deadlineNanos) / 1000000.0f);
 
-		u16 *samplePtr = (u16*)buffer;
-		for (u32 i = 0; i < framesToRender; ++i)
+		snd_pcm_sframes_t availableFrames = 0;
+		snd_pcm_sframes_t delayFrames = 0;
+		res = FP_snd_pcm_avail_delay(handle, &availableFrames, &delayFrames);
+		if ( res == 0 && !hostClock )
+		{
+			const bool clockless = writtenFrames > 0 && delayFrames == 0;
+			clocklessUpdateCount = clockless ? clocklessUpdateCount + 1 : 0;
+			if ( clocklessUpdateCount == 3 ) {
+				LOG(Info, "Device has no clock, pacing it with the host clock\n");
+				hostClock = true;
+				startNanos = wakeNanos;
+				writtenFrames = 0;
+			}
+		}
+		if ( hostClock )
 		{
-			tSine += TwoPi / wavePeriod;
-			while ( tSine >= TwoPi ) { tSine -= TwoPi; }
-			const float sinValue = Sin( tSine );
-			const i16 sample = (i16)(sinValue * toneVolume);
-
-			*samplePtr++ = sample;
-			*samplePtr++ = sample;
-			++frameCount;
+			const u64 playedFrames = (wakeNanos - startNanos) * finalSampleRate / 1000000000ull;
+			if ( playedFrames > writtenFrames ) {
+				underrunCount++;
+				startNanos = wakeNanos - writtenFrames * 1000000000ull / finalSampleRate;
+			}
+			delayFrames = playedFrames < writtenFrames ? writtenFrames - playedFrames : 0;
 		}
 
-		if ( framesToRender > 0 )
+		snd_pcm_sframes_t framesToRender = writeAheadFrames - delayFrames;
+		framesToRender = framesToRender < availableFrames ? framesToRender : availableFrames;
+
+		if ( res == 0 && framesToRender > 0 )
 		{
-			res = FP_snd_pcm_writei(handle, buffer, framesToRender);
+			if ( mmap )
+			{
+				snd_pcm_uframes_t remainingFrames = framesToRender;
+				res = FP_snd_pcm_avail_update(handle);
+				while ( res >= 0 && remainingFrames > 0 )
+				{
+					const snd_pcm_channel_area_t *areas;
+					snd_pcm_uframes_t offset;
+					snd_pcm_uframes_t frames = remainingFrames;
+					res = FP_snd_pcm_mmap_begin(handle, &areas, &offset, &frames);
+					if ( res < 0 ) break;
+					i16 *samples = (i16*)((char*)areas[0].addr + (areas[0].first + offset * areas[0].step) / 8);
+					RenderTone(tone, samples, frames);
+					res = FP_snd_pcm_mmap_commit(handle, offset, frames);
+					if ( res >= 0 && (snd_pcm_uframes_t)res != frames ) res = -EPIPE;
+					remainingFrames -= frames;
+				}
+				if ( res >= 0 && FP_snd_pcm_state(handle) == SND_PCM_STATE_PREPARED ) {
+					res = FP_snd_pcm_start(handle);
+				}
+			}
+			else
+			{
+				RenderTone(tone, (i16*)buffer, framesToRender);
+				res = FP_snd_pcm_writei(handle, buffer, framesToRender);
+			}
 
 			if ( res >= 0 ) {
-				//LOG(Info, "%u frames written\n", res);
-			} else if (res == -EPIPE) {
-				LOG(Error, "An underrun occurred: %s\n", FP_snd_strerror(res));
-				FP_snd_pcm_prepare(handle);
-			} else if (res == -EBADFD) {
-				LOG(Error, "PCM is not in the right state (PREPARED or RUNNING): %s\n", FP_snd_strerror(res));
-			} else if (res == -ESTRPIPE) {
-				LOG(Error, "Underrun error: %s\n", FP_snd_strerror(res));
-			} else {
-				LOG(Error, "Unknown error: %s\n", FP_snd_strerror(res));
+				writtenFrames += framesToRender;
+				latencyMillisSum += 1000.0 * (delayFrames + framesToRender) / finalSampleRate;
+				updateCount++;
 			}
 		}
+
+		if (res == -EPIPE) {
+			underrunCount++;
+			peakDelayMillis += periodNanos / 1000000.0f;
+			FP_snd_pcm_prepare(handle);
+		} else if (res == -EBADFD) {
+			LOG(Error, "PCM is not in the right state (PREPARED or RUNNING): %s\n", FP_snd_strerror(res));
+		} else if (res < 0) {
+			LOG(Error, "Unknown error: %s\n", FP_snd_strerror(res));
+		}
+
+		// Adapt the write-ahead to the wake-up delays
+		const f32 delayMillis = (NowNanos() - deadlineNanos) / 1000000.0f;
+		peakDelayMillis = Max(delayMillis, peakDelayMillis * 0.999f);
+		const f32 writeAheadMillis = periodNanos / 1000000.0f + 2.0f * peakDelayMillis + 1.0f;
+		writeAheadFrames = (snd_pcm_sframes_t)(writeAheadMillis * finalSampleRate / 1000.0f);
+		writeAheadFrames = writeAheadFrames < minWriteAheadFrames ? minWriteAheadFrames : writeAheadFrames;
+		writeAheadFrames = writeAheadFrames > maxWriteAheadFrames ? maxWriteAheadFrames : writeAheadFrames;
 	}
 
+	LOG(Info, "Write-ahead %.1f ms, average latency %.1f ms, wake-ups up to %.2f ms late, %u underruns\n",
+		1000.0f * writeAheadFrames / finalSampleRate,
+		updateCount > 0 ? latencyMillisSum / updateCount : 0.0,
+		maxLateMillis, underrunCount);
+
 	FP_snd_pcm_drain(handle);
 	FP_snd_pcm_close(handle);
 
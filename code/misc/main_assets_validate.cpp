@@ -0,0 +1,280 @@
+#include "../ilu_core.h"
+#include "../data.h"
+
+// Validates a binary assets file (assets.dat / shaders.dat) produced by BuildAssets.
+// Checks the header, the table of contents, every section and every payload checksum,
+// and prints section-level stats.
+
+struct PayloadStats
+{
+	u32 count;
+	u32 errorCount;
+	u64 bytes;
+};
+
+static const BinSection *sections[BinSectionType_COUNT];
+static PayloadStats payloadStats[BinSectionType_COUNT];
+static u32 errorCount = 0;
+static const char *okStatus = "ok";
+
+static bool CheckRange(const DataChunk &file, u64 offset, u64 size)
+{
+	const bool ok = offset + size <= file.size;
+	return ok;
+}
+
+static void CheckPayload(const DataChunk &file, BinSectionType dataType, const BinLocation &location, const char *assetName)
+{
+	PayloadStats &stats = payloadStats[dataType];
+	const BinSection *section = sections[dataType];
+	const char *sectionName = BinSectionInfos[dataType].name;
+	const char *name = assetName ? assetName : "<unnamed>";
+
+	stats.count++;
+	stats.bytes += location.size;
+
+	if ( location.size == 0 ) {
+		return;
+	}
+
+	// Added in 64 bits, so a corrupt offset cannot wrap around and land inside the section
+	const u64 payloadEnd = (u64)location.offset + location.size;
+	const u64 sectionEnd = section ? (u64)section->offset + section->size : 0;
+
+	bool ok = true;
+	if ( !section || location.offset < section->offset || payloadEnd > sectionEnd )
+	{
+		LOG(Error, "- Payload of %s lies outside of section %s\n", name, sectionName);
+		ok = false;
+	}
+	else if ( location.offset % section->alignment != 0 )
+	{
+		LOG(Error, "- Payload of %s is not aligned to %u bytes\n", name, section->alignment);
+		ok = false;
+	}
+	else if ( HashXX64(file.bytes + location.offset, location.size) != location.checksum )
+	{
+		LOG(Error, "- Payload of %s has a wrong checksum\n", name);
+		ok = false;
+	}
+
+	if ( !ok ) {
+		stats.errorCount++;
+		errorCount++;
+	}
+}
+
+template< typename T >
+static const T *GetDescs(const DataChunk &file, BinSectionType type, u32 &count)
+{
+	const BinSection *section = sections[type];
+	count = section && section->count * sizeof(T) <= section->size ? section->count : 0;
+	const T *descs = count > 0 ? (const T*)(file.bytes + section->offset) : nullptr;
+	return descs;
+}
+
+static const char *GetString(const DataChunk &file, const char *offsetPtr)
+{
+	const BinSection *pool = sections[BinSectionType_StringPool];
+	const u64 offset = (u64)offsetPtr;
+	const char *str = pool && offset > 0 && offset < pool->size ? file.chars + pool->offset + offset : nullptr;
+	return str;
+}
+
+int main(int argc, char **argv)
+{
+	if ( argc < 2 )
+	{
+		LOG(Info, "Usage: %s <assets file>\n", argv[0]);
+		return -1;
+	}
+
+	const char *filename = argv[1];
+
+	u64 fileSize = 0;
+	if ( !GetFileSize(filename, fileSize) || fileSize + KB(4) > U32_MAX )
+	{
+		LOG(Error, "Could not get the size of file: %s\n", filename);
+		return -1;
+	}
+
+	// Create a memory arena
+	const u32 memorySize = U64ToU32(fileSize + KB(4));
+	byte *memory = (byte*)AllocateVirtualMemory(memorySize);
+	Arena arena = MakeArena(memory, memorySize, "Validator");
+
+	// Read file
+	DataChunk *chunk = PushFile(arena, filename);
+	if ( !chunk )
+	{
+		LOG(Error, "Error reading file: %s\n", filename);
+		return -1;
+	}
+	const DataChunk &file = *chunk;
+
+	const Clock startClock = GetClock();
+
+	// Header
+	if ( file.size < sizeof(BinAssetsHeader) )
+	{
+		LOG(Error, "File too small to contain a header: %s\n", filename);
+		return -1;
+	}
+
+	const BinAssetsHeader &header = *(const BinAssetsHeader*)file.bytes;
+	if ( header.magicNumber != BinAssetsMagicNumber )
+	{
+		LOG(Error, "Wrong magic number in file %s\n", filename);
+		return -1;
+	}
+	if ( header.version != BinAssetsVersion )
+	{
+		LOG(Error, "Wrong version (%u, expected %u) in file %s\n", header.version, BinAssetsVersion, filename);
+		return -1;
+	}
+
+	// Table of contents
+	const u64 tocSize = (u64)header.sectionCount * sizeof(BinSection);
+	if ( !CheckRange(file, header.tocOffset, tocSize) )
+	{
+		LOG(Error, "Table of contents exceeds the file size (truncated?)\n");
+		return -1;
+	}
+	if ( HashXX64(file.bytes + header.tocOffset, tocSize) != header.tocChecksum )
+	{
+		LOG(Error, "Table of contents has a wrong checksum\n");
+		return -1;
+	}
+
+	const BinSection *toc = (const BinSection*)(file.bytes + header.tocOffset);
+
+	LOG(Info, "File: %s\n", filename);
+	LOG(Info, "Size: %llu bytes, version %u, %u sections\n", file.size, header.version, header.sectionCount);
+	LOG(Info, "\n");
+	LOG(Info, "%-16s %4s %5s %10s %10s %6s  %s\n", "Section", "Ver", "Align", "Offset", "Size", "Count", "Status");
+
+	u64 sectionBytes = 0;
+
+	for (u32 i = 0; i < header.sectionCount; ++i)
+	{
+		const BinSection &section = toc[i];
+		const char *status = okStatus;
+
+		if ( section.type >= BinSectionType_COUNT )
+		{
+			LOG(Info, "%-16s %4u %5u %10u %10u %6u  %s\n", "<unknown>", section.version, section.alignment, section.offset, section.size, section.count, "skipped");
+			continue;
+		}
+
+		const BinSectionInfo &info = BinSectionInfos[section.type];
+
+		if ( sections[section.type] ) {
+			status = "DUPLICATED";
+		} else if ( section.version != info.version ) {
+			status = "WRONG VERSION";
+		} else if ( !CheckRange(file, section.offset, section.size) ) {
+			status = "TRUNCATED";
+		} else if ( section.alignment == 0 || section.offset % section.alignment != 0 ) {
+			status = "MISALIGNED";
+		} else {
+			// Payloads are still checked one by one to tell which one is corrupted
+			sections[section.type] = &section;
+			sectionBytes += section.size;
+
+			if ( HashXX64(file.bytes + section.offset, section.size) != section.checksum ) {
+				status = "WRONG CHECKSUM";
+			}
+		}
+
+		if ( sections[section.type] != &section || status != okStatus ) {
+			errorCount++;
+		}
+
+		LOG(Info, "%-16s %4u %5u %10u %10u %6u  %s\n", info.name, section.version, section.alignment, section.offset, section.size, section.count, status);
+	}
+
+	// Payloads
+	LOG(Info, "\n");
+
+	u32 count = 0;
+
+	const BinShaderDesc *shaderDescs = GetDescs<BinShaderDesc>(file, BinSectionType_ShaderDescs, count);
+	for (u32 i = 0; i < count; ++i) {
+		CheckPayload(file, BinSectionType_ShaderData, shaderDescs[i].location, GetString(file, shaderDescs[i].name));
+	}
+
+	const BinImageDesc *imageDescs = GetDescs<BinImageDesc>(file, BinSectionType_ImageDescs, count);
+	for (u32 i = 0; i < count; ++i) {
+		CheckPayload(file, BinSectionType_ImageData, imageDescs[i].location, GetString(file, imageDescs[i].name));
+	}
+
+	const BinMeshDesc *meshDescs = GetDescs<BinMeshDesc>(file, BinSectionType_MeshDescs, count);
+	for (u32 i = 0; i < count; ++i) {
+		const BinMeshDesc &mesh = meshDescs[i];
+		const char *name = GetString(file, mesh.name);
+		if ( mesh.location.size != mesh.vertexCount * sizeof(BinMeshVertex) + mesh.indexCount * sizeof(u16) ) {
+			LOG(Error, "- Payload of mesh %s does not match its vertex and index counts\n", name ? name : "<unnamed>");
+			payloadStats[BinSectionType_MeshData].errorCount++;
+			errorCount++;
+		}
+		CheckPayload(file, BinSectionType_MeshData, mesh.location, name);
+	}
+
+	const BinAudioClipDesc *audioClipDescs = GetDescs<BinAudioClipDesc>(file, BinSectionType_AudioClipDescs, count);
+	for (u32 i = 0; i < count; ++i) {
+		const BinAudioClipDesc &clip = audioClipDescs[i];
+		const u32 frameCount = clip.channelCount > 0 ? clip.sampleCount / clip.channelCount : 0;
+		const u32 blockCount = ( frameCount + AUDIO_ADPCM_BLOCK_FRAMES - 1 ) / AUDIO_ADPCM_BLOCK_FRAMES;
+		const u64 expectedSize = clip.format == AudioClipFormat_ADPCM ?
+			blockCount * 2 * sizeof(AudioAdpcmHeader) + frameCount :
+			(u64)clip.sampleCount * clip.sampleSize;
+		if ( clip.location.size != expectedSize ) {
+			LOG(Error, "- Payload of audio clip %u does not match its sample count\n", i);
+			payloadStats[BinSectionType_AudioClipData].errorCount++;
+			errorCount++;
+		}
+		CheckPayload(file, BinSectionType_AudioClipData, clip.location, "audio clip");
+	}
+
+	const BinMusicFileDesc *musicFileDescs = GetDescs<BinMusicFileDesc>(file, BinSectionType_MusicFileDescs, count);
+	for (u32 i = 0; i < count; ++i) {
+		CheckPayload(file, BinSectionType_MusicFileData, musicFileDescs[i].location, GetString(file, musicFileDescs[i].name));
+	}
+
+	const BinRoomDesc *roomDescs = GetDescs<BinRoomDesc>(file, BinSectionType_RoomDescs, count);
+	for (u32 i = 0; i < count; ++i) {
+		const BinRoomDesc &room = roomDescs[i];
+		for (u32 l = 0; l < room.layerCount && l < ARRAY_COUNT(room.layers); ++l) {
+			CheckPayload(file, BinSectionType_TileData, room.layers[l].tiles, GetString(file, room.name));
+		}
+	}
+
+	LOG(Info, "%-16s %8s %12s %12s %8s\n", "Payloads", "Count", "Bytes", "Padding", "Errors");
+	for (u32 i = 0; i < BinSectionType_COUNT; ++i)
+	{
+		const PayloadStats &stats = payloadStats[i];
+		const BinSection *section = sections[i];
+		if ( stats.count > 0 && section )
+		{
+			const u64 padding = section->size - stats.bytes;
+			LOG(Info, "%-16s %8u %12llu %12llu %8u\n", BinSectionInfos[i].name, stats.count, stats.bytes, padding, stats.errorCount);
+		}
+	}
+
+	const Clock endClock = GetClock();
+	const f32 seconds = GetSecondsElapsed(startClock, endClock);
+	const f32 megabytes = (f32)file.size / MB(1);
+
+	LOG(Info, "\n");
+	LOG(Info, "Sections cover %llu of %llu bytes (%.1f%%)\n", sectionBytes, file.size, 100.0f * sectionBytes / file.size);
+	LOG(Info, "Validated in %.3f ms (%.0f MB/s)\n", 1000.0f * seconds, seconds > 0.0f ? megabytes / seconds : 0.0f);
+
+	if ( errorCount > 0 )
+	{
+		LOG(Error, "%u errors found in %s\n", errorCount, filename);
+		return -1;
+	}
+
+	LOG(Info, "%s is valid\n", filename);
+	return 0;
+}
@@ -20,6 +20,14 @@ struct AudioDevice
 	u32 writeAheadMillis;
 	u32 safetyMillis;
 
+	// Linux adapts its write-ahead to the wake-up jitter of the audio thread, between
+	// this lower bound and writeAheadMillis
+	u32 minWriteAheadMillis;
+
+	// Options from the command line
+	const char *deviceName; // --audio-device=<name>, the default device otherwise
+	bool realtime;          // --audio-realtime, requests real-time scheduling for the audio thread
+
 	u32 safetyBytes;
 	u32 runningSampleIndex;
 	u32 bufferSize;
@@ -73,6 +81,7 @@ struct PlatformEventMouseWheel
 struct PlatformEvent
 {
 	PlatformEventType type;
+	u64 ticks; // GetTicks when the event was sent
 	union
 	{
 		PlatformEventWindowResize windowResize;
@@ -83,18 +92,12 @@ struct PlatformEvent
 	};
 };
 
-#define MAX_SCRATCH_ARENAS 8
-
 struct Platform
 {
-	u32 globalMemorySize = MB(64);
-	u32 frameMemorySize = MB(16);
-	u32 stringMemorySize = KB(16);
-	u32 dataMemorySize = MB(16);
-
 	void (*SetupAPICallback)(Plat &);
 	bool (*PreInitCallback)(Plat &);
 	bool (*InitCallback)(Plat &);
+	void (*WaitFrameCallback)(Plat &);
 	void (*UpdateCallback)(Plat &);
 	void (*RenderGraphicsCallback)(Plat &);
 	void (*PreRenderAudioCallback)(Plat &);
@@ -113,8 +116,7 @@ struct Platform
 	Arena stringArena;
 	Arena dataArena;
 
-	Arena scratchArenas[MAX_SCRATCH_ARENAS];
-	volatile_u32 scratchArenaLockMask;
+	ScratchStacks scratchStacks;
 
 	DynamicLibrary engineLib;
 
@@ -124,18 +126,19 @@ struct Platform
 	StringInterning stringInterning;
 	Window window;
 	Gamepad gamepad;
+	FramePacer framePacer;
+	FileChanges fileChanges;
 	AudioDevice audio;
 	f32 deltaSeconds;
 	f32 totalSeconds;
 
-	volatile_i64 eventTail;
-	volatile_i64 eventHead;
-	PlatformEvent events[128];
+	MpscQueue eventQueue;
 
 	bool paused;
 	bool keepRunning;
 	bool windowInitialized;
 	volatile_u32 inSizeMove; // Main thread is inside a modal size/move loop
+	Event sizeMoveEndEvent; // Signaled when the main thread leaves the size/move loop
 
 	Semaphore updateThreadFinishSemaphore;
 	Mutex renderLock;
@@ -160,11 +163,44 @@ enum ThreadID
 {
 	THREAD_ID_UPDATE,
 	THREAD_ID_AUDIO,
+	THREAD_ID_FILE_WATCH,
 	THREAD_ID_WORKER_0,
 	THREAD_ID_WORKER_LAST = THREAD_ID_WORKER_0 + WORK_QUEUE_WORKER_COUNT - 1,
 };
 
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Scratch arenas
+
+static thread_local ScratchStack *tScratchStack = nullptr;
+
+// Claims the scratch stack of the calling thread. Threads that do not register get one
+// on their first scratch.
+static ScratchStack &RegisterScratchThread(const char *name)
+{
+	if ( !tScratchStack )
+	{
+		const u32 index = AtomicFetchAdd(&platform.scratchStacks.count, 1);
+		ASSERTMSG(index < MAX_SCRATCH_THREADS, "More than %u threads use scratch arenas.\n", MAX_SCRATCH_THREADS);
+		tScratchStack = &platform.scratchStacks.stacks[index];
+	}
+	tScratchStack->name = name;
+	return *tScratchStack;
+}
+
+static u32 AcquireScratchArena(Arena &outArena, u32 minSize)
+{
+	ScratchStack &stack = tScratchStack ? *tScratchStack : RegisterScratchThread("Thread");
+	const u32 index = PushScratchArena(stack, outArena, minSize);
+	return index;
+}
+
+static void ReleaseScratchArena(u32 index, const Arena &arena)
+{
+	PopScratchArena(*tScratchStack, index, arena);
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // Per-platform interface
 //
@@ -329,16 +365,30 @@ static void InitializeDirectoriesFromWorkingDir(Platform &platform, char *workin
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // Generic platform events
 
-static void SendPlatformEvent(Platform &platform, PlatformEvent event)
+// The queue grows by pages up to this size, some 130k events
+#define EVENT_QUEUE_MAX_SIZE MB(4)
+
+static bool InitializePlatformEvents(Platform &platform)
 {
-	if (platform.eventHead - platform.eventTail < ARRAY_COUNT(platform.events))
+	if ( !CreateMpscQueue(platform.eventQueue, sizeof(PlatformEvent), EVENT_QUEUE_MAX_SIZE) )
 	{
-		const i32 eventIndex = platform.eventHead % ARRAY_COUNT(platform.events);
-		platform.events[eventIndex] = event;
-
-		AtomicIncrement(&platform.eventHead);
+		LOG(Error, "Could not create the platform event queue\n");
+		return false;
 	}
-	else
+	return true;
+}
+
+static void CleanupPlatformEvents(Platform &platform)
+{
+	DestroyMpscQueue(platform.eventQueue);
+}
+
+// Can be called from any thread
+static void SendPlatformEvent(Platform &platform, PlatformEvent event)
+{
+	event.ticks = GetTicks();
+
+	if ( !MpscQueuePush(platform.eventQueue, &event) )
 	{
 		LOG(Warning, "Event %d was lost\n", event.type);
 	}
@@ -473,6 +523,21 @@ static bool InitializeAudio(Platform &platform)
 	// likely but delays how soon a newly triggered sound is heard.
 	audio.writeAheadMillis = 33;
 	audio.safetyMillis = 11;
+	audio.minWriteAheadMillis = 4;
+
+	// Headless machines can play into the ALSA null or file plugins, for instance
+	// --audio-device=null or --audio-device=file:FILE=audio.raw,FORMAT=raw
+	audio.deviceName = "default";
+	for (i32 i = 1; i < platform.pub.argc; ++i)
+	{
+		const char *arg = platform.pub.argv[i];
+		if ( const char *deviceName = StrConsume(arg, "--audio-device=") ) {
+			audio.deviceName = deviceName;
+		}
+		if ( StrEq(arg, "--audio-realtime") ) {
+			audio.realtime = true;
+		}
+	}
 
 	const u32 bytesPerSecond = audio.samplesPerSecond * audio.channelCount * audio.bytesPerSample;
 	audio.safetyBytes = (bytesPerSecond * audio.safetyMillis) / 1000;
@@ -490,6 +555,17 @@ static THREAD_FUNCTION(AudioThread) // void *WorkQueueThread(void* arguments)
 {
 	const ThreadInfo *threadInfo = (const ThreadInfo *)arguments;
 
+	RegisterScratchThread("Audio");
+
+	if ( platform.audio.realtime )
+	{
+		if ( SetThreadRealtimePriority() ) {
+			LOG(Info, "- Audio thread running with real-time priority\n");
+		} else {
+			LOG(Warning, "- Could not set a real-time priority for the audio thread\n");
+		}
+	}
+
 	while ( platform.keepRunning )
 	{
 		if ( platform.audio.isPlaying )
@@ -587,6 +663,15 @@ static void WorkQueuePush(WorkQueueEntry entry)
 	SignalSemaphore(workQueue.workSemaphore);
 }
 
+static void PushWork(WorkQueueCallback *callback, void *data)
+{
+	const WorkQueueEntry entry = {
+		.callback = callback,
+		.data = data,
+	};
+	WorkQueuePush(entry);
+}
+
 static bool WorkQueueEmpty()
 {
 	const bool empty = workQueue.head == workQueue.tail;
@@ -621,6 +706,8 @@ static THREAD_FUNCTION(WorkQueueThread) // void *WorkQueueThread(void* arguments
 	const ThreadInfo *threadInfo = (const ThreadInfo *)arguments;
 	const u32 workerIndex = threadInfo->globalIndex - THREAD_ID_WORKER_0;
 
+	RegisterScratchThread("Worker");
+
 	while ( platform.keepRunning )
 	{
 		if ( platform.paused )
@@ -741,20 +828,313 @@ static bool InitializeWorkQueue(Platform &platform)
 
 
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// File watch service
+
+// A background thread turns the kernel file notifications into a list of changed files per
+// frame. Editors and compilers write a file several times when saving it, so the thread waits
+// until a file has been quiet for a while and reports it once.
+
+#define FILE_WATCH_DEBOUNCE_MILLIS 50
+#define FILE_WATCH_TIMEOUT_MILLIS 100 // Wait for events without pending files, bounds the time to quit
+#define MAX_FILE_WATCH_PENDING 256
+
+struct FileWatchPending
+{
+	const char *path; // Interned
+	Clock lastEventClock;
+};
+
+struct FileWatchService
+{
+	bool enabled;
+	FileWatch watch;
+
+	// Files with recent events, only accessed by the watch thread
+	FileWatchPending pending[MAX_FILE_WATCH_PENDING];
+	u32 pendingCount;
+
+	// Files ready to be reported to the update thread
+	Mutex lock;
+	const char *settledPaths[MAX_FILE_CHANGES];
+	u32 settledCount;
+	bool settledOverflow;
+
+	Semaphore finishSemaphore;
+};
+
+static FileWatchService fileWatch;
+
+static THREAD_FUNCTION(FileWatchThread)
+{
+	FilePath paths[32];
+
+	while ( platform.keepRunning )
+	{
+		const u32 timeoutMillis = fileWatch.pendingCount > 0 ? FILE_WATCH_DEBOUNCE_MILLIS : FILE_WATCH_TIMEOUT_MILLIS;
+		bool overflow = false;
+		const u32 pathCount = ReadFileWatchEvents(fileWatch.watch, timeoutMillis, paths, ARRAY_COUNT(paths), overflow);
+		const Clock now = GetClock();
+
+		// Coalesce events of the same file
+		for (u32 i = 0; i < pathCount; ++i)
+		{
+			const char *path = MakeStringIntern(&platform.stringInterning, paths[i].str);
+			u32 index = 0;
+			while ( index < fileWatch.pendingCount && fileWatch.pending[index].path != path )
+			{
+				index++;
+			}
+			if ( index == MAX_FILE_WATCH_PENDING )
+			{
+				overflow = true;
+				continue;
+			}
+			if ( index == fileWatch.pendingCount )
+			{
+				fileWatch.pending[fileWatch.pendingCount++].path = path;
+			}
+			fileWatch.pending[index].lastEventClock = now;
+		}
+
+		// Report the files that were quiet for the debounce time
+		MutexScope lockScope(fileWatch.lock);
+		fileWatch.settledOverflow = fileWatch.settledOverflow || overflow;
+		for (u32 i = 0; i < fileWatch.pendingCount; )
+		{
+			const FileWatchPending &pending = fileWatch.pending[i];
+			if ( GetSecondsElapsed(pending.lastEventClock, now) * 1000.0f >= FILE_WATCH_DEBOUNCE_MILLIS )
+			{
+				if ( fileWatch.settledCount < MAX_FILE_CHANGES )
+				{
+					fileWatch.settledPaths[fileWatch.settledCount++] = pending.path;
+				}
+				else
+				{
+					fileWatch.settledOverflow = true;
+				}
+				fileWatch.pending[i] = fileWatch.pending[--fileWatch.pendingCount];
+			}
+			else
+			{
+				i++;
+			}
+		}
+	}
+
+	SignalSemaphore(fileWatch.finishSemaphore);
+
+	return 0;
+}
+
+// Returns false if the platform cannot watch files, so the caller has to poll them. The
+// paths reported for this directory start with the dir string as given.
+static bool WatchDirectory(const char *dir)
+{
+	bool ok = false;
+	if ( fileWatch.enabled )
+	{
+		const char *dirCopy = MakeStringIntern(&platform.stringInterning, dir);
+		ok = AddFileWatchDirectory(fileWatch.watch, dirCopy);
+	}
+	return ok;
+}
+
+// Moves the changes reported by the watch thread to the frame change list
+static void TakeFileChanges(Platform &platform)
+{
+	FileChanges &changes = platform.fileChanges;
+	changes.count = 0;
+	changes.overflow = false;
+
+	if ( fileWatch.enabled )
+	{
+		MutexScope lockScope(fileWatch.lock);
+		MemCopy(changes.paths, fileWatch.settledPaths, fileWatch.settledCount * sizeof(changes.paths[0]));
+		changes.count = fileWatch.settledCount;
+		changes.overflow = fileWatch.settledOverflow;
+		fileWatch.settledCount = 0;
+		fileWatch.settledOverflow = false;
+	}
+}
+
+static bool InitializeFileWatch(Platform &platform)
+{
+	platform.pub.fileChanges = &platform.fileChanges;
+
+	if ( !CreateFileWatch(fileWatch.watch) )
+	{
+		LOG(Info, "File watch not available, polling files for hot reload\n");
+		return true;
+	}
+
+	if ( !CreateMutex(fileWatch.lock) || !CreateSemaphore(fileWatch.finishSemaphore, 0, 1) )
+	{
+		return false;
+	}
+
+	static const ThreadInfo threadInfo = {
+		.globalIndex = THREAD_ID_FILE_WATCH,
+	};
+	if ( !CreateDetachedThread(FileWatchThread, threadInfo) )
+	{
+		DestroyFileWatch(fileWatch.watch);
+		return true;
+	}
+
+	fileWatch.enabled = true;
+	platform.fileChanges.watching = true;
+
+	WatchDirectory(BinDir); // Engine library
+
+	return true;
+}
+
+static void CleanupFileWatch()
+{
+	if ( fileWatch.enabled )
+	{
+		WaitSemaphore(fileWatch.finishSemaphore);
+		DestroyFileWatch(fileWatch.watch);
+		fileWatch.enabled = false;
+	}
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Frame pacing
+
+#define FRAME_PACER_DEFAULT_LATENCY 2
+#define FRAME_PACER_PREDICTION_FRAMES 16 // Recent frames used to predict the next one
+#define FRAME_PACER_MARGIN_MILLIS 1.0f // Slack left between the predicted present and the deadline
+#define FRAME_PACER_SPIN_MILLIS 2.0f // Sleeps can overshoot, so the end of the pacing wait yields instead
+
+static void InitializeFramePacer(Platform &platform)
+{
+	FramePacer &pacer = platform.framePacer;
+	pacer.targetMillis = 0.0f;
+	pacer.frameLatency = FRAME_PACER_DEFAULT_LATENCY;
+	pacer.presentClock = GetClock();
+
+	platform.pub.framePacer = &pacer;
+}
+
+// The slowest of the recent frames, so a single fast frame does not make the next one
+// start too late to meet its deadline
+static f32 PredictFrameCpuMillis(const FramePacer &pacer)
+{
+	const u32 frameCount = pacer.frameCount < FRAME_PACER_PREDICTION_FRAMES ? (u32)pacer.frameCount : FRAME_PACER_PREDICTION_FRAMES;
+	f32 predictedMillis = 0.0f;
+	for (u32 i = 0; i < frameCount; ++i)
+	{
+		const FrameTiming &timing = pacer.frames[( pacer.frameCount - 1 - i ) % FRAME_PACER_HISTORY];
+		predictedMillis = Max(predictedMillis, timing.cpuMillis);
+	}
+	return predictedMillis;
+}
+
+// Called right before sampling input. It first blocks until the GPU is within the frame
+// latency and a swapchain image is free. Then, with a target interval, it sleeps until the
+// latest time the frame can start and still be presented by the deadline.
+static void FramePacerWait(Platform &platform)
+{
+	FramePacer &pacer = platform.framePacer;
+	const Clock waitBeginClock = GetClock();
+
+	platform.WaitFrameCallback(platform.pub);
+
+	const f32 targetMillis = pacer.targetMillis;
+	if ( targetMillis > 0.0f && pacer.frameCount > 0 )
+	{
+		const f32 startMillis = targetMillis - PredictFrameCpuMillis(pacer) - FRAME_PACER_MARGIN_MILLIS;
+		for (;;)
+		{
+			const f32 remainingMillis = startMillis - GetSecondsElapsed(pacer.presentClock, GetClock()) * 1000.0f;
+			if ( remainingMillis <= 0.0f )
+			{
+				break;
+			}
+			else if ( remainingMillis > FRAME_PACER_SPIN_MILLIS + 1.0f )
+			{
+				SleepMillis( (u32)(remainingMillis - FRAME_PACER_SPIN_MILLIS) );
+			}
+			else
+			{
+				YieldTimeSlice();
+			}
+		}
+	}
+
+	pacer.frameBeginClock = GetClock();
+	pacer.waitMillis = GetSecondsElapsed(waitBeginClock, pacer.frameBeginClock) * 1000.0f;
+}
+
+// Called right after the frame was presented
+static void FramePacerEndFrame(Platform &platform)
+{
+	FramePacer &pacer = platform.framePacer;
+	const Clock presentClock = GetClock();
+
+	FrameTiming &timing = pacer.frames[pacer.frameCount % FRAME_PACER_HISTORY];
+	timing.cpuMillis = GetSecondsElapsed(pacer.frameBeginClock, presentClock) * 1000.0f;
+	timing.gpuMillis = pacer.gpuMillis;
+	timing.presentMillis = GetSecondsElapsed(pacer.presentClock, presentClock) * 1000.0f;
+	timing.waitMillis = pacer.waitMillis;
+
+	pacer.presentClock = presentClock;
+	pacer.frameCount++;
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // Update thread
 
-static void ProcessPlatformEvents(Platform &platform)
+// Returns the next event sent up to the given ticks, or NULL. Runs of mouse moves and wheel
+// turns are batched into the last event of the run, as only their sum matters.
+static const PlatformEvent *PeekPlatformEvent(Platform &platform, u64 untilTicks, PlatformEvent &batch)
+{
+	const PlatformEvent *event = (const PlatformEvent *)MpscQueuePeek(platform.eventQueue);
+	if ( !event || event->ticks > untilTicks )
+	{
+		return NULL;
+	}
+
+	if ( event->type != PlatformEventTypeMouseMove && event->type != PlatformEventTypeMouseWheel )
+	{
+		return event;
+	}
+
+	batch = *event;
+	MpscQueuePop(platform.eventQueue);
+
+	while ( (event = (const PlatformEvent *)MpscQueuePeek(platform.eventQueue)) &&
+			event->ticks <= untilTicks && event->type == batch.type )
+	{
+		if ( batch.type == PlatformEventTypeMouseMove ) {
+			batch.mouseMove.pos = event->mouseMove.pos;
+		} else {
+			batch.mouseWheel.delta += event->mouseWheel.delta;
+		}
+		batch.ticks = event->ticks;
+		MpscQueuePop(platform.eventQueue);
+	}
+
+	return &batch;
+}
+
+// Events sent after untilTicks stay queued for the next frame
+static void ProcessPlatformEvents(Platform &platform, u64 untilTicks)
 {
 	Window &window = platform.window;
 
 	TransitionInputStatesSinceLastFrame(window);
 
-	while (platform.eventTail < platform.eventHead)
+	PlatformEvent batch;
+	const PlatformEvent *eventPtr;
+	while ( (eventPtr = PeekPlatformEvent(platform, untilTicks, batch)) )
 	{
-		const i64 uncappedIndex = AtomicPreIncrement(&platform.eventTail);
-		const i32 eventIndex = uncappedIndex % ARRAY_COUNT(platform.events);
-		const PlatformEvent &event = platform.events[eventIndex];
+		const PlatformEvent &event = *eventPtr;
 
 		switch (event.type)
 		{
@@ -810,6 +1190,11 @@ static void ProcessPlatformEvents(Platform &platform)
 				break;
 			};
 		}
+
+		if ( eventPtr != &batch )
+		{
+			MpscQueuePop(platform.eventQueue);
+		}
 	}
 
 	UpdateKeyModifiers(window);
@@ -829,15 +1214,24 @@ static void UpdateAndRender(Platform &platform)
 
 	ResetArena(platform.frameArena);
 
-	ProcessPlatformEvents(platform);
+	if ( platform.windowInitialized )
+	{
+		FramePacerWait(platform);
+	}
+
+	ProcessPlatformEvents(platform, GetTicks());
 
 	UpdateGamepad(platform);
 
+	TakeFileChanges(platform);
+
 	if ( platform.windowInitialized )
 	{
 		platform.UpdateCallback(platform.pub);
 		platform.RenderGraphicsCallback(platform.pub);
 
+		FramePacerEndFrame(platform);
+
 		platform.window.flags = 0;
 	}
 
@@ -850,6 +1244,8 @@ static THREAD_FUNCTION(UpdateThread) // void *WorkQueueThread(void* arguments)
 {
 	const ThreadInfo *threadInfo = (const ThreadInfo *)arguments;
 
+	RegisterScratchThread("Update");
+
 	Clock lastClock = GetClock();
 
 	while ( platform.keepRunning )
@@ -857,7 +1253,7 @@ static THREAD_FUNCTION(UpdateThread) // void *WorkQueueThread(void* arguments)
 		if ( platform.inSizeMove )
 		{
 			// The main thread drives update and render during modal size/move loops
-			Yield();
+			WaitEvent(platform.sizeMoveEndEvent);
 		}
 		else
 		{
@@ -879,6 +1275,8 @@ static bool InitializeUpdateThread(Platform &platform)
 		return false;
 	}
 
+	CreateEvent( platform.sizeMoveEndEvent );
+
 	static const ThreadInfo threadInfo = {
 		.globalIndex = THREAD_ID_UPDATE,
 	};
@@ -897,31 +1295,29 @@ static bool InitializeUpdateThread(Platform &platform)
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // Platform
 
+// Address space reserved for each arena. Pages are only committed as they are pushed, and
+// the frame arena gives back what it used past its usual budget when it is reset.
+#define GLOBAL_ARENA_RESERVE ( 16ull * GB(1) )
+#define FRAME_ARENA_RESERVE ( 4ull * GB(1) )
+#define FRAME_ARENA_RETAIN MB(16)
+#define STRING_ARENA_RESERVE GB(1)
+#define DATA_ARENA_RESERVE ( 16ull * GB(1) )
+
 static bool InitializeArenas(Platform &platform)
 {
-	platform.stringMemorySize = KB(16);
-	platform.dataMemorySize = MB(64);
-	platform.globalMemorySize = MB(64);
-	platform.frameMemorySize = MB(16);
-
-	byte *globalMemory = (byte*)AllocateVirtualMemory(platform.globalMemorySize);
-	platform.globalArena = MakeArena(globalMemory, platform.globalMemorySize, "Global arena");
-
-	byte *frameMemory = (byte*)AllocateVirtualMemory(platform.frameMemorySize);
-	platform.frameArena = MakeArena(frameMemory, platform.frameMemorySize, "Frame arena");
-
-	byte *stringMemory = (byte*)AllocateVirtualMemory(platform.stringMemorySize);
-	platform.stringArena = MakeArena(stringMemory, platform.stringMemorySize, "String arena");
-	platform.stringInterning = StringInterningCreate(&platform.stringArena);
-
-	byte *dataMemory = (byte*)AllocateVirtualMemory(platform.dataMemorySize);
-	platform.dataArena = MakeArena(dataMemory, platform.dataMemorySize, "Data arena");
+	platform.globalArena = MakeGrowableArena(GLOBAL_ARENA_RESERVE, GLOBAL_ARENA_RESERVE, "Global arena");
+	platform.frameArena = MakeGrowableArena(FRAME_ARENA_RESERVE, FRAME_ARENA_RETAIN, "Frame arena");
+	platform.stringArena = MakeGrowableArena(STRING_ARENA_RESERVE, STRING_ARENA_RESERVE, "String arena");
+	// Thread-safe so workers can intern and look up names while the main thread does too
+	platform.stringInterning = StringInterningCreate(&platform.stringArena, true);
+	platform.dataArena = MakeGrowableArena(DATA_ARENA_RESERVE, DATA_ARENA_RESERVE, "Data arena");
 
 	platform.pub.stringInterning = &platform.stringInterning;
 	platform.pub.globalArena = &platform.globalArena;
 	platform.pub.stringArena = &platform.stringArena;
 	platform.pub.frameArena = &platform.frameArena;
 	platform.pub.dataArena = &platform.dataArena;
+	platform.pub.scratchStacks = &platform.scratchStacks;
 
 	return true;
 }
@@ -932,53 +1328,6 @@ static void PlatformQuit()
 	PlatformWakeMainThread();
 }
 
-static void ReleaseScratchArena(u32 index)
-{
-	u32 oldValue, newValue;
-	do
-	{
-		oldValue = platform.scratchArenaLockMask;
-		newValue = oldValue & ~(1<<index);
-	}
-	while (!AtomicSwap(&platform.scratchArenaLockMask, oldValue, newValue));
-}
-
-static u32 AcquireScratchArena(Arena &outArena, u32 minSize)
-{
-	u32 rejectedMask = 0; // Slots already found too small in this call; skip them on retry.
-	for (u32 i = 0; i < MAX_SCRATCH_ARENAS; ++i)
-	{
-		const u32 oldValue = platform.scratchArenaLockMask;
-		const u32 index = FBZ(oldValue | rejectedMask);
-		ASSERT(index < MAX_SCRATCH_ARENAS);
-
-		const u32 newValue = oldValue | (1<<index);
-		if (AtomicSwap(&platform.scratchArenaLockMask, oldValue, newValue))
-		{
-			Arena &arena = platform.scratchArenas[index];
-
-			if (arena.base && arena.size < minSize)
-			{
-				// Too small; release it and keep looking rather than growing (and leaking) it.
-				ReleaseScratchArena(index);
-				rejectedMask |= (1<<index);
-				continue;
-			}
-
-			if (!arena.base)
-			{
-				arena.base = (byte*)AllocateVirtualMemory(minSize);
-				arena.size = minSize;
-			}
-			outArena = arena;
-			outArena.used = 0;
-			return index;
-		}
-	}
-	INVALID_CODE_PATH();
-	return U32_MAX;
-}
-
 static FilePath sEngineLibPath = {};
 static FilePath sEngineTmpLibPath = {};
 
@@ -1024,6 +1373,13 @@ static bool LoadEngineDLL(Platform &platform)
 	}
 	LOG(Info, "- Symbol loaded: OnPlatformInit\n");
 
+	platform.WaitFrameCallback = (void (*)(Plat &)) LoadSymbol(platform.engineLib, "OnPlatformWaitFrame");
+	if( !platform.WaitFrameCallback ) {
+		LOG(Error, "- Couldn't load symbol: OnPlatformWaitFrame\n");
+		return false;
+	}
+	LOG(Info, "- Symbol loaded: OnPlatformWaitFrame\n");
+
 	platform.UpdateCallback = (void (*)(Plat &)) LoadSymbol(platform.engineLib, "OnPlatformUpdate");
 	if( !platform.UpdateCallback ) {
 		LOG(Error, "- Couldn't load symbol: OnPlatformUpdate\n");
@@ -1091,6 +1447,8 @@ static bool LoadEngineDLL(Platform &platform)
 	platform.pub.api.PlatformQuit        = PlatformQuit;
 	platform.pub.api.AcquireScratchArena = AcquireScratchArena;
 	platform.pub.api.ReleaseScratchArena = ReleaseScratchArena;
+	platform.pub.api.PushWork            = PushWork;
+	platform.pub.api.WatchDirectory      = WatchDirectory;
 
 	platform.SetupAPICallback(platform.pub);
 
@@ -1111,9 +1469,10 @@ static void PauseThreads(Platform &platform)
 	platform.paused = true;
 
 #if USE_AUDIO_THREAD
+	SpinBackoff audioBackoff = {};
 	while ( !platform.audioPaused && platform.keepRunning )
 	{
-		Yield();
+		SpinBackoffWait(audioBackoff);
 	}
 #endif
 
@@ -1126,9 +1485,10 @@ static void PauseThreads(Platform &platform)
 	// And wait until all of them are paused
 	for (u32 i = 0; i < WORK_QUEUE_WORKER_COUNT; ++i)
 	{
+		SpinBackoff workerBackoff = {};
 		while ( !workQueue.workerPaused[i] && platform.keepRunning )
 		{
-			Yield();
+			SpinBackoffWait(workerBackoff);
 		}
 	}
 }
@@ -1149,14 +1509,31 @@ static void ResumeThreads(Platform &platform)
 
 static void CheckEngineHotReload(Platform &platform)
 {
-	static Clock lastClock = GetClock();
-	const Clock currentClock = GetClock();
-	const f32 secondsSinceLastCheck = GetSecondsElapsed(lastClock, currentClock);
+	bool check = false;
 
-	if ( secondsSinceLastCheck > 0.1f )
+	const FileChanges &changes = platform.fileChanges;
+	if ( changes.watching )
+	{
+		check = changes.overflow;
+		for (u32 i = 0; i < changes.count; ++i)
+		{
+			check = check || StrEq(changes.paths[i], sEngineLibPath.str);
+		}
+	}
+	else
 	{
-		lastClock = currentClock;
+		static Clock lastClock = GetClock();
+		const Clock currentClock = GetClock();
+		const f32 secondsSinceLastCheck = GetSecondsElapsed(lastClock, currentClock);
+		if ( secondsSinceLastCheck > 0.1f )
+		{
+			lastClock = currentClock;
+			check = true;
+		}
+	}
 
+	if ( check )
+	{
 		u64 timestampBase = 0;
 		u64 timestampCopy = 0;
 		const bool success1 = GetFileLastWriteTimestamp(sEngineLibPath.str, timestampBase);
@@ -1168,6 +1545,11 @@ static void CheckEngineHotReload(Platform &platform)
 		{
 			LOG(Info, "Engine DLL was updated. Reloading...\n");
 			PauseThreads(platform);
+
+			// Queued jobs point to engine code, so finish them before unloading it
+			const ThreadInfo threadInfo = { .globalIndex = THREAD_ID_UPDATE };
+			while ( WorkQueueProcess(threadInfo) ) { }
+
 			UnloadEngineDLL(platform);
 			const bool reloaded = LoadEngineDLL(platform);
 			ResumeThreads(platform);
@@ -1192,6 +1574,18 @@ static bool Run(Platform &platform)
 		return false;
 	}
 
+	if ( !InitializePlatformEvents(platform) )
+	{
+		return false;
+	}
+
+	InitializeFramePacer(platform);
+
+	if ( !InitializeFileWatch(platform) )
+	{
+		return false;
+	}
+
 	if ( !platform.PreInitCallback(platform.pub) )
 	{
 		return false;
@@ -1277,11 +1671,13 @@ static bool Run(Platform &platform)
 	}
 
 #if USE_UPDATE_THREAD
+	SignalEvent(platform.sizeMoveEndEvent); // In case we quit during a size/move loop
 	WaitSemaphore(platform.updateThreadFinishSemaphore);
 #endif
 #if USE_AUDIO_THREAD
 	WaitSemaphore(platform.audioThreadFinishSemaphore);
 #endif
+	CleanupFileWatch();
 
 	if ( platform.windowInitialized )
 	{
@@ -1291,6 +1687,8 @@ static bool Run(Platform &platform)
 	platform.CleanupCallback(platform.pub);
 	// TODO: Cleanup window and audio
 
+	CleanupPlatformEvents(platform);
+
 	return false;
 }
 
@@ -1303,6 +1701,8 @@ static void Main( int argc, char **argv )
 
 	InitializeArenas(platform);
 
+	RegisterScratchThread("Main");
+
 	InitializeDirectories(platform);
 
 	GetGraphicsAPI(&platform.pub.graphicsAPI);
@@ -227,9 +227,57 @@ struct Gamepad
 	float2 rightAxis;
 };
 
+#define FRAME_PACER_HISTORY 128
+
+struct FrameTiming
+{
+	f32 cpuMillis;     // From input sampling to present
+	f32 gpuMillis;     // Of the latest frame completed by the GPU
+	f32 presentMillis; // Since the previous present
+	f32 waitMillis;    // Blocked on the GPU, the swapchain and the pacing sleep before input sampling
+};
+
+struct FramePacer
+{
+	// Settings, the engine can change them at any time
+	f32 targetMillis; // Present interval to aim for, or 0 to present as soon as the swapchain allows
+	u32 frameLatency; // Frames the CPU can run ahead of the GPU, from 1 to MAX_FRAMES_IN_FLIGHT
+
+	// Set by the engine when it reads back the GPU timestamps of a frame
+	f32 gpuMillis;
+
+	// History, the frame count modulo FRAME_PACER_HISTORY is the next entry written
+	FrameTiming frames[FRAME_PACER_HISTORY];
+	u64 frameCount;
+
+	Clock frameBeginClock;
+	Clock presentClock;
+	f32 waitMillis;
+};
+
+#define MAX_FILE_CHANGES 64
+
+// Files written since the previous frame in the directories passed to WatchDirectory
+struct FileChanges
+{
+	bool watching; // False if the platform cannot watch files, so they have to be polled
+	bool overflow; // Some changes were dropped, so any file could have changed
+	u32 count;
+	const char *paths[MAX_FILE_CHANGES]; // Interned, each one starts with its directory as passed to WatchDirectory
+};
+
+#define MAX_SCRATCH_THREADS 16
+
+// Scratch arenas of the threads that used them, for memory stats
+struct ScratchStacks
+{
+	volatile_u32 count;
+	ScratchStack stacks[MAX_SCRATCH_THREADS];
+};
+
 struct SoundBuffer
 {
-	u16 samplesPerSecond;
+	u32 samplesPerSecond;
 	u16 sampleCount;
 	i16* samples;
 };
@@ -237,13 +285,17 @@ struct SoundBuffer
 
 typedef void (*PFN_PlatformQuit)();
 typedef u32  (*PFN_AcquireScratchArena)(Arena &outArena, u32 minSize);
-typedef void (*PFN_ReleaseScratchArena)(u32 index);
+typedef void (*PFN_ReleaseScratchArena)(u32 index, const Arena &arena);
+typedef void (*PFN_PushWork)(WorkQueueCallback *callback, void *data);
+typedef bool (*PFN_WatchDirectory)(const char *dir);
 
 struct PlatformAPI
 {
 	PFN_PlatformQuit        PlatformQuit;
 	PFN_AcquireScratchArena AcquireScratchArena;
 	PFN_ReleaseScratchArena ReleaseScratchArena;
+	PFN_PushWork            PushWork; // Only to be called from the update thread
+	PFN_WatchDirectory      WatchDirectory; // Only to be called from the update thread
 };
 
 struct Engine;
@@ -270,6 +322,9 @@ struct Plat
 
 	Window *window;
 	Gamepad *gamepad;
+	FramePacer *framePacer;
+	FileChanges *fileChanges;
+	const ScratchStacks *scratchStacks;
 
 	Engine *engine;
 };
@@ -300,6 +355,8 @@ extern const char *ProjectDir;
 extern PFN_PlatformQuit        PlatformQuit;
 extern PFN_AcquireScratchArena AcquireScratchArena;
 extern PFN_ReleaseScratchArena ReleaseScratchArena;
+extern PFN_PushWork            PushWork;
+extern PFN_WatchDirectory      WatchDirectory;
 
 inline void SetPlatformAPI(Plat &platform)
 {
@@ -313,6 +370,8 @@ inline void SetPlatformAPI(Plat &platform)
 	PlatformQuit        = platform.api.PlatformQuit;
 	AcquireScratchArena = platform.api.AcquireScratchArena;
 	ReleaseScratchArena = platform.api.ReleaseScratchArena;
+	PushWork            = platform.api.PushWork;
+	WatchDirectory      = platform.api.WatchDirectory;
 }
 
 struct Scratch
@@ -321,7 +380,7 @@ struct Scratch
 	u32 lockedBit;
 
 	Scratch(u32 size = MB(1)) { lockedBit = AcquireScratchArena(arena, size); }
-	~Scratch() { ReleaseScratchArena(lockedBit); }
+	~Scratch() { ReleaseScratchArena(lockedBit, arena); }
 };
 
 #endif //  PLATAFORM_API_INCLUDED
@@ -346,6 +405,8 @@ const char *ProjectDir = "";
 PFN_PlatformQuit        PlatformQuit        = nullptr;
 PFN_AcquireScratchArena AcquireScratchArena = nullptr;
 PFN_ReleaseScratchArena ReleaseScratchArena = nullptr;
+PFN_PushWork            PushWork            = nullptr;
+PFN_WatchDirectory      WatchDirectory      = nullptr;
 
 #endif // PLATFORM_API_IMPLEMENTATION_INCLUDED
 
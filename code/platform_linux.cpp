@@ -810,6 +810,7 @@ static void UpdateGamepad(Platform &platform)
 typedef const char * SND_STRERROR (int errnum);
 typedef int SND_PCM_OPEN(snd_pcm_t **pcmp, const char * name, snd_pcm_stream_t stream, int	mode );
 typedef int SND_PCM_HW_PARAMS_MALLOC(snd_pcm_hw_params_t **ptr);
+typedef void SND_PCM_HW_PARAMS_FREE(snd_pcm_hw_params_t *obj);
 typedef int SND_PCM_HW_PARAMS_ANY(snd_pcm_t *pcm, snd_pcm_hw_params_t *params);
 typedef int SND_PCM_HW_PARAMS_SET_ACCESS(snd_pcm_t *pcm, snd_pcm_hw_params_t *params, snd_pcm_access_t _access);
 typedef int SND_PCM_HW_PARAMS_SET_FORMAT(snd_pcm_t *pcm, snd_pcm_hw_params_t *params, snd_pcm_format_t val);
@@ -825,9 +826,13 @@ typedef int SND_PCM_HW_PARAMS_GET_ACCESS(const snd_pcm_hw_params_t *params, snd_
 typedef int SND_PCM_HW_PARAMS_GET_PERIOD_TIME(const snd_pcm_hw_params_t *params, unsigned int *val, int *dir);
 typedef int SND_PCM_HW_PARAMS_GET_PERIOD_SIZE(const snd_pcm_hw_params_t *params, snd_pcm_uframes_t *frames, int *dir);
 typedef int SND_PCM_HW_PARAMS_GET_BUFFER_SIZE(const snd_pcm_hw_params_t *params, snd_pcm_uframes_t *val);
-typedef int SND_PCM_WAIT(snd_pcm_t *pcm, int timeout);
 typedef int SND_PCM_AVAIL_DELAY(snd_pcm_t *pcm, snd_pcm_sframes_t *availp, snd_pcm_sframes_t *delayp);
+typedef snd_pcm_sframes_t SND_PCM_AVAIL_UPDATE(snd_pcm_t *pcm);
 typedef snd_pcm_sframes_t SND_PCM_WRITEI(snd_pcm_t *pcm, const void *buffer, snd_pcm_uframes_t size);
+typedef int SND_PCM_MMAP_BEGIN(snd_pcm_t *pcm, const snd_pcm_channel_area_t **areas, snd_pcm_uframes_t *offset, snd_pcm_uframes_t *frames);
+typedef snd_pcm_sframes_t SND_PCM_MMAP_COMMIT(snd_pcm_t *pcm, snd_pcm_uframes_t offset, snd_pcm_uframes_t frames);
+typedef snd_pcm_state_t SND_PCM_STATE(snd_pcm_t *pcm);
+typedef int SND_PCM_START(snd_pcm_t *pcm);
 typedef int SND_PCM_RECOVER(snd_pcm_t *pcm, int err, int silent);
 typedef int SND_PCM_PREPARE(snd_pcm_t *pcm);
 typedef int SND_PCM_CLOSE(snd_pcm_t *pcm);
@@ -836,6 +841,7 @@ typedef int SND_PCM_DRAIN(snd_pcm_t *pcm);
 static SND_STRERROR* FP_snd_strerror;
 static SND_PCM_OPEN* FP_snd_pcm_open;
 static SND_PCM_HW_PARAMS_MALLOC* FP_snd_pcm_hw_params_malloc;
+static SND_PCM_HW_PARAMS_FREE* FP_snd_pcm_hw_params_free;
 static SND_PCM_HW_PARAMS_ANY* FP_snd_pcm_hw_params_any;
 static SND_PCM_HW_PARAMS_SET_ACCESS* FP_snd_pcm_hw_params_set_access;
 static SND_PCM_HW_PARAMS_SET_FORMAT* FP_snd_pcm_hw_params_set_format;
@@ -851,14 +857,74 @@ static SND_PCM_HW_PARAMS_GET_ACCESS* FP_snd_pcm_hw_params_get_access;
 static SND_PCM_HW_PARAMS_GET_PERIOD_TIME* FP_snd_pcm_hw_params_get_period_time;
 static SND_PCM_HW_PARAMS_GET_PERIOD_SIZE* FP_snd_pcm_hw_params_get_period_size;
 static SND_PCM_HW_PARAMS_GET_BUFFER_SIZE* FP_snd_pcm_hw_params_get_buffer_size;
-static SND_PCM_WAIT* FP_snd_pcm_wait;
 static SND_PCM_AVAIL_DELAY* FP_snd_pcm_avail_delay;
+static SND_PCM_AVAIL_UPDATE* FP_snd_pcm_avail_update;
 static SND_PCM_WRITEI* FP_snd_pcm_writei;
+static SND_PCM_MMAP_BEGIN* FP_snd_pcm_mmap_begin;
+static SND_PCM_MMAP_COMMIT* FP_snd_pcm_mmap_commit;
+static SND_PCM_STATE* FP_snd_pcm_state;
+static SND_PCM_START* FP_snd_pcm_start;
 static SND_PCM_RECOVER* FP_snd_pcm_recover;
 static SND_PCM_PREPARE* FP_snd_pcm_prepare;
 static SND_PCM_CLOSE* FP_snd_pcm_close;
 static SND_PCM_DRAIN* FP_snd_pcm_drain;
 
+// The audio thread wakes up once per period, on an absolute deadline, and tops the device
+// queue up to the write-ahead. The queue has to last until the next update, which comes a
+// period later plus the wake-up delay and the render time of that update. The write-ahead
+// follows the decaying peak of those delays: it shrinks while the thread is scheduled on
+// time, and it grows on a busy machine or after an underrun.
+struct AlsaPacer
+{
+	bool mmap;      // Mixing straight into the device ring, otherwise through snd_pcm_writei
+	bool hostClock; // The device consumes frames without a clock (null and file plugins)
+	u32 clocklessUpdateCount;
+
+	u32 bufferFrames;
+	u32 minWriteAheadFrames;
+	u32 maxWriteAheadFrames;
+	u32 writeAheadFrames;
+
+	u64 periodNanos;
+	u64 deadlineNanos; // Of the current update
+	f32 peakDelayMillis;
+
+	// Host clock, for devices without one
+	u64 startNanos;
+	u64 writtenFrames;
+
+	// Stats of the last few seconds
+	u64 statsNanos;
+	u32 updateCount;
+	u32 underrunCount;
+	f32 maxLateMillis;
+	f32 maxLatencyMillis;
+	f64 latencyMillisSum;
+};
+
+static AlsaPacer audioPacer;
+
+#define ALSA_PEAK_DELAY_DECAY 0.999f // Per update, the peak halves in about 700 updates
+#define ALSA_SAFETY_MILLIS 1.0f
+#define ALSA_CLOCKLESS_UPDATE_COUNT 3 // Updates without any queued frame before using the host clock
+#define ALSA_STATS_SECONDS 5
+
+static u64 AlsaNanos()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	const u64 nanos = (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+	return nanos;
+}
+
+static void AlsaUpdateWriteAhead(AlsaPacer &pacer, u32 samplesPerSecond)
+{
+	const f32 periodMillis = pacer.periodNanos / 1000000.0f;
+	const f32 writeAheadMillis = periodMillis + 2.0f * pacer.peakDelayMillis + ALSA_SAFETY_MILLIS;
+	const u32 writeAheadFrames = (u32)( writeAheadMillis * samplesPerSecond / 1000.0f );
+	pacer.writeAheadFrames = Clamp(writeAheadFrames, pacer.minWriteAheadFrames, pacer.maxWriteAheadFrames);
+}
+
 static bool InitializeAudioDevice(Platform &platform)
 {
 	AudioDevice &audio = platform.audio;
@@ -873,6 +939,7 @@ static bool InitializeAudioDevice(Platform &platform)
 		FP_snd_strerror = (SND_STRERROR*) LoadSymbol(alsa, "snd_strerror");
 		FP_snd_pcm_open = (SND_PCM_OPEN*) LoadSymbol(alsa, "snd_pcm_open");
 		FP_snd_pcm_hw_params_malloc = (SND_PCM_HW_PARAMS_MALLOC*) LoadSymbol(alsa, "snd_pcm_hw_params_malloc");
+		FP_snd_pcm_hw_params_free = (SND_PCM_HW_PARAMS_FREE*) LoadSymbol(alsa, "snd_pcm_hw_params_free");
 		FP_snd_pcm_hw_params_any = (SND_PCM_HW_PARAMS_ANY*) LoadSymbol(alsa, "snd_pcm_hw_params_any");
 		FP_snd_pcm_hw_params_set_access = (SND_PCM_HW_PARAMS_SET_ACCESS*) LoadSymbol(alsa, "snd_pcm_hw_params_set_access");
 		FP_snd_pcm_hw_params_set_format = (SND_PCM_HW_PARAMS_SET_FORMAT*) LoadSymbol(alsa, "snd_pcm_hw_params_set_format");
@@ -888,28 +955,29 @@ static bool InitializeAudioDevice(Platform &platform)
 		FP_snd_pcm_hw_params_get_period_time = (SND_PCM_HW_PARAMS_GET_PERIOD_TIME*) LoadSymbol(alsa, "snd_pcm_hw_params_get_period_time");
 		FP_snd_pcm_hw_params_get_period_size = (SND_PCM_HW_PARAMS_GET_PERIOD_SIZE*) LoadSymbol(alsa, "snd_pcm_hw_params_get_period_size");
 		FP_snd_pcm_hw_params_get_buffer_size = (SND_PCM_HW_PARAMS_GET_BUFFER_SIZE*) LoadSymbol(alsa, "snd_pcm_hw_params_get_buffer_size");
-		FP_snd_pcm_wait = (SND_PCM_WAIT*) LoadSymbol(alsa, "snd_pcm_wait");
 		FP_snd_pcm_avail_delay = (SND_PCM_AVAIL_DELAY*) LoadSymbol(alsa, "snd_pcm_avail_delay");
+		FP_snd_pcm_avail_update = (SND_PCM_AVAIL_UPDATE*) LoadSymbol(alsa, "snd_pcm_avail_update");
 		FP_snd_pcm_writei = (SND_PCM_WRITEI*) LoadSymbol(alsa, "snd_pcm_writei");
+		FP_snd_pcm_mmap_begin = (SND_PCM_MMAP_BEGIN*) LoadSymbol(alsa, "snd_pcm_mmap_begin");
+		FP_snd_pcm_mmap_commit = (SND_PCM_MMAP_COMMIT*) LoadSymbol(alsa, "snd_pcm_mmap_commit");
+		FP_snd_pcm_state = (SND_PCM_STATE*) LoadSymbol(alsa, "snd_pcm_state");
+		FP_snd_pcm_start = (SND_PCM_START*) LoadSymbol(alsa, "snd_pcm_start");
 		FP_snd_pcm_recover = (SND_PCM_RECOVER*) LoadSymbol(alsa, "snd_pcm_recover");
 		FP_snd_pcm_prepare = (SND_PCM_PREPARE*) LoadSymbol(alsa, "snd_pcm_prepare");
 		FP_snd_pcm_close = (SND_PCM_CLOSE*) LoadSymbol(alsa, "snd_pcm_close");
 		FP_snd_pcm_drain = (SND_PCM_DRAIN*) LoadSymbol(alsa, "snd_pcm_drain");
 
 		// Open PCM device
-		int res = FP_snd_pcm_open(&audioPcm, "default", SND_PCM_STREAM_PLAYBACK, SND_PCM_NONBLOCK);
+		int res = FP_snd_pcm_open(&audioPcm, audio.deviceName, SND_PCM_STREAM_PLAYBACK, SND_PCM_NONBLOCK);
 		if (res == 0)
 		{
 			int dir = 0; // direction of approximate values
 			unsigned int sampleRate = audio.samplesPerSecond; // frames/second (CD quality)
 			unsigned int channelCount = audio.channelCount;
 			unsigned int bytesPerSample = audio.bytesPerSample;
-			// snd_pcm_wait only blocks once the ring buffer is nearly full: it returns as soon
-			// as one period of space is free. So the buffer has to be sized to what we actually
-			// intend to keep queued, otherwise there is always free space and the wait spins
-			// instead of pacing us. The period sets the wake-up granularity, a few wake-ups
-			// per write-ahead window.
-			const u32 periodMillis = Max(1u, audio.writeAheadMillis / 3);
+			// The thread paces itself on the host clock, so the period only sets how often
+			// the device reports its position. The buffer leaves room to grow the write-ahead.
+			const u32 periodMillis = Max(1u, audio.minWriteAheadMillis / 2);
 			snd_pcm_uframes_t periodFrames = audio.samplesPerSecond * periodMillis / 1000;
 			snd_pcm_uframes_t bufferFrames = audio.samplesPerSecond * 2 * audio.writeAheadMillis / 1000;
 
@@ -920,7 +988,15 @@ static bool InitializeAudioDevice(Platform &platform)
 			FP_snd_pcm_hw_params_set_channels(audioPcm, params, channelCount);
 			FP_snd_pcm_hw_params_set_rate_near(audioPcm, params, &sampleRate, &dir);
 			FP_snd_pcm_hw_params_set_format(audioPcm, params, SND_PCM_FORMAT_S16_LE); // 16 bit little endian
-			FP_snd_pcm_hw_params_set_access(audioPcm, params, SND_PCM_ACCESS_RW_INTERLEAVED);
+
+			// Mix straight into the device ring where possible, saving a copy and the
+			// latency of the intermediate buffer
+			AlsaPacer &pacer = audioPacer;
+			pacer.mmap = FP_snd_pcm_hw_params_set_access(audioPcm, params, SND_PCM_ACCESS_MMAP_INTERLEAVED) == 0;
+			if ( !pacer.mmap ) {
+				FP_snd_pcm_hw_params_set_access(audioPcm, params, SND_PCM_ACCESS_RW_INTERLEAVED);
+			}
+
 			FP_snd_pcm_hw_params_set_period_size_near(audioPcm, params, &periodFrames, &dir);
 			FP_snd_pcm_hw_params_set_buffer_size_near(audioPcm, params, &bufferFrames);
 
@@ -933,9 +1009,27 @@ static bool InitializeAudioDevice(Platform &platform)
 				snd_pcm_uframes_t actualBufferFrames = 0;
 				FP_snd_pcm_hw_params_get_period_size(params, &actualPeriodFrames, &dir);
 				FP_snd_pcm_hw_params_get_buffer_size(params, &actualBufferFrames);
+				LOG(Info, "- PCM device: %s (%s)\n", audio.deviceName, pacer.mmap ? "mmap" : "read/write");
 				LOG(Info, "- PCM period: %lu frames / buffer: %lu frames\n",
 					(unsigned long)actualPeriodFrames, (unsigned long)actualBufferFrames);
 
+				// The engine resamples its mix if the device did not accept the requested rate
+				audio.samplesPerSecond = sampleRate;
+				LOG(Info, "- PCM rate: %u Hz\n", sampleRate);
+
+				// Devices that report their position once per period need a whole period
+				// queued on top of the one the thread sleeps. The write-ahead starts at its
+				// maximum and comes down as the wake-ups prove to be on time.
+				const u32 minFrames = sampleRate * audio.minWriteAheadMillis / 1000;
+				const u32 sleepFrames = Clamp((u32)actualPeriodFrames, sampleRate / 1000, minFrames / 2);
+				pacer.bufferFrames = actualBufferFrames;
+				pacer.periodNanos = 1000000000ull * sleepFrames / sampleRate;
+				pacer.minWriteAheadFrames = Max(minFrames, (u32)actualPeriodFrames + sleepFrames);
+				pacer.maxWriteAheadFrames = Min(sampleRate * audio.writeAheadMillis / 1000, (u32)actualBufferFrames - sleepFrames);
+				pacer.maxWriteAheadFrames = Max(pacer.maxWriteAheadFrames, pacer.minWriteAheadFrames);
+				pacer.peakDelayMillis = audio.writeAheadMillis * 0.5f;
+				AlsaUpdateWriteAhead(pacer, sampleRate);
+
 				LOG(Info, "- PCM is playing...\n");
 				audio.initialized = true;
 				audio.isPlaying = true;
@@ -946,12 +1040,11 @@ static bool InitializeAudioDevice(Platform &platform)
 				LOG(Error, "- Error setting PCM HW parameters: %s\n", FP_snd_strerror(res));
 			}
 
-			unsigned int finalSampleRate = 0;
-			FP_snd_pcm_hw_params_get_rate(params, &finalSampleRate, &dir);
+			FP_snd_pcm_hw_params_free(params);
 		}
 		else
 		{
-			LOG(Error, "- Error opening PCM device: %s\n", FP_snd_strerror(res));
+			LOG(Error, "- Error opening PCM device %s: %s\n", audio.deviceName, FP_snd_strerror(res));
 		}
 	}
 	else
@@ -962,71 +1055,216 @@ static bool InitializeAudioDevice(Platform &platform)
 	return audio.initialized;
 }
 
-// Blocks until the device has at least one period of free space (or timeout)
+// Sleeps until the deadline of the next update, one period after the last one
 static void WaitForAudioDevice(Platform &platform)
 {
-	const int timeoutMillis = 100;
-	const int res = FP_snd_pcm_wait(audioPcm, timeoutMillis);
+	AlsaPacer &pacer = audioPacer;
+
+	const u64 now = AlsaNanos();
+	pacer.deadlineNanos += pacer.periodNanos;
+
+	// After a stall (or on the first update) restart the schedule instead of catching up
+	if ( pacer.deadlineNanos + pacer.periodNanos < now ) {
+		pacer.deadlineNanos = now + pacer.periodNanos;
+	}
+
+	const timespec deadline = {
+		.tv_sec = (time_t)( pacer.deadlineNanos / 1000000000ull ),
+		.tv_nsec = (long)( pacer.deadlineNanos % 1000000000ull ),
+	};
+	while ( clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR );
+}
+
+// Devices without a clock (the null and file plugins) consume the frames as soon as they
+// are committed, so they never have any queued. The queue is estimated from the host
+// clock instead, so they are still fed in real time.
+static void AlsaHostClockQueue(AlsaPacer &pacer, u32 samplesPerSecond, snd_pcm_sframes_t &availableFrames, snd_pcm_sframes_t &delayFrames)
+{
+	if ( !pacer.hostClock )
+	{
+		const bool clockless = pacer.writtenFrames > 0 && delayFrames == 0 && availableFrames >= (snd_pcm_sframes_t)pacer.bufferFrames;
+		pacer.clocklessUpdateCount = clockless ? pacer.clocklessUpdateCount + 1 : 0;
+		if ( pacer.clocklessUpdateCount == ALSA_CLOCKLESS_UPDATE_COUNT )
+		{
+			LOG(Info, "- PCM device has no clock, pacing it with the host clock\n");
+			pacer.hostClock = true;
+			pacer.startNanos = AlsaNanos();
+			pacer.writtenFrames = 0;
+		}
+	}
+
+	if ( pacer.hostClock )
+	{
+		const u64 now = AlsaNanos();
+		u64 playedFrames = ( now - pacer.startNanos ) * samplesPerSecond / 1000000000ull;
+		if ( playedFrames > pacer.writtenFrames )
+		{
+			// Underrun: the frames that were not there are not played later
+			pacer.underrunCount++;
+			pacer.startNanos = now - pacer.writtenFrames * 1000000000ull / samplesPerSecond;
+			playedFrames = pacer.writtenFrames;
+		}
+		const u32 queuedFrames = (u32)( pacer.writtenFrames - playedFrames );
+		delayFrames = queuedFrames;
+		availableFrames = pacer.bufferFrames - Min(queuedFrames, pacer.bufferFrames);
+	}
+}
+
+// Renders straight into the device ring, in two areas when the frames wrap around it
+static snd_pcm_sframes_t AlsaWriteMmap(Platform &platform, snd_pcm_uframes_t frameCount)
+{
+	AudioDevice &audio = platform.audio;
+
+	snd_pcm_sframes_t res = FP_snd_pcm_avail_update(audioPcm);
+	snd_pcm_uframes_t remainingFrames = frameCount;
+
+	while ( res >= 0 && remainingFrames > 0 )
+	{
+		const snd_pcm_channel_area_t *areas = nullptr;
+		snd_pcm_uframes_t offset = 0;
+		snd_pcm_uframes_t frames = remainingFrames;
+		res = FP_snd_pcm_mmap_begin(audioPcm, &areas, &offset, &frames);
+		if ( res < 0 ) {
+			break;
+		}
+
+		// Interleaved frames, all the channels are in the area of the first one
+		ASSERT( areas[0].step == audio.channelCount * audio.bytesPerSample * 8 );
+		byte *areaBytes = (byte*)areas[0].addr + ( areas[0].first + offset * areas[0].step ) / 8;
+
+		SoundBuffer soundBuffer = {};
+		soundBuffer.samplesPerSecond = audio.samplesPerSecond;
+		soundBuffer.sampleCount = frames;
+		soundBuffer.samples = (i16*)areaBytes;
+		platform.RenderAudioCallback(platform.pub, soundBuffer);
+
+		res = FP_snd_pcm_mmap_commit(audioPcm, offset, frames);
+		if ( res >= 0 && (snd_pcm_uframes_t)res != frames ) {
+			res = -EPIPE;
+		}
+		remainingFrames -= frames;
+	}
+
+	// The stream starts on the first commit, unless it was stopped by an underrun
+	if ( res >= 0 && FP_snd_pcm_state(audioPcm) == SND_PCM_STATE_PREPARED ) {
+		res = FP_snd_pcm_start(audioPcm);
+	}
+
+	return res < 0 ? res : (snd_pcm_sframes_t)frameCount;
+}
+
+static snd_pcm_sframes_t AlsaWriteInterleaved(Platform &platform, snd_pcm_uframes_t frameCount)
+{
+	AudioDevice &audio = platform.audio;
+
+	SoundBuffer soundBuffer = {};
+	soundBuffer.samplesPerSecond = audio.samplesPerSecond;
+	soundBuffer.sampleCount = frameCount;
+	soundBuffer.samples = audio.outputSamples;
+	platform.RenderAudioCallback(platform.pub, soundBuffer);
 
-	// Error recovery
-	if ( res < 0 )
+	const snd_pcm_sframes_t res = FP_snd_pcm_writei(audioPcm, soundBuffer.samples, frameCount);
+	return res;
+}
+
+static void AlsaLogStats(AlsaPacer &pacer, u32 samplesPerSecond)
+{
+	const u64 now = AlsaNanos();
+	if ( pacer.statsNanos == 0 ) {
+		pacer.statsNanos = now;
+	}
+
+	if ( now - pacer.statsNanos >= ALSA_STATS_SECONDS * 1000000000ull && pacer.updateCount > 0 )
 	{
-		FP_snd_pcm_recover(audioPcm, res, 1);
+		LOG(Info, "Audio: write-ahead %.1f ms, latency %.1f ms (max %.1f ms), wake-ups up to %.2f ms late, %u underruns\n",
+			1000.0f * pacer.writeAheadFrames / samplesPerSecond,
+			pacer.latencyMillisSum / pacer.updateCount, pacer.maxLatencyMillis,
+			pacer.maxLateMillis, pacer.underrunCount);
+
+		pacer.statsNanos = now;
+		pacer.updateCount = 0;
+		pacer.underrunCount = 0;
+		pacer.maxLateMillis = 0.0f;
+		pacer.maxLatencyMillis = 0.0f;
+		pacer.latencyMillisSum = 0.0;
 	}
 }
 
 static void UpdateAudioDevice(Platform &platform)
 {
 	AudioDevice &audio = platform.audio;
+	AlsaPacer &pacer = audioPacer;
+
+	const u64 wakeNanos = AlsaNanos();
+	const f32 lateMillis = pacer.deadlineNanos > 0 && wakeNanos > pacer.deadlineNanos ? ( wakeNanos - pacer.deadlineNanos ) / 1000000.0f : 0.0f;
 
 	for (u32 i = 0; i < 2; ++i)
 	{
 		snd_pcm_sframes_t availableFrames;
 		snd_pcm_sframes_t delayFrames;
-		int res = FP_snd_pcm_avail_delay(audioPcm, &availableFrames, &delayFrames);
+		snd_pcm_sframes_t res = FP_snd_pcm_avail_delay(audioPcm, &availableFrames, &delayFrames);
 		//LOG(Debug, "avail %u / delay %u\n", availableFrames, delayFrames);
 
 		if ( res == 0 )
 		{
-			// Keep up to two write-ahead windows queued. Widening the window makes underruns
-			// less likely, at the cost of latency before a new sound is heard.
-			const float time = 2.0f * (float)audio.writeAheadMillis / 1000.0f;
-			const snd_pcm_uframes_t maxFramesToRender = (snd_pcm_uframes_t)(audio.samplesPerSecond * time);
+			AlsaHostClockQueue(pacer, audio.samplesPerSecond, availableFrames, delayFrames);
 
-			snd_pcm_uframes_t framesToRender = maxFramesToRender - delayFrames;
-
-			framesToRender = framesToRender < availableFrames ? framesToRender : availableFrames;
+			// Top the queue up to the write-ahead
+			const i32 framesToRender = Min((i32)pacer.writeAheadFrames - (i32)delayFrames, (i32)availableFrames);
 
 			if ( framesToRender > 0 )
 			{
-				SoundBuffer soundBuffer = {};
-				soundBuffer.samplesPerSecond = audio.samplesPerSecond;
-				soundBuffer.sampleCount = framesToRender;
-				soundBuffer.samples = audio.outputSamples;
-				platform.RenderAudioCallback(platform.pub, soundBuffer);
-
-				res = FP_snd_pcm_writei(audioPcm, soundBuffer.samples, framesToRender);
-
-				if ( res < 0 )
-				{
-					LOG(Error, "Error calling snd_pcm_writei: %s\n", FP_snd_strerror(res));
+				res = pacer.mmap ?
+					AlsaWriteMmap(platform, framesToRender) :
+					AlsaWriteInterleaved(platform, framesToRender);
+
+				if ( res >= 0 ) {
+					pacer.writtenFrames += res;
+				} else if ( res != -EPIPE ) {
+					LOG(Error, "Error writing to the PCM device: %s\n", FP_snd_strerror(res));
 				}
 			}
+
+			if ( res >= 0 )
+			{
+				const f32 latencyMillis = 1000.0f * ( delayFrames + Max(framesToRender, 0) ) / audio.samplesPerSecond;
+				pacer.latencyMillisSum += latencyMillis;
+				pacer.maxLatencyMillis = Max(pacer.maxLatencyMillis, latencyMillis);
+				pacer.updateCount++;
+			}
 		}
-		else
+		else if ( res != -EPIPE )
 		{
 			LOG(Error, "Error calling snd_pcm_avail_delay: %s\n", FP_snd_strerror(res));
 		}
 
 		// Error recovery
-		if (res == -EPIPE || res == -ESTRPIPE || res == -EINTR) {
-			FP_snd_pcm_recover(audioPcm, res, 0);
+		if (res == -EPIPE || res == -ESTRPIPE || res == -EINTR)
+		{
+			// An underrun means the queue did not last until this update, so the
+			// write-ahead grows by a period right away
+			if ( res == -EPIPE ) {
+				pacer.underrunCount++;
+				pacer.peakDelayMillis += pacer.periodNanos / 1000000.0f;
+			}
+			FP_snd_pcm_recover(audioPcm, res, 1);
 			continue;
 		}
 
 		// All good or unrecoverable error (no need to try a second time)
 		break;
 	}
+
+	// The next queue has to cover the wake-up delay and the render time of this update
+	const u64 scheduledNanos = pacer.deadlineNanos < wakeNanos ? pacer.deadlineNanos : wakeNanos;
+	const f32 delayMillis = ( AlsaNanos() - scheduledNanos ) / 1000000.0f;
+	if ( pacer.deadlineNanos > 0 ) {
+		pacer.peakDelayMillis = Max(Min(delayMillis, (f32)audio.writeAheadMillis), pacer.peakDelayMillis * ALSA_PEAK_DELAY_DECAY);
+	}
+	pacer.maxLateMillis = Max(pacer.maxLateMillis, lateMillis);
+	AlsaUpdateWriteAhead(pacer, audio.samplesPerSecond);
+
+	AlsaLogStats(pacer, audio.samplesPerSecond);
 }
 
 
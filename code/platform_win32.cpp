@@ -600,6 +600,9 @@ static LRESULT CALLBACK Win32WindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPA
 		case WM_EXITSIZEMOVE:
 			KillTimer(hWnd, SIZEMOVE_TIMER_ID);
 			platform.inSizeMove = 0;
+#if USE_UPDATE_THREAD
+			SignalEvent(platform.sizeMoveEndEvent);
+#endif
 			break;
 
 		case WM_TIMER:
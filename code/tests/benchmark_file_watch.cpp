@@ -0,0 +1,154 @@
+/*
+ * benchmark_file_watch.cpp
+ * Cost of polling timestamps for hot reload versus the file watch in code/ilu_core.h
+ *
+ * A directory is filled with as many files as a project with a few hundred textures has.
+ * The polling rounds stat every file, as CheckEngineHotReload (2 files every 0.1 s),
+ * CompileModifiedShaders (2 per shader) and RecreateModifiedTextures (1 per texture, both
+ * every 0.2 s) did. Latency is from the close of a write to its detection: at a random
+ * point of the poll period for polling, and reading inotify events for the file watch,
+ * where the platform service adds its debounce time.
+ */
+
+#include "../ilu_core.h"
+
+#define SHADER_COUNT 32
+#define TEXTURE_COUNT 300
+#define LATENCY_SAMPLES 10
+#define POLL_RUNS 5
+#define ENGINE_POLL_MILLIS 100
+#define ASSET_POLL_MILLIS 200
+#define DEBOUNCE_MILLIS 50 // FILE_WATCH_DEBOUNCE_MILLIS in platform.cpp
+
+static const char *gDir = "build/file_watch_files";
+static FilePath gPaths[2 + 2 * SHADER_COUNT + TEXTURE_COUNT];
+static volatile u64 gSink;
+
+static void WriteTestFile(const char *path, u32 value)
+{
+	char content[64];
+	SPrintf(content, "content %u", value);
+	WriteEntireFile(path, content, StrLen(content));
+}
+
+static u64 PollRound()
+{
+	u64 sum = 0;
+	for (u32 i = 0; i < ARRAY_COUNT(gPaths); ++i) {
+		u64 ts = 0;
+		GetFileLastWriteTimestamp(gPaths[i].str, ts);
+		sum += ts;
+	}
+	return sum;
+}
+
+int main()
+{
+	LOG(Info, "====================================\n");
+	LOG(Info, "  File watch benchmark\n");
+	LOG(Info, "====================================\n");
+
+	Dir dir;
+	if ( OpenDir(dir, gDir) ) {
+		CloseDir(dir);
+	} else {
+		CreateDirectory(gDir);
+	}
+
+	u32 pathCount = 0;
+	SPrintf(gPaths[pathCount++].str, "%s/engine.so", gDir);
+	SPrintf(gPaths[pathCount++].str, "%s/engine.tmp.so", gDir);
+	for (u32 i = 0; i < SHADER_COUNT; ++i) {
+		SPrintf(gPaths[pathCount++].str, "%s/shader_%u.hlsl", gDir, i);
+		SPrintf(gPaths[pathCount++].str, "%s/shader_%u.spv", gDir, i);
+	}
+	for (u32 i = 0; i < TEXTURE_COUNT; ++i) {
+		SPrintf(gPaths[pathCount++].str, "%s/texture_%u.png", gDir, i);
+	}
+	ASSERT(pathCount == ARRAY_COUNT(gPaths));
+	for (u32 i = 0; i < pathCount; ++i) {
+		WriteTestFile(gPaths[i].str, i);
+	}
+
+	// Polling cost
+	f32 roundSeconds = 1e9f;
+	for (u32 run = 0; run < POLL_RUNS; ++run) {
+		const Clock begin = GetClock();
+		gSink = PollRound();
+		const f32 seconds = GetSecondsElapsed(begin, GetClock());
+		roundSeconds = seconds < roundSeconds ? seconds : roundSeconds;
+	}
+	const f32 statsPerSecond = 2.0f * 1000.0f / ENGINE_POLL_MILLIS + ( pathCount - 2.0f ) * 1000.0f / ASSET_POLL_MILLIS;
+	const f32 statMicros = roundSeconds * 1e6f / pathCount;
+	LOG(Info, "\nPolling, %u files\n", pathCount);
+	LOG(Info, "%-32s %10.2f us\n", "stat", statMicros);
+	LOG(Info, "%-32s %10.0f\n", "stat calls per second", statsPerSecond);
+	LOG(Info, "%-32s %10.1f (%.0f us)\n", "stat calls per frame at 60 Hz", statsPerSecond / 60.0f, statsPerSecond / 60.0f * statMicros);
+	LOG(Info, "\nFile watch\n");
+	LOG(Info, "%-32s %10u (one mutex lock)\n", "syscalls per frame", 0);
+
+	// Latency of polling: the write lands at a random point of the poll period
+	u32 random = 12345;
+	f32 pollLatencyMillis = 0.0f;
+	const char *texturePath = gPaths[pathCount - 1].str;
+	for (u32 i = 0; i < LATENCY_SAMPLES; ++i)
+	{
+		u64 previousTs = 0;
+		GetFileLastWriteTimestamp(texturePath, previousTs);
+		const Clock periodBegin = GetClock();
+
+		random = random * 1664525u + 1013904223u;
+		SleepMillis( (random >> 8) % ASSET_POLL_MILLIS );
+		WriteTestFile(texturePath, random);
+		const Clock writeClock = GetClock();
+
+		while ( GetSecondsElapsed(periodBegin, GetClock()) * 1000.0f < ASSET_POLL_MILLIS ) {
+			SleepMillis(1);
+		}
+		u64 ts = 0;
+		GetFileLastWriteTimestamp(texturePath, ts);
+		ASSERT(ts > previousTs);
+		pollLatencyMillis += GetSecondsElapsed(writeClock, GetClock()) * 1000.0f;
+	}
+	LOG(Info, "\nChange to detection\n");
+	LOG(Info, "%-32s %10.2f ms\n", "polling", pollLatencyMillis / LATENCY_SAMPLES);
+
+#if USE_FILE_WATCH
+	FileWatch watch;
+	if ( CreateFileWatch(watch) && AddFileWatchDirectory(watch, gDir) )
+	{
+		f32 watchLatencyMillis = 0.0f;
+		for (u32 i = 0; i < LATENCY_SAMPLES; ++i)
+		{
+			SleepMillis(5);
+			WriteTestFile(texturePath, i);
+			const Clock writeClock = GetClock();
+
+			bool detected = false;
+			while ( !detected )
+			{
+				FilePath paths[8];
+				bool overflow = false;
+				const u32 count = ReadFileWatchEvents(watch, 1000, paths, ARRAY_COUNT(paths), overflow);
+				for (u32 p = 0; p < count; ++p) {
+					detected = detected || StrEq(paths[p].str, texturePath);
+				}
+			}
+			watchLatencyMillis += GetSecondsElapsed(writeClock, GetClock()) * 1000.0f;
+		}
+		DestroyFileWatch(watch);
+
+		LOG(Info, "%-32s %10.3f ms\n", "inotify", watchLatencyMillis / LATENCY_SAMPLES);
+		LOG(Info, "%-32s %10.3f ms\n", "inotify with debounce", watchLatencyMillis / LATENCY_SAMPLES + DEBOUNCE_MILLIS);
+	}
+#else
+	LOG(Info, "%-32s %10s\n", "file watch", "not available");
+#endif
+
+	for (u32 i = 0; i < pathCount; ++i) {
+		remove(gPaths[i].str);
+	}
+	rmdir(gDir);
+
+	return 0;
+}
@@ -0,0 +1,115 @@
+/*
+ * benchmark_hash.cpp
+ * Throughput benchmark for the hash functions in code/ilu_core.h
+ *
+ * Every function hashes inputs from 16 bytes to 16 MB: short ones are names and table
+ * keys, long ones are asset sections. The streaming XXH64 is fed in 64 KB chunks, as a
+ * file read would. Throughputs are in GB/s, the best of a few runs, with the time per
+ * call for the short inputs.
+ */
+
+#include "../ilu_core.h"
+
+static const u32 gSizes[] = { 16, 64, 256, KB(1), KB(4), KB(64), MB(1), MB(16) };
+
+#define BENCHMARK_BYTES MB(256) // Bytes hashed per run, so short inputs repeat enough
+#define BENCHMARK_RUNS 3
+#define STREAM_CHUNK_SIZE KB(64)
+
+static byte *gData;
+
+static u64 HashFNVBench(const void *data, u32 size) { return HashFNV(data, size); }
+static u64 HashXX64Bench(const void *data, u32 size) { return HashXX64(data, size); }
+static u64 HashWY64Bench(const void *data, u32 size) { return HashWY64(data, size); }
+static u64 HashWY32Bench(const void *data, u32 size) { return HashWY32(data, size); }
+
+static u64 HashXX64StreamBench(const void *data, u32 size)
+{
+	HashXX64State state = HashXX64Begin();
+	for (u32 offset = 0; offset < size; offset += STREAM_CHUNK_SIZE) {
+		const u32 chunk = size - offset < STREAM_CHUNK_SIZE ? size - offset : STREAM_CHUNK_SIZE;
+		HashXX64Update(state, (const byte*)data + offset, chunk);
+	}
+	return HashXX64End(state);
+}
+
+struct BenchmarkHash
+{
+	const char *name;
+	u64 (*hash)(const void *data, u32 size);
+};
+
+static const BenchmarkHash gHashes[] = {
+	{ "HashFNV", HashFNVBench },
+	{ "HashXX64", HashXX64Bench },
+	{ "HashXX64 stream", HashXX64StreamBench },
+	{ "HashWY64", HashWY64Bench },
+	{ "HashWY32", HashWY32Bench },
+};
+
+static volatile u64 gSink;
+
+static f32 Seconds(const BenchmarkHash &hash, u32 size, u32 count)
+{
+	f32 seconds = 1e9f;
+	for (u32 run = 0; run < BENCHMARK_RUNS; ++run)
+	{
+		u64 sink = 0;
+		const Clock begin = GetClock();
+		for (u32 i = 0; i < count; ++i) {
+			// Depend on the previous hash so calls do not overlap, as table lookups would
+			sink += hash.hash(gData + (sink & 7), size);
+		}
+		const f32 runSeconds = GetSecondsElapsed(begin, GetClock());
+		seconds = runSeconds < seconds ? runSeconds : seconds;
+		gSink = sink;
+	}
+	return seconds;
+}
+
+int main()
+{
+	LOG(Info, "====================================\n");
+	LOG(Info, "  Hash benchmark\n");
+	LOG(Info, "====================================\n");
+
+	gData = (byte*)AllocateVirtualMemory(MB(16) + 8);
+	for (u32 i = 0; i < MB(16) + 8; ++i) {
+		gData[i] = (byte)(i * 2654435761u >> 13);
+	}
+
+	LOG(Info, "\nGB/s (ns per call below 4 KB)\n");
+	LOG(Info, "%-16s", "");
+	for (u32 s = 0; s < ARRAY_COUNT(gSizes); ++s) {
+		if ( gSizes[s] >= MB(1) ) {
+			LOG(Info, " %10llu MB", (unsigned long long)(gSizes[s] / MB(1)));
+		} else if ( gSizes[s] >= KB(1) ) {
+			LOG(Info, " %10llu KB", (unsigned long long)(gSizes[s] / KB(1)));
+		} else {
+			LOG(Info, " %11u B", gSizes[s]);
+		}
+	}
+	LOG(Info, "\n");
+
+	for (u32 h = 0; h < ARRAY_COUNT(gHashes); ++h)
+	{
+		LOG(Info, "%-16s", gHashes[h].name);
+		for (u32 s = 0; s < ARRAY_COUNT(gSizes); ++s)
+		{
+			const u32 size = gSizes[s];
+			// FNV is slow enough to time on fewer bytes
+			const u32 bytes = gHashes[h].hash == HashFNVBench ? BENCHMARK_BYTES / 8 : BENCHMARK_BYTES;
+			const u32 count = size < bytes ? bytes / size : 1;
+			const f32 seconds = Seconds(gHashes[h], size, count);
+			const f32 gbps = (f32)count * size / seconds / 1e9f;
+			if ( size < KB(4) ) {
+				LOG(Info, " %5.2f (%5.1f)", gbps, seconds * 1e9f / count);
+			} else {
+				LOG(Info, " %13.2f", gbps);
+			}
+		}
+		LOG(Info, "\n");
+	}
+
+	return 0;
+}
@@ -0,0 +1,155 @@
+/*
+ * benchmark_math.cpp
+ * Benchmark for the SIMD matrix and transform functions in code/ilu_core.h
+ *
+ * Each function runs 100k times next to its scalar version, as the renderer does for
+ * entity world matrices and culling bounds: over 1k elements that stay in the L1 and L2
+ * caches, and over 100k distinct ones that stream from memory. Times are in milliseconds
+ * per 100k, the best of a few runs.
+ */
+
+#include "../ilu_core.h"
+
+#define ELEMENT_COUNT 100000
+#define CACHED_ELEMENT_COUNT 1000
+#define BENCHMARK_RUNS 10
+
+static float4x4 gMatrices[ELEMENT_COUNT];
+static float4x4 gResults[ELEMENT_COUNT];
+static float3 gPoints[ELEMENT_COUNT];
+static float3 gPointResults[ELEMENT_COUNT];
+static AABB gBoxes[ELEMENT_COUNT];
+static AABB gBoxResults[ELEMENT_COUNT];
+static float4x4 gViewProjection;
+
+static u32 gRandom = 1;
+
+static f32 Random(f32 min, f32 max)
+{
+	gRandom = gRandom * 1664525u + 1013904223u;
+	return min + (max - min) * (f32)(gRandom >> 8) / (f32)(1 << 24);
+}
+
+enum Operation
+{
+	Operation_MulScalar,
+	Operation_Mul,
+	Operation_MulMatrices,
+	Operation_InverseScalar,
+	Operation_Inverse,
+	Operation_MulPointScalar,
+	Operation_MulPoints,
+	Operation_TransformAABBScalar,
+	Operation_TransformAABBs,
+	Operation_Count,
+};
+
+static const char *gOperationNames[] = {
+	"MulScalar 4x4",
+	"Mul 4x4",
+	"MulMatrices",
+	"InverseScalar",
+	"Inverse",
+	"MulPoint (scalar)",
+	"MulPoints",
+	"TransformAABBScalar",
+	"TransformAABBs",
+};
+CT_ASSERT(ARRAY_COUNT(gOperationNames) == Operation_Count);
+
+static void Run(Operation operation, u32 count)
+{
+	switch (operation)
+	{
+		case Operation_MulScalar:
+			for (u32 i = 0; i < count; ++i) { gResults[i] = MulScalar(gViewProjection, gMatrices[i]); }
+			break;
+		case Operation_Mul:
+			for (u32 i = 0; i < count; ++i) { gResults[i] = Mul(gViewProjection, gMatrices[i]); }
+			break;
+		case Operation_MulMatrices:
+			MulMatrices(gViewProjection, gMatrices, gResults, count);
+			break;
+		case Operation_InverseScalar:
+			for (u32 i = 0; i < count; ++i) { gResults[i] = InverseScalar(gMatrices[i]); }
+			break;
+		case Operation_Inverse:
+			for (u32 i = 0; i < count; ++i) { gResults[i] = Inverse(gMatrices[i]); }
+			break;
+		case Operation_MulPointScalar:
+			for (u32 i = 0; i < count; ++i) { gPointResults[i] = MulScalar(gViewProjection, Float4(gPoints[i], 1.0f)).xyz; }
+			break;
+		case Operation_MulPoints:
+			MulPoints(gViewProjection, gPoints, gPointResults, count);
+			break;
+		case Operation_TransformAABBScalar:
+			for (u32 i = 0; i < count; ++i) { gBoxResults[i] = TransformAABBScalar(gViewProjection, gBoxes[i]); }
+			break;
+		case Operation_TransformAABBs:
+			TransformAABBs(gViewProjection, gBoxes, gBoxResults, count);
+			break;
+		default:
+			INVALID_CODE_PATH();
+	}
+}
+
+int main()
+{
+	LOG(Info, "====================================\n");
+	LOG(Info, "  Math benchmark\n");
+	LOG(Info, "====================================\n");
+#if USE_MATH_SSE
+	LOG(Info, "Math kernels: SSE2\n");
+#elif USE_MATH_NEON
+	LOG(Info, "Math kernels: NEON\n");
+#else
+	LOG(Info, "Math kernels: scalar\n");
+#endif
+
+	for (u32 i = 0; i < ELEMENT_COUNT; ++i)
+	{
+		const float3 position = Float3(Random(-100.0f, 100.0f), Random(-100.0f, 100.0f), Random(-100.0f, 100.0f));
+		const float3 axis = Normalize(Float3(Random(-1.0f, 1.0f), Random(-1.0f, 1.0f), Random(0.1f, 1.0f)));
+		gMatrices[i] = Mul(Translate(position), Mul(Rotate(axis, Random(0.0f, 360.0f)), Scale(Float3(Random(0.5f, 2.0f)))));
+		gPoints[i] = position;
+		gBoxes[i] = { .min = position, .max = Float3(position.x + 1.0f, position.y + 2.0f, position.z + 3.0f) };
+	}
+	gViewProjection = Mul(Perspective(60.0f, 16.0f / 9.0f, 0.1f, 1000.0f), LookAt(Float3(0.0f, 10.0f, 10.0f), Float3(0.0f), Float3(0.0f, 1.0f, 0.0f)));
+
+	LOG(Info, "\nms per 100k\n%-20s %8s %8s\n", "", "1k", "100k");
+	f32 millis[Operation_Count][2];
+	for (u32 operation = 0; operation < Operation_Count; ++operation)
+	{
+		for (u32 working = 0; working < 2; ++working)
+		{
+			const u32 count = working ? ELEMENT_COUNT : CACHED_ELEMENT_COUNT;
+			const u32 passes = ELEMENT_COUNT / count;
+			f32 best = 1e9f;
+			for (u32 run = 0; run < BENCHMARK_RUNS; ++run)
+			{
+				const Clock begin = GetClock();
+				for (u32 pass = 0; pass < passes; ++pass) {
+					Run((Operation)operation, count);
+				}
+				const f32 runMillis = GetSecondsElapsed(begin, GetClock()) * 1000.0f;
+				best = runMillis < best ? runMillis : best;
+			}
+			millis[operation][working] = best;
+		}
+		LOG(Info, "%-20s %8.3f %8.3f\n", gOperationNames[operation], millis[operation][0], millis[operation][1]);
+	}
+
+	for (u32 working = 0; working < 2; ++working)
+	{
+		LOG(Info, "\nSpeedups on %s: Mul %.2fx, MulMatrices %.2fx, Inverse %.2fx, MulPoints %.2fx, TransformAABBs %.2fx",
+			working ? "100k" : "1k",
+			millis[Operation_MulScalar][working] / millis[Operation_Mul][working],
+			millis[Operation_MulScalar][working] / millis[Operation_MulMatrices][working],
+			millis[Operation_InverseScalar][working] / millis[Operation_Inverse][working],
+			millis[Operation_MulPointScalar][working] / millis[Operation_MulPoints][working],
+			millis[Operation_TransformAABBScalar][working] / millis[Operation_TransformAABBs][working]);
+	}
+	LOG(Info, "\n");
+
+	return 0;
+}
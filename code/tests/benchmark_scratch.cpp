@@ -0,0 +1,202 @@
+/*
+ * benchmark_scratch.cpp
+ * Benchmark for acquiring and releasing scratch arenas, as every Scratch object does
+ *
+ * 1 to 10 threads (8 workers plus the update and audio threads) acquire a scratch,
+ * acquire a nested one, push a little into both and release them. Times are in ns per
+ * acquire and release pair, and include the wait for the other threads.
+ * Global bitmask: the previous scheme, 8 arenas shared by all threads and handed out
+ * with a compare-and-swap loop on one mask. With more than 4 threads nesting two
+ * scratches the arenas run out, so threads have to yield until one is released (the
+ * platform asserted instead).
+ * Thread stacks: ScratchStack in code/ilu_core.h, one stack of arenas per thread.
+ */
+
+#include "../ilu_core.h"
+
+#define MAX_THREADS 10
+#define PAIRS_PER_THREAD 200000
+#define GLOBAL_ARENA_COUNT 8
+#define ARENA_SIZE MB(1)
+
+enum ScratchKind
+{
+	ScratchKindGlobalBitmask,
+	ScratchKindThreadStacks,
+	ScratchKindCount,
+};
+
+static const char *gScratchNames[] = {
+	"Global bitmask",
+	"Thread stacks",
+};
+CT_ASSERT(ARRAY_COUNT(gScratchNames) == ScratchKindCount);
+
+struct BenchmarkData
+{
+	ScratchKind kind;
+
+	Arena globalArenas[GLOBAL_ARENA_COUNT];
+	volatile_u32 globalLockMask;
+	volatile_u32 exhaustedCount; // Acquires that found all global arenas taken
+
+	ScratchStack stacks[MAX_THREADS];
+
+	volatile_u32 started;
+	volatile_u32 go;
+	volatile_u32 finished;
+};
+
+static BenchmarkData gData;
+static thread_local ScratchStack *tScratchStack;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Global bitmask, as AcquireScratchArena and ReleaseScratchArena were in code/platform.cpp
+
+static u32 GlobalAcquire(Arena &outArena)
+{
+	for (;;)
+	{
+		const u32 oldValue = gData.globalLockMask;
+		const u32 index = FBZ(oldValue);
+		if ( index >= GLOBAL_ARENA_COUNT )
+		{
+			AtomicFetchAdd(&gData.exhaustedCount, 1);
+			Yield();
+			continue;
+		}
+		const u32 newValue = oldValue | (1 << index);
+		if ( AtomicSwap(&gData.globalLockMask, oldValue, newValue) )
+		{
+			outArena = gData.globalArenas[index];
+			outArena.used = 0;
+			return index;
+		}
+	}
+}
+
+static void GlobalRelease(u32 index)
+{
+	u32 oldValue, newValue;
+	do
+	{
+		oldValue = gData.globalLockMask;
+		newValue = oldValue & ~(1 << index);
+	}
+	while ( !AtomicSwap(&gData.globalLockMask, oldValue, newValue) );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Threads
+
+static u32 Acquire(Arena &outArena)
+{
+	if ( gData.kind == ScratchKindGlobalBitmask ) {
+		return GlobalAcquire(outArena);
+	} else {
+		return PushScratchArena(*tScratchStack, outArena, ARENA_SIZE);
+	}
+}
+
+static void Release(u32 index, const Arena &arena)
+{
+	if ( gData.kind == ScratchKindGlobalBitmask ) {
+		GlobalRelease(index);
+	} else {
+		PopScratchArena(*tScratchStack, index, arena);
+	}
+}
+
+static THREAD_FUNCTION(ScratchThread)
+{
+	const ThreadInfo *threadInfo = (const ThreadInfo *)arguments;
+	tScratchStack = &gData.stacks[threadInfo->globalIndex];
+
+	AtomicFetchAdd(&gData.started, 1);
+	while ( !AtomicLoadAcquire(&gData.go) ) {
+		CpuRelax();
+	}
+
+	for (u32 i = 0; i < PAIRS_PER_THREAD / 2; ++i)
+	{
+		Arena outer;
+		const u32 outerIndex = Acquire(outer);
+		u32 *outerData = PushArray(outer, u32, 16);
+		outerData[0] = i;
+
+		Arena inner;
+		const u32 innerIndex = Acquire(inner);
+		u32 *innerData = PushArray(inner, u32, 16);
+		innerData[0] = outerData[0];
+
+		Release(innerIndex, inner);
+		Release(outerIndex, outer);
+	}
+
+	AtomicFetchAdd(&gData.finished, 1);
+	return 0;
+}
+
+static const ThreadInfo gThreadInfos[MAX_THREADS] = {
+	{ .globalIndex = 0 }, { .globalIndex = 1 }, { .globalIndex = 2 }, { .globalIndex = 3 },
+	{ .globalIndex = 4 }, { .globalIndex = 5 }, { .globalIndex = 6 }, { .globalIndex = 7 },
+	{ .globalIndex = 8 }, { .globalIndex = 9 },
+};
+
+static f32 PairNanos(ScratchKind kind, u32 threadCount)
+{
+	gData.kind = kind;
+	gData.started = 0;
+	gData.go = 0;
+	gData.finished = 0;
+
+	for (u32 i = 0; i < threadCount; ++i) {
+		CreateDetachedThread(ScratchThread, gThreadInfos[i]);
+	}
+	while ( AtomicLoadAcquire(&gData.started) < threadCount ) {
+		Yield();
+	}
+
+	const Clock begin = GetClock();
+	AtomicStoreRelease(&gData.go, 1);
+	SpinBackoff backoff = {};
+	while ( AtomicLoadAcquire(&gData.finished) < threadCount ) {
+		SpinBackoffWait(backoff);
+	}
+	const f32 seconds = GetSecondsElapsed(begin, GetClock());
+
+	return seconds * 1e9f / ((f32)PAIRS_PER_THREAD * threadCount);
+}
+
+int main()
+{
+	LOG(Info, "====================================\n");
+	LOG(Info, "  Scratch arena benchmark\n");
+	LOG(Info, "====================================\n");
+
+	for (u32 i = 0; i < GLOBAL_ARENA_COUNT; ++i) {
+		gData.globalArenas[i] = MakeArena((byte*)AllocateVirtualMemory(ARENA_SIZE), ARENA_SIZE, "Scratch");
+	}
+
+	static const u32 threadCounts[] = { 1, 2, 4, 8, 10 };
+
+	LOG(Info, "\nAcquire and release, ns per pair\n");
+	LOG(Info, "%-24s", "threads");
+	for (u32 t = 0; t < ARRAY_COUNT(threadCounts); ++t) {
+		LOG(Info, " %8u", threadCounts[t]);
+	}
+	LOG(Info, "\n");
+	for (u32 k = 0; k < ScratchKindCount; ++k)
+	{
+		LOG(Info, "%-24s", gScratchNames[k]);
+		for (u32 t = 0; t < ARRAY_COUNT(threadCounts); ++t) {
+			LOG(Info, " %8.1f", PairNanos((ScratchKind)k, threadCounts[t]));
+		}
+		LOG(Info, "\n");
+	}
+
+	LOG(Info, "\nGlobal bitmask acquires that found all %u arenas taken: %u\n",
+			GLOBAL_ARENA_COUNT, gData.exhaustedCount);
+
+	return 0;
+}
@@ -0,0 +1,289 @@
+/*
+ * benchmark_threading.cpp
+ * Benchmark for the synchronization primitives in code/ilu_core.h
+ *
+ * Contention: 1 to 8 threads increment a shared counter under a lock, with a few
+ * nanoseconds of private work between locks as a job system would. Times are in ns per
+ * lock and include the wait for the other threads.
+ * Handoff: two threads pass a token back and forth, and the time is per one-way handoff.
+ * The polling variant is how the threads waited on each other before (SleepMillis(1)).
+ * On Linux, the futex primitives are compared with pthread_mutex_t and sem_t.
+ */
+
+#include "../ilu_core.h"
+
+#if PLATFORM_LINUX
+#include <semaphore.h>
+#endif
+
+#define MAX_THREADS 8
+#define CONTENTION_LOCKS 1000000 // Locks per run, split among threads
+#define HANDOFF_ROUNDS 100000
+#define POLLING_ROUNDS 200
+
+enum LockKind
+{
+	LockKindMutex,
+#if PLATFORM_LINUX
+	LockKindPthread,
+#endif
+	LockKindCount,
+};
+
+static const char *gLockNames[] = {
+	"Mutex",
+#if PLATFORM_LINUX
+	"pthread_mutex_t",
+#endif
+};
+CT_ASSERT(ARRAY_COUNT(gLockNames) == LockKindCount);
+
+enum HandoffKind
+{
+	HandoffKindEvent,
+#if PLATFORM_LINUX
+	HandoffKindSemT,
+#endif
+	HandoffKindPolling,
+	HandoffKindCount,
+};
+
+static const char *gHandoffNames[] = {
+	"Event",
+#if PLATFORM_LINUX
+	"sem_t",
+#endif
+	"SleepMillis(1) polling",
+};
+CT_ASSERT(ARRAY_COUNT(gHandoffNames) == HandoffKindCount);
+
+struct BenchmarkData
+{
+	LockKind lockKind;
+	u32 locksPerThread;
+	Mutex mutex;
+#if PLATFORM_LINUX
+	pthread_mutex_t pthreadMutex;
+#endif
+	u64 counter;
+
+	HandoffKind handoffKind;
+	u32 rounds;
+	Event events[2];
+#if PLATFORM_LINUX
+	sem_t semaphores[2];
+#endif
+	volatile_u32 turn; // For polling: whose turn it is to go
+
+	volatile_u32 started;
+	volatile_u32 go;
+	volatile_i64 finished;
+};
+
+static BenchmarkData gData;
+static volatile u32 gSink;
+
+static void WaitStart()
+{
+	AtomicFetchAdd(&gData.started, 1);
+	while ( !AtomicLoadAcquire(&gData.go) ) {
+		CpuRelax();
+	}
+}
+
+static void PrivateWork()
+{
+	u32 x = gSink;
+	for (u32 i = 0; i < 16; ++i) {
+		x = x * 1664525u + 1013904223u;
+	}
+	gSink = x;
+}
+
+static THREAD_FUNCTION(ContentionThread)
+{
+	WaitStart();
+	for (u32 i = 0; i < gData.locksPerThread; ++i)
+	{
+		switch ( gData.lockKind )
+		{
+			case LockKindMutex:
+				LockMutex(gData.mutex);
+				gData.counter++;
+				UnlockMutex(gData.mutex);
+				break;
+#if PLATFORM_LINUX
+			case LockKindPthread:
+				pthread_mutex_lock(&gData.pthreadMutex);
+				gData.counter++;
+				pthread_mutex_unlock(&gData.pthreadMutex);
+				break;
+#endif
+			default:
+				INVALID_CODE_PATH();
+		}
+		PrivateWork();
+	}
+	AtomicIncrement(&gData.finished);
+	return 0;
+}
+
+static void Pass(u32 to)
+{
+	switch ( gData.handoffKind )
+	{
+		case HandoffKindEvent:
+			SignalEvent(gData.events[to]);
+			break;
+#if PLATFORM_LINUX
+		case HandoffKindSemT:
+			sem_post(&gData.semaphores[to]);
+			break;
+#endif
+		case HandoffKindPolling:
+			AtomicStoreRelease(&gData.turn, to);
+			break;
+		default:
+			INVALID_CODE_PATH();
+	}
+}
+
+static void Receive(u32 self)
+{
+	switch ( gData.handoffKind )
+	{
+		case HandoffKindEvent:
+			WaitEvent(gData.events[self]);
+			break;
+#if PLATFORM_LINUX
+		case HandoffKindSemT:
+			sem_wait(&gData.semaphores[self]);
+			break;
+#endif
+		case HandoffKindPolling:
+			while ( AtomicLoadAcquire(&gData.turn) != self ) {
+				SleepMillis(1);
+			}
+			break;
+		default:
+			INVALID_CODE_PATH();
+	}
+}
+
+static THREAD_FUNCTION(HandoffThread)
+{
+	WaitStart();
+	for (u32 i = 0; i < gData.rounds; ++i) {
+		Receive(1);
+		Pass(0);
+	}
+	AtomicIncrement(&gData.finished);
+	return 0;
+}
+
+static void ResetThreads()
+{
+	gData.started = 0;
+	gData.go = 0;
+	gData.finished = 0;
+}
+
+static void StartThreads(u32 threadCount)
+{
+	while ( AtomicLoadAcquire(&gData.started) < threadCount ) {
+		SleepMillis(1);
+	}
+	AtomicStoreRelease(&gData.go, 1);
+}
+
+static void WaitThreads(u32 threadCount)
+{
+	SpinBackoff backoff = {};
+	while ( gData.finished < threadCount ) {
+		SpinBackoffWait(backoff);
+	}
+}
+
+static const ThreadInfo gThreadInfos[MAX_THREADS] = {
+	{ .globalIndex = 1 }, { .globalIndex = 2 }, { .globalIndex = 3 }, { .globalIndex = 4 },
+	{ .globalIndex = 5 }, { .globalIndex = 6 }, { .globalIndex = 7 }, { .globalIndex = 8 },
+};
+
+static f32 ContentionNanos(LockKind kind, u32 threadCount)
+{
+	ResetThreads();
+	gData.lockKind = kind;
+	gData.locksPerThread = CONTENTION_LOCKS / threadCount;
+	gData.counter = 0;
+
+	for (u32 i = 0; i < threadCount; ++i) {
+		CreateDetachedThread(ContentionThread, gThreadInfos[i]);
+	}
+	const Clock begin = GetClock();
+	StartThreads(threadCount);
+	WaitThreads(threadCount);
+	const f32 seconds = GetSecondsElapsed(begin, GetClock());
+
+	ASSERT(gData.counter == (u64)gData.locksPerThread * threadCount);
+	return seconds * 1e9f / (gData.locksPerThread * threadCount);
+}
+
+static f32 HandoffMicros(HandoffKind kind)
+{
+	ResetThreads();
+	gData.handoffKind = kind;
+	gData.rounds = kind == HandoffKindPolling ? POLLING_ROUNDS : HANDOFF_ROUNDS;
+	gData.turn = 0;
+
+	CreateDetachedThread(HandoffThread, gThreadInfos[0]);
+	StartThreads(1);
+	const Clock begin = GetClock();
+	for (u32 i = 0; i < gData.rounds; ++i) {
+		Pass(1);
+		Receive(0);
+	}
+	const f32 seconds = GetSecondsElapsed(begin, GetClock());
+	WaitThreads(1);
+
+	return seconds * 1e6f / (2 * gData.rounds);
+}
+
+int main()
+{
+	LOG(Info, "====================================\n");
+	LOG(Info, "  Threading benchmark\n");
+	LOG(Info, "====================================\n");
+
+	CreateMutex(gData.mutex);
+	CreateEvent(gData.events[0]);
+	CreateEvent(gData.events[1]);
+#if PLATFORM_LINUX
+	pthread_mutex_init(&gData.pthreadMutex, nullptr);
+	sem_init(&gData.semaphores[0], 0, 0);
+	sem_init(&gData.semaphores[1], 0, 0);
+#endif
+
+	static const u32 threadCounts[] = { 1, 2, 4, 8 };
+
+	LOG(Info, "\nContention, ns per lock\n");
+	LOG(Info, "%-24s", "threads");
+	for (u32 t = 0; t < ARRAY_COUNT(threadCounts); ++t) {
+		LOG(Info, " %8u", threadCounts[t]);
+	}
+	LOG(Info, "\n");
+	for (u32 k = 0; k < LockKindCount; ++k)
+	{
+		LOG(Info, "%-24s", gLockNames[k]);
+		for (u32 t = 0; t < ARRAY_COUNT(threadCounts); ++t) {
+			LOG(Info, " %8.1f", ContentionNanos((LockKind)k, threadCounts[t]));
+		}
+		LOG(Info, "\n");
+	}
+
+	LOG(Info, "\nHandoff, us per one-way handoff\n");
+	for (u32 k = 0; k < HandoffKindCount; ++k) {
+		LOG(Info, "%-24s %8.2f\n", gHandoffNames[k], HandoffMicros((HandoffKind)k));
+	}
+
+	return 0;
+}
@@ -0,0 +1,442 @@
+/*
+ * golden_test_audio_render.cpp
+ * Offline render of the audio engine in code/audio.cpp, compared against golden files
+ *
+ * Each scene follows a script of audio commands, timed in milliseconds, and is rendered
+ * block by block faster than real time, without any sound device. The streaming jobs
+ * run inline between blocks, and the music ring is refilled completely before each
+ * block, so the output only depends on the script. It is written to build/ as a WAV
+ * file and compared with the golden file of the scene in code/tests/golden/.
+ *
+ * The cost of each block is measured, so the harness doubles as a mixer benchmark.
+ *
+ * Usage:
+ *   ./build/golden_test_audio_render                 Compares with the golden files
+ *   ./build/golden_test_audio_render --update-golden Rewrites the golden files
+ */
+
+#include "../engine.cpp"
+
+#include "test_engine.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Platform stubs
+
+// Jobs run inline, so the streamer always loads the chunks at the same point of the script
+static void StubPushWork(WorkQueueCallback *callback, void *data)
+{
+    static const ThreadInfo threadInfo = { .globalIndex = 0 };
+    callback(threadInfo, data);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// WAV files
+
+static bool WriteWavFile(const char *path, const i16 *samples, u32 frameCount, u32 sampleRate)
+{
+    FILE *file = fopen(path, "wb");
+    if ( !file ) {
+        return false;
+    }
+
+    const u32 dataSize = frameCount * 2 * sizeof(i16);
+    const u32 byteRate = sampleRate * 2 * sizeof(i16);
+
+    const WAVE_header header = { RIFF_RIFF, 4 + 8 + 16 + 8 + dataSize, RIFF_WAVE };
+    const WAVE_chunk fmtChunk = { RIFF_fmt, 16 };
+    const u16 fmt[8] = { 1, 2, (u16)( sampleRate & 0xffff ), (u16)( sampleRate >> 16 ), (u16)( byteRate & 0xffff ), (u16)( byteRate >> 16 ), 4, 16 };
+    const WAVE_chunk dataChunk = { RIFF_data, dataSize };
+
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(&fmtChunk, sizeof(fmtChunk), 1, file);
+    fwrite(fmt, sizeof(fmt), 1, file);
+    fwrite(&dataChunk, sizeof(dataChunk), 1, file);
+    fwrite(samples, dataSize, 1, file);
+
+    fclose(file);
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Scenes
+
+#define RENDER_BLOCK_MILLIS 10
+#define MAX_RENDER_SECONDS 2
+#define MAX_SCENE_VOICES 8
+
+// Rounding differences between the SIMD paths (SSE2, AVX2, scalar) stay within a few LSB
+#define GOLDEN_TOLERANCE 4
+
+// Golden files in code/tests/golden/, while the renders go next to the executable
+static FilePath gGoldenDir;
+
+enum SceneClip
+{
+    SceneClip_Bell,
+    SceneClip_BellAdpcm,
+    SceneClip_COUNT,
+};
+
+// Voice commands go to the voice of the script slot, VoiceStart plays the clip into
+// the slot and MusicPlay plays the music file. The other commands are pushed as they are.
+struct AudioRenderEvent
+{
+    u32 millis;
+    AudioCmd cmd;
+    u32 voiceIndex;
+    SceneClip clip;
+};
+
+struct AudioRenderScene
+{
+    const char *name;
+    u32 sampleRate; // Of the device
+    u32 millis;
+    const AudioRenderEvent *events;
+    u32 eventCount;
+};
+
+static const AudioRenderEvent sVoiceEvents[] = {
+    { .millis = 0, .cmd = { .type = AudioCmd_VoiceStart }, .voiceIndex = 0, .clip = SceneClip_Bell },
+    { .millis = 100, .cmd = { .type = AudioCmd_VoiceStart }, .voiceIndex = 1, .clip = SceneClip_BellAdpcm },
+    { .millis = 100, .cmd = { .type = AudioCmd_VoiceGainPan, .gain = 0.5f, .pan = -0.8f }, .voiceIndex = 1 },
+    { .millis = 250, .cmd = { .type = AudioCmd_VoiceStart }, .voiceIndex = 2, .clip = SceneClip_Bell },
+    { .millis = 250, .cmd = { .type = AudioCmd_VoicePitch, .pitch = 1.5f }, .voiceIndex = 2 },
+    { .millis = 400, .cmd = { .type = AudioCmd_VoiceStart }, .voiceIndex = 3, .clip = SceneClip_Bell },
+    { .millis = 400, .cmd = { .type = AudioCmd_VoiceGainPan, .gain = 0.0f, .pan = 0.0f }, .voiceIndex = 3 }, // Virtual
+    { .millis = 500, .cmd = { .type = AudioCmd_VoicePause }, .voiceIndex = 0 },
+    { .millis = 600, .cmd = { .type = AudioCmd_VoicePlay }, .voiceIndex = 0 },
+    { .millis = 600, .cmd = { .type = AudioCmd_VoiceGainPan, .gain = 1.0f, .pan = 0.5f }, .voiceIndex = 3 },
+    { .millis = 700, .cmd = { .type = AudioCmd_VoiceStop }, .voiceIndex = 1 },
+};
+
+static const AudioRenderEvent sBusEvents[] = {
+    { .millis = 0, .cmd = { .type = AudioCmd_Reverb, .decaySeconds = 1.5f, .damping = 0.3f } },
+    { .millis = 0, .cmd = { .type = AudioCmd_BusReverbSend, .gain = 0.4f, .bus = AudioBus_Sfx } },
+    { .millis = 0, .cmd = { .type = AudioCmd_VoiceStart }, .voiceIndex = 0, .clip = SceneClip_Bell },
+    { .millis = 200, .cmd = { .type = AudioCmd_BusFilter, .bus = AudioBus_Sfx, .filter = AudioFilter_LowPass, .frequency = 2000.0f, .q = AUDIO_BUTTERWORTH_Q } },
+    { .millis = 300, .cmd = { .type = AudioCmd_VoiceStart }, .voiceIndex = 1, .clip = SceneClip_BellAdpcm },
+    { .millis = 500, .cmd = { .type = AudioCmd_BusFilter, .bus = AudioBus_Master, .filter = AudioFilter_HighPass, .frequency = 300.0f, .q = AUDIO_BUTTERWORTH_Q } },
+    { .millis = 700, .cmd = { .type = AudioCmd_BusGain, .gain = 0.25f, .bus = AudioBus_Master } },
+};
+
+static const AudioRenderEvent sMusicEvents[] = {
+    { .millis = 0, .cmd = { .type = AudioCmd_MusicPlay } },
+    { .millis = 0, .cmd = { .type = AudioCmd_BusGain, .gain = 0.7f, .bus = AudioBus_Music } },
+    { .millis = 300, .cmd = { .type = AudioCmd_VoiceStart }, .voiceIndex = 0, .clip = SceneClip_Bell },
+    { .millis = 300, .cmd = { .type = AudioCmd_BusReverbSend, .gain = 0.3f, .bus = AudioBus_Music } },
+    { .millis = 600, .cmd = { .type = AudioCmd_MusicPause } },
+    { .millis = 800, .cmd = { .type = AudioCmd_MusicPlay } },
+};
+
+static const AudioRenderScene sScenes[] = {
+    { "voices", 48000, 1000, sVoiceEvents, ARRAY_COUNT(sVoiceEvents) },
+    { "buses", 48000, 1000, sBusEvents, ARRAY_COUNT(sBusEvents) },
+    { "music", 48000, 1000, sMusicEvents, ARRAY_COUNT(sMusicEvents) },
+    // Same script, on a device that runs at another rate than the mix
+    { "music_44100", 44100, 1000, sMusicEvents, ARRAY_COUNT(sMusicEvents) },
+};
+
+struct AudioRenderStats
+{
+    u32 blockCount;
+    f32 totalMillis;
+    f32 minMillis;
+    f32 maxMillis;
+    f32 busMillis[AudioBus_COUNT];
+    u32 streamUnderrunCount;
+    u32 musicUnderrunCount;
+};
+
+static Engine gEngine;
+static Arena gGlobalArena;
+static Arena gDataArena;
+static AudioClipH gClips[SceneClip_COUNT];
+static Handle gMusic;
+
+#define ADPCM_CLIP_NAME "golden_audio_bell_adpcm.bin"
+
+// The engine starts from scratch for every scene, so no state leaks between them
+static bool ResetAudio()
+{
+    ResetArena(gGlobalArena);
+    ResetArena(gDataArena);
+    gEngine.audio = {};
+    sAudioCmdQueue.readPos = sAudioCmdQueue.writePos;
+
+    if ( !InitializeAudio(gEngine.audio, gGlobalArena) ) {
+        LOG(Error, "Could not initialize audio\n");
+        return false;
+    }
+
+    const AudioClipDesc bellDesc = { .name = "bell", .filename = "bell.wav" };
+    gClips[SceneClip_Bell] = CreateAudioClip(gEngine, bellDesc);
+    if ( gClips[SceneClip_Bell] == InvalidHandle ) {
+        return false;
+    }
+
+    // The same bell, stored as the assets built by BuildAssets
+    {
+        AudioClip bell = {};
+        void *samples = nullptr;
+        if ( !LoadAudioClipFromWAVFile("bell.wav", gDataArena, bell, &samples) ) {
+            return false;
+        }
+
+        const u32 frameCount = bell.sampleCount / 2;
+        const u32 size = AdpcmEncodedSize(frameCount);
+        byte *blocks = PushArray(gDataArena, byte, size);
+        EncodeAdpcm((const i16*)samples, frameCount, blocks);
+
+        const FilePath adpcmPath = MakePath(gTestBinDir.str, ADPCM_CLIP_NAME);
+        FILE *file = fopen(adpcmPath.str, "wb");
+        if ( !file ) {
+            LOG(Error, "Could not write %s\n", adpcmPath.str);
+            return false;
+        }
+        fwrite(blocks, size, 1, file);
+        fclose(file);
+        SetAudioAssetsFilepath(gEngine.audio, adpcmPath.str);
+
+        static BinAudioClipDesc adpcmDesc = {};
+        adpcmDesc = {
+            .sampleCount = bell.sampleCount,
+            .samplingRate = bell.samplingRate,
+            .sampleSize = 2,
+            .channelCount = 2,
+            .format = AudioClipFormat_ADPCM,
+            .location = { .offset = 0, .size = size },
+        };
+        const BinAudioClip binClip = { .desc = &adpcmDesc };
+        gClips[SceneClip_BellAdpcm] = CreateAudioClip(gEngine, binClip);
+    }
+
+    const MusicFileDesc musicDesc = { .name = "aurora", .filename = "aurora.mod" };
+    gMusic = CreateMusicFile(gEngine, musicDesc);
+
+    return true;
+}
+
+static void PushRenderEvent(const AudioRenderEvent &event, AudioVoiceH *voices)
+{
+    AudioCmd cmd = event.cmd;
+    switch ( cmd.type )
+    {
+        case AudioCmd_VoiceStart:
+            voices[event.voiceIndex] = PlayAudioClip(gEngine, gClips[event.clip]);
+            break;
+        case AudioCmd_MusicPlay:
+            MusicPlay(gEngine, gMusic);
+            break;
+        case AudioCmd_VoicePlay:
+        case AudioCmd_VoicePause:
+        case AudioCmd_VoiceStop:
+        case AudioCmd_VoiceGainPan:
+        case AudioCmd_VoicePitch:
+            cmd.voice = voices[event.voiceIndex];
+            AudioCmdQueue_Push(cmd);
+            break;
+        default:
+            AudioCmdQueue_Push(cmd);
+            break;
+    }
+}
+
+// Renders the scene into the samples, which must fit all its frames
+static u32 RenderScene(const AudioRenderScene &scene, i16 *samples, AudioRenderStats &stats)
+{
+    stats = {};
+    stats.minMillis = 1000.0f;
+
+    if ( !ResetAudio() ) {
+        return 0;
+    }
+
+    Audio &audio = gEngine.audio;
+    AudioVoiceH voices[MAX_SCENE_VOICES] = {};
+
+    const u32 blockFrameCount = scene.sampleRate * RENDER_BLOCK_MILLIS / 1000;
+    const u32 blockCount = scene.millis / RENDER_BLOCK_MILLIS;
+    u32 eventIndex = 0;
+
+    for (u32 block = 0; block < blockCount; ++block)
+    {
+        // Update thread: script, voice reclaiming and streaming
+        const u32 millis = block * RENDER_BLOCK_MILLIS;
+        while ( eventIndex < scene.eventCount && scene.events[eventIndex].millis <= millis ) {
+            PushRenderEvent(scene.events[eventIndex++], voices);
+        }
+        UpdateAudio(gEngine);
+
+        // Music producer: refilled completely, instead of within its time budget
+        do {
+            PreRenderAudio(gEngine);
+        } while ( audio.musicRefilling );
+
+        // Audio thread
+        SoundBuffer soundBuffer = {
+            .samplesPerSecond = scene.sampleRate,
+            .sampleCount = (u16)blockFrameCount,
+            .samples = samples + block * blockFrameCount * 2,
+        };
+
+        const Clock begin = GetClock();
+        RenderAudio(gEngine, soundBuffer);
+        const f32 renderMillis = 1000.0f * GetSecondsElapsed(begin, GetClock());
+
+        stats.blockCount++;
+        stats.totalMillis += renderMillis;
+        stats.minMillis = Min(stats.minMillis, renderMillis);
+        stats.maxMillis = Max(stats.maxMillis, renderMillis);
+        for (u32 i = 0; i < AudioBus_COUNT; ++i) {
+            stats.busMillis[i] += audio.buses[i].millis;
+        }
+    }
+
+    stats.streamUnderrunCount = audio.streamer.underrunCount;
+    stats.musicUnderrunCount = audio.musicUnderrunCount;
+
+    for (u32 i = 0; i < SceneClip_COUNT; ++i) {
+        RemoveAudioClip(gEngine, gClips[i]);
+    }
+    DestroyMusicFile(gEngine, gMusic);
+
+    return blockCount * blockFrameCount;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Tests
+
+static i16 gSamples[AUDIO_SAMPLE_RATE * MAX_RENDER_SECONDS * 2];
+static i16 gSecondSamples[AUDIO_SAMPLE_RATE * MAX_RENDER_SECONDS * 2];
+
+void TestScene(const AudioRenderScene &scene, bool updateGolden)
+{
+    char title[64];
+    SPrintf(title, "%s (%u ms at %u Hz)", scene.name, scene.millis, scene.sampleRate);
+    TEST_SECTION(title);
+
+    ASSERT(scene.millis <= MAX_RENDER_SECONDS * 1000);
+
+    AudioRenderStats stats;
+    const u32 frameCount = RenderScene(scene, gSamples, stats);
+    if ( frameCount == 0 ) {
+        TEST("Scene rendered", false);
+        return;
+    }
+
+    const u32 blockFrameCount = scene.sampleRate * RENDER_BLOCK_MILLIS / 1000;
+    const f32 averageMillis = stats.totalMillis / stats.blockCount;
+    LOG(Info, "RenderAudio per %u-frame block: %.1f us average, %.1f us min, %.1f us max (%.0fx real time)\n",
+            blockFrameCount, 1000.0f * averageMillis, 1000.0f * stats.minMillis, 1000.0f * stats.maxMillis,
+            scene.millis / stats.totalMillis);
+    LOG(Info, "Buses per block: music %.1f us, sfx %.1f us, reverb %.1f us, master %.1f us\n",
+            1000.0f * stats.busMillis[AudioBus_Music] / stats.blockCount,
+            1000.0f * stats.busMillis[AudioBus_Sfx] / stats.blockCount,
+            1000.0f * stats.busMillis[AudioBus_Reverb] / stats.blockCount,
+            1000.0f * stats.busMillis[AudioBus_Master] / stats.blockCount);
+
+    char filename[64];
+    SPrintf(filename, "audio_render_%s.wav", scene.name);
+    const FilePath renderPath = MakePath(gTestBinDir.str, filename);
+    const FilePath goldenPath = MakePath(gGoldenDir.str, filename);
+    WriteWavFile(renderPath.str, gSamples, frameCount, scene.sampleRate);
+
+    // Another render of the same script has to match bit by bit
+    AudioRenderStats secondStats;
+    const u32 secondFrameCount = RenderScene(scene, gSecondSamples, secondStats);
+    const bool deterministic = secondFrameCount == frameCount &&
+        MemCompare(gSamples, gSecondSamples, frameCount * 2 * sizeof(i16)) == 0;
+
+    u32 nonSilentCount = 0;
+    for (u32 i = 0; i < frameCount * 2; ++i) {
+        nonSilentCount += gSamples[i] != 0;
+    }
+
+    TEST("Scene is not silent", nonSilentCount > frameCount / 2);
+    TEST("Render is deterministic", deterministic);
+    TEST("No stream or music underruns", stats.streamUnderrunCount == 0 && stats.musicUnderrunCount == 0);
+
+    if ( updateGolden )
+    {
+        const bool written = WriteWavFile(goldenPath.str, gSamples, frameCount, scene.sampleRate);
+        LOG(Info, "Golden file %s %s\n", goldenPath.str, written ? "updated" : "could not be written");
+        TEST("Golden file updated", written);
+        return;
+    }
+
+    // Golden file comparison
+    Arena &arena = gDataArena;
+    ResetArena(arena);
+    AudioClip golden = {};
+    void *goldenSamples = nullptr;
+    const bool loaded = LoadAudioClipFromWAVFile(goldenPath.str, arena, golden, &goldenSamples);
+    if ( !loaded ) {
+        LOG(Error, "Missing golden file %s, run with --update-golden to create it\n", goldenPath.str);
+        TEST("Golden file exists", false);
+        return;
+    }
+
+    const bool sameFormat = golden.samplingRate == scene.sampleRate && golden.channelCount == 2 &&
+        golden.sampleCount == frameCount * 2;
+
+    u32 maxDiff = 0;
+    u32 firstDiffFrame = U32_MAX;
+    f64 errorPower = 0.0;
+    f64 signalPower = 0.0;
+    if ( sameFormat )
+    {
+        const i16 *expected = (const i16 *)goldenSamples;
+        for (u32 i = 0; i < frameCount * 2; ++i)
+        {
+            const i32 diff = (i32)gSamples[i] - (i32)expected[i];
+            const u32 absDiff = diff < 0 ? -diff : diff;
+            if ( absDiff > 0 && firstDiffFrame == U32_MAX ) {
+                firstDiffFrame = i / 2;
+            }
+            maxDiff = Max(maxDiff, absDiff);
+            errorPower += (f64)diff * diff;
+            signalPower += (f64)expected[i] * expected[i];
+        }
+    }
+
+    if ( firstDiffFrame != U32_MAX ) {
+        LOG(Info, "Differs from frame %u (%.1f ms), max %u LSB, SNR %.1f dB\n",
+                firstDiffFrame, 1000.0f * firstDiffFrame / scene.sampleRate, maxDiff,
+                10.0 * log10((signalPower + 1e-9) / (errorPower + 1e-9)));
+    }
+
+    TEST("Golden file has the same format and length", sameFormat);
+    TEST("Output matches the golden file", sameFormat && maxDiff <= GOLDEN_TOLERANCE);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Main
+
+int main(int argc, char **argv)
+{
+    PrintTestTitle("Audio render golden test");
+
+    bool updateGolden = false;
+    for (i32 i = 1; i < argc; ++i) {
+        if ( StrEq(argv[i], "--update-golden") ) {
+            updateGolden = true;
+        }
+    }
+
+    InitializeTestPaths(argc > 0 ? argv[0] : "");
+    gGoldenDir = MakePath(gTestProjectDir.str, "code/tests/golden");
+    static const FilePath assetDir = MakePath(gTestProjectDir.str, "assets");
+
+    gGlobalArena = MakeArena((byte*)AllocateVirtualMemory(MB(32)), MB(32), "Global");
+    gDataArena = MakeArena((byte*)AllocateVirtualMemory(MB(4)), MB(4), "Data");
+
+    static Plat platform = {};
+    InitializeTestPlatform(platform, gGlobalArena, gDataArena, StubPushWork, assetDir.str);
+
+    for (u32 i = 0; i < ARRAY_COUNT(sScenes); ++i) {
+        TestScene(sScenes[i], updateGolden);
+    }
+
+    return PrintTestResults();
+}
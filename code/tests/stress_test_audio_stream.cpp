@@ -0,0 +1,719 @@
+/*
+ * stress_test_audio_stream.cpp
+ * Stress test for the audio chunk streamer in code/audio.cpp
+ *
+ * An audio thread renders in real time while the main thread plays as the update
+ * thread, and a worker thread runs the streaming jobs with a deliberately slowed
+ * file reader. The audio thread must never read from disk, and it must only
+ * report underruns when the reader cannot keep up.
+ *
+ * The voice pool is also checked: virtual voices, stealing when the pool is full,
+ * and the cost of 512 requested voices with 64 real ones. ADPCM clips are checked
+ * against their decoded samples, also when a voice starts in the middle of a chunk.
+ */
+
+#include "../engine.cpp"
+
+#include "test_engine.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Platform stubs
+
+// Single worker thread running the jobs pushed from the main thread
+struct StubWorkQueue
+{
+    WorkQueueCallback *callbacks[64];
+    void *data[64];
+    volatile_u32 head;
+    volatile_u32 tail;
+    Semaphore semaphore;
+};
+
+static StubWorkQueue gWorkQueue;
+static volatile_u32 gRunning = 1;
+
+static void StubPushWork(WorkQueueCallback *callback, void *data)
+{
+    ASSERT(gWorkQueue.head - gWorkQueue.tail < ARRAY_COUNT(gWorkQueue.callbacks));
+    const u32 index = gWorkQueue.head % ARRAY_COUNT(gWorkQueue.callbacks);
+    gWorkQueue.callbacks[index] = callback;
+    gWorkQueue.data[index] = data;
+    FullWriteBarrier();
+    gWorkQueue.head = gWorkQueue.head + 1;
+    SignalSemaphore(gWorkQueue.semaphore);
+}
+
+static THREAD_FUNCTION(WorkerThread)
+{
+    const ThreadInfo &threadInfo = *(const ThreadInfo *)arguments;
+    while ( gRunning )
+    {
+        WaitSemaphore(gWorkQueue.semaphore);
+        while ( gWorkQueue.tail != gWorkQueue.head )
+        {
+            FullReadBarrier();
+            const u32 index = gWorkQueue.tail % ARRAY_COUNT(gWorkQueue.callbacks);
+            gWorkQueue.callbacks[index](threadInfo, gWorkQueue.data[index]);
+            gWorkQueue.tail = gWorkQueue.tail + 1;
+        }
+    }
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Slowed file reader
+
+static volatile_u32 gReadDelayMillis = 0;
+static volatile_u32 gReadCount = 0;
+static volatile_u32 gReadBytes = 0;
+static volatile_u32 gAudioThreadReadCount = 0;
+static thread_local bool tIsAudioThread = false;
+
+static bool SlowStreamRead(File &file, u64 offset, void *samples, u32 size)
+{
+    if ( tIsAudioThread ) {
+        gAudioThreadReadCount = gAudioThreadReadCount + 1;
+    }
+    gReadCount = gReadCount + 1;
+    gReadBytes = gReadBytes + size;
+    SleepMillis(gReadDelayMillis);
+    const bool ok = AudioStreamRead(file, offset, samples, size);
+    return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Audio thread
+
+#define AUDIO_FRAMES_PER_CALLBACK 480 // 10 ms at 48 kHz
+#define MAX_AUDIO_FRAMES_PER_CALLBACK 960 // 10 ms at 96 kHz
+#define CAPTURE_SAMPLE_COUNT (48000 * 2 * 8)
+
+static Engine gEngine;
+static volatile_u32 gAudioThreadFinished = 0;
+static i16 gCapture[CAPTURE_SAMPLE_COUNT];
+static volatile_u32 gCaptureSampleCount = 0;
+static volatile_u32 gCaptureEnabled = 0;
+static f32 gMaxRenderMillis = 0.0f;
+static f32 gTotalRenderMillis = 0.0f;
+static u32 gRenderCount = 0;
+static u32 gMaxRealVoiceCount = 0;
+static u32 gMaxVirtualVoiceCount = 0;
+static volatile_u32 gDeviceRate = 48000;
+
+static THREAD_FUNCTION(AudioThread)
+{
+    tIsAudioThread = true;
+
+    static i16 samples[MAX_AUDIO_FRAMES_PER_CALLBACK * 2];
+    SoundBuffer soundBuffer = {
+        .samplesPerSecond = 48000,
+        .sampleCount = AUDIO_FRAMES_PER_CALLBACK,
+        .samples = samples,
+    };
+
+    Clock nextClock = GetClock();
+    while ( gRunning )
+    {
+        // 10 ms of frames at the current device rate
+        soundBuffer.samplesPerSecond = gDeviceRate;
+        soundBuffer.sampleCount = (u16)( gDeviceRate / 100 );
+
+        const Clock begin = GetClock();
+        RenderAudio(gEngine, soundBuffer);
+        const f32 renderMillis = 1000.0f * GetSecondsElapsed(begin, GetClock());
+        gMaxRenderMillis = Max(gMaxRenderMillis, renderMillis);
+        gTotalRenderMillis += renderMillis;
+        gRenderCount++;
+        gMaxRealVoiceCount = Max(gMaxRealVoiceCount, (u32)gEngine.audio.realVoiceCount);
+        gMaxVirtualVoiceCount = Max(gMaxVirtualVoiceCount, (u32)gEngine.audio.virtualVoiceCount);
+
+        const u32 sampleCount = soundBuffer.sampleCount * 2;
+        if ( gCaptureEnabled && gCaptureSampleCount + sampleCount <= CAPTURE_SAMPLE_COUNT )
+        {
+            MemCopy(gCapture + gCaptureSampleCount, samples, sampleCount * sizeof(i16));
+            gCaptureSampleCount = gCaptureSampleCount + sampleCount;
+        }
+
+        // Real-time pace: one callback every 10 ms
+        nextClock.ticks += 10 * GetTicksPerSecond() / 1000;
+        while ( GetClock().ticks < nextClock.ticks ) {
+            SleepMillis(1);
+        }
+    }
+
+    gAudioThreadFinished = 1;
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Test clips
+
+#define CLIP_COUNT 16
+
+static i16 ClipSample(u32 clipIndex, u32 sampleIndex)
+{
+    const i16 sample = (i16)((sampleIndex * 7 + clipIndex * 131) % 2000) - 1000;
+    return sample;
+}
+
+static u32 ClipSampleCount(u32 clipIndex)
+{
+    // Between 1 and 2 seconds of stereo audio, not a multiple of the chunk size
+    const u32 sampleCount = 48000 * 2 + (clipIndex * 6007 * 2) % (48000 * 2);
+    return sampleCount;
+}
+
+static bool WriteClip(const char *path, u32 clipIndex)
+{
+    FILE *file = fopen(path, "wb");
+    if ( !file ) {
+        return false;
+    }
+
+    const u32 sampleCount = ClipSampleCount(clipIndex);
+    const u32 dataSize = sampleCount * sizeof(i16);
+
+    const WAVE_header header = { RIFF_RIFF, 4 + 8 + 16 + 8 + dataSize, RIFF_WAVE };
+    const WAVE_chunk fmtChunk = { RIFF_fmt, 16 };
+    const u16 fmt[8] = { 1, 2, 48000 & 0xffff, 48000 >> 16, (48000 * 4) & 0xffff, (48000 * 4) >> 16, 4, 16 };
+    const WAVE_chunk dataChunk = { RIFF_data, dataSize };
+
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(&fmtChunk, sizeof(fmtChunk), 1, file);
+    fwrite(fmt, sizeof(fmt), 1, file);
+    fwrite(&dataChunk, sizeof(dataChunk), 1, file);
+    for (u32 i = 0; i < sampleCount; ++i) {
+        const i16 sample = ClipSample(clipIndex, i);
+        fwrite(&sample, sizeof(sample), 1, file);
+    }
+
+    fclose(file);
+    return true;
+}
+
+static AudioClipH gClips[CLIP_COUNT];
+static char gClipNames[CLIP_COUNT][32];
+
+// ADPCM clip, stored like the clips of the assets file
+#define ADPCM_CLIP_INDEX 5
+#define ADPCM_CLIP_NAME "stress_audio_adpcm.bin"
+
+static AudioClipH gAdpcmClip;
+static i16 *gAdpcmSamples; // Decoded
+static u32 gAdpcmSize;
+
+static bool WriteAdpcmClip(Arena &arena, const char *path)
+{
+    FILE *file = fopen(path, "wb");
+    if ( !file ) {
+        return false;
+    }
+
+    const u32 sampleCount = ClipSampleCount(ADPCM_CLIP_INDEX);
+    i16 *samples = PushArray(arena, i16, sampleCount);
+    for (u32 i = 0; i < sampleCount; ++i) {
+        samples[i] = ClipSample(ADPCM_CLIP_INDEX, i);
+    }
+
+    gAdpcmSize = AdpcmEncodedSize(sampleCount / 2);
+    byte *blocks = PushArray(arena, byte, gAdpcmSize);
+    EncodeAdpcm(samples, sampleCount / 2, blocks);
+    fwrite(blocks, gAdpcmSize, 1, file);
+    fclose(file);
+
+    gAdpcmSamples = PushArray(arena, i16, sampleCount);
+    DecodeAdpcm(blocks, sampleCount / 2, gAdpcmSamples);
+    return true;
+}
+
+static AudioVoiceH gVoices[MAX_AUDIO_VOICES];
+static u32 gVoiceCount = 0;
+
+static bool AllVoicesIdle()
+{
+    for (u32 i = 0; i < gVoiceCount; ++i) {
+        if ( IsActiveAudioVoice(gEngine, gVoices[i]) ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Plays the voices from the update (main) thread, kicking the streamer every 16 ms
+static void WaitVoices()
+{
+    while ( !AllVoicesIdle() )
+    {
+        UpdateAudio(gEngine);
+        SleepMillis(16);
+    }
+
+    WaitAudioStreaming(gEngine.audio);
+}
+
+// Plays the voices as WaitVoices does until one of them reaches the given sample of its clip
+static void WaitVoicePosition(u32 voiceIndex, u32 sampleIndex)
+{
+    const AudioVoice &voice = gEngine.audio.voices[gVoices[voiceIndex].idx];
+    while ( !( voice.handle == gVoices[voiceIndex] ) || voice.lastWriteSampleIndex < sampleIndex )
+    {
+        UpdateAudio(gEngine);
+        SleepMillis(16);
+    }
+}
+
+static void StartVoices(u32 voiceCount)
+{
+    gVoiceCount = 0;
+    for (u32 i = 0; i < voiceCount; ++i) {
+        gVoices[gVoiceCount++] = PlayAudioClip(gEngine, gClips[i % CLIP_COUNT]);
+    }
+}
+
+static f32 PlayClips(u32 clipCount)
+{
+    const Clock begin = GetClock();
+
+    StartVoices(clipCount);
+    WaitVoices();
+
+    const f32 seconds = GetSecondsElapsed(begin, GetClock());
+    return seconds;
+}
+
+static void ResetStats()
+{
+    AudioStreamer &streamer = gEngine.audio.streamer;
+    streamer.underrunCount = 0;
+    streamer.loadedChunkCount = 0;
+    gReadCount = 0;
+    gReadBytes = 0;
+    gAudioThreadReadCount = 0;
+    gMaxRenderMillis = 0.0f;
+    gTotalRenderMillis = 0.0f;
+    gRenderCount = 0;
+    gMaxRealVoiceCount = 0;
+    gMaxVirtualVoiceCount = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Tests
+
+void TestSingleSourceContent()
+{
+    TEST_SECTION("Single source content (20 ms per chunk read)");
+
+    ResetStats();
+    gReadDelayMillis = 20;
+    gCaptureSampleCount = 0;
+    gCaptureEnabled = 1;
+
+    PlayClips(1);
+
+    // The limiter look-ahead delays the output, keep capturing a few more callbacks
+    SleepMillis(50);
+
+    gCaptureEnabled = 0;
+
+    // Skip the silence before the first chunk arrives
+    u32 first = 0;
+    while ( first < gCaptureSampleCount && gCapture[first] == 0 ) {
+        first++;
+    }
+
+    const u32 sampleCount = ClipSampleCount(0);
+    bool matches = first + sampleCount <= gCaptureSampleCount;
+    for (u32 i = 0; matches && i < sampleCount; ++i) {
+        matches = gCapture[first + i] == ClipSample(0, i);
+    }
+
+    const AudioStreamer &streamer = gEngine.audio.streamer;
+    LOG(Info, "Start latency %.1f ms, %u chunks streamed, %u underruns\n",
+            1000.0f * first / (2 * 48000), streamer.loadedChunkCount, streamer.underrunCount);
+
+    TEST("Output matches the clip samples", matches);
+    TEST("No underruns", streamer.underrunCount == 0);
+    TEST("All chunks streamed", streamer.loadedChunkCount == (sampleCount - 1) / AUDIO_CHUNK_SAMPLE_COUNT + 1);
+    TEST("Audio thread never read from disk", gAudioThreadReadCount == 0);
+}
+
+void TestSixteenSources(u32 readDelayMillis, bool expectUnderruns)
+{
+    char title[64];
+    SPrintf(title, "%u sources (%u ms per chunk read)", CLIP_COUNT, readDelayMillis);
+    TEST_SECTION(title);
+
+    ResetStats();
+    gReadDelayMillis = readDelayMillis;
+
+    const f32 seconds = PlayClips(CLIP_COUNT);
+
+    u32 chunkCount = 0;
+    for (u32 i = 0; i < CLIP_COUNT; ++i) {
+        chunkCount += (ClipSampleCount(i) - 1) / AUDIO_CHUNK_SAMPLE_COUNT + 1;
+    }
+
+    const AudioStreamer &streamer = gEngine.audio.streamer;
+    LOG(Info, "Played in %.2f s, %u chunks streamed (%u reads), %u underruns, max RenderAudio %.3f ms\n",
+            seconds, streamer.loadedChunkCount, gReadCount, streamer.underrunCount, gMaxRenderMillis);
+
+    if ( expectUnderruns ) {
+        TEST("Underruns reported when the reader is too slow", streamer.underrunCount > 0);
+    } else {
+        TEST("No underruns", streamer.underrunCount == 0);
+    }
+    TEST("All chunks streamed once", streamer.loadedChunkCount == chunkCount);
+    TEST("Audio thread never read from disk", gAudioThreadReadCount == 0);
+    TEST("RenderAudio never blocked on the reader", gMaxRenderMillis < (f32)readDelayMillis);
+}
+
+void TestVirtualVoice()
+{
+    TEST_SECTION("Inaudible voice");
+
+    ResetStats();
+    gReadDelayMillis = 0;
+
+    // The gain arrives with the start, so the voice is virtual from the first callback
+    const Clock begin = GetClock();
+    StartVoices(1);
+    SetAudioVoiceGainPan(gEngine, gVoices[0], 0.0f, 0.0f);
+    WaitVoices();
+    const f32 seconds = GetSecondsElapsed(begin, GetClock());
+
+    const f32 clipSeconds = ClipSampleCount(0) / (2.0f * 48000.0f);
+    LOG(Info, "Virtual voice played in %.2f s (clip length %.2f s)\n", seconds, clipSeconds);
+
+    TEST("Voice never streamed", gEngine.audio.streamer.loadedChunkCount == 0);
+    TEST("Voice kept its position", seconds > clipSeconds - 0.05f && seconds < clipSeconds + 0.2f);
+}
+
+void TestPitchedVoice(f32 pitch, u32 deviceRate)
+{
+    char title[64];
+    SPrintf(title, "Pitch %.2f, device at %u Hz", pitch, deviceRate);
+    TEST_SECTION(title);
+
+    ResetStats();
+    gReadDelayMillis = 0;
+    gDeviceRate = deviceRate;
+
+    // The pitch arrives with the start, so the voice is resampled from the first callback
+    const Clock begin = GetClock();
+    StartVoices(1);
+    SetAudioVoicePitch(gEngine, gVoices[0], pitch);
+    WaitVoices();
+    const f32 seconds = GetSecondsElapsed(begin, GetClock());
+
+    const f32 expectedSeconds = ClipSampleCount(0) / (2.0f * 48000.0f * pitch);
+    LOG(Info, "Played in %.2f s (expected %.2f s), RenderAudio %.3f ms max\n", seconds, expectedSeconds, gMaxRenderMillis);
+
+    TEST("Play time follows the pitch", seconds > expectedSeconds - 0.05f && seconds < expectedSeconds + 0.2f);
+    TEST("No underruns", gEngine.audio.streamer.underrunCount == 0);
+
+    gDeviceRate = 48000;
+}
+
+void TestPitchChangeMidPlay()
+{
+    TEST_SECTION("Pitch change mid-play");
+
+    ResetStats();
+    gReadDelayMillis = 0;
+
+    SleepMillis(50);
+    gCaptureSampleCount = 0;
+    gCaptureEnabled = 1;
+
+    // Barely off the mix rate and back, half a second and three quarters into the clip: the
+    // voice moves to the resampler and stays on it, so the output must keep following
+    // the clip without skipping or repeating frames
+    StartVoices(1);
+    WaitVoicePosition(0, 48000);
+    SetAudioVoicePitch(gEngine, gVoices[0], 1.000001f);
+    WaitVoicePosition(0, 72000);
+    SetAudioVoicePitch(gEngine, gVoices[0], 1.0f);
+    WaitVoices();
+
+    SleepMillis(50);
+    gCaptureEnabled = 0;
+
+    // Skip the silence, and the quiet tail of the previous test, up to the first sample of -1000
+    u32 first = 0;
+    while ( first < gCaptureSampleCount && gCapture[first] > -500 ) {
+        first++;
+    }
+
+    // The filter rings around the wraps of the test signal, elsewhere it follows the ramp.
+    // A jump of a few frames would offset every sample by a multiple of 14.
+    const u32 sampleCount = ClipSampleCount(0);
+    u32 closeCount = 0;
+    for (u32 i = 0; first + i < gCaptureSampleCount && i < sampleCount; ++i) {
+        const i32 difference = (i32)gCapture[first + i] - (i32)ClipSample(0, i);
+        closeCount += difference > -8 && difference < 8 ? 1 : 0;
+    }
+    const f32 closeRatio = (f32)closeCount / sampleCount;
+    LOG(Info, "%.1f%% of the samples within 8 of the clip\n", 100.0f * closeRatio);
+
+    TEST("Output keeps following the clip", closeRatio > 0.9f);
+    TEST("No underruns", gEngine.audio.streamer.underrunCount == 0);
+}
+
+void TestMusicRingWrap()
+{
+    TEST_SECTION("Music ring wraparound");
+
+    ResetStats();
+    gEngine.audio.musicUnderrunCount = 0;
+
+    // Act as the producer: half a second of samples across the end of the ring,
+    // published before the music starts so the consumer never waits for them
+    AudioMusicRing &ring = gEngine.audio.musicRing;
+    const u32 sampleCount = 48000;
+    const u32 firstIndex = ring.sampleCount - sampleCount / 3;
+    ring.readIndex = firstIndex;
+    ring.writeIndex = firstIndex;
+    for (u32 i = 0; i < sampleCount; ++i) {
+        ring.samples[( firstIndex + i ) & ring.mask] = ClipSample(1, i);
+    }
+    FullWriteBarrier();
+    ring.writeIndex = firstIndex + sampleCount;
+
+    // Let the output of the previous test leave the limiter
+    SleepMillis(50);
+    gCaptureSampleCount = 0;
+    gCaptureEnabled = 1;
+
+    AudioCmd play = { .type = AudioCmd_MusicPlay };
+    AudioCmdQueue_Push(play);
+    while ( ring.readIndex != ring.writeIndex ) {
+        SleepMillis(10);
+    }
+
+    // The limiter look-ahead delays the output, keep capturing a few more callbacks
+    SleepMillis(50);
+    gCaptureEnabled = 0;
+
+    u32 first = 0;
+    while ( first < gCaptureSampleCount && gCapture[first] == 0 ) {
+        first++;
+    }
+
+    bool matches = first + sampleCount <= gCaptureSampleCount;
+    for (u32 i = 0; matches && i < sampleCount; ++i) {
+        matches = gCapture[first + i] == ClipSample(1, i);
+    }
+
+    LOG(Info, "Read index %u, music underruns %u\n", ring.readIndex & ring.mask, gEngine.audio.musicUnderrunCount);
+    TEST("Output matches the samples across the wrap", matches);
+    TEST("Starved consumer reports underruns", gEngine.audio.musicUnderrunCount > 0);
+
+    AudioCmd stop = { .type = AudioCmd_MusicStop };
+    AudioCmdQueue_Push(stop);
+}
+
+// Returns the position of the captured samples within the decoded ADPCM clip, or U32_MAX
+static u32 FindAdpcmCapture(u32 &first)
+{
+    first = 0;
+    while ( first < gCaptureSampleCount && gCapture[first] == 0 ) {
+        first++;
+    }
+
+    const u32 sampleCount = ClipSampleCount(ADPCM_CLIP_INDEX);
+    for (u32 position = 0; position < sampleCount; position += 2)
+    {
+        const u32 matchCount = sampleCount - position;
+        bool matches = first + matchCount <= gCaptureSampleCount;
+        for (u32 i = 0; matches && i < matchCount; ++i) {
+            matches = gCapture[first + i] == gAdpcmSamples[position + i];
+        }
+        if ( matches ) {
+            return position;
+        }
+    }
+    return U32_MAX;
+}
+
+void TestAdpcmClip(bool startVirtual)
+{
+    TEST_SECTION(startVirtual ? "ADPCM clip, starting mid-chunk" : "ADPCM clip");
+
+    ResetStats();
+    gReadDelayMillis = 0;
+
+    SleepMillis(50);
+    gCaptureSampleCount = 0;
+    gCaptureEnabled = 1;
+
+    // An inaudible voice does not stream, and becomes real where it is when turned up
+    gVoiceCount = 0;
+    gVoices[gVoiceCount++] = PlayAudioClip(gEngine, gAdpcmClip);
+    if ( startVirtual )
+    {
+        SetAudioVoiceGainPan(gEngine, gVoices[0], 0.0f, 0.0f);
+        SleepMillis(400);
+        SetAudioVoiceGainPan(gEngine, gVoices[0], 1.0f, 0.0f);
+    }
+    WaitVoices();
+
+    SleepMillis(50);
+    gCaptureEnabled = 0;
+
+    u32 first = 0;
+    const u32 position = FindAdpcmCapture(first);
+
+    // The streamer reads from the block of the voice position, up to the end of the clip
+    const u32 startSampleIndex = gEngine.audio.streamer.streams[0].startSampleIndex;
+    const u32 firstBlock = startSampleIndex / ( AUDIO_ADPCM_BLOCK_FRAMES * 2 );
+    const u32 expectedBytes = gAdpcmSize - firstBlock * AUDIO_ADPCM_BLOCK_SIZE;
+    LOG(Info, "Output from sample %u, stream started at sample %u (chunk %u, block %u), %u of %u bytes read\n",
+            position, startSampleIndex, startSampleIndex / AUDIO_CHUNK_SAMPLE_COUNT, firstBlock, gReadBytes, gAdpcmSize);
+
+    TEST("Output matches the decoded samples", position != U32_MAX && position >= startSampleIndex);
+    TEST("Only the blocks from the voice position are read", gReadBytes == expectedBytes);
+    if ( startVirtual ) {
+        TEST("Voice started within a chunk", startSampleIndex % AUDIO_CHUNK_SAMPLE_COUNT != 0);
+    }
+    TEST("No underruns", gEngine.audio.streamer.underrunCount == 0);
+}
+
+void TestVoiceStealing()
+{
+    TEST_SECTION("Voice stealing");
+
+    ResetStats();
+    gReadDelayMillis = 0;
+
+    // Clips last more than a second, so none ends while the pool is full
+    StartVoices(MAX_AUDIO_VOICES);
+    const u32 stolenCount = gEngine.audio.stolenVoiceCount;
+    const AudioVoiceH lowVoice = PlayAudioClip(gEngine, gClips[0], AUDIO_PRIORITY_DEFAULT - 1);
+    const AudioVoiceH highVoice = PlayAudioClip(gEngine, gClips[0], AUDIO_PRIORITY_DEFAULT + 1);
+    const AudioVoiceH stolenVoice = gVoices[0];
+    gVoices[0] = highVoice;
+
+    TEST("All requested voices got a handle", gVoiceCount == MAX_AUDIO_VOICES && gVoices[MAX_AUDIO_VOICES - 1] != InvalidHandle);
+    TEST("Lower priority voice is rejected when the pool is full", lowVoice == InvalidHandle);
+    TEST("Higher priority voice steals the oldest one", highVoice != InvalidHandle && gEngine.audio.stolenVoiceCount == stolenCount + 1);
+    TEST("Stolen handle is not active anymore", !IsActiveAudioVoice(gEngine, stolenVoice));
+
+    WaitVoices();
+}
+
+void TestVoiceBudget(u32 voiceCount, u32 realVoiceLimit, f32 *averageRenderMillis)
+{
+    char title[64];
+    SPrintf(title, "%u voices, %u real", voiceCount, realVoiceLimit);
+    TEST_SECTION(title);
+
+    ResetStats();
+    gReadDelayMillis = 0;
+    SetAudioRealVoiceLimit(gEngine, realVoiceLimit);
+
+    const f32 seconds = PlayClips(voiceCount);
+
+    *averageRenderMillis = gTotalRenderMillis / Max(gRenderCount, 1u);
+    LOG(Info, "Played in %.2f s, max %u real and %u virtual voices, RenderAudio %.3f ms average, %.3f ms max\n",
+            seconds, gMaxRealVoiceCount, gMaxVirtualVoiceCount, *averageRenderMillis, gMaxRenderMillis);
+
+    TEST("Real voices within the limit", gMaxRealVoiceCount == Min(voiceCount, realVoiceLimit));
+    TEST("Other voices virtual", gMaxVirtualVoiceCount == voiceCount - gMaxRealVoiceCount);
+    TEST("No underruns", gEngine.audio.streamer.underrunCount == 0);
+
+    SetAudioRealVoiceLimit(gEngine, AUDIO_DEFAULT_REAL_VOICES);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Main
+
+int main(int argc, char **argv)
+{
+    PrintTestTitle("Audio streaming stress test");
+
+    InitializeTestPaths(argc > 0 ? argv[0] : "");
+
+    Arena globalArena = MakeArena((byte*)AllocateVirtualMemory(MB(32)), MB(32), "Global");
+    Arena dataArena = MakeArena((byte*)AllocateVirtualMemory(MB(1)), MB(1), "Data");
+
+    // The generated clips are written next to the executable
+    static Plat platform = {};
+    InitializeTestPlatform(platform, globalArena, dataArena, StubPushWork, gTestBinDir.str);
+
+    if ( !InitializeAudio(gEngine.audio, globalArena) ) {
+        LOG(Error, "Could not initialize audio\n");
+        return 1;
+    }
+    gEngine.audio.streamer.read = SlowStreamRead;
+
+    for (u32 i = 0; i < CLIP_COUNT; ++i)
+    {
+        SPrintf(gClipNames[i], "stress_audio_%u.wav", i);
+        const FilePath path = MakePath(AssetDir, gClipNames[i]);
+        if ( !WriteClip(path.str, i) ) {
+            LOG(Error, "Could not write %s\n", path.str);
+            return 1;
+        }
+        const AudioClipDesc desc = { .name = gClipNames[i], .filename = gClipNames[i] };
+        gClips[i] = CreateAudioClip(gEngine, desc);
+    }
+
+    {
+        const FilePath adpcmPath = MakePath(AssetDir, ADPCM_CLIP_NAME);
+        if ( !WriteAdpcmClip(dataArena, adpcmPath.str) ) {
+            LOG(Error, "Could not write %s\n", adpcmPath.str);
+            return 1;
+        }
+        SetAudioAssetsFilepath(gEngine.audio, adpcmPath.str);
+        static BinAudioClipDesc adpcmDesc = {
+            .sampleCount = ClipSampleCount(ADPCM_CLIP_INDEX),
+            .samplingRate = 48000,
+            .sampleSize = 2,
+            .channelCount = 2,
+            .format = AudioClipFormat_ADPCM,
+            .location = { .offset = 0, .size = gAdpcmSize },
+        };
+        const BinAudioClip binClip = { .desc = &adpcmDesc };
+        gAdpcmClip = CreateAudioClip(gEngine, binClip);
+    }
+
+    CreateSemaphore(gWorkQueue.semaphore, 0, ARRAY_COUNT(gWorkQueue.callbacks));
+    static const ThreadInfo workerThreadInfo = { .globalIndex = 1 };
+    static const ThreadInfo audioThreadInfo = { .globalIndex = 2 };
+    CreateDetachedThread(WorkerThread, workerThreadInfo);
+    CreateDetachedThread(AudioThread, audioThreadInfo);
+
+    TestSingleSourceContent();
+    TestSixteenSources(3, false);
+    TestSixteenSources(15, true);
+    TestVirtualVoice();
+    TestPitchedVoice(2.0f, 48000);
+    TestPitchedVoice(0.75f, 44100);
+    TestPitchedVoice(1.0f, 96000);
+    TestPitchChangeMidPlay();
+    TestMusicRingWrap();
+    TestAdpcmClip(false);
+    TestAdpcmClip(true);
+    TestVoiceStealing();
+
+    // Benchmark: the mixing cost follows the real voices, not the requested ones
+    f32 realMillis = 0.0f;
+    f32 requestedMillis = 0.0f;
+    TestVoiceBudget(MAX_AUDIO_REAL_VOICES, MAX_AUDIO_REAL_VOICES, &realMillis);
+    TestVoiceBudget(MAX_AUDIO_VOICES, MAX_AUDIO_REAL_VOICES, &requestedMillis);
+    LOG(Info, "\nRenderAudio average: %.3f ms with %u voices, %.3f ms with %u voices (%u real)\n",
+            realMillis, MAX_AUDIO_REAL_VOICES, requestedMillis, MAX_AUDIO_VOICES, MAX_AUDIO_REAL_VOICES);
+
+    gRunning = 0;
+    SignalSemaphore(gWorkQueue.semaphore);
+    while ( !gAudioThreadFinished ) {
+        Yield();
+    }
+
+    for (u32 i = 0; i < CLIP_COUNT; ++i) {
+        RemoveAudioClip(gEngine, gClips[i]);
+    }
+    RemoveAudioClip(gEngine, gAdpcmClip);
+
+    return PrintTestResults();
+}
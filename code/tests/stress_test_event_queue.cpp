@@ -0,0 +1,331 @@
+/*
+ * stress_test_event_queue.cpp
+ * Stress test for the multi-producer queue (MpscQueue) in code/ilu_core.h
+ *
+ * Producer threads push 100k events, each tagged with its producer, a per-producer
+ * sequence number and GetTicks, while the main thread drains them as the update thread
+ * drains platform events. Every event must come out once, and the events of a producer
+ * in the order it pushed them.
+ *
+ * The queue is also checked growing from one page to hold all events without a consumer,
+ * reusing its pages when it is small and drained concurrently or while a producer stays
+ * inside a push, and being drained only up to a timestamp.
+ */
+
+#include "../ilu_core.h"
+
+// ANSI color codes
+#ifdef _WIN32
+#define ANSI_RESET   "\x1b[0m"
+#define ANSI_BOLD    "\x1b[1m"
+#define ANSI_RED     "\x1b[31m"
+#define ANSI_GREEN   "\x1b[32m"
+#else
+#define ANSI_RESET
+#define ANSI_BOLD
+#define ANSI_RED
+#define ANSI_GREEN
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Test framework
+
+static u32 gTestsPassed = 0;
+static u32 gTestsFailed = 0;
+
+#define TEST(name, expression) \
+    do { \
+        if (expression) { \
+            LOG(Info, ANSI_GREEN "[PASS]" ANSI_RESET " %s\n", name); \
+            gTestsPassed++; \
+        } else { \
+            LOG(Error, ANSI_RED "[FAIL]" ANSI_RESET " %s  (line %d)\n", name, __LINE__); \
+            gTestsFailed++; \
+        } \
+    } while(0)
+
+#define TEST_SECTION(name) LOG(Info, ANSI_BOLD "\n--- %s ---\n" ANSI_RESET, name)
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Producers
+
+#define MAX_PRODUCERS 8
+#define EVENT_COUNT 100000
+
+struct TestEvent
+{
+    u32 producer;
+    u32 sequence;
+    u64 ticks;
+};
+
+struct ProducerData
+{
+    MpscQueue *queue;
+    u32 eventsPerProducer;
+    volatile_u32 started;
+    volatile_u32 go;
+    volatile_u32 finished;
+    volatile_u32 failedPushes; // Pushes retried because the queue was at its maximum size
+};
+
+static ProducerData gData;
+
+static const ThreadInfo gThreadInfos[MAX_PRODUCERS] = {
+    { .globalIndex = 0 }, { .globalIndex = 1 }, { .globalIndex = 2 }, { .globalIndex = 3 },
+    { .globalIndex = 4 }, { .globalIndex = 5 }, { .globalIndex = 6 }, { .globalIndex = 7 },
+};
+
+static THREAD_FUNCTION(ProducerThread)
+{
+    const ThreadInfo *threadInfo = (const ThreadInfo *)arguments;
+
+    AtomicFetchAdd(&gData.started, 1);
+    while ( !AtomicLoadAcquire(&gData.go) ) {
+        Yield();
+    }
+
+    for (u32 i = 0; i < gData.eventsPerProducer; ++i)
+    {
+        const TestEvent event = {
+            .producer = threadInfo->globalIndex,
+            .sequence = i,
+            .ticks = GetTicks(),
+        };
+        while ( !MpscQueuePush(*gData.queue, &event) ) {
+            AtomicFetchAdd(&gData.failedPushes, 1);
+            Yield();
+        }
+    }
+
+    AtomicFetchAdd(&gData.finished, 1);
+    return 0;
+}
+
+struct DrainResult
+{
+    u32 count;
+    u32 outOfOrder; // Events not following the previous one of their producer
+    u32 ticksBackwards; // Events older than the previous one of their producer
+};
+
+static void CheckEvent(const TestEvent &event, u32 *nextSequence, u64 *lastTicks, DrainResult &result)
+{
+    ASSERT( event.producer < MAX_PRODUCERS );
+    if ( event.sequence != nextSequence[event.producer] ) {
+        result.outOfOrder++;
+    }
+    if ( event.ticks < lastTicks[event.producer] ) {
+        result.ticksBackwards++;
+    }
+    nextSequence[event.producer] = event.sequence + 1;
+    lastTicks[event.producer] = event.ticks;
+    result.count++;
+}
+
+// Runs producerCount threads pushing EVENT_COUNT events in total and drains the queue
+// from this thread until all of them finished and the queue is empty
+static DrainResult RunProducers(MpscQueue &queue, u32 producerCount, f32 *seconds)
+{
+    gData = {};
+    gData.queue = &queue;
+    gData.eventsPerProducer = EVENT_COUNT / producerCount;
+
+    for (u32 i = 0; i < producerCount; ++i) {
+        CreateDetachedThread(ProducerThread, gThreadInfos[i]);
+    }
+    while ( AtomicLoadAcquire(&gData.started) < producerCount ) {
+        Yield();
+    }
+
+    u32 nextSequence[MAX_PRODUCERS] = {};
+    u64 lastTicks[MAX_PRODUCERS] = {};
+    DrainResult result = {};
+
+    const Clock begin = GetClock();
+    AtomicStoreRelease(&gData.go, 1);
+
+    for (;;)
+    {
+        const bool finished = AtomicLoadAcquire(&gData.finished) == producerCount;
+
+        const TestEvent *event;
+        while ( (event = (const TestEvent *)MpscQueuePeek(queue)) ) {
+            CheckEvent(*event, nextSequence, lastTicks, result);
+            MpscQueuePop(queue);
+        }
+
+        if ( finished ) {
+            break;
+        }
+        Yield();
+    }
+
+    *seconds = GetSecondsElapsed(begin, GetClock());
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Tests
+
+void TestSingleThreadGrowth()
+{
+    TEST_SECTION("Growth without a consumer");
+
+    MpscQueue queue;
+    TEST("CreateMpscQueue", CreateMpscQueue(queue, sizeof(TestEvent), MB(8)));
+    TEST("Starts with one page", queue.pageCount == 1);
+    TEST("Empty queue peeks nothing", MpscQueuePeek(queue) == NULL);
+
+    bool allPushed = true;
+    for (u32 i = 0; i < EVENT_COUNT; ++i) {
+        const TestEvent event = { .producer = 0, .sequence = i, .ticks = i };
+        allPushed = MpscQueuePush(queue, &event) && allPushed;
+    }
+    TEST("100k events pushed without draining", allPushed);
+    TEST("Pages were chained for them", queue.pageCount * queue.slotsPerPage >= EVENT_COUNT);
+
+    u32 nextSequence[MAX_PRODUCERS] = {};
+    u64 lastTicks[MAX_PRODUCERS] = {};
+    DrainResult result = {};
+    const TestEvent *event;
+    while ( (event = (const TestEvent *)MpscQueuePeek(queue)) ) {
+        CheckEvent(*event, nextSequence, lastTicks, result);
+        MpscQueuePop(queue);
+    }
+    TEST("All events drained", result.count == EVENT_COUNT);
+    TEST("Events drained in push order", result.outOfOrder == 0);
+
+    // Drained pages are reused instead of committing new ones
+    const u32 pageCount = queue.pageCount;
+    for (u32 i = 0; i < EVENT_COUNT; ++i) {
+        const TestEvent pushed = { .producer = 1, .sequence = i };
+        MpscQueuePush(queue, &pushed);
+        MpscQueuePeek(queue);
+        MpscQueuePop(queue);
+    }
+    TEST("Drained pages are reused", queue.pageCount == pageCount);
+
+    const TestEvent overflow = {};
+    MpscQueue smallQueue;
+    CreateMpscQueue(smallQueue, sizeof(TestEvent), KB(8));
+    u32 pushedCount = 0;
+    while ( MpscQueuePush(smallQueue, &overflow) ) {
+        pushedCount++;
+    }
+    TEST("Push fails once the maximum size is used", pushedCount == 2 * smallQueue.slotsPerPage);
+
+    DestroyMpscQueue(smallQueue);
+    DestroyMpscQueue(queue);
+}
+
+void TestStalledProducer()
+{
+    TEST_SECTION("Reuse with a producer inside a push");
+
+    MpscQueue queue;
+    CreateMpscQueue(queue, sizeof(TestEvent), MB(1));
+
+    // A producer that read the first page as the tail and did not write yet. The other
+    // pages are reused while it stays there, as when producers keep pushing.
+    const u32 stalledPage = queue.tailPage;
+    AtomicFetchAdd(&MpscQueueGetPage(queue, stalledPage)->users, 1);
+
+    u32 popCount = 0;
+    for (u32 i = 0; i < EVENT_COUNT; ++i) {
+        const TestEvent event = { .producer = 0, .sequence = i };
+        MpscQueuePush(queue, &event);
+        if ( MpscQueuePeek(queue) ) {
+            MpscQueuePop(queue);
+            popCount++;
+        }
+    }
+    TEST("All events drained", popCount == EVENT_COUNT);
+    TEST("Other pages are reused", queue.pageCount <= 3);
+    TEST("The page in use is not reused", queue.retiredList == stalledPage + 1);
+
+    // Once the producer leaves, the next pop reuses its page too
+    AtomicFetchAdd(&MpscQueueGetPage(queue, stalledPage)->users, -1);
+    const TestEvent event = {};
+    MpscQueuePush(queue, &event);
+    MpscQueuePeek(queue);
+    MpscQueuePop(queue);
+    TEST("The page is reused once left", queue.retiredList == 0);
+
+    DestroyMpscQueue(queue);
+}
+
+void TestDrainUntil()
+{
+    TEST_SECTION("Drain up to a timestamp");
+
+    MpscQueue queue;
+    CreateMpscQueue(queue, sizeof(TestEvent), MB(1));
+
+    for (u32 i = 0; i < 1000; ++i) {
+        const TestEvent event = { .producer = 0, .sequence = i, .ticks = 100 + i };
+        MpscQueuePush(queue, &event);
+    }
+
+    const u64 untilTicks = 100 + 499;
+    u32 count = 0;
+    const TestEvent *event;
+    while ( (event = (const TestEvent *)MpscQueuePeek(queue)) && event->ticks <= untilTicks ) {
+        count++;
+        MpscQueuePop(queue);
+    }
+    TEST("Events up to the timestamp are drained", count == 500);
+    TEST("Later events stay queued", event && event->sequence == 500);
+
+    DestroyMpscQueue(queue);
+}
+
+void TestProducers(u32 producerCount, u32 maxSize)
+{
+    char sectionName[64];
+    SPrintf(sectionName, "%u producers, %u KB queue", producerCount, maxSize / KB(1));
+    TEST_SECTION(sectionName);
+
+    MpscQueue queue;
+    CreateMpscQueue(queue, sizeof(TestEvent), maxSize);
+
+    f32 seconds = 0.0f;
+    const DrainResult result = RunProducers(queue, producerCount, &seconds);
+    const u32 expectedCount = gData.eventsPerProducer * producerCount;
+
+    TEST("No event lost or duplicated", result.count == expectedCount);
+    TEST("Events of each producer in order", result.outOfOrder == 0);
+    TEST("Timestamps of each producer never go back", result.ticksBackwards == 0);
+    TEST("Queue stays within its maximum size", queue.pageCount <= queue.maxPages);
+    LOG(Info, "%u events in %.2f ms (%.0f ns per event), %u pages, %u pushes retried on a full queue\n",
+            result.count, seconds * 1000.0f, seconds * 1e9f / result.count,
+            queue.pageCount, gData.failedPushes);
+
+    DestroyMpscQueue(queue);
+}
+
+int main()
+{
+    LOG(Info, ANSI_BOLD "====================================\n" ANSI_RESET);
+    LOG(Info, ANSI_BOLD "  Event queue stress test\n" ANSI_RESET);
+    LOG(Info, ANSI_BOLD "====================================\n" ANSI_RESET);
+
+    TestSingleThreadGrowth();
+    TestStalledProducer();
+    TestDrainUntil();
+    TestProducers(1, MB(8));
+    TestProducers(4, MB(8));
+    TestProducers(8, MB(8));
+    // Small enough for producers to fill it, so pages must be reused while they push
+    TestProducers(4, KB(64));
+
+    LOG(Info, "\n" ANSI_BOLD "====================================\n" ANSI_RESET);
+    if (gTestsFailed == 0) {
+        LOG(Info, ANSI_BOLD ANSI_GREEN "  Results: %u passed, %u failed\n" ANSI_RESET, gTestsPassed, gTestsFailed);
+    } else {
+        LOG(Info, ANSI_BOLD "  Results: " ANSI_GREEN "%u passed" ANSI_RESET ANSI_BOLD ", " ANSI_RED "%u failed\n" ANSI_RESET, gTestsPassed, gTestsFailed);
+    }
+    LOG(Info, ANSI_BOLD "====================================\n" ANSI_RESET);
+
+    return gTestsFailed > 0 ? 1 : 0;
+}
@@ -0,0 +1,142 @@
+/*
+ * test_engine.h
+ * Test framework and platform stubs shared by the tests that run the engine
+ *
+ * Include it after ../engine.cpp. The Makefile writes the test executables to build/,
+ * so paths are resolved from the directory of the executable and the tests can run
+ * from any working directory.
+ */
+
+#ifndef TEST_ENGINE_H
+#define TEST_ENGINE_H
+
+// ANSI color codes
+#ifdef _WIN32
+#define ANSI_RESET   "\x1b[0m"
+#define ANSI_BOLD    "\x1b[1m"
+#define ANSI_RED     "\x1b[31m"
+#define ANSI_GREEN   "\x1b[32m"
+#else
+#define ANSI_RESET
+#define ANSI_BOLD
+#define ANSI_RED
+#define ANSI_GREEN
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Test framework
+
+static u32 gTestsPassed = 0;
+static u32 gTestsFailed = 0;
+
+#define TEST(name, expression) \
+    do { \
+        if (expression) { \
+            LOG(Info, ANSI_GREEN "[PASS]" ANSI_RESET " %s\n", name); \
+            gTestsPassed++; \
+        } else { \
+            LOG(Error, ANSI_RED "[FAIL]" ANSI_RESET " %s  (line %d)\n", name, __LINE__); \
+            gTestsFailed++; \
+        } \
+    } while(0)
+
+#define TEST_SECTION(name) LOG(Info, ANSI_BOLD "\n--- %s ---\n" ANSI_RESET, name)
+
+void PrintTestTitle(const char *title)
+{
+    LOG(Info, ANSI_BOLD "====================================\n" ANSI_RESET);
+    LOG(Info, ANSI_BOLD "  %s\n" ANSI_RESET, title);
+    LOG(Info, ANSI_BOLD "====================================\n" ANSI_RESET);
+}
+
+// Returns the exit code of the test executable
+int PrintTestResults()
+{
+    LOG(Info, "\n" ANSI_BOLD "====================================\n" ANSI_RESET);
+    if (gTestsFailed == 0) {
+        LOG(Info, ANSI_BOLD ANSI_GREEN "  Results: %u passed, %u failed\n" ANSI_RESET, gTestsPassed, gTestsFailed);
+    } else {
+        LOG(Info, ANSI_BOLD "  Results: " ANSI_GREEN "%u passed" ANSI_RESET ANSI_BOLD ", " ANSI_RED "%u failed\n" ANSI_RESET, gTestsPassed, gTestsFailed);
+    }
+    LOG(Info, ANSI_BOLD "====================================\n" ANSI_RESET);
+
+    return gTestsFailed > 0 ? 1 : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Paths
+
+static FilePath gTestBinDir; // Directory of the test executable
+static FilePath gTestProjectDir; // Root of the repository, the parent of gTestBinDir
+
+void InitializeTestPaths(const char *exePath)
+{
+    FilePath path = {};
+    StrCopy(path.str, exePath);
+    StrReplace(path.str, '\\', '/');
+    const char *lastSeparator = StrCharR(path.str, '/');
+    if (lastSeparator) {
+        StrCopyN(gTestBinDir.str, path.str, lastSeparator - path.str);
+    } else {
+        StrCopy(gTestBinDir.str, ".");
+    }
+    gTestProjectDir = MakePath(gTestBinDir.str, "..");
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Platform stubs
+
+#define SCRATCH_ARENA_COUNT 4
+#define SCRATCH_ARENA_SIZE MB(16)
+
+static Arena gScratchArenas[SCRATCH_ARENA_COUNT];
+static volatile_u32 gScratchLocked[SCRATCH_ARENA_COUNT];
+
+u32 StubAcquireScratchArena(Arena &outArena, u32 minSize)
+{
+    ASSERT(minSize <= SCRATCH_ARENA_SIZE);
+    for (;;)
+    {
+        for (u32 i = 0; i < SCRATCH_ARENA_COUNT; ++i)
+        {
+            if ( AtomicSwap(&gScratchLocked[i], 0, 1) )
+            {
+                gScratchArenas[i].used = 0;
+                outArena = gScratchArenas[i];
+                return i;
+            }
+        }
+        Yield();
+    }
+}
+
+void StubReleaseScratchArena(u32 index, const Arena &arena)
+{
+    FullWriteBarrier();
+    gScratchLocked[index] = 0;
+}
+
+void StubPlatformQuit()
+{
+}
+
+// Sets the platform API with the stubs above and the given work queue. The directories
+// of the platform are the one of the executable, and assetDir for the assets.
+void InitializeTestPlatform(Plat &platform, Arena &globalArena, Arena &dataArena, PFN_PushWork pushWork, const char *assetDir)
+{
+    for (u32 i = 0; i < SCRATCH_ARENA_COUNT; ++i) {
+        gScratchArenas[i] = MakeArena((byte*)AllocateVirtualMemory(SCRATCH_ARENA_SIZE), SCRATCH_ARENA_SIZE, "Scratch");
+    }
+
+    platform.api.PlatformQuit = StubPlatformQuit;
+    platform.api.AcquireScratchArena = StubAcquireScratchArena;
+    platform.api.ReleaseScratchArena = StubReleaseScratchArena;
+    platform.api.PushWork = pushWork;
+    platform.BinDir = platform.DataDir = platform.ProjectDir = gTestBinDir.str;
+    platform.AssetDir = assetDir;
+    platform.globalArena = &globalArena;
+    platform.dataArena = &dataArena;
+    SetPlatformAPI(platform);
+}
+
+#endif // #ifndef TEST_ENGINE_H
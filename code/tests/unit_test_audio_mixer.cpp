@@ -0,0 +1,1059 @@
+/*
+ * unit_test_audio_mixer.cpp
+ * Unit tests and benchmark for the audio mixer in code/audio.cpp
+ *
+ * The SIMD mixer, limiter, resampler and bus effects are checked against their scalar
+ * reference versions, with odd frame counts so the scalar tails are also covered. The
+ * resampler, the filters and the ADPCM codec are also checked against analytic sines.
+ * The benchmarks mix 64 sources for one second of audio, resample one second, and time
+ * the bus effects per audio callback, with each version, and decode one second of ADPCM.
+ * The ibxm module player mixes aurora.mod and a synthetic 32 channel MOD with its SIMD and
+ * scalar mixers, which must match, and renders 60 seconds of each with both.
+ */
+
+#include "../engine.cpp"
+
+#include "test_engine.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Test signals
+
+#define SOURCE_COUNT 64
+#define SOURCE_FRAME_COUNT 48000 // One second at 48 kHz
+
+static u32 gRandomState = 0x12345678;
+
+static u32 NextRandom()
+{
+    // xorshift32
+    gRandomState ^= gRandomState << 13;
+    gRandomState ^= gRandomState >> 17;
+    gRandomState ^= gRandomState << 5;
+    return gRandomState;
+}
+
+static f32 RandomUnit()
+{
+    const f32 value = (f32)(NextRandom() & 0xffffff) / (f32)0xffffff;
+    return value;
+}
+
+static Arena gArena; // Copied by each test, so its allocations are temporary
+static i16 *gSources[SOURCE_COUNT];
+static f32 gGainsL[SOURCE_COUNT];
+static f32 gGainsR[SOURCE_COUNT];
+
+static void MakeSources()
+{
+    for (u32 i = 0; i < SOURCE_COUNT; ++i)
+    {
+        gSources[i] = (i16*)AllocateVirtualMemory(SOURCE_FRAME_COUNT * 2 * sizeof(i16));
+        for (u32 s = 0; s < SOURCE_FRAME_COUNT * 2; ++s) {
+            gSources[i][s] = (i16)NextRandom();
+        }
+        AudioPanGains(1.5f * RandomUnit(), 2.0f * RandomUnit() - 1.0f, gGainsL[i], gGainsR[i]);
+    }
+}
+
+static f32 MaxDifference(const f32 *a, const f32 *b, u32 count)
+{
+    f32 maxDiff = 0.0f;
+    for (u32 i = 0; i < count; ++i) {
+        maxDiff = Max(maxDiff, fabsf(a[i] - b[i]));
+    }
+    return maxDiff;
+}
+
+static i32 MaxDifference(const i16 *a, const i16 *b, u32 count)
+{
+    i32 maxDiff = 0;
+    for (u32 i = 0; i < count; ++i) {
+        maxDiff = Max(maxDiff, abs((i32)a[i] - (i32)b[i]));
+    }
+    return maxDiff;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Tests
+
+static const u32 gFrameCounts[] = { 1, 3, 4, 7, 8, 31, 33, 65, 480, 1023 };
+
+#define BENCHMARK_ITERATIONS 10
+#define BENCHMARK_FRAMES_PER_CALLBACK 480 // 10 ms at 48 kHz, like the audio thread
+
+void TestPanGains()
+{
+    TEST_SECTION("Pan gains");
+
+    f32 gainL, gainR;
+    AudioPanGains(1.0f, 0.0f, gainL, gainR);
+    TEST("Centered source keeps unity gain", fabsf(gainL - 1.0f) < 1e-6f && fabsf(gainR - 1.0f) < 1e-6f);
+
+    AudioPanGains(1.0f, -1.0f, gainL, gainR);
+    TEST("Hard left pan silences the right channel", fabsf(gainR) < 1e-6f);
+
+    AudioPanGains(0.5f, 0.3f, gainL, gainR);
+    TEST("Pan keeps constant power", fabsf(gainL * gainL + gainR * gainR - 2.0f * 0.5f * 0.5f) < 1e-5f);
+}
+
+void TestMix()
+{
+    TEST_SECTION("Mix (SIMD vs scalar)");
+
+    Arena arena = gArena;
+    f32 *expected = PushArray(arena, f32, SOURCE_FRAME_COUNT * 2);
+    f32 *result = PushArray(arena, f32, SOURCE_FRAME_COUNT * 2);
+
+    bool tailsMatch = true;
+    for (u32 f = 0; f < ARRAY_COUNT(gFrameCounts); ++f)
+    {
+        // Offset destinations and sources so the loads are not aligned
+        const u32 frameCount = gFrameCounts[f];
+        MemSet(expected, SOURCE_FRAME_COUNT * 2 * sizeof(f32), 0);
+        MemSet(result, SOURCE_FRAME_COUNT * 2 * sizeof(f32), 0);
+        for (u32 i = 0; i < 4; ++i) {
+            MixSamplesScalar(expected + 2, gSources[i] + 2 * f + 2, frameCount, gGainsL[i], gGainsR[i]);
+            MixSamples(result + 2, gSources[i] + 2 * f + 2, frameCount, gGainsL[i], gGainsR[i]);
+        }
+        tailsMatch = tailsMatch && MaxDifference(expected, result, SOURCE_FRAME_COUNT * 2) < 0.01f;
+    }
+    TEST("Odd frame counts match", tailsMatch);
+
+    MemSet(expected, SOURCE_FRAME_COUNT * 2 * sizeof(f32), 0);
+    MemSet(result, SOURCE_FRAME_COUNT * 2 * sizeof(f32), 0);
+    for (u32 i = 0; i < SOURCE_COUNT; ++i) {
+        MixSamplesScalar(expected, gSources[i], SOURCE_FRAME_COUNT, gGainsL[i], gGainsR[i]);
+        MixSamples(result, gSources[i], SOURCE_FRAME_COUNT, gGainsL[i], gGainsR[i]);
+    }
+    const f32 maxDiff = MaxDifference(expected, result, SOURCE_FRAME_COUNT * 2);
+    LOG(Info, "Max difference after mixing %u sources: %f\n", SOURCE_COUNT, maxDiff);
+    TEST("64 sources match", maxDiff < 0.01f);
+}
+
+void TestLimiter()
+{
+    TEST_SECTION("Limiter (SIMD vs scalar)");
+
+    Arena arena = gArena;
+
+    // Loud mix of all the sources, far over the i16 range
+    f32 *mix = PushZeroArray(arena, f32, SOURCE_FRAME_COUNT * 2);
+    for (u32 i = 0; i < SOURCE_COUNT; ++i) {
+        MixSamplesScalar(mix, gSources[i], SOURCE_FRAME_COUNT, gGainsL[i], gGainsR[i]);
+    }
+
+    i16 *expected = PushArray(arena, i16, SOURCE_FRAME_COUNT * 2);
+    i16 *result = PushArray(arena, i16, SOURCE_FRAME_COUNT * 2);
+
+    // Consecutive buffers of varying sizes, to carry the delay and gain across calls
+    AudioLimiter scalarLimiter = { .gain = 1.0f };
+    AudioLimiter simdLimiter = { .gain = 1.0f };
+    i32 maxDiff = 0;
+    i32 maxOutput = 0;
+    for (u32 frame = 0, f = 0; frame < SOURCE_FRAME_COUNT; ++f)
+    {
+        const u32 frameCount = Min(gFrameCounts[f % ARRAY_COUNT(gFrameCounts)], SOURCE_FRAME_COUNT - frame);
+
+        f32 *scalarSamples = PushMixBuffer(arena, scalarLimiter, frameCount);
+        f32 *simdSamples = PushMixBuffer(arena, simdLimiter, frameCount);
+        MemCopy(scalarSamples + AUDIO_LIMITER_LOOKAHEAD * 2, mix + frame * 2, frameCount * 2 * sizeof(f32));
+        MemCopy(simdSamples + AUDIO_LIMITER_LOOKAHEAD * 2, mix + frame * 2, frameCount * 2 * sizeof(f32));
+
+        LimitSamplesScalar(scalarLimiter, scalarSamples, frameCount, expected + frame * 2);
+        LimitSamples(simdLimiter, simdSamples, frameCount, result + frame * 2);
+
+        for (u32 i = 0; i < frameCount * 2; ++i) {
+            maxOutput = Max(maxOutput, abs((i32)expected[frame * 2 + i]));
+        }
+
+        frame += frameCount;
+    }
+    maxDiff = MaxDifference(expected, result, SOURCE_FRAME_COUNT * 2);
+
+    LOG(Info, "Max difference: %d, max output: %d, final gain: %f\n", maxDiff, maxOutput, scalarLimiter.gain);
+    TEST("Outputs match within 1 LSB", maxDiff <= 1);
+    TEST("Output stays under the threshold", maxOutput <= (i32)AUDIO_LIMITER_THRESHOLD + 1);
+    TEST("Gains match", fabsf(scalarLimiter.gain - simdLimiter.gain) < 1e-4f);
+}
+
+void TestLimiterTransparent()
+{
+    TEST_SECTION("Limiter below the threshold");
+
+    Arena arena = gArena;
+
+    AudioLimiter limiter = { .gain = 1.0f };
+    const u32 frameCount = 480;
+    i16 *input = PushArray(arena, i16, frameCount * 2);
+    for (u32 i = 0; i < frameCount * 2; ++i) {
+        input[i] = gSources[0][i] / 2;
+    }
+    i16 *output = PushArray(arena, i16, (frameCount + AUDIO_LIMITER_LOOKAHEAD) * 2);
+
+    // Two buffers, to flush the look-ahead frames of the first one
+    f32 *samples = PushMixBuffer(arena, limiter, frameCount);
+    MixSamples(samples + AUDIO_LIMITER_LOOKAHEAD * 2, input, frameCount, 1.0f, 1.0f);
+    LimitSamples(limiter, samples, frameCount, output);
+    samples = PushMixBuffer(arena, limiter, AUDIO_LIMITER_LOOKAHEAD);
+    LimitSamples(limiter, samples, AUDIO_LIMITER_LOOKAHEAD, output + frameCount * 2);
+
+    bool delayed = true;
+    for (u32 i = 0; i < AUDIO_LIMITER_LOOKAHEAD * 2; ++i) {
+        delayed = delayed && output[i] == 0;
+    }
+    TEST("Output is delayed by the look-ahead", delayed);
+    TEST("Samples pass unchanged", MemCompare(output + AUDIO_LIMITER_LOOKAHEAD * 2, input, frameCount * 2 * sizeof(i16)) == 0);
+    TEST("Gain stays at unity", limiter.gain == 1.0f);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Resampler tests
+
+#define RESAMPLER_INPUT_RATE 44100
+#define RESAMPLER_OUTPUT_RATE 48000
+
+static const char *gQualityNames[] = { "Linear", "Sinc" };
+
+static AudioSincFilter gSincFilter;
+
+// Converts i16 stereo frames into the f32 input frames of the resampler buffer
+static void CopyResamplerInput(f32 *samples, const i16 *source, u32 frameCount)
+{
+    for (u32 i = 0; i < frameCount * 2; ++i) {
+        samples[AUDIO_RESAMPLER_TAPS * 2 + i] = source[i];
+    }
+}
+
+typedef u32 ResampleFunc(AudioResampler &resampler, const f32 *samples, u32 inputFrameCount, f32 *output, u32 outputFrameCount, f32 gainL, f32 gainR);
+
+// Resamples the first source in consecutive callbacks of varying sizes, returns the input frames consumed
+static u32 ResampleSource(ResampleFunc *resample, AudioResamplerQuality quality, Arena arena, f32 *output, u32 outputFrameCount, bool &countsMatch)
+{
+    AudioResampler resampler;
+    InitializeResampler(resampler, quality, &gSincFilter, RESAMPLER_INPUT_RATE, RESAMPLER_OUTPUT_RATE);
+
+    u32 inputFrame = 0;
+    for (u32 frame = 0, f = 0; frame < outputFrameCount; ++f)
+    {
+        Arena callbackArena = arena;
+        const u32 frameCount = Min(gFrameCounts[f % ARRAY_COUNT(gFrameCounts)], outputFrameCount - frame);
+        const u32 inputFrameCount = ResamplerInputFrames(resampler, frameCount);
+
+        f32 *samples = PushResampleBuffer(callbackArena, resampler, inputFrameCount);
+        CopyResamplerInput(samples, gSources[0] + inputFrame * 2, inputFrameCount);
+        const u32 resampledFrameCount = resample(resampler, samples, inputFrameCount, output + frame * 2, frameCount, 0.5f, 0.25f);
+
+        countsMatch = countsMatch && resampledFrameCount == frameCount;
+        inputFrame += inputFrameCount;
+        frame += frameCount;
+    }
+    return inputFrame;
+}
+
+void TestResampler()
+{
+    TEST_SECTION("Resampler (SIMD vs scalar)");
+
+    const u32 outputFrameCount = SOURCE_FRAME_COUNT / 2;
+
+    for (u32 q = 0; q < ARRAY_COUNT(gQualityNames); ++q)
+    {
+        const AudioResamplerQuality quality = (AudioResamplerQuality)q;
+
+        Arena arena = gArena;
+        f32 *expected = PushZeroArray(arena, f32, outputFrameCount * 2);
+        f32 *result = PushZeroArray(arena, f32, outputFrameCount * 2);
+
+        bool countsMatch = true;
+        const u32 scalarInputFrames = ResampleSource(ResampleFramesScalar, quality, arena, expected, outputFrameCount, countsMatch);
+        const u32 simdInputFrames = ResampleSource(ResampleFrames, quality, arena, result, outputFrameCount, countsMatch);
+
+        // Input consumed so far, ahead of the output by the resampler delay
+        const u32 inputFrames = (u32)( (u64)outputFrameCount * RESAMPLER_INPUT_RATE / RESAMPLER_OUTPUT_RATE );
+        const u32 delay = AUDIO_RESAMPLER_TAPS / 2 + 1;
+
+        const f32 maxDiff = MaxDifference(expected, result, outputFrameCount * 2);
+        LOG(Info, "%s: max difference %f, input frames %u\n", gQualityNames[q], maxDiff, simdInputFrames);
+        TEST("Outputs match", maxDiff < 0.05f);
+        TEST("Every callback gets all its frames", countsMatch);
+        TEST("Input frames follow the rate ratio", scalarInputFrames == simdInputFrames &&
+            simdInputFrames >= inputFrames - delay && simdInputFrames <= inputFrames + 1);
+    }
+}
+
+// Signal to noise ratio of a 44.1 kHz sine converted to 48 kHz, in dB
+static f32 ResampledSineSNR(AudioResamplerQuality quality)
+{
+    Arena arena = gArena;
+
+    const f32 frequency = 1000.0f;
+    const f32 amplitude = 16000.0f;
+    const u32 outputFrameCount = RESAMPLER_OUTPUT_RATE / 2;
+    const u32 delay = AUDIO_RESAMPLER_TAPS / 2 + 1;
+
+    AudioResampler resampler;
+    InitializeResampler(resampler, quality, &gSincFilter, RESAMPLER_INPUT_RATE, RESAMPLER_OUTPUT_RATE);
+    const u64 step = resampler.step;
+
+    f32 *output = PushZeroArray(arena, f32, outputFrameCount * 2);
+    u32 inputFrame = 0;
+    for (u32 frame = 0; frame < outputFrameCount; frame += BENCHMARK_FRAMES_PER_CALLBACK)
+    {
+        Arena callbackArena = arena;
+        const u32 frameCount = Min((u32)BENCHMARK_FRAMES_PER_CALLBACK, outputFrameCount - frame);
+        const u32 inputFrameCount = ResamplerInputFrames(resampler, frameCount);
+
+        f32 *samples = PushResampleBuffer(callbackArena, resampler, inputFrameCount);
+        for (u32 i = 0; i < inputFrameCount; ++i)
+        {
+            const f32 sample = (f32)( amplitude * sin(2.0 * 3.14159265358979 * frequency * ( inputFrame + i ) / RESAMPLER_INPUT_RATE) );
+            samples[( AUDIO_RESAMPLER_TAPS + i ) * 2 + 0] = sample;
+            samples[( AUDIO_RESAMPLER_TAPS + i ) * 2 + 1] = -sample;
+        }
+        ResampleFrames(resampler, samples, inputFrameCount, output + frame * 2, frameCount, 1.0f, 1.0f);
+        inputFrame += inputFrameCount;
+    }
+
+    // Output frame k is the input at k * step, delayed by the resampler
+    f64 signal = 0.0;
+    f64 noise = 0.0;
+    for (u32 k = AUDIO_RESAMPLER_TAPS; k < outputFrameCount; ++k)
+    {
+        const f64 position = (f64)k * (f64)step / 4294967296.0 - delay;
+        const f64 expected = amplitude * sin(2.0 * 3.14159265358979 * frequency * position / RESAMPLER_INPUT_RATE);
+        signal += 2.0 * expected * expected;
+        noise += ( output[k * 2 + 0] - expected ) * ( output[k * 2 + 0] - expected );
+        noise += ( output[k * 2 + 1] + expected ) * ( output[k * 2 + 1] + expected );
+    }
+    const f32 snr = (f32)( 10.0 * log10(signal / noise) );
+    return snr;
+}
+
+void TestResamplerQuality()
+{
+    TEST_SECTION("Resampler quality (1 kHz sine, 44.1 kHz to 48 kHz)");
+
+    const f32 linearSNR = ResampledSineSNR(AudioResamplerQuality_Linear);
+    const f32 sincSNR = ResampledSineSNR(AudioResamplerQuality_Sinc);
+    LOG(Info, "SNR: linear %.1f dB, sinc %.1f dB\n", linearSNR, sincSNR);
+    TEST("Linear SNR over 40 dB", linearSNR > 40.0f);
+    TEST("Sinc SNR over 80 dB", sincSNR > 80.0f);
+}
+
+void TestResampleClip()
+{
+    TEST_SECTION("Clip resampling");
+
+    Arena arena = gArena;
+
+    // Mono clip with a constant level, which the filter must keep
+    const u32 frameCount = 22050;
+    i16 *clip = PushArray(arena, i16, frameCount);
+    for (u32 i = 0; i < frameCount; ++i) {
+        clip[i] = 10000;
+    }
+
+    i16 *resampled = nullptr;
+    const u32 resampledFrameCount = ResampleClip(arena, clip, frameCount, 1, 22050, 48000, &resampled);
+    TEST("Length follows the rate ratio", resampledFrameCount == 48000);
+
+    bool upmixed = true;
+    i32 maxError = 0;
+    for (u32 i = 0; i < resampledFrameCount; ++i)
+    {
+        upmixed = upmixed && resampled[i * 2 + 0] == resampled[i * 2 + 1];
+        if ( i >= AUDIO_RESAMPLER_TAPS * 3 && i < resampledFrameCount - AUDIO_RESAMPLER_TAPS * 3 ) {
+            maxError = Max(maxError, abs(resampled[i * 2] - 10000));
+        }
+    }
+    LOG(Info, "Max error of the constant level: %d\n", maxError);
+    TEST("Mono is copied to both channels", upmixed);
+    TEST("Constant level is kept", maxError <= 2);
+
+    // Reducing the rate lowers the cutoff, so full band noise loses most of its power
+    const u32 stereoFrameCount = ResampleClip(arena, gSources[1], 9600, 2, 96000, 48000, &resampled);
+    f64 inputPower = 0.0;
+    f64 outputPower = 0.0;
+    for (u32 i = 0; i < 9600 * 2; ++i) {
+        inputPower += (f64)gSources[1][i] * gSources[1][i];
+    }
+    for (u32 i = 0; i < stereoFrameCount * 2; ++i) {
+        outputPower += 2.0 * resampled[i] * resampled[i];
+    }
+    LOG(Info, "Power kept from 96 kHz noise: %.2f\n", outputPower / inputPower);
+    TEST("Downsampled length follows the rate ratio", stereoFrameCount == 4800);
+    TEST("Downsampling filters the upper half of the band", outputPower < 0.6 * inputPower);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Bus tests
+
+static void MakeSine(f32 *samples, u32 frameCount, f32 frequency, f32 amplitude)
+{
+    for (u32 i = 0; i < frameCount; ++i)
+    {
+        const f32 sample = (f32)( amplitude * sin(2.0 * 3.14159265358979 * frequency * i / AUDIO_SAMPLE_RATE) );
+        samples[2 * i + 0] = sample;
+        samples[2 * i + 1] = sample;
+    }
+}
+
+static f32 PeakLevel(const f32 *samples, u32 first, u32 last)
+{
+    f32 peak = 0.0f;
+    for (u32 i = first * 2; i < last * 2; ++i) {
+        peak = Max(peak, fabsf(samples[i]));
+    }
+    return peak;
+}
+
+void TestAccumulate()
+{
+    TEST_SECTION("Bus gain ramps (SIMD vs scalar)");
+
+    Arena arena = gArena;
+    f32 *source = PushZeroArray(arena, f32, SOURCE_FRAME_COUNT * 2);
+    MixSamples(source, gSources[0], SOURCE_FRAME_COUNT, 1.0f, 1.0f);
+    f32 *expected = PushZeroArray(arena, f32, SOURCE_FRAME_COUNT * 2);
+    f32 *result = PushZeroArray(arena, f32, SOURCE_FRAME_COUNT * 2);
+
+    bool tailsMatch = true;
+    for (u32 f = 0; f < ARRAY_COUNT(gFrameCounts); ++f)
+    {
+        AccumulateSamplesScalar(expected + 2, source + 2 * f, gFrameCounts[f], 0.25f, 1.5f);
+        AccumulateSamples(result + 2, source + 2 * f, gFrameCounts[f], 0.25f, 1.5f);
+        tailsMatch = tailsMatch && MaxDifference(expected, result, SOURCE_FRAME_COUNT * 2) < 0.01f;
+    }
+    TEST("Odd frame counts match", tailsMatch);
+
+    // The ramp reaches the target gain on the last frame
+    f32 *ramp = PushZeroArray(arena, f32, 480 * 2);
+    f32 *ones = PushArray(arena, f32, 480 * 2);
+    for (u32 i = 0; i < 480 * 2; ++i) {
+        ones[i] = 1.0f;
+    }
+    AccumulateSamples(ramp, ones, 480, 0.0f, 1.0f);
+    TEST("Gain ramps up to the target", fabsf(ramp[0] - 1.0f / 480) < 1e-6f && fabsf(ramp[479 * 2] - 1.0f) < 1e-6f);
+}
+
+void TestBiquad()
+{
+    TEST_SECTION("Biquad filters");
+
+    Arena arena = gArena;
+    const u32 frameCount = 9600;
+    f32 *expected = PushZeroArray(arena, f32, frameCount * 2);
+    f32 *result = PushArray(arena, f32, frameCount * 2);
+    MixSamples(expected, gSources[2], frameCount, 0.5f, 0.5f);
+    MemCopy(result, expected, frameCount * 2 * sizeof(f32));
+
+    // Consecutive buffers of varying sizes, to carry the state across calls
+    AudioBiquad scalarBiquad = {};
+    AudioBiquad simdBiquad = {};
+    InitializeBiquad(scalarBiquad, AudioFilter_LowPass, 2000.0f, AUDIO_BUTTERWORTH_Q, AUDIO_SAMPLE_RATE);
+    InitializeBiquad(simdBiquad, AudioFilter_LowPass, 2000.0f, AUDIO_BUTTERWORTH_Q, AUDIO_SAMPLE_RATE);
+    for (u32 frame = 0, f = 0; frame < frameCount; ++f)
+    {
+        const u32 count = Min(gFrameCounts[f % ARRAY_COUNT(gFrameCounts)], frameCount - frame);
+        ProcessBiquadScalar(scalarBiquad, expected + frame * 2, count);
+        ProcessBiquad(simdBiquad, result + frame * 2, count);
+        frame += count;
+    }
+    const f32 maxDiff = MaxDifference(expected, result, frameCount * 2);
+    LOG(Info, "Max difference: %f\n", maxDiff);
+    TEST("SIMD matches scalar", maxDiff < 0.05f);
+
+    // Response to sines an octave and more away from a 1 kHz cutoff, once settled
+    struct FilterCase { AudioFilterType type; f32 frequency; f32 minGain; f32 maxGain; const char *name; };
+    const FilterCase cases[] = {
+        { AudioFilter_LowPass, 100.0f, 0.99f, 1.01f, "Low-pass keeps 100 Hz" },
+        { AudioFilter_LowPass, 1000.0f, 0.69f, 0.72f, "Low-pass is at -3 dB on the cutoff" },
+        { AudioFilter_LowPass, 10000.0f, 0.0f, 0.02f, "Low-pass removes 10 kHz" },
+        { AudioFilter_HighPass, 100.0f, 0.0f, 0.02f, "High-pass removes 100 Hz" },
+        { AudioFilter_HighPass, 10000.0f, 0.99f, 1.01f, "High-pass keeps 10 kHz" },
+    };
+    for (u32 c = 0; c < ARRAY_COUNT(cases); ++c)
+    {
+        const FilterCase &filterCase = cases[c];
+        MakeSine(result, frameCount, filterCase.frequency, 1.0f);
+        AudioBiquad biquad = {};
+        InitializeBiquad(biquad, filterCase.type, 1000.0f, AUDIO_BUTTERWORTH_Q, AUDIO_SAMPLE_RATE);
+        ProcessBiquad(biquad, result, frameCount);
+        const f32 gain = PeakLevel(result, frameCount / 2, frameCount);
+        LOG(Info, "%s: gain %.4f\n", filterCase.name, gain);
+        TEST(filterCase.name, gain >= filterCase.minGain && gain <= filterCase.maxGain);
+    }
+}
+
+void TestReverb()
+{
+    TEST_SECTION("Reverb");
+
+    Arena arena = gArena;
+    AudioReverb scalarReverb;
+    AudioReverb simdReverb;
+    InitializeReverb(scalarReverb, arena);
+    InitializeReverb(simdReverb, arena);
+    // Without damping, so only the line feedback sets the decay
+    SetReverbDecay(scalarReverb, 1.0f, 0.0f);
+    SetReverbDecay(simdReverb, 1.0f, 0.0f);
+
+    // An impulse, and silence for two decay times
+    const u32 frameCount = 2 * AUDIO_SAMPLE_RATE;
+    f32 *input = PushZeroArray(arena, f32, frameCount * 2);
+    input[0] = input[1] = 10000.0f;
+    f32 *expected = PushZeroArray(arena, f32, frameCount * 2);
+    f32 *result = PushZeroArray(arena, f32, frameCount * 2);
+
+    for (u32 frame = 0, f = 0; frame < frameCount; ++f)
+    {
+        const u32 count = Min(gFrameCounts[f % ARRAY_COUNT(gFrameCounts)], frameCount - frame);
+        ProcessReverbScalar(scalarReverb, input + frame * 2, expected + frame * 2, count);
+        ProcessReverb(simdReverb, input + frame * 2, result + frame * 2, count);
+        frame += count;
+    }
+
+    const f32 maxDiff = MaxDifference(expected, result, frameCount * 2);
+    const f32 earlyPeak = PeakLevel(result, 0, AUDIO_SAMPLE_RATE / 10);
+    const f32 decayedPeak = PeakLevel(result, AUDIO_SAMPLE_RATE, AUDIO_SAMPLE_RATE + AUDIO_SAMPLE_RATE / 10);
+    const f32 decayDb = 20.0f * log10f(decayedPeak / earlyPeak);
+    LOG(Info, "Max difference: %f, early peak %.1f, level after the decay time %.1f dB\n", maxDiff, earlyPeak, decayDb);
+
+    TEST("SIMD matches scalar", maxDiff < 0.01f);
+    TEST("Reverb is delayed by the shortest line", PeakLevel(result, 0, sAudioReverbLengths[0]) == 0.0f && earlyPeak > 0.0f);
+    TEST("Tail decays about 60 dB in the decay time", decayDb < -50.0f && decayDb > -75.0f);
+    TEST("Channels are decorrelated", MaxDifference(result, result + 1, frameCount * 2 - 1) > 0.0f);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Codec tests
+
+// Two tones per channel at -12 dBFS each, like the ones of a music clip
+static void MakeTones(i16 *samples, u32 frameCount)
+{
+    for (u32 i = 0; i < frameCount; ++i)
+    {
+        const f64 t = 2.0 * 3.14159265358979 * i / AUDIO_SAMPLE_RATE;
+        samples[2 * i + 0] = (i16)( 8000.0 * ( sin(440.0 * t) + sin(1250.0 * t) ) );
+        samples[2 * i + 1] = (i16)( 8000.0 * ( sin(330.0 * t) + sin(5000.0 * t) ) );
+    }
+}
+
+static f32 SignalToNoise(const i16 *signal, const i16 *decoded, u32 count)
+{
+    f64 signalPower = 0.0;
+    f64 noisePower = 0.0;
+    for (u32 i = 0; i < count; ++i) {
+        const f64 error = (f64)decoded[i] - signal[i];
+        signalPower += (f64)signal[i] * signal[i];
+        noisePower += error * error;
+    }
+    return (f32)( 10.0 * log10(signalPower / ( noisePower + 1e-9 )) );
+}
+
+void TestAdpcm()
+{
+    TEST_SECTION("ADPCM codec");
+
+    Arena arena = gArena;
+    const u32 frameCount = SOURCE_FRAME_COUNT + 123; // The last block is shorter
+    i16 *samples = PushArray(arena, i16, frameCount * 2);
+    MakeTones(samples, frameCount);
+
+    const u32 size = AdpcmEncodedSize(frameCount);
+    byte *blocks = PushArray(arena, byte, size + 1);
+    blocks[size] = 0xcd;
+    EncodeAdpcm(samples, frameCount, blocks);
+
+    i16 *decoded = PushArray(arena, i16, frameCount * 2);
+    DecodeAdpcm(blocks, frameCount, decoded);
+
+    const f32 snr = SignalToNoise(samples, decoded, frameCount * 2);
+    const f32 ratio = (f32)( frameCount * 2 * sizeof(i16) ) / size;
+    LOG(Info, "%u bytes of PCM encoded into %u bytes (%.2fx), SNR %.1f dB\n", frameCount * 4, size, ratio, snr);
+
+    TEST("Encoder writes exactly the encoded size", blocks[size] == 0xcd);
+    TEST("Compresses about 4 to 1", ratio > 3.9f);
+    TEST("Tones decode above 25 dB of SNR", snr > 25.0f);
+
+    // Any block decodes on its own, as the streamer does when a voice starts mid-clip
+    bool blocksMatch = true;
+    i16 *blockSamples = PushArray(arena, i16, AUDIO_ADPCM_BLOCK_FRAMES * 2);
+    for (u32 firstFrame = 0; firstFrame < frameCount; firstFrame += AUDIO_ADPCM_BLOCK_FRAMES)
+    {
+        const u32 blockFrameCount = Min(AUDIO_ADPCM_BLOCK_FRAMES, frameCount - firstFrame);
+        const u32 block = firstFrame / AUDIO_ADPCM_BLOCK_FRAMES;
+        DecodeAdpcm(blocks + block * AUDIO_ADPCM_BLOCK_SIZE, blockFrameCount, blockSamples);
+        blocksMatch = blocksMatch && MaxDifference(blockSamples, decoded + firstFrame * 2, blockFrameCount * 2) == 0;
+    }
+    TEST("Blocks decode independently", blocksMatch);
+
+    // Full scale square waves must saturate instead of wrapping around
+    for (u32 i = 0; i < frameCount * 2; ++i) {
+        samples[i] = ( i / 200 ) % 2 ? I16_MAX : I16_MIN;
+    }
+    EncodeAdpcm(samples, frameCount, blocks);
+    DecodeAdpcm(blocks, frameCount, decoded);
+    bool saturates = true;
+    for (u32 i = 400; i < frameCount * 2; i += 400) {
+        saturates = saturates && decoded[i - 2] > 16000 && decoded[i + 198] < -16000;
+    }
+    TEST("Full scale square waves do not wrap around", saturates);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Module player tests
+
+#define MOD_CHANNEL_COUNT 32
+#define MOD_SAMPLE_LENGTH 4096
+#define MOD_FILE_SIZE ( 1084 + 64 * MOD_CHANNEL_COUNT * 4 + 4 * MOD_SAMPLE_LENGTH )
+
+static const char *gInterpolationNames[] = { "Nearest", "Linear", "Cubic" };
+
+// A one pattern, 32 channel MOD with four looped instruments, the last one with a 32 sample
+// loop like chiptunes use. Every channel plays a different note and the notes change every 16 rows.
+static struct data MakeModule(Arena &arena)
+{
+    byte *bytes = PushZeroArray(arena, byte, MOD_FILE_SIZE);
+    for (u32 ins = 1; ins <= 4; ++ins)
+    {
+        byte *header = bytes + ins * 30 - 10;
+        const u32 loopWords = ins == 4 ? 16 : MOD_SAMPLE_LENGTH / 2;
+        header[22] = ( MOD_SAMPLE_LENGTH / 2 ) >> 8;
+        header[23] = ( MOD_SAMPLE_LENGTH / 2 ) & 0xff;
+        header[25] = 48;
+        header[26] = ( MOD_SAMPLE_LENGTH / 2 - loopWords ) >> 8;
+        header[27] = ( MOD_SAMPLE_LENGTH / 2 - loopWords ) & 0xff;
+        header[28] = loopWords >> 8;
+        header[29] = loopWords & 0xff;
+    }
+    bytes[950] = 1;
+    bytes[1080] = '0' + MOD_CHANNEL_COUNT / 10;
+    bytes[1081] = '0' + MOD_CHANNEL_COUNT % 10;
+    bytes[1082] = 'C';
+    bytes[1083] = 'H';
+
+    static const u32 periods[] = { 856, 678, 508, 428, 320, 254, 214, 170, 143, 113 };
+    byte *note = bytes + 1084;
+    for (u32 row = 0; row < 64; ++row)
+    {
+        for (u32 channel = 0; channel < MOD_CHANNEL_COUNT; ++channel, note += 4)
+        {
+            if (row % 16 == 0) {
+                const u32 period = periods[( channel * 3 + row / 16 ) % ARRAY_COUNT(periods)];
+                const u32 ins = 1 + ( channel + row / 16 ) % 4;
+                note[0] = period >> 8;
+                note[1] = period & 0xff;
+                note[2] = ins << 4;
+            }
+        }
+    }
+
+    // Noise, a saw, a square and a short pulse
+    i8 *samples = (i8*)note;
+    for (u32 i = 0; i < MOD_SAMPLE_LENGTH; ++i) {
+        samples[i] = (i8)NextRandom();
+        samples[MOD_SAMPLE_LENGTH + i] = (i8)( i * 4 );
+        samples[2 * MOD_SAMPLE_LENGTH + i] = ( i / 32 ) % 2 ? 100 : -100;
+        samples[3 * MOD_SAMPLE_LENGTH + i] = i % 32 < 8 ? 120 : -80;
+    }
+
+    struct data data = { (char*)bytes, MOD_FILE_SIZE };
+    return data;
+}
+
+static FilePath gModulePath;
+
+static struct data LoadModuleFile(Arena &arena, const char *filename)
+{
+    struct data data = {};
+    DataChunk *file = PushFile(arena, filename);
+    if (file) {
+        data.buffer = (char*)file->bytes;
+        data.length = (int)file->size;
+    }
+    return data;
+}
+
+static struct replay *MakeReplay(Arena &arena, struct data &data, int interpolation, int simd)
+{
+    char message[64];
+    struct module *module = module_load(&data, message, &arena);
+    struct replay *replay = module ? new_replay(module, AUDIO_SAMPLE_RATE, interpolation, &arena) : nullptr;
+    if (replay) {
+        replay_set_simd(replay, simd);
+    }
+    return replay;
+}
+
+// Renders the same ticks with the scalar and the SIMD mixers and returns the largest difference
+static i32 ModMixerDifference(struct data &data, int interpolation, u32 tickCount)
+{
+    Arena arena = gArena;
+    struct replay *scalar = MakeReplay(arena, data, interpolation, 0);
+    struct replay *simd = MakeReplay(arena, data, interpolation, 1);
+    if (!scalar || !simd) {
+        return I32_MAX;
+    }
+
+    const int mixBufLen = calculate_mix_buf_len(AUDIO_SAMPLE_RATE);
+    int *scalarBuf = PushArray(arena, int, mixBufLen);
+    int *simdBuf = PushArray(arena, int, mixBufLen);
+    i32 maxDifference = 0;
+    for (u32 tick = 0; tick < tickCount; ++tick)
+    {
+        const int frameCount = replay_get_audio(scalar, scalarBuf, 0);
+        if (replay_get_audio(simd, simdBuf, 0) != frameCount) {
+            return I32_MAX;
+        }
+        for (int i = 0; i < frameCount * 2; ++i) {
+            const i32 difference = scalarBuf[i] - simdBuf[i];
+            maxDifference = Max(maxDifference, difference < 0 ? -difference : difference);
+        }
+    }
+    return maxDifference;
+}
+
+void TestModMixer()
+{
+    TEST_SECTION("Module player mixer");
+
+    Arena arena = gArena;
+    struct data modules[] = { LoadModuleFile(arena, gModulePath.str), MakeModule(arena) };
+    const char *moduleNames[] = { "aurora.mod", "32 channels" };
+    if ( ExistsFile(gModulePath.str) ) {
+        TEST("Test module loads", modules[0].buffer != nullptr);
+    } else {
+        LOG(Info, "Skipping the aurora.mod cases, %s was not found\n", gModulePath.str);
+    }
+
+    Arena replayArena = arena;
+    TEST("Synthetic module loads", MakeReplay(replayArena, modules[1], 0, 1) != nullptr);
+
+    // 500 ticks are 10 seconds at the default tempo, past the notes and the loop ends
+    char name[128];
+    for (u32 m = 0; m < ARRAY_COUNT(modules); ++m)
+    {
+        if (modules[m].buffer == nullptr) {
+            continue;
+        }
+        Arena moduleArena = gArena;
+        gArena = arena;
+        const i32 nearest = ModMixerDifference(modules[m], 0, 500);
+        const i32 linear = ModMixerDifference(modules[m], 1, 500);
+        const i32 cubic = ModMixerDifference(modules[m], 2, 500);
+        gArena = moduleArena;
+        LOG(Info, "%s, max scalar vs SIMD difference: nearest %d, linear %d, cubic %d\n", moduleNames[m], nearest, linear, cubic);
+
+        sprintf(name, "SIMD nearest matches the scalar mixer exactly (%s)", moduleNames[m]);
+        TEST(name, nearest == 0);
+        sprintf(name, "SIMD linear matches the scalar mixer exactly (%s)", moduleNames[m]);
+        TEST(name, linear == 0);
+        // The float interpolation may round differently on a few samples
+        sprintf(name, "SIMD cubic is within 1 LSB per channel of the scalar mixer (%s)", moduleNames[m]);
+        TEST(name, cubic <= MOD_CHANNEL_COUNT);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Benchmark
+
+typedef void MixFunc(f32 *dst, const i16 *src, u32 frameCount, f32 gainL, f32 gainR);
+typedef void LimitFunc(AudioLimiter &limiter, const f32 *samples, u32 frameCount, i16 *output);
+
+// Renders one second in callbacks as RenderAudio does, and times the mixing and limiting
+static void BenchmarkRender(MixFunc *mix, LimitFunc *limit, i16 *output, f32 &mixMillis, f32 &limitMillis)
+{
+    AudioLimiter limiter = { .gain = 1.0f };
+    f32 mixSeconds = 0.0f;
+    f32 limitSeconds = 0.0f;
+
+    for (u32 frame = 0; frame < SOURCE_FRAME_COUNT; frame += BENCHMARK_FRAMES_PER_CALLBACK)
+    {
+        Arena arena = gArena;
+        const u32 frameCount = Min((u32)BENCHMARK_FRAMES_PER_CALLBACK, SOURCE_FRAME_COUNT - frame);
+
+        const Clock begin = GetClock();
+        f32 *samples = PushMixBuffer(arena, limiter, frameCount);
+        for (u32 i = 0; i < SOURCE_COUNT; ++i) {
+            mix(samples + AUDIO_LIMITER_LOOKAHEAD * 2, gSources[i] + frame * 2, frameCount, gGainsL[i], gGainsR[i]);
+        }
+        const Clock mixed = GetClock();
+        limit(limiter, samples, frameCount, output + frame * 2);
+        const Clock end = GetClock();
+
+        mixSeconds += GetSecondsElapsed(begin, mixed);
+        limitSeconds += GetSecondsElapsed(mixed, end);
+    }
+
+    mixMillis = Min(mixMillis, 1000.0f * mixSeconds);
+    limitMillis = Min(limitMillis, 1000.0f * limitSeconds);
+}
+
+void Benchmark()
+{
+    TEST_SECTION("Benchmark (64 sources x 1 second)");
+
+    i16 *output = (i16*)AllocateVirtualMemory(SOURCE_FRAME_COUNT * 2 * sizeof(i16));
+
+    f32 scalarMillis = 1e9f;
+    f32 simdMillis = 1e9f;
+    f32 scalarLimitMillis = 1e9f;
+    f32 simdLimitMillis = 1e9f;
+
+    for (u32 iteration = 0; iteration < BENCHMARK_ITERATIONS; ++iteration)
+    {
+        BenchmarkRender(MixSamplesScalar, LimitSamplesScalar, output, scalarMillis, scalarLimitMillis);
+        BenchmarkRender(MixSamples, LimitSamples, output, simdMillis, simdLimitMillis);
+    }
+
+#if USE_AUDIO_AVX2
+    const char *isa = "AVX2";
+#elif USE_AUDIO_SSE2
+    const char *isa = "SSE2";
+#else
+    const char *isa = "scalar";
+#endif
+
+    LOG(Info, "%-10s %10s %10s\n", "", "Mix (ms)", "Limit (ms)");
+    LOG(Info, "%-10s %10.3f %10.3f\n", "Scalar", scalarMillis, scalarLimitMillis);
+    LOG(Info, "%-10s %10.3f %10.3f\n", isa, simdMillis, simdLimitMillis);
+    LOG(Info, "Speedup: mix %.2fx, limit %.2fx\n", scalarMillis / simdMillis, scalarLimitMillis / simdLimitMillis);
+}
+
+// Resamples one second of the first source in callbacks, and returns the output samples per second
+static f64 BenchmarkResample(ResampleFunc *resample, AudioResamplerQuality quality)
+{
+    f32 seconds = 1e9f;
+    for (u32 iteration = 0; iteration < BENCHMARK_ITERATIONS; ++iteration)
+    {
+        AudioResampler resampler;
+        InitializeResampler(resampler, quality, &gSincFilter, RESAMPLER_INPUT_RATE, RESAMPLER_OUTPUT_RATE);
+
+        Arena arena = gArena;
+        f32 *output = PushZeroArray(arena, f32, RESAMPLER_OUTPUT_RATE * 2);
+        f32 iterationSeconds = 0.0f;
+        u32 inputFrame = 0;
+
+        for (u32 frame = 0; frame < RESAMPLER_OUTPUT_RATE; frame += BENCHMARK_FRAMES_PER_CALLBACK)
+        {
+            Arena callbackArena = arena;
+            const u32 inputFrameCount = ResamplerInputFrames(resampler, BENCHMARK_FRAMES_PER_CALLBACK);
+            f32 *samples = PushResampleBuffer(callbackArena, resampler, inputFrameCount);
+            CopyResamplerInput(samples, gSources[0] + inputFrame * 2, inputFrameCount);
+
+            const Clock begin = GetClock();
+            resample(resampler, samples, inputFrameCount, output + frame * 2, BENCHMARK_FRAMES_PER_CALLBACK, 1.0f, 1.0f);
+            iterationSeconds += GetSecondsElapsed(begin, GetClock());
+            inputFrame += inputFrameCount;
+        }
+
+        seconds = Min(seconds, iterationSeconds);
+    }
+
+    // Stereo samples, so both channels count
+    return 2.0 * RESAMPLER_OUTPUT_RATE / seconds;
+}
+
+void BenchmarkResampler()
+{
+    TEST_SECTION("Benchmark (resampling 1 second, 44.1 kHz to 48 kHz)");
+
+    LOG(Info, "%-10s %16s %16s\n", "", "Scalar (Msmp/s)", "SIMD (Msmp/s)");
+    for (u32 q = 0; q < ARRAY_COUNT(gQualityNames); ++q)
+    {
+        const AudioResamplerQuality quality = (AudioResamplerQuality)q;
+        const f64 scalarRate = BenchmarkResample(ResampleFramesScalar, quality);
+        const f64 simdRate = BenchmarkResample(ResampleFrames, quality);
+        LOG(Info, "%-10s %16.1f %16.1f (%.2fx, %.0f voices in real time)\n", gQualityNames[q],
+            scalarRate / 1e6, simdRate / 1e6, simdRate / scalarRate, simdRate / ( 2.0 * AUDIO_SAMPLE_RATE ));
+    }
+}
+
+typedef void AccumulateFunc(f32 *dst, const f32 *src, u32 frameCount, f32 gain0, f32 gain1);
+typedef void BiquadFunc(AudioBiquad &biquad, f32 *samples, u32 frameCount);
+typedef void ReverbFunc(AudioReverb &reverb, const f32 *input, f32 *output, u32 frameCount);
+
+// Average microseconds per callback to filter, scale and send one bus, and to run the reverb
+static void BenchmarkBus(AccumulateFunc *accumulate, BiquadFunc *biquad, ReverbFunc *reverbFunc, f32 &busMicros, f32 &reverbMicros)
+{
+    Arena arena = gArena;
+    f32 *samples = PushZeroArray(arena, f32, SOURCE_FRAME_COUNT * 2);
+    MixSamples(samples, gSources[3], SOURCE_FRAME_COUNT, 0.5f, 0.5f);
+    f32 *master = PushZeroArray(arena, f32, BENCHMARK_FRAMES_PER_CALLBACK * 2);
+    f32 *send = PushZeroArray(arena, f32, BENCHMARK_FRAMES_PER_CALLBACK * 2);
+
+    AudioBiquad filters[AudioFilter_COUNT] = {};
+    InitializeBiquad(filters[AudioFilter_LowPass], AudioFilter_LowPass, 8000.0f, AUDIO_BUTTERWORTH_Q, AUDIO_SAMPLE_RATE);
+    InitializeBiquad(filters[AudioFilter_HighPass], AudioFilter_HighPass, 80.0f, AUDIO_BUTTERWORTH_Q, AUDIO_SAMPLE_RATE);
+    AudioReverb reverb;
+    InitializeReverb(reverb, arena);
+
+    const u32 callbackCount = SOURCE_FRAME_COUNT / BENCHMARK_FRAMES_PER_CALLBACK;
+    f32 busSeconds = 0.0f;
+    f32 reverbSeconds = 0.0f;
+    for (u32 frame = 0; frame + BENCHMARK_FRAMES_PER_CALLBACK <= SOURCE_FRAME_COUNT; frame += BENCHMARK_FRAMES_PER_CALLBACK)
+    {
+        f32 *busSamples = samples + frame * 2;
+
+        const Clock begin = GetClock();
+        biquad(filters[AudioFilter_LowPass], busSamples, BENCHMARK_FRAMES_PER_CALLBACK);
+        biquad(filters[AudioFilter_HighPass], busSamples, BENCHMARK_FRAMES_PER_CALLBACK);
+        accumulate(master, busSamples, BENCHMARK_FRAMES_PER_CALLBACK, 1.0f, 0.9f);
+        accumulate(send, busSamples, BENCHMARK_FRAMES_PER_CALLBACK, 0.3f, 0.3f);
+        const Clock filtered = GetClock();
+        reverbFunc(reverb, send, master, BENCHMARK_FRAMES_PER_CALLBACK);
+        const Clock end = GetClock();
+
+        busSeconds += GetSecondsElapsed(begin, filtered);
+        reverbSeconds += GetSecondsElapsed(filtered, end);
+    }
+
+    busMicros = Min(busMicros, 1e6f * busSeconds / callbackCount);
+    reverbMicros = Min(reverbMicros, 1e6f * reverbSeconds / callbackCount);
+}
+
+void BenchmarkBuses()
+{
+    TEST_SECTION("Benchmark (bus effects per 480 frame callback)");
+
+    f32 scalarBusMicros = 1e9f, simdBusMicros = 1e9f;
+    f32 scalarReverbMicros = 1e9f, simdReverbMicros = 1e9f;
+    for (u32 iteration = 0; iteration < BENCHMARK_ITERATIONS; ++iteration)
+    {
+        BenchmarkBus(AccumulateSamplesScalar, ProcessBiquadScalar, ProcessReverbScalar, scalarBusMicros, scalarReverbMicros);
+        BenchmarkBus(AccumulateSamples, ProcessBiquad, ProcessReverb, simdBusMicros, simdReverbMicros);
+    }
+
+    LOG(Info, "%-10s %18s %12s\n", "", "Bus, 2 filters (us)", "Reverb (us)");
+    LOG(Info, "%-10s %18.2f %12.2f\n", "Scalar", scalarBusMicros, scalarReverbMicros);
+    LOG(Info, "%-10s %18.2f %12.2f\n", "SIMD", simdBusMicros, simdReverbMicros);
+    LOG(Info, "Speedup: bus %.2fx, reverb %.2fx\n", scalarBusMicros / simdBusMicros, scalarReverbMicros / simdReverbMicros);
+}
+
+// Decodes one second of ADPCM per voice in chunks, as the streamer does, against copying
+// one second of PCM. Also reports the bytes read per second and the chunk memory.
+void BenchmarkAdpcm()
+{
+    TEST_SECTION("Benchmark (decoding 1 second of ADPCM per voice)");
+
+    Arena arena = gArena;
+    i16 *samples = PushArray(arena, i16, SOURCE_FRAME_COUNT * 2);
+    MakeTones(samples, SOURCE_FRAME_COUNT);
+    const u32 pcmSize = SOURCE_FRAME_COUNT * 2 * sizeof(i16);
+    const u32 adpcmSize = AdpcmEncodedSize(SOURCE_FRAME_COUNT);
+    byte *blocks = PushArray(arena, byte, adpcmSize);
+    EncodeAdpcm(samples, SOURCE_FRAME_COUNT, blocks);
+    i16 *output = PushArray(arena, i16, SOURCE_FRAME_COUNT * 2);
+
+    const u32 chunkFrameCount = AUDIO_CHUNK_SAMPLE_COUNT / 2;
+    const u32 chunkBlockCount = chunkFrameCount / AUDIO_ADPCM_BLOCK_FRAMES;
+
+    f32 pcmMicros = 1e9f;
+    f32 adpcmMicros = 1e9f;
+    for (u32 iteration = 0; iteration < BENCHMARK_ITERATIONS; ++iteration)
+    {
+        const Clock begin = GetClock();
+        for (u32 frame = 0; frame < SOURCE_FRAME_COUNT; frame += chunkFrameCount) {
+            const u32 frameCount = Min(chunkFrameCount, SOURCE_FRAME_COUNT - frame);
+            MemCopy(output + frame * 2, samples + frame * 2, frameCount * 2 * sizeof(i16));
+        }
+        const Clock copied = GetClock();
+        for (u32 frame = 0, chunk = 0; frame < SOURCE_FRAME_COUNT; frame += chunkFrameCount, ++chunk) {
+            const u32 frameCount = Min(chunkFrameCount, SOURCE_FRAME_COUNT - frame);
+            DecodeAdpcm(blocks + chunk * chunkBlockCount * AUDIO_ADPCM_BLOCK_SIZE, frameCount, output + frame * 2);
+        }
+        const Clock end = GetClock();
+
+        pcmMicros = Min(pcmMicros, 1e6f * GetSecondsElapsed(begin, copied));
+        adpcmMicros = Min(adpcmMicros, 1e6f * GetSecondsElapsed(copied, end));
+    }
+
+    const u32 chunkMemory = MAX_AUDIO_REAL_VOICES * AUDIO_STREAM_CHUNK_COUNT * sizeof(AudioChunk);
+    const u32 decoderMemory = AdpcmEncodedSize(chunkFrameCount);
+    LOG(Info, "%-10s %14s %22s %18s\n", "", "Disk (KB/s)", "Copy or decode (us/s)", "Chunk memory (KB)");
+    LOG(Info, "%-10s %14.1f %22.1f %18u\n", "PCM", pcmSize / 1024.0f, pcmMicros, chunkMemory / 1024);
+    LOG(Info, "%-10s %14.1f %22.1f %18u\n", "ADPCM", adpcmSize / 1024.0f, adpcmMicros, ( chunkMemory + decoderMemory ) / 1024);
+    LOG(Info, "Decoding costs %.3f%% of a core per voice (%.0f voices per core)\n",
+            adpcmMicros / 1e4f, 1e6f / adpcmMicros);
+}
+
+// Renders 60 seconds of the module with each interpolation, with the scalar and SIMD mixers
+static f32 BenchmarkModReplay(struct data &data, int interpolation, int simd)
+{
+    f32 seconds = 1e9f;
+    for (u32 iteration = 0; iteration < 3; ++iteration)
+    {
+        Arena arena = gArena;
+        struct replay *replay = MakeReplay(arena, data, interpolation, simd);
+        if (!replay) {
+            return 0.0f;
+        }
+        int *mixBuf = PushArray(arena, int, calculate_mix_buf_len(AUDIO_SAMPLE_RATE));
+
+        const Clock begin = GetClock();
+        for (u32 frame = 0; frame < 60 * AUDIO_SAMPLE_RATE; ) {
+            frame += replay_get_audio(replay, mixBuf, 0);
+        }
+        seconds = Min(seconds, GetSecondsElapsed(begin, GetClock()));
+    }
+    return seconds;
+}
+
+void BenchmarkModMixer()
+{
+    TEST_SECTION("Benchmark (module player, 60 seconds)");
+
+    Arena arena = gArena;
+    struct data modules[] = { LoadModuleFile(arena, gModulePath.str), MakeModule(arena) };
+    const char *moduleNames[] = { "aurora.mod", "32 channels" };
+    Arena moduleArena = gArena;
+    gArena = arena;
+
+    LOG(Info, "%-12s %-10s %12s %12s\n", "", "", "Scalar (ms)", "SIMD (ms)");
+    for (u32 m = 0; m < ARRAY_COUNT(modules); ++m)
+    {
+        for (u32 i = 0; modules[m].buffer != nullptr && i < ARRAY_COUNT(gInterpolationNames); ++i)
+        {
+            const f32 scalarSeconds = BenchmarkModReplay(modules[m], i, 0);
+            const f32 simdSeconds = BenchmarkModReplay(modules[m], i, 1);
+            LOG(Info, "%-12s %-10s %12.1f %12.1f (%.2fx, %.0fx real time)\n", moduleNames[m], gInterpolationNames[i],
+                1e3f * scalarSeconds, 1e3f * simdSeconds, scalarSeconds / simdSeconds, 60.0f / simdSeconds);
+        }
+    }
+    gArena = moduleArena;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Main
+
+int main(int argc, char **argv)
+{
+    PrintTestTitle("Audio mixer unit tests");
+
+    gArena = MakeArena((byte*)AllocateVirtualMemory(MB(16)), MB(16), "Test");
+    InitializeTestPaths(argc > 0 ? argv[0] : "");
+    gModulePath = MakePath(gTestProjectDir.str, "assets/aurora.mod");
+    MakeSources();
+    InitializeSincFilter(gSincFilter, AUDIO_RESAMPLER_CUTOFF);
+
+    TestPanGains();
+    TestMix();
+    TestLimiter();
+    TestLimiterTransparent();
+    TestResampler();
+    TestResamplerQuality();
+    TestResampleClip();
+    TestAccumulate();
+    TestBiquad();
+    TestReverb();
+    TestAdpcm();
+    TestModMixer();
+    Benchmark();
+    BenchmarkResampler();
+    BenchmarkBuses();
+    BenchmarkAdpcm();
+    BenchmarkModMixer();
+
+    return PrintTestResults();
+}
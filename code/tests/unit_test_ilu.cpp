@@ -492,6 +492,266 @@ void TestHashing()
         u32 h2 = HashStringFNV("hello");
         TEST("HashFNV and HashStringFNV agree", h1 == h2);
     }
+
+    // HashXX64 (reference XXH64 values)
+    {
+        TEST("HashXX64 empty", HashXX64("", 0) == 0xEF46DB3751D8E999ULL);
+        TEST("HashXX64 short", HashXX64("abc", 3) == 0x44BC2CF5AD770999ULL);
+        const char *text = "Nobody inspects the spammish repetition";
+        TEST("HashXX64 stripes", HashXX64(text, StrLen(text)) == 0xFBCEA83C8A378BF1ULL);
+    }
+    {
+        u64 h1 = HashXX64("hello", 5, 0);
+        u64 h2 = HashXX64("hello", 5, 1);
+        TEST("HashXX64 different seeds differ", h1 != h2);
+    }
+    {
+        // Same bytes at a different alignment must hash the same
+        u64 aligned[8];
+        char unaligned[80] = {};
+        for (u32 i = 0; i < 64; ++i) { ((char*)aligned)[i] = (char)i; unaligned[i + 11] = (char)i; }
+        TEST("HashXX64 unaligned input", HashXX64(aligned, 64) == HashXX64(unaligned + 11, 64));
+    }
+
+    // HashXX64 streaming
+    {
+        byte data[1024];
+        for (u32 i = 0; i < sizeof(data); ++i) { data[i] = (byte)(i * 31 + 7); }
+
+        static const u32 chunkSizes[] = { 1, 3, 7, 31, 32, 33, 100, 1024 };
+        bool equal = true;
+        for (u32 size = 0; size <= sizeof(data); size += size < 80 ? 1 : 59) {
+            for (u32 c = 0; c < ARRAY_COUNT(chunkSizes); ++c) {
+                HashXX64State state = HashXX64Begin(size);
+                for (u32 offset = 0; offset < size; offset += chunkSizes[c]) {
+                    const u32 chunk = size - offset < chunkSizes[c] ? size - offset : chunkSizes[c];
+                    HashXX64Update(state, data + offset, chunk);
+                }
+                equal = equal && HashXX64End(state) == HashXX64(data, size, size);
+            }
+        }
+        TEST("HashXX64 streaming matches one shot for any split", equal);
+
+        HashXX64State state = HashXX64Begin();
+        TEST("HashXX64 streaming empty", HashXX64End(state) == 0xEF46DB3751D8E999ULL);
+    }
+
+    // HashWY64 and HashWY32
+    {
+        TEST("HashWY64 deterministic", HashWY64("hello", 5) == HashWY64("hello", 5));
+        TEST("HashWY64 different inputs differ", HashWY64("hello", 5) != HashWY64("world", 5));
+        TEST("HashWY64 different seeds differ", HashWY64("hello", 5, 0) != HashWY64("hello", 5, 1));
+        TEST("HashWY32 different seeds differ", HashWY32("hello", 5, 0) != HashWY32("hello", 5, 1));
+        TEST("HashStringWY32 matches HashWY32", HashStringWY32("hello") == HashWY32("hello", 5));
+
+        u64 aligned[16];
+        char unaligned[144] = {};
+        for (u32 i = 0; i < 128; ++i) { ((char*)aligned)[i] = (char)i; unaligned[i + 5] = (char)i; }
+        bool equal = true;
+        for (u32 size = 0; size <= 128; ++size) {
+            equal = equal && HashWY64(aligned, size) == HashWY64(unaligned + 5, size);
+        }
+        TEST("HashWY64 unaligned input", equal);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Hash quality tests, after the SMHasher avalanche, sparse key and distribution checks
+
+typedef u64 HashFunction(const void *data, u32 size, u32 seed);
+
+static u64 HashQualityXX64(const void *data, u32 size, u32 seed) { return HashXX64(data, size, seed); }
+static u64 HashQualityWY64(const void *data, u32 size, u32 seed) { return HashWY64(data, size, seed); }
+static u64 HashQualityWY32(const void *data, u32 size, u32 seed) { return HashWY32(data, size, seed); }
+
+static u64 gHashQualityRandom = 0x853c49e6748fea9bULL;
+
+static u64 HashQualityRandom()
+{
+    gHashQualityRandom ^= gHashQualityRandom << 13;
+    gHashQualityRandom ^= gHashQualityRandom >> 7;
+    gHashQualityRandom ^= gHashQualityRandom << 17;
+    return gHashQualityRandom;
+}
+
+// Flipping any input bit must flip every output bit with probability 1/2. Returns the
+// worst distance to 1/2 over all (input bit, output bit) pairs.
+static f32 HashAvalancheBias(HashFunction *hash, u32 outputBits, u32 keySize, u32 keyCount, u32 *flips)
+{
+    byte key[64];
+    const u32 inputBits = keySize * 8;
+    MemSet(flips, inputBits * outputBits * sizeof(u32), 0);
+
+    for (u32 k = 0; k < keyCount; ++k)
+    {
+        for (u32 i = 0; i < keySize; ++i) { key[i] = (byte)HashQualityRandom(); }
+        const u64 h = hash(key, keySize, 0);
+        for (u32 bit = 0; bit < inputBits; ++bit)
+        {
+            key[bit / 8] ^= 1 << (bit % 8);
+            u64 diff = h ^ hash(key, keySize, 0);
+            key[bit / 8] ^= 1 << (bit % 8);
+            u32 *row = flips + bit * outputBits;
+            for (u32 out = 0; out < outputBits; ++out, diff >>= 1) {
+                row[out] += (u32)(diff & 1);
+            }
+        }
+    }
+
+    f32 worst = 0.0f;
+    for (u32 i = 0; i < inputBits * outputBits; ++i) {
+        const f32 ratio = (f32)flips[i] / keyCount;
+        const f32 bias = ratio > 0.5f ? ratio - 0.5f : 0.5f - ratio;
+        worst = bias > worst ? bias : worst;
+    }
+    return worst;
+}
+
+// Counts repeated values with an open addressing set indexed by the values themselves
+static u32 HashCollisions(const u64 *hashes, u32 count, u64 *set, u32 setCapacity)
+{
+    const u32 mask = setCapacity - 1;
+    MemSet(set, setCapacity * sizeof(u64), 0);
+    u32 collisions = 0;
+    bool zeroSeen = false;
+    for (u32 i = 0; i < count; ++i)
+    {
+        const u64 h = hashes[i];
+        if ( h == 0 ) {
+            collisions += zeroSeen;
+            zeroSeen = true;
+            continue;
+        }
+        u32 index = (u32)(h ^ (h >> 32)) & mask;
+        while ( set[index] != 0 && set[index] != h ) { index = (index + 1) & mask; }
+        collisions += set[index] == h;
+        set[index] = h;
+    }
+    return collisions;
+}
+
+void TestHashQuality()
+{
+    TEST_SECTION("Hashing (quality)");
+
+    struct QualityHash
+    {
+        const char *name;
+        HashFunction *hash;
+        u32 bits;
+    };
+    static const QualityHash hashes[] = {
+        { "HashXX64", HashQualityXX64, 64 },
+        { "HashWY64", HashQualityWY64, 64 },
+        { "HashWY32", HashQualityWY32, 32 },
+    };
+
+    const u32 sparseKeySize = 32;
+    const u32 sparseKeyCount = 1 + 256 + 256 * 255 / 2; // Keys with up to two bits set
+    const u32 nameCount = 100000;
+    const u32 setCapacity = 1 << 18;
+    const u32 bucketCount = 4096;
+    const u64 memorySize = (u64)(64 * 8 * 64 + bucketCount) * sizeof(u32) + (u64)(nameCount + setCapacity) * sizeof(u64);
+    byte *memory = (byte*)AllocateVirtualMemory(memorySize);
+    u32 *flips = (u32*)memory;
+    u32 *buckets = flips + 64 * 8 * 64;
+    u64 *values = (u64*)(buckets + bucketCount);
+    u64 *set = values + nameCount;
+    char name[64];
+
+    for (u32 h = 0; h < ARRAY_COUNT(hashes); ++h)
+    {
+        const QualityHash &hash = hashes[h];
+
+        // Avalanche on every size class of the short and long paths
+        static const u32 keySizes[] = { 3, 8, 16, 24, 64 };
+        f32 worstBias = 0.0f;
+        for (u32 i = 0; i < ARRAY_COUNT(keySizes); ++i) {
+            const f32 bias = HashAvalancheBias(hash.hash, hash.bits, keySizes[i], 2000, flips);
+            worstBias = bias > worstBias ? bias : worstBias;
+        }
+        // 2000 keys give a deviation of 0.011 per pair, so 0.07 is over 6 deviations
+        SPrintf(name, "%s avalanche (worst bias %.3f)", hash.name, worstBias);
+        TEST(name, worstBias < 0.07f);
+
+        // Seeds must avalanche too, so seeded tables do not share collisions
+        {
+            u32 seedFlips = 0;
+            const u32 seedCount = 2000;
+            for (u32 i = 0; i < seedCount; ++i) {
+                const u32 seed = (u32)HashQualityRandom();
+                const u32 bit = i % 32;
+                const u64 diff = hash.hash("seed", 4, seed) ^ hash.hash("seed", 4, seed ^ (1u << bit));
+                for (u64 bits = diff; bits; bits &= bits - 1) { seedFlips++; }
+            }
+            const f32 ratio = (f32)seedFlips / (seedCount * hash.bits);
+            SPrintf(name, "%s seed avalanche (%.3f)", hash.name, ratio);
+            TEST(name, ratio > 0.49f && ratio < 0.51f);
+        }
+
+        // Sparse keys: 32 bytes with at most two bits set
+        {
+            byte key[sparseKeySize] = {};
+            u32 count = 0;
+            values[count++] = hash.hash(key, sparseKeySize, 0);
+            for (u32 a = 0; a < sparseKeySize * 8; ++a) {
+                key[a / 8] ^= 1 << (a % 8);
+                values[count++] = hash.hash(key, sparseKeySize, 0);
+                for (u32 b = a + 1; b < sparseKeySize * 8; ++b) {
+                    key[b / 8] ^= 1 << (b % 8);
+                    values[count++] = hash.hash(key, sparseKeySize, 0);
+                    key[b / 8] ^= 1 << (b % 8);
+                }
+                key[a / 8] ^= 1 << (a % 8);
+            }
+            ASSERT(count == sparseKeyCount);
+            // 32-bit hashes expect n^2 / 2^33 collisions, 0.13 here
+            const u32 collisions = HashCollisions(values, count, set, setCapacity);
+            SPrintf(name, "%s sparse keys (%u collisions)", hash.name, collisions);
+            TEST(name, collisions <= (hash.bits == 64 ? 0u : 2u));
+        }
+
+        // Zero bytes appended to a key must change its hash
+        {
+            byte zeros[256] = {};
+            for (u32 size = 0; size < ARRAY_COUNT(zeros); ++size) {
+                values[size] = hash.hash(zeros, size, 0);
+            }
+            SPrintf(name, "%s appended zeroes", hash.name);
+            TEST(name, HashCollisions(values, ARRAY_COUNT(zeros), set, setCapacity) == 0);
+        }
+
+        // Sequential names, as interned strings are: no collisions, and both the low and
+        // the high bits fill the buckets evenly (chi-square within 6 deviations)
+        {
+            for (u32 i = 0; i < nameCount; ++i) {
+                const u32 len = SPrintf(name, "Assets/Textures/name_%u", i);
+                values[i] = hash.hash(name, len, 0);
+            }
+            const u32 collisions = HashCollisions(values, nameCount, set, setCapacity);
+
+            f32 worstChiSquare = 0.0f;
+            for (u32 shift = 0; shift < 2; ++shift)
+            {
+                MemSet(buckets, bucketCount * sizeof(u32), 0);
+                for (u32 i = 0; i < nameCount; ++i) {
+                    const u64 h = shift ? values[i] >> (hash.bits - 12) : values[i];
+                    buckets[h & (bucketCount - 1)]++;
+                }
+                const f32 expected = (f32)nameCount / bucketCount;
+                f32 chiSquare = 0.0f;
+                for (u32 i = 0; i < bucketCount; ++i) {
+                    chiSquare += (buckets[i] - expected) * (buckets[i] - expected) / expected;
+                }
+                worstChiSquare = chiSquare > worstChiSquare ? chiSquare : worstChiSquare;
+            }
+            const f32 maxChiSquare = (bucketCount - 1) + 6.0f * Sqrt(2.0f * (bucketCount - 1));
+            SPrintf(name, "%s sequential names (%u collisions, chi-square %.0f)", hash.name, collisions, worstChiSquare);
+            TEST(name, collisions <= (hash.bits == 64 ? 0u : 3u) && worstChiSquare < maxChiSquare);
+        }
+    }
+
+    FreeVirtualMemory(memory, memorySize);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -543,6 +803,127 @@ void TestMemory()
     }
 }
 
+// Sizes around every word and vector width, the unrolled loop and the non-temporal threshold
+static const u32 gMemSizes[] = {
+    0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 24, 31, 32, 33, 47, 48, 63, 64, 65,
+    95, 96, 127, 128, 129, 191, 255, 256, 257, 1000, 4096, 4099,
+};
+
+static const char *gMemVersionNames[] = { "Words", "SSE2", "AVX2" };
+static const u32 gMemVersionFeatures[] = { 0, CpuFeature_SSE2, CpuFeature_SSE2 | CpuFeature_AVX2 };
+
+#define MEM_TEST_ALIGNMENTS 32
+#define MEM_TEST_BUFFER_SIZE ( 4099 + 2 * MEM_TEST_ALIGNMENTS + 64 )
+
+// Byte at a time references
+static bool MemMatches(const byte *a, const byte *b, u32 size)
+{
+    for (u32 i = 0; i < size; ++i) {
+        if (a[i] != b[i]) return false;
+    }
+    return true;
+}
+
+static i32 MemCompareReference(const byte *a, const byte *b, u32 size)
+{
+    for (u32 i = 0; i < size; ++i) {
+        if (a[i] != b[i]) return a[i] - b[i];
+    }
+    return 0;
+}
+
+// Copies, sets or compares every size at every source and destination alignment, checking
+// that the bytes around the destination are left untouched
+static void TestMemVersion(u32 version)
+{
+    const u32 features = gMemVersionFeatures[version];
+    if (MemUseCpuFeatures(features) != features) {
+        LOG(Info, "%s is not supported by this CPU, skipped\n", gMemVersionNames[version]);
+        return;
+    }
+
+    static byte src[MEM_TEST_BUFFER_SIZE];
+    static byte dst[MEM_TEST_BUFFER_SIZE];
+    static byte expected[MEM_TEST_BUFFER_SIZE];
+    for (u32 i = 0; i < MEM_TEST_BUFFER_SIZE; ++i) {
+        src[i] = (byte)(i * 7 + 3);
+    }
+
+    bool copyWorks = true, streamWorks = true, setWorks = true, compareWorks = true;
+    for (u32 s = 0; s < ARRAY_COUNT(gMemSizes); ++s)
+    {
+        const u32 size = gMemSizes[s];
+        for (u32 srcOffset = 0; srcOffset < MEM_TEST_ALIGNMENTS; ++srcOffset)
+        {
+            for (u32 dstOffset = 0; dstOffset < MEM_TEST_ALIGNMENTS; ++dstOffset)
+            {
+                // Copy, with a non-temporal copy for each source alignment
+                for (u32 i = 0; i < MEM_TEST_BUFFER_SIZE; ++i) dst[i] = expected[i] = 0xEE;
+                for (u32 i = 0; i < size; ++i) expected[dstOffset + i] = src[srcOffset + i];
+                gMemFunctions.copy(dst + dstOffset, src + srcOffset, size);
+                copyWorks = copyWorks && MemMatches(dst, expected, MEM_TEST_BUFFER_SIZE);
+                if (dstOffset == srcOffset) {
+                    for (u32 i = 0; i < MEM_TEST_BUFFER_SIZE; ++i) dst[i] = 0xEE;
+                    gMemFunctions.copyStream(dst + dstOffset, src + srcOffset, size);
+                    streamWorks = streamWorks && MemMatches(dst, expected, MEM_TEST_BUFFER_SIZE);
+                }
+
+                // Compare equal bytes at different alignments, then with one byte changed
+                // in the first, middle or last position
+                compareWorks = compareWorks && gMemFunctions.compare(dst + dstOffset, src + srcOffset, size) == 0;
+                for (u32 p = 0; size > 0 && p < 3; ++p)
+                {
+                    const u32 position = p == 0 ? 0 : ( p == 1 ? size / 2 : size - 1 );
+                    dst[dstOffset + position] ^= (byte)( 0x81 >> p );
+                    const i32 result = gMemFunctions.compare(dst + dstOffset, src + srcOffset, size);
+                    compareWorks = compareWorks && result != 0 &&
+                        result == MemCompareReference(dst + dstOffset, src + srcOffset, size);
+                    dst[dstOffset + position] ^= (byte)( 0x81 >> p );
+                }
+            }
+
+            // The set does not read a source
+            const u32 dstOffset = srcOffset;
+            for (u32 i = 0; i < MEM_TEST_BUFFER_SIZE; ++i) dst[i] = expected[i] = 0xEE;
+            for (u32 i = 0; i < size; ++i) expected[dstOffset + i] = (byte)size;
+            gMemFunctions.set(dst + dstOffset, size, (byte)size);
+            setWorks = setWorks && MemMatches(dst, expected, MEM_TEST_BUFFER_SIZE);
+        }
+    }
+
+    char name[128];
+    SPrintf(name, "%s MemCopy at every size and alignment", gMemVersionNames[version]);
+    TEST(name, copyWorks);
+    SPrintf(name, "%s non-temporal copy at every size and alignment", gMemVersionNames[version]);
+    TEST(name, streamWorks);
+    SPrintf(name, "%s MemSet at every size and alignment", gMemVersionNames[version]);
+    TEST(name, setWorks);
+    SPrintf(name, "%s MemCompare finds the first different byte", gMemVersionNames[version]);
+    TEST(name, compareWorks);
+
+    // Above the threshold MemCopy also uses non-temporal stores
+    const u32 largeSize = MEM_NON_TEMPORAL_THRESHOLD + 4099;
+    byte *largeSrc = (byte*)AllocateVirtualMemory(largeSize + 64);
+    byte *largeDst = (byte*)AllocateVirtualMemory(largeSize + 64);
+    for (u32 i = 0; i < largeSize; ++i) largeSrc[i + 5] = (byte)(i ^ (i >> 9));
+    largeDst[largeSize + 3] = 0xEE;
+    gMemFunctions.copy(largeDst + 3, largeSrc + 5, largeSize);
+    SPrintf(name, "%s MemCopy of %u bytes", gMemVersionNames[version], largeSize);
+    TEST(name, MemMatches(largeDst + 3, largeSrc + 5, largeSize) && largeDst[largeSize + 3] == 0xEE);
+}
+
+void TestMemoryVersions()
+{
+    TEST_SECTION("Memory (versions)");
+
+    LOG(Info, "CPU features:%s%s\n", (GetCpuFeatures() & CpuFeature_SSE2) ? " SSE2" : "",
+        (GetCpuFeatures() & CpuFeature_AVX2) ? " AVX2" : "");
+    for (u32 version = 0; version < ARRAY_COUNT(gMemVersionNames); ++version) {
+        TestMemVersion(version);
+    }
+    MemUseCpuFeatures(GetCpuFeatures());
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // Arena tests
 
@@ -672,14 +1053,302 @@ void TestArena()
     }
 }
 
+#if PLATFORM_LINUX
+// Runs the function in a child process and returns whether it crashed
+static bool CrashesInChild(void (*function)(Arena &), Arena &arena)
+{
+    const pid_t pid = fork();
+    if (pid == 0) {
+        function(arena);
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return WIFSIGNALED(status);
+}
+
+static void WritePastUsedPage(Arena &arena)
+{
+    const u64 pageSize = GetVirtualMemoryPageSize();
+    arena.base[( arena.used + pageSize - 1 ) / pageSize * pageSize + 8] = 1;
+}
+
+static void WritePastReservedRange(Arena &arena)
+{
+    arena.base[arena.size] = 1;
+}
+#endif
+
+void TestGrowableArena()
+{
+    TEST_SECTION("Growable arena");
+
+    const u64 pageSize = GetVirtualMemoryPageSize();
+
+    // Pushes across pages and commit blocks, with every byte written
+    {
+        Arena arena = MakeGrowableArena(MB(64), MB(64), "growable");
+        TEST("MakeGrowableArena commits nothing", arena.committed == 0 && arena.used == 0);
+        bool contentsKept = true;
+        byte *previous = nullptr;
+        u32 previousSize = 0;
+        for (u32 i = 0; i < 600; ++i)
+        {
+            const u32 size = 1 + ( i * 977 ) % 5000; // Odd sizes, so pushes straddle pages
+            byte *bytes = PushSize(arena, size);
+            MemSet(bytes, size, (byte)i);
+            contentsKept = contentsKept && ( !previous || ( previous[0] == (byte)(i - 1) && previous[previousSize - 1] == (byte)(i - 1) ) );
+            previous = bytes;
+            previousSize = size;
+        }
+        TEST("Growable pushes across pages keep their contents", contentsKept);
+        TEST("Growable commits whole blocks past used", arena.committed >= arena.used && arena.committed % ARENA_COMMIT_SIZE == 0);
+        TEST("Growable commits less than a block past used", arena.committed - arena.used < ARENA_COMMIT_SIZE);
+
+        // Sub-arenas grow into their part of the reserved range
+        Arena sub = PushSubArena(arena, MB(8), "sub");
+        byte *subBytes = PushSize(sub, MB(4) + 3);
+        MemSet(subBytes, MB(4) + 3, 0xAB);
+        TEST("Sub-arena of a growable arena grows", sub.used == MB(4) + 3 && subBytes[MB(4) + 2] == 0xAB);
+        TEST("Sub-arena memory follows the parent's", subBytes == arena.base + arena.used - MB(8));
+
+        // The bytes past the high-water mark are given back, and come back as zeros
+        Arena scratch = MakeGrowableArena(MB(16), MB(1), "scratch");
+        byte *bytes = PushSize(scratch, MB(8));
+        MemSet(bytes, MB(8), 0xCD);
+        ResetArena(scratch);
+        bytes = PushSize(scratch, MB(8));
+        TEST("ResetArena keeps pages below the high-water mark", bytes[MB(1) - 1] == 0xCD);
+#if PLATFORM_LINUX
+        TEST("ResetArena releases pages past the high-water mark", bytes[MB(1) + pageSize] == 0 && bytes[MB(8) - 1] == 0);
+#endif
+        TEST("ResetArena keeps the pages committed", scratch.committed >= MB(8));
+
+        FreeGrowableArena(scratch);
+        FreeGrowableArena(arena);
+        TEST("FreeGrowableArena clears the arena", arena.base == nullptr && arena.size == 0);
+    }
+
+    // Sizes above 4 GB, only touching the end
+    {
+        const u64 reserveSize = 6ull * GB(1);
+        Arena arena = MakeGrowableArena(reserveSize, reserveSize, "large");
+        PushSize(arena, 5ull * GB(1));
+        byte *tail = PushSize(arena, 16);
+        tail[15] = 0x5A;
+        TEST("Growable arenas address past 4 GB", arena.used == 5ull * GB(1) + 16 && tail[15] == 0x5A &&
+            tail == arena.base + 5ull * GB(1));
+        FreeGrowableArena(arena);
+    }
+
+    // Guard pages commit page by page
+    {
+        Arena arena = MakeGrowableArena(MB(1), MB(1), "guarded", ArenaFlag_GuardPages);
+        PushSize(arena, pageSize + 1);
+        TEST("Guarded arena commits only the pages in use", arena.committed == 2 * pageSize);
+#if PLATFORM_LINUX
+        TEST("Writing past the last used page faults", CrashesInChild(WritePastUsedPage, arena));
+        PushSize(arena, arena.size - arena.used);
+        TEST("Writing past the reserved range faults", CrashesInChild(WritePastReservedRange, arena));
+#endif
+        FreeGrowableArena(arena);
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // String interning tests
 
+#define STRING_INTERNING_THREAD_STRINGS 20000
+
+struct StringInterningThreadData
+{
+    StringInterning *interning;
+    const char *interns[STRING_INTERNING_THREAD_STRINGS];
+    volatile_u32 published;
+    volatile_u32 running;
+    volatile_u32 failures;
+    volatile_i64 finished;
+};
+
+static StringInterningThreadData gInterningThreadData;
+
+static THREAD_FUNCTION(StringInternReaderThread)
+{
+    StringInterningThreadData &data = gInterningThreadData;
+    char name[32];
+    u32 random = 12345;
+    while ( AtomicLoadAcquire(&data.running) )
+    {
+        const u32 published = AtomicLoadAcquire(&data.published);
+        if ( published > 0 ) {
+            random = random * 1664525u + 1013904223u;
+            const u32 index = random % published;
+            SPrintf(name, "thread_%u", index);
+            if ( FindStringIntern(data.interning, name) != data.interns[index] ) {
+                data.failures++;
+            }
+        }
+    }
+    AtomicIncrement(&data.finished);
+    return 0;
+}
+
+static THREAD_FUNCTION(StringInternWriterThread)
+{
+    StringInterningThreadData &data = gInterningThreadData;
+    char name[32];
+    while ( AtomicLoadAcquire(&data.running) )
+    {
+        for (u32 i = 0; i < STRING_INTERNING_THREAD_STRINGS; i += 7) {
+            SPrintf(name, "thread_%u", i);
+            const char *intern = MakeStringIntern(data.interning, name);
+            if ( !StrEq(intern, name) ) {
+                data.failures++;
+            }
+        }
+    }
+    AtomicIncrement(&data.finished);
+    return 0;
+}
+
+static void TestStringInterningThreads()
+{
+    const u32 arenaSize = MB(8);
+    byte *memory = (byte*)AllocateVirtualMemory(arenaSize);
+    Arena arena = MakeArena(memory, arenaSize, "interning threads");
+    StringInterning interning = StringInterningCreate(&arena, true);
+
+    StringInterningThreadData &data = gInterningThreadData;
+    data.interning = &interning;
+    data.running = 1;
+
+    // Two lock-free readers check the strings published so far, while a second writer
+    // interns some of the same strings as the main thread
+    static const ThreadInfo threadInfos[] = { { .globalIndex = 1 }, { .globalIndex = 2 }, { .globalIndex = 3 } };
+    CreateDetachedThread(StringInternReaderThread, threadInfos[0]);
+    CreateDetachedThread(StringInternReaderThread, threadInfos[1]);
+    CreateDetachedThread(StringInternWriterThread, threadInfos[2]);
+
+    char name[32];
+    for (u32 i = 0; i < STRING_INTERNING_THREAD_STRINGS; ++i) {
+        SPrintf(name, "thread_%u", i);
+        data.interns[i] = MakeStringIntern(&interning, name);
+        AtomicStoreRelease(&data.published, i + 1);
+    }
+
+    AtomicStoreRelease(&data.running, 0);
+    const i64 threadCount = ARRAY_COUNT(threadInfos);
+    while ( data.finished < threadCount ) {
+        SleepMillis(1);
+    }
+
+    bool unique = true;
+    for (u32 i = 0; i < STRING_INTERNING_THREAD_STRINGS; ++i) {
+        SPrintf(name, "thread_%u", i);
+        unique = unique && MakeStringIntern(&interning, name) == data.interns[i];
+    }
+    TEST("StringIntern concurrent lookups see published strings", data.failures == 0);
+    TEST("StringIntern concurrent inserts return one pointer", unique);
+
+    FreeVirtualMemory(memory, arenaSize);
+}
+
+// A reader probes the new table before a string is migrated into it, and the migration
+// finishes before it looks any further. The migration is stepped by hand.
+static void TestStringInterningMigration()
+{
+    const u32 arenaSize = MB(1);
+    byte *memory = (byte*)AllocateVirtualMemory(arenaSize);
+    Arena arena = MakeArena(memory, arenaSize, "interning migration");
+    StringInterning interning = StringInterningCreate(&arena);
+
+    // Intern strings until one of them replaces the first table
+    const char **interns = PushArray(arena, const char*, STRING_INTERNING_INITIAL_CAPACITY);
+    char name[32];
+    u32 count = 0;
+    while ( !interning.oldTable ) {
+        SPrintf(name, "migrate_%u", count);
+        interns[count++] = MakeStringIntern(&interning, name);
+    }
+
+    const StringInterningTable *table = interning.table;
+    u32 missedCount = 0;
+    for (u32 i = 0; i < count; ++i) {
+        SPrintf(name, "migrate_%u", i);
+        const u32 len = StrLen(name);
+        missedCount += FindStringIntern(table, name, len, StringInternHash(name, len)) ? 0 : 1;
+    }
+
+    bool found = true;
+    while ( interning.oldTable ) {
+        StringInterningMigrate(&interning, STRING_INTERNING_MIGRATE_STEP);
+        for (u32 i = 0; i < count; ++i) {
+            SPrintf(name, "migrate_%u", i);
+            found = found && FindStringIntern(&interning, name) == interns[i];
+        }
+    }
+
+    // All of them but the last one, inserted in the new table, are where the reader looks next
+    bool foundInPrev = true;
+    for (u32 i = 0; i + 1 < count; ++i) {
+        SPrintf(name, "migrate_%u", i);
+        const u32 len = StrLen(name);
+        foundInPrev = foundInPrev && table->prev && FindStringIntern(table->prev, name, len, StringInternHash(name, len)) == interns[i];
+    }
+
+    TEST("StringIntern new table misses strings not migrated yet", missedCount == count - 1);
+    TEST("FindStringIntern at every migration step", found);
+    TEST("StringIntern previous table still has the strings migrated meanwhile", foundInPrev);
+    TEST("FindStringIntern after the migration", FindStringIntern(&interning, "migrate_0") == interns[0]);
+
+    FreeVirtualMemory(memory, arenaSize);
+}
+
+void TestScratchStack()
+{
+    TEST_SECTION("Scratch stack");
+
+    ScratchStack stack = {};
+
+    Arena outer;
+    const u32 outerIndex = PushScratchArena(stack, outer, KB(100));
+    TEST("PushScratchArena starts at level 0", outerIndex == 0 && stack.depth == 1);
+    TEST("PushScratchArena commits the minimum size", outer.used == 0 && outer.committed >= KB(100));
+    u32 *outerData = PushArray(outer, u32, 4);
+    outerData[0] = 0xCAFE;
+
+    Arena inner;
+    const u32 innerIndex = PushScratchArena(stack, inner, KB(1));
+    TEST("Nested scratch takes the next level", innerIndex == 1 && inner.base != outer.base);
+    u32 *innerData = PushArray(inner, u32, 4);
+    innerData[0] = 0xBEEF;
+    TEST("Nested scratch leaves the outer data", outerData[0] == 0xCAFE);
+
+    // Pushing past the committed pages of the copy commits more of the reserved range
+    PushSize(inner, MB(2));
+    PopScratchArena(stack, innerIndex, inner);
+    PopScratchArena(stack, outerIndex, outer);
+    TEST("PopScratchArena unwinds the levels", stack.depth == 0 && stack.maxDepth == 2);
+    TEST("PopScratchArena keeps the high-water marks", stack.highWater[0] == 4 * sizeof(u32) && stack.highWater[1] == 4 * sizeof(u32) + MB(2));
+    TEST("PopScratchArena keeps what the copy committed", stack.arenas[1].committed >= inner.used);
+
+    Arena again;
+    PushScratchArena(stack, again, KB(1));
+    TEST("Scratch at a released level starts empty", again.base == outer.base && again.used == 0);
+    PopScratchArena(stack, 0, again);
+
+    for (u32 level = 0; level < SCRATCH_STACK_DEPTH; ++level) {
+        if ( stack.arenas[level].base ) {
+            FreeGrowableArena(stack.arenas[level]);
+        }
+    }
+}
+
 void TestStringInterning()
 {
     TEST_SECTION("String Interning");
 
-    const u32 arenaSize = MB(1);
+    const u32 arenaSize = MB(4);
     byte *memory = (byte*)AllocateVirtualMemory(arenaSize);
     Arena arena = MakeArena(memory, arenaSize, "interning");
 
@@ -717,6 +1386,52 @@ void TestStringInterning()
         const char *b = MakeStringIntern(&interning, "hello", 5);
         TEST("StringIntern with length same pointer", a == b);
     }
+
+    // A prefix of an interned string is a different string
+    {
+        const char *a = MakeStringIntern(&interning, "prefix_and_more");
+        const char *b = MakeStringIntern(&interning, "prefix_and_more", 6);
+        TEST("StringIntern prefix different pointer", a != b);
+        TEST("StringIntern prefix content", StrEq(b, "prefix"));
+    }
+
+    // Empty string
+    {
+        const char *a = MakeStringIntern(&interning, "");
+        const char *b = MakeStringIntern(&interning, "abc", 0);
+        TEST("StringIntern empty string", a == b && a[0] == 0);
+    }
+
+    // Lookups
+    {
+        TEST("FindStringIntern finds interned", FindStringIntern(&interning, "foobar") == MakeStringIntern(&interning, "foobar"));
+        TEST("FindStringIntern missing", FindStringIntern(&interning, "never interned") == NULL);
+    }
+
+    // Pointers stay stable while the table grows many times
+    {
+        const u32 count = 20000;
+        const char **interns = PushArray(arena, const char*, count);
+        char name[32];
+        for (u32 i = 0; i < count; ++i) {
+            SPrintf(name, "name_%u", i);
+            interns[i] = MakeStringIntern(&interning, name);
+        }
+        bool stable = true;
+        bool found = true;
+        for (u32 i = 0; i < count; ++i) {
+            SPrintf(name, "name_%u", i);
+            stable = stable && MakeStringIntern(&interning, name) == interns[i] && StrEq(interns[i], name);
+            found = found && FindStringIntern(&interning, name) == interns[i];
+        }
+        TEST("StringIntern table resized", interning.table->capacity >= count);
+        TEST("StringIntern stable pointers across resizes", stable);
+        TEST("FindStringIntern across resizes", found);
+        TEST("StringIntern earlier strings survive resizes", FindStringIntern(&interning, "hello") == MakeStringIntern(&interning, "hello"));
+    }
+
+    TestStringInterningMigration();
+    TestStringInterningThreads();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -760,6 +1475,42 @@ void TestFilePaths()
     }
 }
 
+void TestFileWatch()
+{
+#if USE_FILE_WATCH
+    TEST_SECTION("File Watch");
+
+    const char *dirPath = "/tmp/ilu_unit_test_file_watch";
+    mkdir(dirPath, S_IRWXU);
+
+    FileWatch watch;
+    TEST("CreateFileWatch", CreateFileWatch(watch));
+    TEST("AddFileWatchDirectory", AddFileWatchDirectory(watch, dirPath));
+
+    FilePath paths[8];
+    bool overflow = false;
+    TEST("ReadFileWatchEvents times out without changes", ReadFileWatchEvents(watch, 0, paths, ARRAY_COUNT(paths), overflow) == 0);
+
+    const FilePath filePath = MakePath(dirPath, "file.txt");
+    WriteEntireFile(filePath.str, "1", 1);
+    WriteEntireFile(filePath.str, "2", 1);
+    const u32 count = ReadFileWatchEvents(watch, 1000, paths, ARRAY_COUNT(paths), overflow);
+    bool allMatch = count > 0;
+    for (u32 i = 0; i < count; ++i) {
+        allMatch = allMatch && StrEq(paths[i].str, filePath.str);
+    }
+    TEST("ReadFileWatchEvents reports written files", allMatch && !overflow);
+
+    WriteEntireFile(filePath.str, "3", 1);
+    const u32 truncatedCount = ReadFileWatchEvents(watch, 1000, paths, 0, overflow);
+    TEST("ReadFileWatchEvents sets overflow when paths are full", truncatedCount == 0 && overflow);
+
+    DestroyFileWatch(watch);
+    remove(filePath.str);
+    rmdir(dirPath);
+#endif
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // Math tests
 
@@ -1284,6 +2035,196 @@ void TestMath()
     }
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// SIMD math tests, against the scalar versions
+
+static u32 gMathRandom = 1;
+
+static f32 MathRandom(f32 min, f32 max)
+{
+    gMathRandom = gMathRandom * 1664525u + 1013904223u;
+    return min + (max - min) * (f32)(gMathRandom >> 8) / (f32)(1 << 24);
+}
+
+static float4x4 RandomMatrix()
+{
+    float4x4 m;
+    for (u32 i = 0; i < 16; ++i) {
+        m.mat[i / 4][i % 4] = MathRandom(-4.0f, 4.0f);
+    }
+    return m;
+}
+
+static float4x4 RandomTransform()
+{
+    const float3 axis = Normalize(Float3(MathRandom(-1.0f, 1.0f), MathRandom(-1.0f, 1.0f), MathRandom(0.1f, 1.0f)));
+    const float4x4 translate = Translate(Float3(MathRandom(-100.0f, 100.0f), MathRandom(-100.0f, 100.0f), MathRandom(-100.0f, 100.0f)));
+    const float4x4 rotate = Rotate(axis, MathRandom(0.0f, 360.0f));
+    const float4x4 scale = Scale(Float3(MathRandom(0.5f, 4.0f), MathRandom(0.5f, 4.0f), MathRandom(0.5f, 4.0f)));
+    return MulScalar(translate, MulScalar(rotate, scale));
+}
+
+// SSE adds in the same order as the scalar code, NEON fuses the multiply-adds
+static bool MathClose(f32 a, f32 b, f32 scale)
+{
+#if USE_MATH_NEON
+    const f32 diff = a > b ? a - b : b - a;
+    return diff <= 1e-6f * scale;
+#else
+    return a == b;
+#endif
+}
+
+static bool MathClose(const float4x4 &a, const float4x4 &b, f32 scale)
+{
+    bool close = true;
+    for (u32 i = 0; i < 16; ++i) {
+        close = close && MathClose(a.mat[i / 4][i % 4], b.mat[i / 4][i % 4], scale);
+    }
+    return close;
+}
+
+static bool MathNear(const float4x4 &a, const float4x4 &b, f32 tolerance)
+{
+    bool near = true;
+    for (u32 i = 0; i < 16; ++i) {
+        const f32 x = a.mat[i / 4][i % 4], y = b.mat[i / 4][i % 4];
+        const f32 diff = x > y ? x - y : y - x;
+        const f32 size = y > 0.0f ? y : -y;
+        near = near && diff <= tolerance * (1.0f + size);
+    }
+    return near;
+}
+
+void TestMathSimd()
+{
+    TEST_SECTION("Math (SIMD)");
+#if USE_MATH_SSE
+    LOG(Info, "Math kernels: SSE2\n");
+#elif USE_MATH_NEON
+    LOG(Info, "Math kernels: NEON\n");
+#else
+    LOG(Info, "Math kernels: scalar\n");
+#endif
+
+    const u32 iterations = 1000;
+
+    {
+        bool vectorsMatch = true, matricesMatch = true, transposesMatch = true;
+        for (u32 i = 0; i < iterations; ++i) {
+            const float4x4 a = RandomMatrix();
+            const float4x4 b = RandomMatrix();
+            const float4 v = { MathRandom(-8.0f, 8.0f), MathRandom(-8.0f, 8.0f), MathRandom(-8.0f, 8.0f), MathRandom(-8.0f, 8.0f) };
+            const float4 res = Mul(a, v);
+            const float4 ref = MulScalar(a, v);
+            for (u32 j = 0; j < 4; ++j) {
+                vectorsMatch = vectorsMatch && MathClose(res.vec[j], ref.vec[j], 128.0f);
+            }
+            matricesMatch = matricesMatch && MathClose(Mul(a, b), MulScalar(a, b), 64.0f);
+            const float4x4 t = Transpose(a);
+            const float4x4 tRef = TransposeScalar(a);
+            transposesMatch = transposesMatch && MemCompare(&t, &tRef, sizeof(t)) == 0;
+        }
+        TEST("Mul float4x4 * float4 matches scalar", vectorsMatch);
+        TEST("Mul float4x4 * float4x4 matches scalar", matricesMatch);
+        TEST("Transpose matches scalar", transposesMatch);
+    }
+
+    // Inverse uses a different expansion than InverseScalar, so compare with a tolerance
+    {
+        bool inversesMatch = true, identities = true, transforms = true;
+        for (u32 i = 0; i < iterations; ++i) {
+            const float4x4 m = RandomMatrix();
+            const float4x4 inv = Inverse(m);
+            const float4x4 invRef = InverseScalar(m);
+            const float4x4 mInvRef = MulScalar(m, invRef);
+            // Skip badly conditioned matrices, where neither version is accurate
+            if ( !MathNear(mInvRef, Eye(), 1e-4f) ) continue;
+            inversesMatch = inversesMatch && MathNear(inv, invRef, 1e-3f);
+            identities = identities && MathNear(MulScalar(m, inv), Eye(), 1e-3f);
+
+            const float4x4 transform = RandomTransform();
+            transforms = transforms && MathNear(MulScalar(Inverse(transform), transform), Eye(), 1e-4f);
+        }
+        TEST("Inverse matches scalar", inversesMatch);
+        TEST("Inverse times matrix is identity", identities);
+        TEST("Inverse of translate-rotate-scale", transforms);
+
+        const float4x4 inv = Inverse(Translate(Float3(1.0f, 2.0f, 3.0f)));
+        TEST("Inverse of translation", inv.m30 == -1.0f && inv.m31 == -2.0f && inv.m32 == -3.0f && inv.m00 == 1.0f);
+    }
+
+    // Every batch length, to cover the four-point blocks and the tail
+    {
+        float3 points[19];
+        float3 res[19];
+        bool pointsMatch = true, inPlace = true;
+        for (u32 count = 0; count <= ARRAY_COUNT(points); ++count) {
+            const float4x4 m = RandomTransform();
+            for (u32 i = 0; i < count; ++i) {
+                points[i] = Float3(MathRandom(-10.0f, 10.0f), MathRandom(-10.0f, 10.0f), MathRandom(-10.0f, 10.0f));
+            }
+            MulPoints(m, points, res, count);
+            for (u32 i = 0; i < count; ++i) {
+                const float3 ref = MulScalar(m, Float4(points[i], 1.0f)).xyz;
+                for (u32 j = 0; j < 3; ++j) {
+                    pointsMatch = pointsMatch && MathClose(res[i].vec[j], ref.vec[j], 1024.0f);
+                }
+            }
+            MulPoints(m, points, points, count);
+            inPlace = inPlace && MemCompare(points, res, count * sizeof(float3)) == 0;
+        }
+        TEST("MulPoints matches scalar", pointsMatch);
+        TEST("MulPoints in place", inPlace);
+    }
+
+    {
+        float4x4 matrices[7];
+        float4x4 res[7];
+        const float4x4 a = RandomMatrix();
+        for (u32 i = 0; i < ARRAY_COUNT(matrices); ++i) {
+            matrices[i] = RandomMatrix();
+        }
+        MulMatrices(a, matrices, res, ARRAY_COUNT(matrices));
+        bool match = true;
+        for (u32 i = 0; i < ARRAY_COUNT(matrices); ++i) {
+            match = match && MathClose(res[i], MulScalar(a, matrices[i]), 64.0f);
+        }
+        TEST("MulMatrices matches scalar", match);
+    }
+
+    {
+        bool boxesMatch = true, contained = true;
+        AABB boxes[5];
+        AABB res[5];
+        for (u32 i = 0; i < iterations; ++i) {
+            const float4x4 m = RandomTransform();
+            const float3 a = Float3(MathRandom(-10.0f, 10.0f), MathRandom(-10.0f, 10.0f), MathRandom(-10.0f, 10.0f));
+            const AABB box = { .min = a, .max = Float3(a.x + MathRandom(0.0f, 5.0f), a.y + MathRandom(0.0f, 5.0f), a.z + MathRandom(0.0f, 5.0f)) };
+            const AABB bounds = TransformAABB(m, box);
+            const AABB ref = TransformAABBScalar(m, box);
+            for (u32 j = 0; j < 3; ++j) {
+                boxesMatch = boxesMatch && MathClose(bounds.min.vec[j], ref.min.vec[j], 1024.0f) && MathClose(bounds.max.vec[j], ref.max.vec[j], 1024.0f);
+            }
+            for (u32 corner = 0; corner < 8; ++corner) {
+                const float3 p = Float3(corner & 1 ? box.max.x : box.min.x, corner & 2 ? box.max.y : box.min.y, corner & 4 ? box.max.z : box.min.z);
+                const float3 q = MulPoint(m, p);
+                for (u32 j = 0; j < 3; ++j) {
+                    contained = contained && q.vec[j] >= bounds.min.vec[j] - 1e-3f && q.vec[j] <= bounds.max.vec[j] + 1e-3f;
+                }
+            }
+            boxes[i % ARRAY_COUNT(boxes)] = box;
+        }
+        TEST("TransformAABB matches scalar", boxesMatch);
+        TEST("TransformAABB contains the transformed corners", contained);
+
+        const float4x4 m = RandomTransform();
+        TransformAABBs(m, boxes, res, ARRAY_COUNT(boxes));
+        TransformAABBs(m, boxes, boxes, ARRAY_COUNT(boxes));
+        TEST("TransformAABBs in place", MemCompare(boxes, res, sizeof(boxes)) == 0);
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // Alignment tests
 
@@ -1399,6 +2340,126 @@ void TestClock()
     }
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Threading tests
+
+#define THREADING_TEST_THREADS 4
+#define THREADING_TEST_ITERATIONS 50000
+
+struct ThreadingTestData
+{
+    Mutex mutex;
+    u32 counter; // Protected by mutex
+    Semaphore semaphore;
+    volatile_u32 acquired;
+    Event pingEvent;
+    Event pongEvent;
+    volatile_i64 finished;
+};
+
+static ThreadingTestData gThreadingData;
+
+static THREAD_FUNCTION(MutexCounterThread)
+{
+    ThreadingTestData &data = gThreadingData;
+    for (u32 i = 0; i < THREADING_TEST_ITERATIONS; ++i) {
+        MutexScope scope(data.mutex);
+        data.counter++;
+    }
+    AtomicIncrement(&data.finished);
+    return 0;
+}
+
+static THREAD_FUNCTION(SemaphoreWaitThread)
+{
+    ThreadingTestData &data = gThreadingData;
+    WaitSemaphore(data.semaphore);
+    AtomicFetchAdd(&data.acquired, 1);
+    AtomicIncrement(&data.finished);
+    return 0;
+}
+
+static THREAD_FUNCTION(EventPongThread)
+{
+    ThreadingTestData &data = gThreadingData;
+    for (u32 i = 0; i < 1000; ++i) {
+        WaitEvent(data.pingEvent);
+        SignalEvent(data.pongEvent);
+    }
+    AtomicIncrement(&data.finished);
+    return 0;
+}
+
+static void WaitThreadingTestThreads(i64 count)
+{
+    while ( gThreadingData.finished < count ) {
+        SleepMillis(1);
+    }
+    gThreadingData.finished = 0;
+}
+
+void TestThreading()
+{
+    TEST_SECTION("Threading");
+
+    ThreadingTestData &data = gThreadingData;
+    static const ThreadInfo threadInfos[THREADING_TEST_THREADS] = {
+        { .globalIndex = 1 }, { .globalIndex = 2 }, { .globalIndex = 3 }, { .globalIndex = 4 },
+    };
+
+    // Mutex
+    {
+        CreateMutex(data.mutex);
+        TEST("TryLockMutex on unlocked mutex", TryLockMutex(data.mutex));
+        TEST("TryLockMutex on locked mutex fails", !TryLockMutex(data.mutex));
+        UnlockMutex(data.mutex);
+
+        for (u32 i = 0; i < THREADING_TEST_THREADS; ++i) {
+            CreateDetachedThread(MutexCounterThread, threadInfos[i]);
+        }
+        WaitThreadingTestThreads(THREADING_TEST_THREADS);
+        TEST("Mutex serializes contended increments", data.counter == THREADING_TEST_THREADS * THREADING_TEST_ITERATIONS);
+        TEST("Mutex is unlocked after contention", TryLockMutex(data.mutex));
+        UnlockMutex(data.mutex);
+        DestroyMutex(data.mutex);
+    }
+
+    // Semaphore
+    {
+        CreateSemaphore(data.semaphore, 1, THREADING_TEST_THREADS);
+        for (u32 i = 0; i < THREADING_TEST_THREADS; ++i) {
+            CreateDetachedThread(SemaphoreWaitThread, threadInfos[i]);
+        }
+        SleepMillis(20);
+        TEST("Semaphore releases initial count only", AtomicLoadAcquire(&data.acquired) == 1);
+        for (u32 i = 1; i < THREADING_TEST_THREADS; ++i) {
+            SignalSemaphore(data.semaphore);
+        }
+        WaitThreadingTestThreads(THREADING_TEST_THREADS);
+        TEST("Semaphore signals wake every waiter", data.acquired == THREADING_TEST_THREADS);
+    }
+
+    // Event
+    {
+        CreateEvent(data.pingEvent);
+        CreateEvent(data.pongEvent);
+        TEST("WaitEvent times out when not signaled", !WaitEvent(data.pingEvent, 10));
+        SignalEvent(data.pingEvent);
+        SignalEvent(data.pingEvent);
+        TEST("WaitEvent returns when signaled", WaitEvent(data.pingEvent, 10));
+        TEST("Event signals do not accumulate", !WaitEvent(data.pingEvent, 10));
+
+        CreateDetachedThread(EventPongThread, threadInfos[0]);
+        bool handoffs = true;
+        for (u32 i = 0; i < 1000; ++i) {
+            SignalEvent(data.pingEvent);
+            handoffs = handoffs && WaitEvent(data.pongEvent, 1000);
+        }
+        WaitThreadingTestThreads(1);
+        TEST("Event ping-pong between threads", handoffs);
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // Sized types tests
 
@@ -1455,14 +2516,21 @@ int main()
     TestIntrinsics();
     TestStrings();
     TestHashing();
+    TestHashQuality();
     TestMemory();
+    TestMemoryVersions();
     TestArena();
+    TestGrowableArena();
+    TestScratchStack();
     TestStringInterning();
     TestFilePaths();
+    TestFileWatch();
     TestMath();
+    TestMathSimd();
     TestAlignment();
     TestTicks();
     TestClock();
+    TestThreading();
 
     LOG(Info, "\n" ANSI_BOLD "====================================\n" ANSI_RESET);
     if (gTestsFailed == 0) {